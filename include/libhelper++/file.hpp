@@ -0,0 +1,118 @@
+//===----------------------------- file -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                            C++ Layer
+ *
+ *  `libhelper::file` owns a file_t, and closes it - and unmaps it, if
+ *  it was mapped - when it goes out of scope. It can be moved but not
+ *  copied. file_t keeps the pointer to its path rather than a copy, so
+ *  the wrapper holds its own copy of the path for as long as the file_t
+ *  lives.
+ *
+ *  Nothing here throws. A file that couldn't be loaded or mapped is
+ *  empty, and tests false.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_PP_FILE_HPP_
+#define _LIBHELPER_PP_FILE_HPP_
+
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+
+extern "C" {
+#include "libhelper/file.h"
+}
+
+#include "libhelper++/span.hpp"
+
+namespace libhelper {
+
+class file {
+public:
+    file () noexcept = default;
+
+    /**
+     *  Use `file::load()` to open `path`, which is copied. Returns an
+     *  empty file if it can't be opened, or the copy can't be made.
+     */
+    static file load (std::string_view path) noexcept
+    {
+        file f;
+        f.path_.reset (new (std::nothrow) char[path.size () + 1]);
+        if (!f.path_)
+            return f;
+
+        std::memcpy (f.path_.get (), path.data (), path.size ());
+        f.path_[path.size ()] = '\0';
+
+        f.file_.reset (file_load (f.path_.get ()));
+        if (!f.file_)
+            f.path_.reset ();
+        return f;
+    }
+
+    explicit operator bool () const noexcept { return file_ != nullptr; }
+
+    file_t         *get () const noexcept { return file_.get (); }
+    const char     *path () const noexcept { return path_.get (); }
+    std::size_t     size () const noexcept { return (file_) ? file_->size : 0; }
+
+    /**
+     *  Use `map()` to map the whole file with `file_map()`, and `bytes()`
+     *  for the mapping made by an earlier `map()`. Both are empty if
+     *  there's no mapping. The mapping lasts as long as the file.
+     */
+    span<const std::uint8_t> map (int flags = 0) noexcept
+    {
+        const unsigned char *data = (file_) ? file_map (file_.get (), flags) : nullptr;
+        return (data) ? span<const std::uint8_t> (data, file_->size) : span<const std::uint8_t> ();
+    }
+
+    span<const std::uint8_t> bytes () const noexcept
+    {
+        return (file_ && file_->data) ? span<const std::uint8_t> (file_->data, file_->size)
+                                      : span<const std::uint8_t> ();
+    }
+
+private:
+    struct closer {
+        void operator() (file_t *f) const noexcept { file_close (f); }
+    };
+
+    std::unique_ptr<char[]>             path_;
+    std::unique_ptr<file_t, closer>     file_;
+};
+
+} // namespace libhelper
+
+#endif /* _libhelper_pp_file_hpp_ */
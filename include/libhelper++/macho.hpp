@@ -0,0 +1,670 @@
+//===----------------------------- macho ----------------------------===//
+//
+//                         Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                            C++ Layer
+ *
+ *  `libhelper::macho` owns a macho_t, and usually the mapped file it was
+ *  parsed from. Everything it hands out is a view straight into that
+ *  mapping: load commands, segments, sections and symbols are a pointer
+ *  or two each, names are `std::string_view`s and contents are spans.
+ *  Nothing is copied, and the views are valid for as long as the macho.
+ *
+ *  When a macho is made, the load commands are walked once to record
+ *  where each one and each 64-bit segment starts, and where the symbol
+ *  and string tables are. That's what makes the ranges random access:
+ *
+ *      auto m = libhelper::macho::load ("/usr/lib/dyld");
+ *      for (auto seg : m.segments ())
+ *          for (auto sect : seg.sections ())
+ *              use (sect.name (), sect.data ());
+ *
+ *      auto syms = m.symbols ();
+ *      std::sort (order.begin (), order.end (), [&] (auto a, auto b) {
+ *          return syms[a].value () < syms[b].value ();
+ *      });
+ *
+ *  Every offset and size is checked against the file when the views are
+ *  made: a load command that runs past `sizeofcmds` ends the walk, and
+ *  sections, segment data and the symbol and string tables are clamped
+ *  to the file. As in the C parser, only 64-bit Mach-Os are handled.
+ *
+ *  Load commands can be read as their struct by LC_* id, with the type
+ *  and minimum size coming from the descriptor table in
+ *  macho-command-table.h, or visited with their typed struct:
+ *
+ *      m.visit ([&] (auto lc, const auto &cmd) {
+ *          if constexpr (decltype (lc)::cmd == LC_UUID)
+ *              use (cmd.uuid);
+ *      });
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_PP_MACHO_HPP_
+#define _LIBHELPER_PP_MACHO_HPP_
+
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "libhelper-macho/macho.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-command-table.h"
+#include "libhelper-macho/macho-segment.h"
+#include "libhelper-macho/macho-symbol.h"
+}
+
+#include "libhelper++/file.hpp"
+#include "libhelper++/span.hpp"
+
+namespace libhelper {
+
+using bytes_view = span<const std::uint8_t>;
+
+namespace detail {
+
+// A fixed width name, like segname, which is only NUL terminated if
+// it's shorter than the field.
+template <std::size_t N>
+inline std::string_view fixed_name (const char (&name)[N]) noexcept
+{
+    const void *nul = std::memchr (name, '\0', N);
+    return std::string_view (name, (nul) ? static_cast<const char *> (nul) - name : N);
+}
+
+// A NUL terminated string at `off` in `data`, cut off at `size`.
+inline std::string_view cstring (const char *data, std::size_t size, std::size_t off) noexcept
+{
+    if (off >= size)
+        return std::string_view ();
+    const void *nul = std::memchr (data + off, '\0', size - off);
+    return std::string_view (data + off, (nul) ? static_cast<const char *> (nul) - (data + off) : size - off);
+}
+
+// [off, off + len) of `file`, clamped to it.
+inline bytes_view clamp (bytes_view file, std::uint64_t off, std::uint64_t len) noexcept
+{
+    if (off >= file.size ())
+        return bytes_view ();
+    if (len > file.size () - off)
+        len = file.size () - off;
+    return file.subspan (off, len);
+}
+
+} // namespace detail
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Load Commands                        									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  `command_traits<LC_*>` is the descriptor table entry for a command
+ *  type: its struct `type`, `name`, `min_size` and the offset of its
+ *  lc_str field, `string_field`. Types that aren't in the table, like
+ *  `unknown_command`, are read as a mach_load_command_t.
+ */
+template <std::uint32_t Cmd>
+struct command_traits {
+    using type = mach_load_command_t;
+    static constexpr std::uint32_t  cmd = Cmd;
+    static constexpr bool           known = false;
+    static constexpr const char    *name = "LC_UNKNOWN";
+    static constexpr std::uint32_t  min_size = sizeof (mach_load_command_t);
+    static constexpr std::uint32_t  string_field = 0;
+};
+
+#define LIBHELPER_PP_COMMAND_TRAITS(NAME, TYPE, MIN_SIZE, STR)      \
+    template <>                                                     \
+    struct command_traits<NAME> {                                   \
+        using type = TYPE;                                          \
+        static constexpr std::uint32_t  cmd = NAME;                 \
+        static constexpr bool           known = true;               \
+        static constexpr const char    *name = #NAME;               \
+        static constexpr std::uint32_t  min_size = MIN_SIZE;        \
+        static constexpr std::uint32_t  string_field = STR;         \
+    };
+
+MACH_LOAD_COMMANDS (LIBHELPER_PP_COMMAND_TRAITS)
+
+#undef LIBHELPER_PP_COMMAND_TRAITS
+
+using unknown_command = command_traits<0>;
+
+
+class load_command {
+public:
+    load_command () noexcept = default;
+    load_command (bytes_view file, std::uint32_t offset) noexcept : file_ (file), off_ (offset) {}
+
+    const mach_load_command_t &command () const noexcept
+    {
+        return *reinterpret_cast<const mach_load_command_t *> (file_.data () + off_);
+    }
+
+    std::uint32_t   cmd () const noexcept { return command ().cmd; }
+    std::uint32_t   size () const noexcept { return command ().cmdsize; }
+    std::uint32_t   offset () const noexcept { return off_; }
+    bytes_view      bytes () const noexcept { return file_.subspan (off_, size ()); }
+
+    /**
+     *  The LC_* name from the descriptor table, or "LC_UNKNOWN".
+     */
+    const char *name () const noexcept
+    {
+        const mach_load_command_desc_t *desc = mach_load_command_desc (cmd ());
+        return (desc) ? desc->name : unknown_command::name;
+    }
+
+    /**
+     *  Whether the command is at least as big as the table says.
+     */
+    bool valid () const noexcept
+    {
+        const mach_load_command_desc_t *desc = mach_load_command_desc (cmd ());
+        return size () >= ((desc) ? desc->min_size : unknown_command::min_size);
+    }
+
+    /**
+     *  The command as `T`, or nullptr if it's smaller than a `T`. Doesn't
+     *  check `cmd`.
+     */
+    template <class T>
+    const T *as () const noexcept
+    {
+        return (size () >= sizeof (T)) ? reinterpret_cast<const T *> (file_.data () + off_) : nullptr;
+    }
+
+    /**
+     *  The command as the struct for `Cmd`, like `as<LC_UUID> ()`, or
+     *  nullptr if it's another type or smaller than the table says.
+     */
+    template <std::uint32_t Cmd>
+    const typename command_traits<Cmd>::type *as () const noexcept
+    {
+        using type = typename command_traits<Cmd>::type;
+        return (cmd () == Cmd && size () >= command_traits<Cmd>::min_size)
+                    ? reinterpret_cast<const type *> (file_.data () + off_) : nullptr;
+    }
+
+    /**
+     *  Calls `f (command_traits<LC_*> (), cmd)` with the command as its
+     *  struct. Commands that aren't in the table, or are smaller than it
+     *  says, are passed as `unknown_command` and a mach_load_command_t.
+     *  The dispatch is a switch on the table index.
+     */
+    template <class F>
+    void visit (F &&f) const
+    {
+        switch (mach_load_command_index (cmd ())) {
+
+#define LIBHELPER_PP_VISIT_CASE(NAME, TYPE, MIN_SIZE, STR)                                      \
+            case MACH_LC_INDEX_##NAME:                                                          \
+                if (size () >= MIN_SIZE) {                                                      \
+                    f (command_traits<NAME> (), *reinterpret_cast<const TYPE *> (file_.data () + off_)); \
+                    return;                                                                     \
+                }                                                                               \
+                break;
+
+            MACH_LOAD_COMMANDS (LIBHELPER_PP_VISIT_CASE)
+
+#undef LIBHELPER_PP_VISIT_CASE
+
+            default:
+                break;
+        }
+        f (unknown_command (), command ());
+    }
+
+    /**
+     *  The string for an lc_str field - a 32-bit offset from the start of
+     *  the command - at byte `field` of the command, like the name of a
+     *  dylib at offsetof (mach_dylib_command_t, dylib.offset). Empty if
+     *  the field or the string isn't inside the command.
+     */
+    std::string_view string (std::size_t field) const noexcept
+    {
+        if (field + sizeof (std::uint32_t) > size ())
+            return std::string_view ();
+
+        std::uint32_t str;
+        std::memcpy (&str, file_.data () + off_ + field, sizeof (str));
+        return detail::cstring (reinterpret_cast<const char *> (file_.data () + off_), size (), str);
+    }
+
+    /**
+     *  The string for the command's own lc_str field, from the table.
+     *  Empty if the command type doesn't have one.
+     */
+    std::string_view string () const noexcept
+    {
+        const mach_load_command_desc_t *desc = mach_load_command_desc (cmd ());
+        return (desc && desc->str_offset && valid ()) ? string (desc->str_offset) : std::string_view ();
+    }
+
+private:
+    bytes_view      file_;
+    std::uint32_t   off_ = 0;
+};
+
+class load_command_range {
+public:
+    using value_type = load_command;
+    using iterator = index_iterator<load_command_range>;
+
+    load_command_range () noexcept = default;
+    load_command_range (bytes_view file, const std::uint32_t *offsets, std::size_t count) noexcept
+        : file_ (file), offs_ (offsets), n_ (count) {}
+
+    std::size_t     size () const noexcept { return n_; }
+    bool            empty () const noexcept { return n_ == 0; }
+    load_command    operator[] (std::size_t i) const noexcept { return load_command (file_, offs_[i]); }
+
+    iterator        begin () const noexcept { return iterator (*this, 0); }
+    iterator        end () const noexcept { return iterator (*this, n_); }
+
+private:
+    bytes_view              file_;
+    const std::uint32_t    *offs_ = nullptr;
+    std::size_t             n_ = 0;
+};
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Segments & Sections                  									 --*/
+//===-----------------------------------------------------------------------===//
+
+class section {
+public:
+    section () noexcept = default;
+    section (bytes_view file, const mach_section_64_t *sect) noexcept : file_ (file), sect_ (sect) {}
+
+    const mach_section_64_t &command () const noexcept { return *sect_; }
+
+    std::string_view    name () const noexcept { return detail::fixed_name (sect_->sectname); }
+    std::string_view    segment_name () const noexcept { return detail::fixed_name (sect_->segname); }
+    std::uint64_t       addr () const noexcept { return sect_->addr; }
+    std::uint64_t       size () const noexcept { return sect_->size; }
+    std::uint32_t       offset () const noexcept { return sect_->offset; }
+    std::uint32_t       flags () const noexcept { return sect_->flags; }
+
+    /**
+     *  The section's contents in the file. Empty for zero-fill sections.
+     */
+    bytes_view data () const noexcept
+    {
+        if (MACH_SECTION_IS_ZEROFILL (sect_->flags))
+            return bytes_view ();
+        return detail::clamp (file_, sect_->offset, sect_->size);
+    }
+
+private:
+    bytes_view                  file_;
+    const mach_section_64_t    *sect_ = nullptr;
+};
+
+class section_range {
+public:
+    using value_type = section;
+    using iterator = index_iterator<section_range>;
+
+    section_range () noexcept = default;
+    section_range (bytes_view file, const mach_section_64_t *first, std::size_t count) noexcept
+        : file_ (file), first_ (first), n_ (count) {}
+
+    std::size_t     size () const noexcept { return n_; }
+    bool            empty () const noexcept { return n_ == 0; }
+    section         operator[] (std::size_t i) const noexcept { return section (file_, first_ + i); }
+
+    iterator        begin () const noexcept { return iterator (*this, 0); }
+    iterator        end () const noexcept { return iterator (*this, n_); }
+
+    /**
+     *  The raw section headers.
+     */
+    span<const mach_section_64_t> commands () const noexcept { return span<const mach_section_64_t> (first_, n_); }
+
+private:
+    bytes_view                  file_;
+    const mach_section_64_t    *first_ = nullptr;
+    std::size_t                 n_ = 0;
+};
+
+class segment {
+public:
+    segment () noexcept = default;
+    segment (bytes_view file, std::uint32_t offset) noexcept : file_ (file), off_ (offset) {}
+
+    const mach_segment_command_64_t &command () const noexcept
+    {
+        return *reinterpret_cast<const mach_segment_command_64_t *> (file_.data () + off_);
+    }
+
+    std::string_view    name () const noexcept { return detail::fixed_name (command ().segname); }
+    std::uint64_t       vmaddr () const noexcept { return command ().vmaddr; }
+    std::uint64_t       vmsize () const noexcept { return command ().vmsize; }
+    std::uint64_t       fileoff () const noexcept { return command ().fileoff; }
+    std::uint64_t       filesize () const noexcept { return command ().filesize; }
+    std::uint32_t       offset () const noexcept { return off_; }
+
+    /**
+     *  The segment's contents in the file.
+     */
+    bytes_view data () const noexcept { return detail::clamp (file_, fileoff (), filesize ()); }
+
+    /**
+     *  The section headers following the segment command. Only as many
+     *  as fit in its cmdsize are used, whatever nsects says.
+     */
+    section_range sections () const noexcept
+    {
+        const mach_segment_command_64_t &seg = command ();
+        std::size_t room = (seg.cmdsize - sizeof (mach_segment_command_64_t)) / sizeof (mach_section_64_t);
+        std::size_t n = (seg.nsects < room) ? seg.nsects : room;
+        return section_range (file_, reinterpret_cast<const mach_section_64_t *> (&seg + 1), n);
+    }
+
+private:
+    bytes_view      file_;
+    std::uint32_t   off_ = 0;
+};
+
+class segment_range {
+public:
+    using value_type = segment;
+    using iterator = index_iterator<segment_range>;
+
+    segment_range () noexcept = default;
+    segment_range (bytes_view file, const std::uint32_t *offsets, std::size_t count) noexcept
+        : file_ (file), offs_ (offsets), n_ (count) {}
+
+    std::size_t     size () const noexcept { return n_; }
+    bool            empty () const noexcept { return n_ == 0; }
+    segment         operator[] (std::size_t i) const noexcept { return segment (file_, offs_[i]); }
+
+    iterator        begin () const noexcept { return iterator (*this, 0); }
+    iterator        end () const noexcept { return iterator (*this, n_); }
+
+private:
+    bytes_view              file_;
+    const std::uint32_t    *offs_ = nullptr;
+    std::size_t             n_ = 0;
+};
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Symbols                              									 --*/
+//===-----------------------------------------------------------------------===//
+
+class symbol {
+public:
+    symbol () noexcept = default;
+    symbol (const nlist *sym, std::string_view name) noexcept : sym_ (sym), name_ (name) {}
+
+    const nlist        &entry () const noexcept { return *sym_; }
+
+    std::string_view    name () const noexcept { return name_; }
+    std::uint64_t       value () const noexcept { return sym_->n_value; }
+    std::uint8_t        type () const noexcept { return sym_->n_type; }
+    std::uint8_t        sect () const noexcept { return sym_->n_sect; }
+    std::uint16_t       desc () const noexcept { return sym_->n_desc; }
+
+private:
+    const nlist        *sym_ = nullptr;
+    std::string_view    name_;
+};
+
+class symbol_range {
+public:
+    using value_type = symbol;
+    using iterator = index_iterator<symbol_range>;
+
+    symbol_range () noexcept = default;
+    symbol_range (const nlist *syms, std::size_t count, const char *strtab, std::size_t strsize) noexcept
+        : syms_ (syms), n_ (count), strtab_ (strtab), strsize_ (strsize) {}
+
+    std::size_t     size () const noexcept { return n_; }
+    bool            empty () const noexcept { return n_ == 0; }
+
+    symbol operator[] (std::size_t i) const noexcept
+    {
+        return symbol (syms_ + i, detail::cstring (strtab_, strsize_, syms_[i].n_strx));
+    }
+
+    iterator        begin () const noexcept { return iterator (*this, 0); }
+    iterator        end () const noexcept { return iterator (*this, n_); }
+
+    /**
+     *  The raw symbol table entries.
+     */
+    span<const nlist> entries () const noexcept { return span<const nlist> (syms_, n_); }
+
+private:
+    const nlist    *syms_ = nullptr;
+    std::size_t     n_ = 0;
+    const char     *strtab_ = nullptr;
+    std::size_t     strsize_ = 0;
+};
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Mach-O                               									 --*/
+//===-----------------------------------------------------------------------===//
+
+class macho {
+public:
+    macho () noexcept = default;
+
+    /**
+     *  Use `macho::load()` to map a thin Mach-O and parse it straight from
+     *  the mapping. Returns an empty macho if the file can't be mapped or
+     *  isn't a thin 64-bit Mach-O.
+     */
+    static macho load (std::string_view path)
+    {
+        return from_file (file::load (path));
+    }
+
+    /**
+     *  Use `macho::from_file()` to parse an already loaded file, which the
+     *  macho takes over. The file is mapped if it isn't already.
+     */
+    static macho from_file (file f)
+    {
+        macho m;
+        bytes_view data = f.map ();
+        if (data.size () < sizeof (mach_header_t) || data.size () > UINT32_MAX)
+            return m;
+
+        macho_t *parsed = macho_create_from_buffer (const_cast<char *> (f.path ()),
+                                                    const_cast<std::uint8_t *> (data.data ()),
+                                                    static_cast<std::uint32_t> (data.size ()));
+        if (parsed) {
+            m.file_ = std::move (f);
+            m.reset (parsed, 0);
+        }
+        return m;
+    }
+
+    /**
+     *  Use `macho::adopt()` to take ownership of a macho_t from the C API.
+     *  Its data must outlive the macho. For one from
+     *  `macho_create_embedded()`, `header_offset` is the offset it was
+     *  created with, as offsets in the view are relative to the container.
+     */
+    static macho adopt (macho_t *parsed, std::uint32_t header_offset = 0)
+    {
+        macho m;
+        if (parsed)
+            m.reset (parsed, header_offset);
+        return m;
+    }
+
+    explicit operator bool () const noexcept { return macho_ != nullptr; }
+
+    macho_t                *get () const noexcept { return macho_.get (); }
+    const char             *path () const noexcept { return (macho_) ? macho_->path : nullptr; }
+    const mach_header_t    &header () const noexcept { return *macho_->header; }
+    std::uint32_t           header_offset () const noexcept { return header_off_; }
+    bytes_view              bytes () const noexcept { return data_; }
+
+    load_command_range load_commands () const noexcept
+    {
+        return load_command_range (data_, lc_offsets_.data (), lc_offsets_.size ());
+    }
+
+    segment_range segments () const noexcept
+    {
+        return segment_range (data_, seg_offsets_.data (), seg_offsets_.size ());
+    }
+
+    symbol_range symbols () const noexcept
+    {
+        return symbol_range (syms_, nsyms_, strtab_, strsize_);
+    }
+
+    /**
+     *  Calls `load_command::visit (f)` for each load command, in order.
+     */
+    template <class F>
+    void visit (F &&f) const
+    {
+        for (load_command lc : load_commands ())
+            lc.visit (f);
+    }
+
+    /**
+     *  Segment and section lookup by name. Both return false, and leave
+     *  `out` alone, if there's no match.
+     */
+    bool find_segment (std::string_view name, segment &out) const noexcept
+    {
+        for (segment seg : segments ())
+            if (seg.name () == name) {
+                out = seg;
+                return true;
+            }
+        return false;
+    }
+
+    bool find_section (std::string_view segname, std::string_view sectname, section &out) const noexcept
+    {
+        segment seg;
+        if (!find_segment (segname, seg))
+            return false;
+        for (section sect : seg.sections ())
+            if (sect.name () == sectname) {
+                out = sect;
+                return true;
+            }
+        return false;
+    }
+
+    /**
+     *  The NUL terminated string at file offset `off`.
+     */
+    std::string_view cstring (std::uint64_t off) const noexcept
+    {
+        return detail::cstring (reinterpret_cast<const char *> (data_.data ()), data_.size (), off);
+    }
+
+private:
+    struct releaser {
+        void operator() (macho_t *m) const noexcept { macho_free (m); }
+    };
+
+    void reset (macho_t *parsed, std::uint32_t header_offset)
+    {
+        macho_.reset (parsed);
+        data_ = bytes_view (parsed->data, parsed->size);
+        header_off_ = header_offset;
+        index ();
+    }
+
+    /**
+     *  Records where each load command and 64-bit segment starts, and
+     *  finds the symbol and string tables.
+     */
+    void index ()
+    {
+        std::uint64_t off = static_cast<std::uint64_t> (header_off_) + sizeof (mach_header_t);
+        std::uint64_t end = off + macho_->header->sizeofcmds;
+        if (end > data_.size ())
+            end = data_.size ();
+
+        lc_offsets_.reserve (macho_->header->ncmds);
+
+        for (std::uint32_t i = 0; i < macho_->header->ncmds && off + sizeof (mach_load_command_t) <= end; i++) {
+            const mach_load_command_t *lc = reinterpret_cast<const mach_load_command_t *> (data_.data () + off);
+            if (lc->cmdsize < sizeof (mach_load_command_t) || lc->cmdsize > end - off)
+                break;
+
+            lc_offsets_.push_back (static_cast<std::uint32_t> (off));
+
+            if (lc->cmd == LC_SEGMENT_64 && lc->cmdsize >= command_traits<LC_SEGMENT_64>::min_size)
+                seg_offsets_.push_back (static_cast<std::uint32_t> (off));
+
+            if (lc->cmd == LC_SYMTAB && lc->cmdsize >= command_traits<LC_SYMTAB>::min_size && !syms_) {
+                const mach_symtab_command_t *st = reinterpret_cast<const mach_symtab_command_t *> (lc);
+
+                bytes_view syms = detail::clamp (data_, st->symoff, static_cast<std::uint64_t> (st->nsyms) * sizeof (nlist));
+                bytes_view strs = detail::clamp (data_, st->stroff, st->strsize);
+
+                syms_ = reinterpret_cast<const nlist *> (syms.data ());
+                nsyms_ = syms.size () / sizeof (nlist);
+                strtab_ = reinterpret_cast<const char *> (strs.data ());
+                strsize_ = strs.size ();
+            }
+
+            off += lc->cmdsize;
+        }
+    }
+
+    // Declared first, so the mapping is released after the macho_t
+    file                                file_;
+    std::unique_ptr<macho_t, releaser>  macho_;
+    bytes_view                          data_;
+    std::uint32_t                       header_off_ = 0;
+
+    std::vector<std::uint32_t>          lc_offsets_;
+    std::vector<std::uint32_t>          seg_offsets_;
+
+    const nlist                        *syms_ = nullptr;
+    std::size_t                         nsyms_ = 0;
+    const char                         *strtab_ = nullptr;
+    std::size_t                         strsize_ = 0;
+};
+
+} // namespace libhelper
+
+#endif /* _libhelper_pp_macho_hpp_ */
@@ -0,0 +1,159 @@
+//===----------------------------- span -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                            C++ Layer
+ *
+ *  The pieces shared by the C++ headers: `span`, which is `std::span`
+ *  when the standard library has it and a small stand-in for C++17
+ *  otherwise, and `index_iterator`, the random-access iterator used by
+ *  every range in the layer.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_PP_SPAN_HPP_
+#define _LIBHELPER_PP_SPAN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+
+#if __cplusplus > 201703L && defined(__has_include)
+#   if __has_include(<span>)
+#       include <span>
+#       define LIBHELPER_PP_STD_SPAN   1
+#   endif
+#endif
+
+namespace libhelper {
+
+#if defined(LIBHELPER_PP_STD_SPAN)
+
+template <class T>
+using span = std::span<T>;
+
+#else
+
+/**
+ *  The subset of `std::span<T>` (with a dynamic extent) that the layer
+ *  uses, so code written against it keeps compiling under C++20.
+ */
+template <class T>
+class span {
+public:
+    using element_type = T;
+    using value_type = typename std::remove_cv<T>::type;
+    using size_type = std::size_t;
+    using pointer = T *;
+    using reference = T &;
+    using iterator = T *;
+
+    constexpr span () noexcept : data_ (nullptr), size_ (0) {}
+    constexpr span (T *data, size_type size) noexcept : data_ (data), size_ (size) {}
+
+    constexpr T        *data () const noexcept { return data_; }
+    constexpr size_type size () const noexcept { return size_; }
+    constexpr size_type size_bytes () const noexcept { return size_ * sizeof (T); }
+    constexpr bool      empty () const noexcept { return size_ == 0; }
+
+    constexpr iterator  begin () const noexcept { return data_; }
+    constexpr iterator  end () const noexcept { return data_ + size_; }
+
+    constexpr T        &operator[] (size_type i) const noexcept { return data_[i]; }
+    constexpr T        &front () const noexcept { return data_[0]; }
+    constexpr T        &back () const noexcept { return data_[size_ - 1]; }
+
+    constexpr span      first (size_type n) const noexcept { return span (data_, n); }
+    constexpr span      last (size_type n) const noexcept { return span (data_ + size_ - n, n); }
+    constexpr span      subspan (size_type off, size_type n = static_cast<size_type> (-1)) const noexcept
+    {
+        return span (data_ + off, (n == static_cast<size_type> (-1)) ? size_ - off : n);
+    }
+
+private:
+    T          *data_;
+    size_type   size_;
+};
+
+#endif
+
+
+/**
+ *  A random-access iterator over anything with `operator[] (size_t)` and
+ *  a `value_type`. The layer's ranges are a couple of pointers, so each
+ *  iterator keeps a copy and outlives the range it came from. Ranges
+ *  hand out small views by value, so `reference` is the view itself
+ *  rather than a reference to it.
+ */
+template <class Range>
+class index_iterator {
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename Range::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type;
+    using pointer = void;
+
+    constexpr index_iterator () noexcept : range_ (), i_ (0) {}
+    constexpr index_iterator (const Range &range, std::size_t i) noexcept : range_ (range), i_ (i) {}
+
+    reference        operator* () const noexcept { return range_[i_]; }
+    reference        operator[] (difference_type n) const noexcept { return range_[i_ + n]; }
+
+    index_iterator  &operator++ () noexcept { ++i_; return *this; }
+    index_iterator  &operator-- () noexcept { --i_; return *this; }
+    index_iterator   operator++ (int) noexcept { index_iterator t = *this; ++i_; return t; }
+    index_iterator   operator-- (int) noexcept { index_iterator t = *this; --i_; return t; }
+    index_iterator  &operator+= (difference_type n) noexcept { i_ += n; return *this; }
+    index_iterator  &operator-= (difference_type n) noexcept { i_ -= n; return *this; }
+
+    friend index_iterator  operator+ (index_iterator it, difference_type n) noexcept { return it += n; }
+    friend index_iterator  operator+ (difference_type n, index_iterator it) noexcept { return it += n; }
+    friend index_iterator  operator- (index_iterator it, difference_type n) noexcept { return it -= n; }
+    friend difference_type operator- (const index_iterator &a, const index_iterator &b) noexcept
+    {
+        return static_cast<difference_type> (a.i_) - static_cast<difference_type> (b.i_);
+    }
+
+    friend bool operator== (const index_iterator &a, const index_iterator &b) noexcept { return a.i_ == b.i_; }
+    friend bool operator!= (const index_iterator &a, const index_iterator &b) noexcept { return a.i_ != b.i_; }
+    friend bool operator< (const index_iterator &a, const index_iterator &b) noexcept { return a.i_ < b.i_; }
+    friend bool operator> (const index_iterator &a, const index_iterator &b) noexcept { return a.i_ > b.i_; }
+    friend bool operator<= (const index_iterator &a, const index_iterator &b) noexcept { return a.i_ <= b.i_; }
+    friend bool operator>= (const index_iterator &a, const index_iterator &b) noexcept { return a.i_ >= b.i_; }
+
+private:
+    Range           range_;
+    std::size_t     i_;
+};
+
+} // namespace libhelper
+
+#endif /* _libhelper_pp_span_hpp_ */
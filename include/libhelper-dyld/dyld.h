@@ -41,6 +41,7 @@
 
 #include "libhelper/hslist.h"
 #include "libhelper/strutils.h"
+#include "libhelper/hasync.h"
 
 
 /***********************************************************************
@@ -77,4 +78,18 @@ typedef struct dyld_cache_header        dyld_cache_header_t;
 
 dyld_cache_header_t *dyld_cache_header_create ();
 
+
+/***********************************************************************
+* Asynchronous loading.
+***********************************************************************/
+
+/**
+ *  Use `dyld_cache_load_async()` to read and check a dyld shared cache's
+ *  header on libhelper's I/O pool. `callback` is called once with the
+ *  header or an errno value, see hasync.h.
+ */
+typedef void (*dyld_cache_load_callback_t) (dyld_cache_header_t *header, int error, void *ctx);
+
+HAsync *dyld_cache_load_async (const char *path, dyld_cache_load_callback_t callback, void *ctx);
+
 #endif /* libhelper_dyld_h */
\ No newline at end of file
@@ -70,10 +70,6 @@
 #   include <mach-o/loader.h>
 #endif
 
-#define IS64(image) (*(uint8_t *)(image) & 1)
-
-#define MACHO(p) ((*(unsigned int *)(p) & ~1) == 0xfeedface)
-
 static const struct sepapp_t {
     uint64_t phys;
     uint32_t virt;
@@ -87,5 +83,6 @@ static size_t sizeof_sepapp = sizeof(struct sepapp_t);
 #define __UCHAR_MAX 255
 
 void sep_split_init (char *filename);
+void sep_split_buffer (const uint8_t *data, size_t size);
 
 #endif /* _libhelper_img4_sep_h_ */
\ No newline at end of file
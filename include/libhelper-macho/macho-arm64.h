@@ -0,0 +1,216 @@
+//===---------------------------- macho_arm64 -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_ARM64_LL_H
+#define LIBHELPER_MACHO_ARM64_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Just enough of an arm64 instruction decoder to follow addresses through
+ *  code: ADRP/ADD pairs, LDR/STR with immediate offsets, branches, and the
+ *  move-wide instructions. This isn't a disassembler, it's used by the
+ *  analysis passes (symbol matching, class extraction...) that need to
+ *  know which address an instruction sequence refers to.
+ *
+ *  All of the helpers take a raw, little-endian instruction word.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include <stdint.h>
+
+#define ARM64_REG_SP                31
+#define ARM64_REG_XZR               31
+
+/**
+ *  Sign extend the low `bits` bits of `value`.
+ */
+static inline int64_t arm64_sign_extend (uint64_t value, unsigned bits)
+{
+    uint64_t m = 1ULL << (bits - 1);
+    value &= (1ULL << bits) - 1;
+    return (int64_t) ((value ^ m) - m);
+}
+
+static inline unsigned arm64_rd (uint32_t insn) { return insn & 0x1f; }
+static inline unsigned arm64_rn (uint32_t insn) { return (insn >> 5) & 0x1f; }
+
+
+/**
+ *  ADRP Xd, page / ADR Xd, label
+ */
+static inline int arm64_is_adrp (uint32_t insn) { return (insn & 0x9f000000) == 0x90000000; }
+static inline int arm64_is_adr (uint32_t insn) { return (insn & 0x9f000000) == 0x10000000; }
+
+static inline uint64_t arm64_adrp_target (uint64_t pc, uint32_t insn)
+{
+    uint64_t imm = ((insn >> 29) & 0x3) | (((insn >> 5) & 0x7ffff) << 2);
+    return (pc & ~0xfffULL) + ((uint64_t) arm64_sign_extend (imm, 21) << 12);
+}
+
+static inline uint64_t arm64_adr_target (uint64_t pc, uint32_t insn)
+{
+    uint64_t imm = ((insn >> 29) & 0x3) | (((insn >> 5) & 0x7ffff) << 2);
+    return pc + (uint64_t) arm64_sign_extend (imm, 21);
+}
+
+
+/**
+ *  ADD Xd, Xn, #imm{, lsl #12}  (64-bit, immediate)
+ */
+static inline int arm64_is_add_imm (uint32_t insn) { return (insn & 0xff800000) == 0x91000000; }
+
+static inline uint64_t arm64_add_imm (uint32_t insn)
+{
+    uint64_t imm = (insn >> 10) & 0xfff;
+    return (insn & (1 << 22)) ? imm << 12 : imm;
+}
+
+
+/**
+ *  LDR/STR (immediate, unsigned offset) of any size. The immediate is
+ *  scaled by the access size, which arm64_ldst_imm() accounts for.
+ */
+static inline int arm64_is_ldst_uimm (uint32_t insn) { return (insn & 0x3b000000) == 0x39000000; }
+static inline int arm64_is_ldr_uimm_64 (uint32_t insn) { return (insn & 0xffc00000) == 0xf9400000; }
+static inline int arm64_is_str_uimm_64 (uint32_t insn) { return (insn & 0xffc00000) == 0xf9000000; }
+
+static inline uint64_t arm64_ldst_imm (uint32_t insn)
+{
+    unsigned size = insn >> 30;
+    // 128-bit SIMD&FP loads/stores use opc<1> with size 00
+    if ((insn & 0x04800000) == 0x04800000 && size == 0)
+        size = 4;
+    return (uint64_t) ((insn >> 10) & 0xfff) << size;
+}
+
+
+/**
+ *  B / BL label
+ */
+static inline int arm64_is_b (uint32_t insn) { return (insn & 0xfc000000) == 0x14000000; }
+static inline int arm64_is_bl (uint32_t insn) { return (insn & 0xfc000000) == 0x94000000; }
+
+static inline uint64_t arm64_branch_target (uint64_t pc, uint32_t insn)
+{
+    return pc + ((uint64_t) arm64_sign_extend (insn & 0x3ffffff, 26) << 2);
+}
+
+
+/**
+ *  RET / BR / BRAA et al. End of a straight-line block.
+ */
+static inline int arm64_is_ret (uint32_t insn) { return (insn & 0xfffffc1f) == 0xd65f0000 || (insn & 0xfffffbff) == 0xd65f0bff; }
+static inline int arm64_is_br (uint32_t insn) { return (insn & 0xfffffc1f) == 0xd61f0000 || (insn & 0xfefff800) == 0xd61f0800; }
+
+
+/**
+ *  MOVZ / MOVK / ORR Xd, XZR, #imm (MOV Xd, #imm). For MOVZ/MOVK the
+ *  value returned is already shifted into place.
+ */
+static inline int arm64_is_movz (uint32_t insn) { return (insn & 0x7f800000) == 0x52800000; }
+static inline int arm64_is_movk (uint32_t insn) { return (insn & 0x7f800000) == 0x72800000; }
+
+static inline uint64_t arm64_movw_imm (uint32_t insn)
+{
+    return (uint64_t) ((insn >> 5) & 0xffff) << (((insn >> 21) & 0x3) * 16);
+}
+
+static inline int arm64_is_orr_imm (uint32_t insn) { return (insn & 0x7f800000) == 0x32000000; }
+
+static inline uint64_t arm64_bitmask_imm (uint32_t insn)
+{
+    unsigned n = (insn >> 22) & 1, immr = (insn >> 16) & 0x3f, imms = (insn >> 10) & 0x3f;
+    unsigned bits = (n << 6) | (~imms & 0x3f), len = 6;
+    while (len && !(bits & (1u << len)))
+        len--;
+
+    unsigned esize = 1u << len, r = immr & (esize - 1), s = imms & (esize - 1);
+    uint64_t emask = (esize == 64) ? ~0ULL : (1ULL << esize) - 1;
+    uint64_t elem = (s + 1 == 64) ? ~0ULL : (1ULL << (s + 1)) - 1;
+    if (r)
+        elem = ((elem >> r) | (elem << (esize - r))) & emask;
+
+    uint64_t imm = 0;
+    for (unsigned i = 0; i < 64; i += esize)
+        imm |= elem << i;
+    return (insn >> 31) ? imm : imm & 0xffffffff;
+}
+
+static inline int arm64_is_mov_reg (uint32_t insn)
+{
+    // ORR Xd, XZR, Xm (64 and 32-bit)
+    return (insn & 0x7fe0ffe0) == 0x2a0003e0;
+}
+
+static inline unsigned arm64_rm (uint32_t insn) { return (insn >> 16) & 0x1f; }
+
+
+/**
+ *  PAC* / AUT* / XPAC* Xd. These sign or strip a pointer in place, so as
+ *  far as following addresses goes they don't change Xd.
+ */
+static inline int arm64_is_pac (uint32_t insn) { return (insn & 0xffff8000) == 0xdac10000; }
+
+
+/**
+ *  Function:   arm64_normalise
+ *  -----------------------------
+ *
+ *  Masks out the parts of an instruction that change when code is moved
+ *  or relinked - PC-relative immediates for ADRP/ADR, branches and literal
+ *  loads - so two copies of a function linked at different addresses
+ *  produce the same instruction stream.
+ *
+ *  `paged` is a bitmask of registers that currently hold the result of
+ *  an ADRP. ADD and LDR/STR immediates based on one of those registers
+ *  are page offsets, so they are masked too.
+ *
+ */
+static inline uint32_t arm64_normalise (uint32_t insn, uint32_t paged)
+{
+    if (arm64_is_adrp (insn) || arm64_is_adr (insn))
+        return insn & 0x9f00001f;
+    if (arm64_is_b (insn) || arm64_is_bl (insn))
+        return insn & 0xfc000000;
+    if ((insn & 0xff000010) == 0x54000000)          // B.cond
+        return insn & 0xff00001f;
+    if ((insn & 0x7e000000) == 0x34000000)          // CBZ/CBNZ
+        return insn & 0xff00001f;
+    if ((insn & 0x7e000000) == 0x36000000)          // TBZ/TBNZ
+        return insn & 0xfff8001f;
+    if ((insn & 0x3b000000) == 0x18000000)          // LDR (literal)
+        return insn & 0xff00001f;
+    if ((arm64_is_add_imm (insn) || arm64_is_ldst_uimm (insn)) &&
+        (paged & (1u << arm64_rn (insn))))
+        return insn & 0xffc003ff;
+    return insn;
+}
+
+#endif /* libhelper_macho_arm64_ll_h */
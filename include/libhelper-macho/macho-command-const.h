@@ -131,6 +131,7 @@
 #define LC_BUILD_VERSION 				0x32 	/* build for platform min OS version */
 #define LC_DYLD_EXPORTS_TRIE 			(0x33 | 0x80000000) 	/* used with linkedit_data_command, payload is trie */
 #define LC_DYLD_CHAINED_FIXUPS 			(0x34 | 0x80000000) 	/* used with linkedit_data_command */
+#define LC_FILESET_ENTRY 				(0x35 | 0x80000000) 	/* used with fileset_entry_command */
 
 
 #endif /* libhelper_macho_command_const_h */
\ No newline at end of file
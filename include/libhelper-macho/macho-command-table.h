@@ -0,0 +1,213 @@
+//===------------------------ macho_command_table ---------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_COMMAND_TABLE_LL_H
+#define LIBHELPER_MACHO_COMMAND_TABLE_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Everything the parser knows about each load command type, in one
+ *  place. MACH_LOAD_COMMANDS() is an X-macro with one entry per command:
+ *
+ *      X (NAME, TYPE, MIN_SIZE, STR)
+ *
+ *  NAME        The LC_* constant. Stringised it's the command's name.
+ *  TYPE        The struct the command is read as. Commands the parser has
+ *              no struct for use mach_load_command_t.
+ *  MIN_SIZE    The smallest valid cmdsize, as laid out in the file. This
+ *              is given as a number rather than sizeof (TYPE) because some
+ *              of the structs carry a pointer after an lc_str on 32-bit
+ *              hosts, and because mach_load_command_t stands in for the
+ *              commands without a struct.
+ *  STR         The offset of the command's lc_str field - a 32-bit offset
+ *              from the start of the command to a NUL terminated string
+ *              inside it - or 0 if there isn't one.
+ *
+ *  The name lookup, the descriptor table, the typed visitor below and the
+ *  C++ `command_traits` specialisations are all generated from the list,
+ *  so adding a command is one line here.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho-command-types.h"
+
+#define MACH_LOAD_COMMANDS(X)                                                           \
+    X (LC_SEGMENT,                  mach_segment_command_32_t,      56, 0)              \
+    X (LC_SYMTAB,                   mach_symtab_command_t,          24, 0)              \
+    X (LC_SYMSEG,                   mach_load_command_t,            16, 0)              \
+    X (LC_THREAD,                   mach_load_command_t,             8, 0)              \
+    X (LC_UNIXTHREAD,               mach_load_command_t,             8, 0)              \
+    X (LC_LOADFVMLIB,               mach_load_command_t,            20, 8)              \
+    X (LC_IDFVMLIB,                 mach_load_command_t,            20, 8)              \
+    X (LC_IDENT,                    mach_load_command_t,             8, 0)              \
+    X (LC_FVMFILE,                  mach_load_command_t,            16, 8)              \
+    X (LC_PREPAGE,                  mach_load_command_t,             8, 0)              \
+    X (LC_DYSYMTAB,                 mach_dysymtab_command_t,        80, 0)              \
+    X (LC_LOAD_DYLIB,               mach_dylib_command_t,           24, 8)              \
+    X (LC_ID_DYLIB,                 mach_dylib_command_t,           24, 8)              \
+    X (LC_LOAD_DYLINKER,            mach_dylinker_command_t,        12, 8)              \
+    X (LC_ID_DYLINKER,              mach_dylinker_command_t,        12, 8)              \
+    X (LC_PREBOUND_DYLIB,           mach_load_command_t,            20, 8)              \
+    X (LC_ROUTINES,                 mach_load_command_t,            40, 0)              \
+    X (LC_SUB_FRAMEWORK,            mach_load_command_t,            12, 8)              \
+    X (LC_SUB_UMBRELLA,             mach_load_command_t,            12, 8)              \
+    X (LC_SUB_CLIENT,               mach_load_command_t,            12, 8)              \
+    X (LC_SUB_LIBRARY,              mach_load_command_t,            12, 8)              \
+    X (LC_TWOLEVEL_HINTS,           mach_load_command_t,            16, 0)              \
+    X (LC_PREBIND_CKSUM,            mach_load_command_t,            12, 0)              \
+    X (LC_LOAD_WEAK_DYLIB,          mach_dylib_command_t,           24, 8)              \
+    X (LC_SEGMENT_64,               mach_segment_command_64_t,      72, 0)              \
+    X (LC_ROUTINES_64,              mach_load_command_t,            72, 0)              \
+    X (LC_UUID,                     mach_uuid_command_t,            24, 0)              \
+    X (LC_RPATH,                    mach_rpath_command_t,           12, 8)              \
+    X (LC_CODE_SIGNATURE,           mach_linkedit_data_command_t,   16, 0)              \
+    X (LC_SEGMENT_SPLIT_INFO,       mach_linkedit_data_command_t,   16, 0)              \
+    X (LC_REEXPORT_DYLIB,           mach_dylib_command_t,           24, 8)              \
+    X (LC_LAZY_LOAD_DYLIB,          mach_dylib_command_t,           24, 8)              \
+    X (LC_ENCRYPTION_INFO,          mach_load_command_t,            20, 0)              \
+    X (LC_DYLD_INFO,                mach_dyld_info_command_t,       48, 0)              \
+    X (LC_DYLD_INFO_ONLY,           mach_dyld_info_command_t,       48, 0)              \
+    X (LC_LOAD_UPWARD_DYLIB,        mach_dylib_command_t,           24, 8)              \
+    X (LC_VERSION_MIN_MACOSX,       mach_version_min_command_t,     16, 0)              \
+    X (LC_VERSION_MIN_IPHONEOS,     mach_version_min_command_t,     16, 0)              \
+    X (LC_FUNCTION_STARTS,          mach_linkedit_data_command_t,   16, 0)              \
+    X (LC_DYLD_ENVIRONMENT,         mach_dylinker_command_t,        12, 8)              \
+    X (LC_MAIN,                     mach_entry_point_command_t,     24, 0)              \
+    X (LC_DATA_IN_CODE,             mach_linkedit_data_command_t,   16, 0)              \
+    X (LC_SOURCE_VERSION,           mach_source_version_command_t,  16, 0)              \
+    X (LC_DYLIB_CODE_SIGN_DRS,      mach_linkedit_data_command_t,   16, 0)              \
+    X (LC_ENCRYPTION_INFO_64,       mach_crypto_command_64_t,       24, 0)              \
+    X (LC_LINKER_OPTION,            mach_load_command_t,            12, 0)              \
+    X (LC_LINKER_OPTIMIZATION_HINT, mach_linkedit_data_command_t,   16, 0)              \
+    X (LC_VERSION_MIN_TVOS,         mach_version_min_command_t,     16, 0)              \
+    X (LC_VERSION_MIN_WATCHOS,      mach_version_min_command_t,     16, 0)              \
+    X (LC_NOTE,                     mach_load_command_t,            40, 0)              \
+    X (LC_BUILD_VERSION,            mach_build_version_command_t,   24, 0)              \
+    X (LC_DYLD_EXPORTS_TRIE,        mach_linkedit_data_command_t,   16, 0)              \
+    X (LC_DYLD_CHAINED_FIXUPS,      mach_linkedit_data_command_t,   16, 0)              \
+    X (LC_FILESET_ENTRY,            mach_fileset_entry_command_t,   32, 24)
+
+
+/**
+ *  A dense index for each command in the table, in table order. Index 0
+ *  is any command that isn't in the table.
+ */
+#define MACH_LC_INDEX_ENUM(NAME, TYPE, MIN_SIZE, STR)      MACH_LC_INDEX_##NAME,
+
+typedef enum mach_lc_index_t {
+    MACH_LC_INDEX_UNKNOWN = 0,
+    MACH_LOAD_COMMANDS (MACH_LC_INDEX_ENUM)
+    MACH_LC_INDEX_COUNT
+} mach_lc_index_t;
+
+#undef MACH_LC_INDEX_ENUM
+
+
+/**
+ *  The table entry for a command type.
+ */
+typedef struct mach_load_command_desc_t {
+    uint32_t         cmd;           /* LC_* */
+    const char      *name;          /* "LC_*" */
+    uint32_t         min_size;      /* smallest valid cmdsize */
+    uint32_t         str_offset;    /* offset of the lc_str field, or 0 */
+} mach_load_command_desc_t;
+
+
+/**
+ *  Use `mach_load_command_index()` to find a command's index, and
+ *  `mach_load_command_desc()` for its table entry, or NULL if it isn't in
+ *  the table. Both are a couple of array lookups.
+ *
+ *  Use `mach_load_command_valid()` to check that the command at `offset`
+ *  is inside the load command area and the file, and no smaller than the
+ *  table says. Commands not in the table only need to hold a
+ *  mach_load_command_t.
+ *
+ *  Use `mach_load_command_str()` for the string of the command at
+ *  `offset`, like a dylib's install name or an rpath. It's a pointer
+ *  into the Mach-O, or NULL if the command has no string or the string
+ *  isn't NUL terminated inside the command.
+ */
+mach_lc_index_t                  mach_load_command_index (uint32_t cmd);
+const mach_load_command_desc_t  *mach_load_command_desc (uint32_t cmd);
+
+int                              mach_load_command_valid (macho_t *macho, uint32_t offset);
+const char                      *mach_load_command_str (macho_t *macho, uint32_t offset);
+
+
+/**
+ *  Use `mach_lc_find_checked()` for the first command of type `cmd` that
+ *  passes `mach_load_command_valid()`. It's a pointer into the Mach-O,
+ *  to be cast to the command's struct, or NULL if there isn't one. If
+ *  `offset` isn't NULL it's set to the command's offset.
+ */
+const void                      *mach_lc_find_checked (macho_t *macho, uint32_t cmd, uint32_t *offset);
+
+
+/**
+ *  Typed visitor.
+ *
+ *      `mach_load_commands_visit()` walks every load command in `macho`,
+ *  including the segments, and calls the visitor's callback for that
+ *  command type with the command cast to its struct:
+ *
+ *      static int on_uuid (macho_t *macho, const mach_uuid_command_t *uuid,
+ *                          uint32_t offset, void *ctx) { ... }
+ *
+ *      mach_lc_visitor_t v = { .on_LC_UUID = on_uuid };
+ *      mach_load_commands_visit (macho, &v, ctx);
+ *
+ *  Commands not in the table go to `on_unknown`, and commands smaller
+ *  than the table says go to `on_invalid`. NULL callbacks are skipped. A
+ *  callback returning non-zero ends the walk with that value.
+ *
+ *  The walk stops with -1 at a command that runs past `sizeofcmds` or
+ *  the file, after passing it to `on_invalid` if it has a whole
+ *  mach_load_command_t. Otherwise it returns 0.
+ */
+typedef int (*mach_lc_visit_raw_t) (macho_t *macho, const mach_load_command_t *lc, uint32_t offset, void *ctx);
+
+#define MACH_LC_VISITOR_FIELD(NAME, TYPE, MIN_SIZE, STR)  \
+    int (*on_##NAME) (macho_t *macho, const TYPE *cmd, uint32_t offset, void *ctx);
+
+typedef struct mach_lc_visitor_t {
+    MACH_LOAD_COMMANDS (MACH_LC_VISITOR_FIELD)
+
+    mach_lc_visit_raw_t      on_unknown;
+    mach_lc_visit_raw_t      on_invalid;
+} mach_lc_visitor_t;
+
+#undef MACH_LC_VISITOR_FIELD
+
+int         mach_load_commands_visit (macho_t *macho, const mach_lc_visitor_t *visitor, void *ctx);
+
+
+#endif /* libhelper_macho_command_table_ll_h */
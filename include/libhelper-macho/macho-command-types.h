@@ -134,6 +134,19 @@ typedef struct mach_build_version_info_t {
 
 
 mach_build_version_info_t 		*mach_lc_build_version_info (mach_build_version_command_t *bvc, off_t offset, macho_t *macho);
+char							*mach_lc_platform_string (uint32_t platform);
+
+
+/**
+ * 	The version_min_command is the older form of LC_BUILD_VERSION, where
+ * 	the platform is given by the command type.
+ */
+typedef struct mach_version_min_command_t {
+	uint32_t	cmd;		/* LC_VERSION_MIN_MACOSX, _IPHONEOS, _WATCHOS or _TVOS */
+	uint32_t	cmdsize;	/* sizeof(mach_version_min_command_t) */
+	uint32_t	version;	/* X.Y.Z is encoded in nibbles xxxx.yy.zz */
+	uint32_t	sdk;		/* X.Y.Z is encoded in nibbles xxxx.yy.zz */
+} mach_version_min_command_t;
 
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -428,6 +441,37 @@ typedef struct mach_linkedit_data_command_t {
 } mach_linkedit_data_command_t;
 
 
+/**
+ * 	LC_FUNCTION_STARTS
+ *
+ * 	The payload is a zero-terminated sequence of ULEB128 deltas. The first
+ * 	delta is from the start of the __TEXT segment (the mach header), and
+ * 	each following one from the previous function.
+ */
+uint64_t 				*mach_lc_load_function_starts (macho_t *macho, uint32_t *count);
+
+
+/**
+ * 	LC_DATA_IN_CODE
+ *
+ * 	The payload is an array of these, each marking a range of data (jump
+ * 	tables, literal pools...) inside a code section.
+ */
+typedef struct mach_data_in_code_entry_t {
+	uint32_t		offset;			/* from mach_header to start of data range*/
+	uint16_t		length;			/* number of bytes in data range */
+	uint16_t		kind;			/* a DICE_KIND_* value  */
+} mach_data_in_code_entry_t;
+
+#define DICE_KIND_DATA              0x0001
+#define DICE_KIND_JUMP_TABLE8       0x0002
+#define DICE_KIND_JUMP_TABLE16      0x0003
+#define DICE_KIND_JUMP_TABLE32      0x0004
+#define DICE_KIND_ABS_JUMP_TABLE32  0x0005
+
+mach_data_in_code_entry_t 	*mach_lc_load_data_in_code (macho_t *macho, uint32_t *count);
+
+
 /////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
 
@@ -464,6 +508,27 @@ typedef struct mach_crypto_command_64_t {
 				   of 8 bytes */
 } mach_crypto_command_64_t;
 
+
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+ * 	LC_FILESET_ENTRY
+ *
+ * 	A file set (MH_FILESET) bundles several Mach-O's into one, which is how
+ * 	newer kernelcaches are built. Each entry names one of them and points
+ * 	at its mach header.
+ */
+typedef struct mach_fileset_entry_command_t {
+	uint32_t		cmd;			/* LC_FILESET_ENTRY */
+	uint32_t		cmdsize;		/* includes entry_id string */
+	uint64_t		vmaddr;			/* memory address of the entry's mach header */
+	uint64_t		fileoff;		/* file offset of the entry's mach header */
+	uint32_t		entry_id;		/* offset of the entry id string */
+	uint32_t		reserved;
+} mach_fileset_entry_command_t;
+
 //////////////////////////////////////////////////////////////////////////
 //                 Other Function Definitions                           //
 //////////////////////////////////////////////////////////////////////////
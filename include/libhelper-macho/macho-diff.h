@@ -0,0 +1,130 @@
+//===---------------------------- macho_diff --------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_DIFF_LL_H
+#define LIBHELPER_MACHO_DIFF_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Structural diffing of two Mach-O's. Rather than comparing a dump of
+ *  each file, the two files are broken down into named items - load
+ *  commands, segments, sections, symbols, dylibs and exports - and each
+ *  category is compared as a set, keyed by name. Every item also carries
+ *  a hash of whatever makes it "the same" (section contents, dylib
+ *  versions, raw load command bytes...), so an item that exists in both
+ *  files but differs is reported as changed.
+ *
+ *  The sets are compared with hash tables, so a diff is roughly linear in
+ *  the number of items. mach_diff_batch() can be used to diff many pairs
+ *  at once, for example every binary across two firmware versions.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+
+
+/**
+ * 	What happened to an item between the old (a) and new (b) Mach-O.
+ */
+typedef enum mach_diff_kind_t {
+	MACH_DIFF_ADDED = 0,
+	MACH_DIFF_REMOVED,
+	MACH_DIFF_CHANGED,
+
+	MACH_DIFF_KIND_COUNT
+} mach_diff_kind_t;
+
+
+/**
+ * 	The type of item that was compared.
+ */
+typedef enum mach_diff_category_t {
+	MACH_DIFF_HEADER = 0,
+	MACH_DIFF_LOAD_COMMAND,
+	MACH_DIFF_SEGMENT,
+	MACH_DIFF_SECTION,
+	MACH_DIFF_SYMBOL,
+	MACH_DIFF_DYLIB,
+	MACH_DIFF_EXPORT,
+
+	MACH_DIFF_CATEGORY_COUNT
+} mach_diff_category_t;
+
+
+/**
+ * 	A single difference. The size of the item in each file is given, and
+ * 	is zero on the side where the item doesn't exist. For symbols and
+ * 	exports the size is the distance to the next symbol in the same
+ * 	section, as symbol tables don't record sizes.
+ *
+ */
+typedef struct mach_diff_item_t {
+	uint32_t		 category;		/* mach_diff_category_t */
+	uint32_t		 kind;			/* mach_diff_kind_t */
+	char			*name;			/* e.g. "__TEXT.__text", "LC_UUID#0" */
+	uint64_t		 old_size;		/* size in a */
+	uint64_t		 new_size;		/* size in b */
+} mach_diff_item_t;
+
+
+/**
+ * 	Result of a diff. `counts` holds the number of items for each category
+ * 	and kind, e.g. counts[MACH_DIFF_SYMBOL][MACH_DIFF_ADDED].
+ */
+typedef struct mach_diff_t {
+	mach_diff_item_t	*items;
+	uint32_t			 nitems;
+	uint32_t			 capacity;
+
+	uint32_t			 counts[MACH_DIFF_CATEGORY_COUNT][MACH_DIFF_KIND_COUNT];
+} mach_diff_t;
+
+
+/**
+ * 	A pair of Mach-O's for mach_diff_batch(). Either side may be NULL, in
+ * 	which case the whole binary is reported as added or removed.
+ */
+typedef struct mach_diff_pair_t {
+	macho_t				*a;
+	macho_t				*b;
+	mach_diff_t			*diff;			/* set by mach_diff_batch() */
+} mach_diff_pair_t;
+
+
+mach_diff_t 		*mach_diff (macho_t *a, macho_t *b);
+void 				 mach_diff_batch (mach_diff_pair_t *pairs, size_t count, int nthreads);
+void 				 mach_diff_free (mach_diff_t *diff);
+
+void 				 mach_diff_print (mach_diff_t *diff);
+char 				*mach_diff_kind_string (uint32_t kind);
+char 				*mach_diff_category_string (uint32_t category);
+
+
+#endif /* libhelper_macho_diff_ll_h */
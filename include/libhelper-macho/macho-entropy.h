@@ -0,0 +1,69 @@
+//===--------------------------- macho_entropy ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_ENTROPY_LL_H
+#define LIBHELPER_MACHO_ENTROPY_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Entropy profiling of a Mach-O, per section, for the LC_ENCRYPTION_INFO
+ *  range, or over a sliding window across the whole file. See
+ *  libhelper/hentropy.h for the underlying histogram and entropy code.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+#include "libhelper/hentropy.h"
+
+
+/**
+ * 	Entropy of a single section. Sections with no data in the file
+ * 	(zerofill, or running past the end of the file) have an entropy of -1.
+ */
+typedef struct mach_section_entropy_t {
+	char		segname[17];
+	char		sectname[17];
+	uint64_t	addr;
+	uint64_t	offset;
+	uint64_t	size;
+	uint64_t	hist[256];			/* byte histogram */
+	double		entropy;			/* bits per byte, 0.0 - 8.0 */
+} mach_section_entropy_t;
+
+
+mach_section_entropy_t		*mach_entropy_sections (macho_t *macho, int nthreads, uint32_t *count);
+double						 mach_entropy_range (macho_t *macho, uint64_t offset, uint64_t size, int nthreads);
+double						 mach_entropy_encrypted_range (macho_t *macho, int nthreads);
+double						*mach_entropy_profile (macho_t *macho, size_t window, size_t step, int nthreads, size_t *count);
+
+void						 mach_entropy_sections_print (mach_section_entropy_t *sects, uint32_t count);
+
+
+#endif /* libhelper_macho_entropy_ll_h */
@@ -0,0 +1,106 @@
+//===--------------------------- macho_export -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_EXPORT_LL_H
+#define LIBHELPER_MACHO_EXPORT_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Exports a parsed Mach-O as a stream of records, for loading into
+ *  other tools. There is one record for the header, then one for each
+ *  load command, one for the build version if there is one, one for
+ *  each segment followed by its sections, and then one for each dylib
+ *  and symbol. Records are formatted straight into an h_writer_t, with
+ *  no allocation per record.
+ *
+ *  == NDJSON.
+ *
+ *      One JSON object per line, with a "type" of "macho", "load_command",
+ *  "segment", "section", "dylib", "build_version", "symbol" or "error".
+ *  Addresses and symbol values are hex strings, since not every JSON
+ *  reader keeps 64-bit integers exact, and versions are "X.Y.Z" strings.
+ *
+ *  == Binary.
+ *
+ *      Each record is a u32 length of the rest of the record, a u8 type
+ *  (MACH_EXPORT_REC_*), then its fields. Integers are little endian and
+ *  strings are a u32 length followed by the bytes, with no NUL.
+ *
+ *      MACHO           str path, u32 magic, cputype, cpusubtype, filetype,
+ *                      ncmds, sizeofcmds, flags, u64 size
+ *      LOAD_COMMAND    u32 index, cmd, cmdsize, offset
+ *      SEGMENT         str name, u64 vmaddr, vmsize, fileoff, filesize,
+ *                      u32 maxprot, initprot, nsects, flags
+ *      SECTION         str segment, str name, u64 addr, size, u32 offset,
+ *                      align, flags
+ *      DYLIB           u32 cmd, timestamp, current_version,
+ *                      compatibility_version, str name
+ *      BUILD_VERSION   u32 platform, minos, sdk, ntools, then ntools pairs
+ *                      of u32 tool, version
+ *      SYMBOL          u64 value, u8 type, u8 sect, u16 desc, str name
+ *      ERROR           str path
+ *
+ *  Versions are in the Mach-O encoding, xxxx.yy.zz in nibbles.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+#include "libhelper/hwriter.h"
+
+#define MACH_EXPORT_NDJSON              0
+#define MACH_EXPORT_BINARY              1
+
+#define MACH_EXPORT_REC_MACHO           1
+#define MACH_EXPORT_REC_LOAD_COMMAND    2
+#define MACH_EXPORT_REC_SEGMENT         3
+#define MACH_EXPORT_REC_SECTION         4
+#define MACH_EXPORT_REC_DYLIB           5
+#define MACH_EXPORT_REC_BUILD_VERSION   6
+#define MACH_EXPORT_REC_SYMBOL          7
+#define MACH_EXPORT_REC_ERROR           8
+
+/**
+ *  Use `mach_export()` to add the records for `macho` to a writer, in
+ *  MACH_EXPORT_NDJSON or MACH_EXPORT_BINARY `format`. It only reads the
+ *  macho_t, so several threads may export at once, each to its own
+ *  writer.
+ *
+ *  Use `mach_export_files()` to load and export `count` files to `fd` on
+ *  `nthreads` threads (0 for one per CPU). Each file is exported to
+ *  memory by whichever thread loads it, and written out in the order of
+ *  `paths`. A file that can't be loaded gets an "error" record.
+ *
+ *  Both return 0, or -1 if writing failed.
+ */
+int         mach_export (h_writer_t *w, macho_t *macho, int format);
+int         mach_export_files (int fd, const char **paths, size_t count, int format, int nthreads);
+
+
+#endif /* libhelper_macho_export_ll_h */
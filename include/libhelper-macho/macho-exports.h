@@ -0,0 +1,67 @@
+//===--------------------------- macho_exports ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_EXPORTS_LL_H
+#define LIBHELPER_MACHO_EXPORTS_LL_H
+
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho.h"
+
+/**
+ * 	Export trie symbol flags. These are taken from mach-o/loader.h. See
+ * 	the notes on `export_off` in mach_dyld_info_command_t for how the trie
+ * 	is laid out.
+ *
+ */
+#define EXPORT_SYMBOL_FLAGS_KIND_MASK				0x03
+#define EXPORT_SYMBOL_FLAGS_KIND_REGULAR			0x00
+#define EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL		0x01
+#define EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE			0x02
+#define EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION			0x04
+#define EXPORT_SYMBOL_FLAGS_REEXPORT				0x08
+#define EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER		0x10
+
+
+/**
+ * 	A single exported symbol from the export trie.
+ *
+ * 	For re-exports, `other` holds the library ordinal and `import_name` the
+ * 	name in that library (NULL if it's the same name). For stub and resolver
+ * 	exports `other` is the resolver offset.
+ *
+ */
+typedef struct mach_export_info_t {
+	char		*name;			/* allocated, full symbol name */
+	uint64_t	 flags;			/* EXPORT_SYMBOL_FLAGS_* */
+	uint64_t	 address;		/* offset from the mach header */
+	uint64_t	 other;			/* library ordinal / resolver offset */
+	char		*import_name;	/* re-export name, points into macho->data */
+} mach_export_info_t;
+
+
+mach_export_info_t 		*mach_exports_load (macho_t *macho, uint32_t *count);
+void 					 mach_exports_free (mach_export_info_t *exports, uint32_t count);
+
+
+#endif /* libhelper_macho_exports_ll_h */
@@ -0,0 +1,122 @@
+//===---------------------------- macho_fixups ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_FIXUPS_LL_H
+#define LIBHELPER_MACHO_FIXUPS_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Binds and rebases, enough to read pointers stored in a Mach-O the way
+ *  dyld would see them. Binds come from either the LC_DYLD_INFO bind
+ *  opcodes or the LC_DYLD_CHAINED_FIXUPS imports, and are kept sorted by
+ *  address. Rebases are only decoded on demand, when a pointer is read.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+
+
+/**
+ * 	Bind opcodes, from LC_DYLD_INFO.
+ */
+#define BIND_OPCODE_MASK								0xF0
+#define BIND_IMMEDIATE_MASK								0x0F
+#define BIND_OPCODE_DONE								0x00
+#define BIND_OPCODE_SET_DYLIB_ORDINAL_IMM				0x10
+#define BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB				0x20
+#define BIND_OPCODE_SET_DYLIB_SPECIAL_IMM				0x30
+#define BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM		0x40
+#define BIND_OPCODE_SET_TYPE_IMM						0x50
+#define BIND_OPCODE_SET_ADDEND_SLEB						0x60
+#define BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB			0x70
+#define BIND_OPCODE_ADD_ADDR_ULEB						0x80
+#define BIND_OPCODE_DO_BIND								0x90
+#define BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB				0xA0
+#define BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED			0xB0
+#define BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB	0xC0
+#define BIND_OPCODE_THREADED							0xD0
+
+
+/**
+ * 	Chained fixups, from LC_DYLD_CHAINED_FIXUPS.
+ */
+typedef struct mach_chained_fixups_header_t {
+	uint32_t	fixups_version;		/* 0 */
+	uint32_t	starts_offset;		/* offset of dyld_chained_starts_in_image */
+	uint32_t	imports_offset;		/* offset of imports table */
+	uint32_t	symbols_offset;		/* offset of symbol strings */
+	uint32_t	imports_count;		/* number of imported symbol names */
+	uint32_t	imports_format;		/* DYLD_CHAINED_IMPORT* */
+	uint32_t	symbols_format;		/* 0 => uncompressed */
+} mach_chained_fixups_header_t;
+
+#define DYLD_CHAINED_IMPORT								1
+#define DYLD_CHAINED_IMPORT_ADDEND						2
+#define DYLD_CHAINED_IMPORT_ADDEND64					3
+
+#define DYLD_CHAINED_PTR_ARM64E							1
+#define DYLD_CHAINED_PTR_64								2
+#define DYLD_CHAINED_PTR_64_OFFSET						6
+#define DYLD_CHAINED_PTR_ARM64E_KERNEL					7
+#define DYLD_CHAINED_PTR_64_KERNEL_CACHE				8
+#define DYLD_CHAINED_PTR_ARM64E_USERLAND				9
+#define DYLD_CHAINED_PTR_ARM64E_USERLAND24				12
+
+#define DYLD_CHAINED_PTR_START_NONE						0xFFFF
+
+
+/**
+ * 	A bound pointer. `name` points into macho->data.
+ */
+typedef struct mach_bind_t {
+	uint64_t		 vmaddr;
+	const char		*name;
+	int64_t			 addend;
+	int32_t			 ordinal;		/* library ordinal, or a BIND_SPECIAL_DYLIB_* value */
+} mach_bind_t;
+
+typedef struct mach_fixups_t {
+	mach_bind_t		*binds;			/* sorted by vmaddr */
+	uint32_t		 nbinds;
+
+	uint16_t		 pointer_format;	/* DYLD_CHAINED_PTR_*, or 0 for plain pointers */
+	uint64_t		 base;			/* VM address of the mach header */
+} mach_fixups_t;
+
+
+mach_fixups_t			*mach_fixups_load (macho_t *macho);
+void					 mach_fixups_free (mach_fixups_t *fixups);
+
+mach_bind_t				*mach_fixups_find_bind (mach_fixups_t *fixups, uint64_t vmaddr);
+uint64_t				 mach_fixups_read_pointer (macho_t *macho, mach_fixups_t *fixups, uint64_t vmaddr,
+												   mach_bind_t **bind);
+
+
+#endif /* libhelper_macho_fixups_ll_h */
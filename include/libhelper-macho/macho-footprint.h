@@ -0,0 +1,75 @@
+//===-------------------------- macho_footprint -----------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_FOOTPRINT_LL_H
+#define LIBHELPER_MACHO_FOOTPRINT_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Memory footprint of a parsed Mach-O, for budgeting a cache of them.
+ *
+ *  Heap bytes are split by what they hold, and are the real allocation
+ *  sizes where the allocator can report them (glibc, Darwin), so they
+ *  include malloc's rounding. The file data is reported separately:
+ *  its size, how much of it is in RAM, and how much of that is dirty,
+ *  i.e. couldn't be dropped and re-read from the file under pressure.
+ *  Residency is found a page at a time, so `resident` and `dirty` are
+ *  clamped to `mapped`.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+
+
+typedef struct mach_footprint_t {
+    /* heap, by category */
+    size_t      header;             /* macho_t and mach header */
+    size_t      load_commands;      /* load command and dylib info */
+    size_t      sections;           /* segment and section commands */
+    size_t      symbols;
+    size_t      strings;
+    size_t      indices;            /* list nodes linking the above */
+    size_t      heap;               /* sum of the above */
+
+    /* file data */
+    size_t      mapped;
+    size_t      resident;
+    size_t      dirty;
+} mach_footprint_t;
+
+/**
+ *  Use `macho_footprint()` to measure a macho_t. The result is written
+ *  to `fp`. A view from macho_create_embedded() shares its container's
+ *  data, so only its heap is its own.
+ */
+void        macho_footprint (macho_t *macho, mach_footprint_t *fp);
+
+
+#endif /* libhelper_macho_footprint_ll_h */
@@ -0,0 +1,103 @@
+//===---------------------------- macho_iokit -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_IOKIT_LL_H
+#define LIBHELPER_MACHO_IOKIT_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  IOKit class extraction for kernelcaches. Every libkern C++ class has a
+ *  static OSMetaClass instance, built by a call like
+ *
+ *      OSMetaClass::OSMetaClass (&gMetaClass, "IOService", &super::gMetaClass, sizeof (IOService));
+ *
+ *  in its kext's static initialisers. Following the arguments of each of
+ *  those calls gives the class name, its superclass and its size, and
+ *  the vtable stored into the metaclass straight after gives the
+ *  metaclass vtable. The class vtable comes from the symbol table when
+ *  there is one, and otherwise from the metaclass's alloc() method.
+ *
+ *  Kexts are processed in parallel. The constructor itself is found by
+ *  symbol, or failing that, as the function most often called with a
+ *  class name string as its second argument.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper/hhash.h"
+#include "libhelper-macho/macho.h"
+#include "libhelper-macho/macho-kext.h"
+
+#define MACH_IOKIT_NO_CLASS				UINT32_MAX
+
+
+/**
+ * 	One class. Vtable addresses are address points, i.e. the address that
+ * 	is stored in an object, 0x10 past the start of the vtable symbol.
+ * 	Anything that couldn't be worked out is zero.
+ */
+typedef struct mach_iokit_class_t {
+	const char		*name;				/* in kernel->data */
+	uint32_t		 size;				/* sizeof (class) */
+
+	uint64_t		 metaclass;			/* address of the OSMetaClass instance */
+	uint64_t		 metaclass_vtable;
+	uint64_t		 vtable;
+
+	uint64_t		 super_metaclass;	/* zero for root classes */
+	uint32_t		 super;				/* index of the superclass, or MACH_IOKIT_NO_CLASS */
+
+	uint32_t		 kext;				/* index into the kext list */
+} mach_iokit_class_t;
+
+
+/**
+ * 	The class table, indexed by name and by metaclass address.
+ */
+typedef struct mach_iokit_classes_t {
+	mach_iokit_class_t	*classes;
+	uint32_t			 count;
+
+	uint64_t			 ctor;			/* OSMetaClass::OSMetaClass */
+
+	HHashTable			*by_name;
+	HHashTable			*by_metaclass;
+} mach_iokit_classes_t;
+
+
+mach_iokit_classes_t		*mach_iokit_classes_load (macho_t *kernel, mach_kext_list_t *kexts, int nthreads);
+void						 mach_iokit_classes_free (mach_iokit_classes_t *classes);
+
+mach_iokit_class_t			*mach_iokit_class_find (mach_iokit_classes_t *classes, const char *name);
+mach_iokit_class_t			*mach_iokit_class_find_metaclass (mach_iokit_classes_t *classes, uint64_t metaclass);
+
+void						 mach_iokit_classes_print (mach_iokit_classes_t *classes, mach_kext_list_t *kexts);
+
+
+#endif /* libhelper_macho_iokit_ll_h */
@@ -0,0 +1,102 @@
+//===--------------------------- macho_kcsyms -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_KCSYMS_LL_H
+#define LIBHELPER_MACHO_KCSYMS_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  A single address to symbol table for a whole kernelcache, for
+ *  symbolicating panic backtraces. The symbol tables of the kernel and
+ *  every kext that has one are loaded in parallel, sorted, and merged
+ *  into one array sorted by address. Each symbol records the kext whose
+ *  segments contain it.
+ *
+ *  Lookups first find the segment containing the address, so an address
+ *  past the end of a kext's last symbol isn't attributed to whatever
+ *  symbol happens to come next in memory.
+ *
+ *  Tables can be written to disk and read back, keyed by the UUID of the
+ *  kernelcache, so they only need to be built once per kernelcache.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+#include "libhelper-macho/macho-kext.h"
+
+
+typedef struct mach_kc_symbol_t {
+	uint64_t		 addr;
+	const char		*name;
+	uint32_t		 kext;			/* index into kext_names */
+} mach_kc_symbol_t;
+
+/**
+ * 	A segment of a kext, with __LINKEDIT left out.
+ */
+typedef struct mach_kc_range_t {
+	uint64_t		 start;
+	uint64_t		 end;
+	uint32_t		 kext;
+} mach_kc_range_t;
+
+
+/**
+ * 	A table built from a kernelcache points into its data, so that must
+ * 	outlive the table. The kext names are copied, so the kext list can be
+ * 	freed first. A table read from disk owns everything.
+ */
+typedef struct mach_kc_symtab_t {
+	uint8_t				 uuid[16];
+
+	mach_kc_symbol_t	*symbols;		/* sorted by address */
+	uint32_t			 count;
+	mach_kc_range_t		*ranges;		/* sorted by address, non-overlapping */
+	uint32_t			 nranges;
+	const char			**kext_names;	/* the kernel is always index 0 */
+	uint32_t			 nkexts;
+
+	char				*strings;		/* the names the table owns */
+} mach_kc_symtab_t;
+
+
+mach_kc_symtab_t		*mach_kc_symtab_build (macho_t *kernel, mach_kext_list_t *kexts, int nthreads);
+mach_kc_symtab_t		*mach_kc_symtab_load (macho_t *kernel, mach_kext_list_t *kexts, int nthreads,
+											  const char *cache_dir);
+void					 mach_kc_symtab_free (mach_kc_symtab_t *symtab);
+
+int						 mach_kc_symtab_write (mach_kc_symtab_t *symtab, const char *path);
+mach_kc_symtab_t		*mach_kc_symtab_read (const char *path, const uint8_t *uuid);
+
+mach_kc_symbol_t		*mach_kc_symtab_lookup (mach_kc_symtab_t *symtab, uint64_t addr, uint64_t *offset);
+const char				*mach_kc_symtab_kext_name (mach_kc_symtab_t *symtab, mach_kc_symbol_t *symbol);
+
+
+#endif /* libhelper_macho_kcsyms_ll_h */
@@ -0,0 +1,80 @@
+//===----------------------------- macho_kext -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_KEXT_LL_H
+#define LIBHELPER_MACHO_KEXT_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Kernelcache support: enumerating the kexts in a kernelcache, and
+ *  untagging the pointers stored in one.
+ *
+ *  There are three layouts to deal with:
+ *
+ *      -   File sets (MH_FILESET). Every kext, and the kernel, has an
+ *          LC_FILESET_ENTRY pointing at its mach header.
+ *      -   Prelinked kernelcaches. Kext mach headers live in
+ *          __PRELINK_TEXT, and __PRELINK_INFO has a plist naming them.
+ *      -   Merged kernelcaches. The kexts are linked into the kernel
+ *          itself, and only the kernel is returned.
+ *
+ *  In every case the kernel is the first entry.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+
+
+typedef struct mach_kext_t {
+	char			*name;			/* bundle identifier */
+	uint64_t		 vmaddr;		/* address of the kext's mach header */
+	uint32_t		 offset;		/* file offset of the kext's mach header */
+	macho_t			*macho;			/* view onto the kernelcache, see macho_create_embedded() */
+} mach_kext_t;
+
+typedef struct mach_kext_list_t {
+	mach_kext_t		*kexts;
+	uint32_t		 count;
+	int				 fileset;		/* pointers use the kernel collection fixup format */
+	uint64_t		 base;			/* lowest VM address of the kernelcache */
+} mach_kext_list_t;
+
+
+mach_kext_list_t		*mach_kexts_load (macho_t *kernel);
+void					 mach_kexts_free (mach_kext_list_t *list);
+
+mach_kext_t				*mach_kext_find (mach_kext_list_t *list, const char *name);
+mach_kext_t				*mach_kext_containing (mach_kext_list_t *list, uint64_t vmaddr);
+
+uint64_t				 mach_kext_untag_pointer (mach_kext_list_t *list, uint64_t raw);
+uint64_t				 mach_kext_read_pointer (macho_t *kernel, mach_kext_list_t *list, uint64_t vmaddr);
+
+
+#endif /* libhelper_macho_kext_ll_h */
@@ -0,0 +1,87 @@
+//===--------------------------- macho_leb128 -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_LEB128_LL_H
+#define LIBHELPER_MACHO_LEB128_LL_H
+
+#include <stdint.h>
+
+/**
+ *  LEB128 decoding.
+ *
+ *  Most of the LINKEDIT payloads (export tries, function starts, split
+ *  segment info, linker optimisation hints) are streams of LEB128 values.
+ *  Both readers advance `*p` past the value, and will never read at or
+ *  beyond `end`. If the value runs off the end of the buffer, `*p` is set
+ *  to `end` and whatever was decoded so far is returned, so callers can
+ *  simply check `*p < end` to see whether there is more to read.
+ *
+ */
+static inline uint64_t
+mach_read_uleb128 (const uint8_t **p, const uint8_t *end)
+{
+    uint64_t result = 0;
+    unsigned shift = 0;
+    const uint8_t *q = *p;
+
+    while (q < end) {
+        uint8_t byte = *q++;
+        if (shift < 64)
+            result |= (uint64_t) (byte & 0x7f) << shift;
+        shift += 7;
+        if (!(byte & 0x80)) {
+            *p = q;
+            return result;
+        }
+    }
+
+    *p = end;
+    return result;
+}
+
+static inline int64_t
+mach_read_sleb128 (const uint8_t **p, const uint8_t *end)
+{
+    int64_t result = 0;
+    unsigned shift = 0;
+    uint8_t byte = 0;
+    const uint8_t *q = *p;
+
+    while (q < end) {
+        byte = *q++;
+        if (shift < 64)
+            result |= (int64_t) ((uint64_t) (byte & 0x7f) << shift);
+        shift += 7;
+        if (!(byte & 0x80))
+            break;
+    }
+
+    if (shift < 64 && (byte & 0x40))
+        result |= (int64_t) (~0ULL << shift);
+
+    *p = q;
+    return result;
+}
+
+#endif /* libhelper_macho_leb128_ll_h */
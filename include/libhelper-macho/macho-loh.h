@@ -0,0 +1,100 @@
+//===----------------------------- macho_loh --------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_LOH_LL_H
+#define LIBHELPER_MACHO_LOH_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Decoder for LC_LINKER_OPTIMIZATION_HINT. The compiler records which
+ *  ADRP, ADD and LDR/STR instructions belong together so the linker can
+ *  relax them; that is exactly the pairing that xref analysis otherwise
+ *  has to recover by tracking registers. The payload is a stream of
+ *  ULEB128 values:
+ *
+ *      <kind> <address count> <address>...
+ *
+ *  terminated by a zero kind or the end of the data.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+
+
+/**
+ * 	Hint kinds, with the instructions each one covers.
+ */
+#define LOH_ARM64_ADRP_ADRP					1		/* adrp, adrp */
+#define LOH_ARM64_ADRP_LDR					2		/* adrp, ldr */
+#define LOH_ARM64_ADRP_ADD_LDR				3		/* adrp, add, ldr */
+#define LOH_ARM64_ADRP_LDR_GOT_LDR			4		/* adrp, ldr (got), ldr */
+#define LOH_ARM64_ADRP_ADD_STR				5		/* adrp, add, str */
+#define LOH_ARM64_ADRP_LDR_GOT_STR			6		/* adrp, ldr (got), str */
+#define LOH_ARM64_ADRP_ADD					7		/* adrp, add */
+#define LOH_ARM64_ADRP_LDR_GOT				8		/* adrp, ldr (got) */
+
+#define MACH_LOH_MAX_ARGS					3
+
+
+typedef struct mach_loh_t {
+	uint32_t		kind;
+	uint32_t		count;
+	uint64_t		addrs[MACH_LOH_MAX_ARGS];
+} mach_loh_t;
+
+/**
+ * 	Every address of every hint, sorted, pointing back at the hint and
+ * 	the position of the address within it.
+ */
+typedef struct mach_loh_index_t {
+	uint64_t		addr;
+	uint32_t		hint;
+	uint32_t		position;
+} mach_loh_index_t;
+
+typedef struct mach_loh_table_t {
+	mach_loh_t			*hints;
+	uint32_t			 count;
+
+	mach_loh_index_t	*index;
+	uint32_t			 nindex;
+} mach_loh_table_t;
+
+
+mach_loh_table_t		*mach_loh_table_load (macho_t *macho);
+void					 mach_loh_table_free (mach_loh_table_t *table);
+
+mach_loh_t				*mach_loh_lookup (mach_loh_table_t *table, uint64_t addr, uint32_t *position);
+uint64_t				 mach_loh_resolve (macho_t *macho, mach_loh_table_t *table, uint64_t addr);
+
+char					*mach_loh_kind_string (uint32_t kind);
+
+
+#endif /* libhelper_macho_loh_ll_h */
@@ -0,0 +1,91 @@
+//===---------------------------- macho_probe -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_PROBE_LL_H
+#define LIBHELPER_MACHO_PROBE_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Triage of Mach-O files without loading them. macho_probe() reads the
+ *  mach header and load command region of a file - and of every slice,
+ *  for a universal binary - with pread(), and nothing else. The file is
+ *  never mapped, and for most thin files the whole probe is one 4KB
+ *  read.
+ *
+ *  The summary holds what's needed to classify a file: architecture,
+ *  file type, UUID, platform and OS versions, install name and linked
+ *  dylibs. Strings point into the load command buffer kept for each
+ *  slice.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+
+
+/**
+ * 	One Mach-O, either the whole file or a slice of a universal binary.
+ */
+typedef struct mach_probe_arch_t {
+	uint32_t		 offset;			/* file offset of the mach header */
+	uint32_t		 size;				/* slice size, or the file size */
+	mach_header_t	 header;			/* `reserved` is 0 for 32-bit Mach-Os */
+
+	int				 has_uuid;
+	uint8_t			 uuid[16];
+
+	uint32_t		 platform;			/* PLATFORM_*, or 0 */
+	uint32_t		 minos;				/* X.Y.Z in nibbles xxxx.yy.zz */
+	uint32_t		 sdk;
+	int				 encrypted;			/* LC_ENCRYPTION_INFO with a cryptid */
+
+	const char		*install_name;		/* LC_ID_DYLIB, or NULL */
+	const char		**dylibs;			/* linked dylibs, of any load type */
+	uint32_t		 ndylibs;
+
+	uint8_t			*lcmds;				/* the load command region */
+} mach_probe_arch_t;
+
+typedef struct mach_probe_t {
+	mach_header_type_t	 type;			/* MH_TYPE_UNKNOWN if not a Mach-O */
+	uint64_t			 size;			/* file size */
+
+	mach_probe_arch_t	*archs;
+	uint32_t			 narchs;
+} mach_probe_t;
+
+
+mach_probe_t			*macho_probe (const char *path);
+mach_probe_t			*macho_probe_fd (int fd);
+void					 macho_probe_free (mach_probe_t *probe);
+
+mach_probe_arch_t		*macho_probe_find_arch (mach_probe_t *probe, cpu_type_t cputype);
+
+
+#endif /* libhelper_macho_probe_ll_h */
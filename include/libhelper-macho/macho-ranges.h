@@ -0,0 +1,87 @@
+//===--------------------------- macho_ranges -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_RANGES_LL_H
+#define LIBHELPER_MACHO_RANGES_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  A sorted set of non-overlapping VM address ranges, and a builder for
+ *  the "non-code" ranges of a Mach-O: data-in-code entries, the
+ *  LC_ENCRYPTION_INFO range, and zero-fill memory. Anything that walks
+ *  instructions (xrefs, patchfinders, call graphs) can check an address,
+ *  or skip to the next one that is worth decoding, in O(log n).
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+
+
+/**
+ * 	Why a range isn't code. Overlapping or touching ranges are merged, so
+ * 	a range may have several of these set.
+ */
+#define MACH_RANGE_DATA_IN_CODE		0x1
+#define MACH_RANGE_ENCRYPTED		0x2
+#define MACH_RANGE_ZEROFILL			0x4
+
+
+typedef struct mach_range_t {
+	uint64_t		start;
+	uint64_t		end;			/* exclusive */
+	uint32_t		flags;			/* MACH_RANGE_* */
+} mach_range_t;
+
+typedef struct mach_range_set_t {
+	mach_range_t	*ranges;
+	uint32_t		 count;
+	uint32_t		 capacity;
+	int				 sorted;		/* cleared by add, set by finalise */
+} mach_range_set_t;
+
+
+/**
+ * 	Ranges are added in any order, then mach_range_set_finalise() sorts and
+ * 	merges them. Call it once after the last add: lookups don't change the
+ * 	set, so they're safe from several threads, and find nothing in a set
+ * 	that hasn't been finalised.
+ */
+mach_range_set_t		*mach_range_set_create ();
+void					 mach_range_set_add (mach_range_set_t *set, uint64_t start, uint64_t end, uint32_t flags);
+void					 mach_range_set_finalise (mach_range_set_t *set);
+void					 mach_range_set_free (mach_range_set_t *set);
+
+mach_range_t			*mach_range_set_find (mach_range_set_t *set, uint64_t addr);
+uint64_t				 mach_range_set_next_outside (mach_range_set_t *set, uint64_t addr);
+
+mach_range_set_t		*mach_noncode_ranges_load (macho_t *macho);
+
+
+#endif /* libhelper_macho_ranges_ll_h */
@@ -112,6 +112,31 @@ struct section_64 {
 typedef struct section_64 mach_section_64_t;
 
 
+/**
+ * 	The flags field of a section is split into a section type (low byte)
+ * 	and section attributes (high three bytes). These are the types that
+ * 	have no data in the file, C string literals, and the attributes that
+ * 	mark a section as containing code, taken from mach-o/loader.h.
+ *
+ */
+#define SECTION_TYPE					0x000000ff	/* 256 section types */
+#define SECTION_ATTRIBUTES				0xffffff00	/*  24 section attributes */
+
+#define S_ZEROFILL						0x1			/* zero fill on demand section */
+#define S_CSTRING_LITERALS				0x2			/* section with only literal C strings*/
+#define S_MOD_INIT_FUNC_POINTERS		0x9			/* section with only function pointers for initialization*/
+#define S_GB_ZEROFILL					0xc			/* zero fill on demand section (that can be larger than 4 gigabytes) */
+#define S_THREAD_LOCAL_ZEROFILL			0x12		/* TLV zero fill section */
+#define S_INIT_FUNC_OFFSETS				0x16		/* 32-bit offsets to initializers */
+
+#define S_ATTR_PURE_INSTRUCTIONS		0x80000000	/* section contains only true machine instructions */
+#define S_ATTR_SOME_INSTRUCTIONS		0x00000400	/* section contains some machine instructions */
+
+#define MACH_SECTION_IS_ZEROFILL(flags)	(((flags) & SECTION_TYPE) == S_ZEROFILL || \
+										 ((flags) & SECTION_TYPE) == S_GB_ZEROFILL || \
+										 ((flags) & SECTION_TYPE) == S_THREAD_LOCAL_ZEROFILL)
+
+
 /**
  * 
  */
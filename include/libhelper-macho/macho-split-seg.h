@@ -0,0 +1,123 @@
+//===-------------------------- macho_split_seg -----------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_SPLIT_SEG_LL_H
+#define LIBHELPER_MACHO_SPLIT_SEG_LL_H
+
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho.h"
+
+/**
+ * 	LC_SEGMENT_SPLIT_INFO lists every place in a dylib that refers to
+ * 	another segment, so the segments can be slid independently of each
+ * 	other - which is how dyld packs dylibs into the shared cache, and what
+ * 	is needed to pull one back out again.
+ *
+ * 	There are two formats. v1 is a list of kinds, each followed by ULEB128
+ * 	address deltas from the mach header, and only records where a
+ * 	reference is. v2 starts with DYLD_CACHE_ADJ_V2_FORMAT and also records
+ * 	which section each reference points to:
+ *
+ * 		<section pair count>
+ * 		  <from section> <to section> <to offset count>
+ * 		    <to offset delta> <from offset count>
+ * 		      <kind> <from offset delta count> <from offset deltas...>
+ *
+ * 	Section indexes count from 1, in load command order, with 0 meaning
+ * 	the mach header.
+ *
+ */
+#define DYLD_CACHE_ADJ_V2_FORMAT					0x7F
+
+#define DYLD_CACHE_ADJ_V2_POINTER_32				0x01
+#define DYLD_CACHE_ADJ_V2_POINTER_64				0x02
+#define DYLD_CACHE_ADJ_V2_DELTA_32					0x03
+#define DYLD_CACHE_ADJ_V2_DELTA_64					0x04
+#define DYLD_CACHE_ADJ_V2_ARM64_ADRP				0x05
+#define DYLD_CACHE_ADJ_V2_ARM64_OFF12				0x06
+#define DYLD_CACHE_ADJ_V2_ARM64_BR26				0x07
+#define DYLD_CACHE_ADJ_V2_ARM_MOVW_MOVT				0x08
+#define DYLD_CACHE_ADJ_V2_ARM_BR24					0x09
+#define DYLD_CACHE_ADJ_V2_THUMB_MOVW_MOVT			0x0A
+#define DYLD_CACHE_ADJ_V2_THUMB_BR22				0x0B
+#define DYLD_CACHE_ADJ_V2_IMAGE_OFF_32				0x0C
+#define DYLD_CACHE_ADJ_V2_THREADED_POINTER_64		0x0D
+
+/**
+ * 	v1 kinds that can be adjusted. v1 entries are converted to the v2 kind
+ * 	with the same meaning when loaded.
+ */
+#define DYLD_CACHE_ADJ_V1_POINTER_32				0x01
+#define DYLD_CACHE_ADJ_V1_POINTER_64				0x02
+#define DYLD_CACHE_ADJ_V1_ARM64_ADRP				0x06
+
+#define MACH_SPLIT_SEG_NO_SECTION					0xffff
+
+
+/**
+ * 	A single reference. `from_offset` and `to_offset` are relative to the
+ * 	start of their sections. v1 doesn't say where a reference points, so
+ * 	`to_section` is MACH_SPLIT_SEG_NO_SECTION for v1 entries.
+ */
+typedef struct mach_split_seg_ref_t {
+	uint64_t	from_offset;
+	uint64_t	to_offset;
+	uint16_t	from_section;
+	uint16_t	to_section;
+	uint32_t	kind;				/* DYLD_CACHE_ADJ_V2_* */
+} mach_split_seg_ref_t;
+
+
+/**
+ * 	Decoded split seg info. `sections` maps section indexes to their
+ * 	section commands (index 0, the mach header, is NULL) and `segments`
+ * 	maps them to the index of their segment in macho->scmds.
+ *
+ * 	v1 entries of a kind that can't be adjusted aren't kept in `refs`, but
+ * 	are counted in `skipped` so mach_split_seg_adjust() reports them as
+ * 	failed.
+ */
+typedef struct mach_split_seg_info_t {
+	uint32_t				 version;		/* 1 or 2 */
+
+	mach_split_seg_ref_t	*refs;
+	uint64_t				 count;
+	uint64_t				 skipped;		/* v1 entries of an unknown kind */
+
+	mach_section_64_t	   **sections;
+	uint32_t				*segments;
+	uint32_t				 nsections;
+} mach_split_seg_info_t;
+
+
+mach_split_seg_info_t		*mach_split_seg_info_load (macho_t *macho);
+void						 mach_split_seg_info_free (mach_split_seg_info_t *info);
+
+int64_t						 mach_split_seg_adjust (macho_t *macho, mach_split_seg_info_t *info,
+												    const int64_t *deltas, uint32_t ndeltas);
+
+char						*mach_split_seg_kind_string (uint32_t kind);
+
+
+#endif /* libhelper_macho_split_seg_ll_h */
@@ -0,0 +1,108 @@
+//===--------------------------- macho_strings ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_STRINGS_LL_H
+#define LIBHELPER_MACHO_STRINGS_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  A `strings`-like pass over a Mach-O. Finds runs of printable ASCII
+ *  (0x20 - 0x7e and tab), and optionally UTF-16LE runs of the same
+ *  characters, in either a set of sections or the whole file.
+ *
+ *  The data is classified 64 bytes at a time into bitmasks of printable
+ *  and zero bytes, using SSE2 or NEON where available, and runs are then
+ *  found by scanning the masks for set bits. Large inputs are split into
+ *  chunks and scanned in parallel.
+ *
+ *  Nothing is copied: each result is an offset and length into the
+ *  Mach-O's data, so results are only valid for as long as the macho_t.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+
+
+#define MACH_STRING_ASCII		0x1
+#define MACH_STRING_UTF16		0x2			/* UTF-16LE */
+
+
+/**
+ * 	A single string. `length` is in characters, so a UTF-16 string takes
+ * 	up twice as many bytes. `section` is NULL if the string isn't inside a
+ * 	section, and `vmaddr` is MACH_ADDR_INVALID if it isn't mapped.
+ */
+typedef struct mach_string_t {
+	uint64_t			 offset;			/* file offset */
+	uint64_t			 vmaddr;			/* VM address */
+	mach_section_64_t	*section;			/* section, owned by the macho_t */
+	uint32_t			 length;			/* in characters */
+	uint32_t			 encoding;			/* MACH_STRING_* */
+} mach_string_t;
+
+
+/**
+ * 	Results, sorted by file offset.
+ */
+typedef struct mach_strings_t {
+	mach_string_t		*strings;
+	uint64_t			 count;
+} mach_strings_t;
+
+
+/**
+ * 	Options for mach_strings_find(). Pass NULL for ASCII strings of at
+ * 	least 4 characters, anywhere in the file, using one thread per CPU.
+ *
+ * 	`sections` is a NULL-terminated list of "SEGMENT.section" names, e.g.
+ * 	"__TEXT.__cstring". If NULL, the whole file is scanned.
+ */
+typedef struct mach_strings_opts_t {
+	uint32_t			 min_length;		/* 0 for the default of 4 */
+	uint32_t			 encodings;			/* 0 for MACH_STRING_ASCII */
+	int					 nthreads;			/* 0 for one per CPU */
+	const char		   **sections;
+} mach_strings_opts_t;
+
+
+mach_strings_t		*mach_strings_find (macho_t *macho, mach_strings_opts_t *opts);
+void				 mach_strings_free (mach_strings_t *strings);
+
+/**
+ * 	Returns a pointer to the first byte of a string. ASCII strings are not
+ * 	necessarily NUL-terminated, so always use the length.
+ */
+static inline const char *mach_string_data (macho_t *macho, mach_string_t *str)
+{
+	return (const char *) macho->data + str->offset;
+}
+
+
+#endif /* libhelper_macho_strings_ll_h */
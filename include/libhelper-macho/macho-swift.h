@@ -0,0 +1,157 @@
+//===---------------------------- macho_swift -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_SWIFT_LL_H
+#define LIBHELPER_MACHO_SWIFT_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Reader for the Swift 5 metadata sections:
+ *
+ *      __swift5_types      relative pointers to nominal type descriptors
+ *      __swift5_protos     relative pointers to protocol descriptors
+ *      __swift5_proto      relative pointers to protocol conformances
+ *      __swift5_fieldmd    field descriptors, back to back
+ *
+ *  Every reference in these sections is a 32-bit offset relative to the
+ *  reference itself, and the descriptors are read in place - only the
+ *  index arrays and qualified names are allocated. The index maps
+ *  qualified type names ("Module.Outer.Type") to types, and protocol
+ *  names to the conformances of that protocol, so "who conforms to X"
+ *  is a hash lookup.
+ *
+ *  Protocols and types defined in other images are referenced through a
+ *  bound pointer. Their names come from the bind's symbol, demangled if
+ *  it's a simple enough name, e.g. "$sSQMp" is "Swift.Equatable".
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper/hhash.h"
+#include "libhelper-macho/macho.h"
+#include "libhelper-macho/macho-fixups.h"
+
+
+/**
+ * 	Context descriptor kinds.
+ */
+#define SWIFT_KIND_MODULE					0
+#define SWIFT_KIND_EXTENSION				1
+#define SWIFT_KIND_ANONYMOUS				2
+#define SWIFT_KIND_PROTOCOL					3
+#define SWIFT_KIND_OPAQUE_TYPE				4
+#define SWIFT_KIND_CLASS					16
+#define SWIFT_KIND_STRUCT					17
+#define SWIFT_KIND_ENUM						18
+
+#define MACH_SWIFT_NONE						UINT32_MAX
+
+
+/**
+ * 	On-disk field descriptor and record layout, from __swift5_fieldmd.
+ */
+typedef struct mach_swift_field_descriptor_t {
+	int32_t			mangled_type_name;
+	int32_t			superclass;
+	uint16_t		kind;
+	uint16_t		field_record_size;
+	uint32_t		num_fields;
+} mach_swift_field_descriptor_t;
+
+typedef struct mach_swift_field_record_t {
+	uint32_t		flags;
+	int32_t			mangled_type_name;
+	int32_t			field_name;
+} mach_swift_field_record_t;
+
+
+/**
+ * 	A nominal type. `name` points into macho->data, `full_name` is
+ * 	allocated.
+ */
+typedef struct mach_swift_type_t {
+	uint64_t		 descriptor;		/* VM address of the type descriptor */
+	uint32_t		 kind;				/* SWIFT_KIND_* */
+	const char		*name;
+	char			*full_name;
+	uint64_t		 fields;			/* VM address of the field descriptor, or 0 */
+} mach_swift_type_t;
+
+typedef struct mach_swift_protocol_t {
+	uint64_t		 descriptor;		/* 0 for protocols from other images */
+	char			*full_name;
+} mach_swift_protocol_t;
+
+typedef struct mach_swift_conformance_t {
+	uint64_t		 descriptor;		/* VM address of the conformance descriptor */
+	uint32_t		 protocol;			/* index into protocols */
+	uint32_t		 type;				/* index into types, or MACH_SWIFT_NONE */
+	const char		*type_name;			/* when `type` is MACH_SWIFT_NONE, or NULL */
+} mach_swift_conformance_t;
+
+
+typedef struct mach_swift_index_t {
+	macho_t						*macho;
+	mach_fixups_t				*fixups;
+
+	mach_swift_type_t			*types;
+	uint32_t					 ntypes;
+	mach_swift_protocol_t		*protocols;
+	uint32_t					 nprotocols;
+	mach_swift_conformance_t	*conformances;
+	uint32_t					 nconformances;
+
+	HHashTable					*types_by_name;			/* full name -> type */
+	HHashTable					*types_by_descriptor;	/* &descriptor -> type */
+	HHashTable					*protocols_by_name;		/* full name -> index + 1 */
+	uint32_t					*conformers;			/* conformance indexes, grouped by protocol */
+	uint32_t					*conformers_start;		/* per protocol, nprotocols + 1 entries */
+} mach_swift_index_t;
+
+
+mach_swift_index_t				*mach_swift_index_load (macho_t *macho);
+void							 mach_swift_index_free (mach_swift_index_t *index);
+
+mach_swift_type_t				*mach_swift_type_find (mach_swift_index_t *index, const char *name);
+mach_swift_protocol_t			*mach_swift_protocol_find (mach_swift_index_t *index, const char *name);
+const uint32_t					*mach_swift_conformers (mach_swift_index_t *index, const char *protocol, uint32_t *count);
+
+/**
+ * 	The mangled type name of a field is returned as-is. It may contain
+ * 	symbolic references - a control byte from 0x01 to 0x17 followed by a
+ * 	32-bit relative offset - so it isn't necessarily a plain C string.
+ */
+mach_swift_field_record_t		*mach_swift_type_fields (mach_swift_index_t *index, mach_swift_type_t *type, uint32_t *count);
+const char						*mach_swift_field_name (mach_swift_index_t *index, mach_swift_field_record_t *record);
+const char						*mach_swift_field_type (mach_swift_index_t *index, mach_swift_field_record_t *record);
+
+char							*mach_swift_kind_string (uint32_t kind);
+
+
+#endif /* libhelper_macho_swift_ll_h */
@@ -88,6 +88,20 @@ typedef struct mach_symbol_table_t {
 #define N_INDR	0xa		/* indirect */
 
 
+/**
+ * 	Parsed symbol table entry. Unlike mach_symtab_find_symbol_name(), the
+ * 	name is not copied - it points directly into the string table held in
+ * 	macho->data, so it is only valid for as long as the macho_t is.
+ */
+typedef struct mach_symbol_info_t {
+	char		*name;			/* symbol name, in macho->data */
+	uint64_t	 value;			/* n_value */
+	uint8_t		 type;			/* n_type */
+	uint8_t		 sect;			/* n_sect */
+	uint16_t	 desc;			/* n_desc */
+} mach_symbol_info_t;
+
+
 /**
  *  Function definitions
  */
@@ -95,6 +109,7 @@ mach_symtab_command_t *mach_symtab_command_create ();
 mach_symtab_command_t *mach_symtab_command_load (macho_t *macho, uint32_t offset);
 char *mach_symtab_find_symbol_name (macho_t *macho, nlist *sym, mach_symtab_command_t *cmd);
 mach_symbol_table_t *mach_symtab_load_symbols (macho_t *macho, mach_symtab_command_t *symbol_table);
+mach_symbol_info_t *mach_symtab_load_symbol_info (macho_t *macho, uint32_t *count);
 
 
 //===-----------------------------------------------------------------------===//
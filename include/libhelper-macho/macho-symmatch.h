@@ -0,0 +1,120 @@
+//===-------------------------- macho_symmatch ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#ifndef LIBHELPER_MACHO_SYMMATCH_LL_H
+#define LIBHELPER_MACHO_SYMMATCH_LL_H
+
+/**
+ *                  === The Libhelper Project ===
+ *                          Mach-O Parser
+ *
+ *  Symbol recovery for stripped binaries. Given a reference Mach-O with
+ *  symbols (e.g. a KDK development kernel) and a stripped target built
+ *  from the same sources (e.g. the release kernelcache), function names
+ *  are carried over from the reference to the target.
+ *
+ *  Both files are split into functions using LC_FUNCTION_STARTS (or the
+ *  symbol table where there isn't one). For each function we compute:
+ *
+ *      -   A hash of its instructions with all of the address-dependant
+ *          immediates masked out (see arm64_normalise()).
+ *      -   An "anchor" hash of every C string it references through an
+ *          ADRP/ADD pair.
+ *      -   The list of functions it calls.
+ *
+ *  Functions are then matched in passes, from most to least certain:
+ *  unique instruction hash *and* anchors, unique anchors, unique
+ *  instruction hash, and finally by walking the call lists of functions
+ *  that have already been matched. Each match records the pass that found
+ *  it and a confidence between 0 and 1.
+ *
+ *  Results are cached by the (reference UUID, target UUID) pair, both in
+ *  memory and, optionally, in a cache directory on disk.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#include "libhelper-macho/macho.h"
+
+
+/**
+ * 	Which pass produced a match.
+ */
+#define MACH_SYMMATCH_HASH_ANCHOR		0x1		/* unique instruction hash and anchors */
+#define MACH_SYMMATCH_ANCHOR			0x2		/* unique string anchors */
+#define MACH_SYMMATCH_HASH				0x3		/* unique instruction hash */
+#define MACH_SYMMATCH_CALLGRAPH			0x4		/* callee of a matched function */
+
+
+/**
+ * 	A recovered symbol.
+ */
+typedef struct mach_symbol_match_t {
+	char		*name;				/* symbol name from the reference */
+	uint64_t	 ref_addr;			/* address in the reference */
+	uint64_t	 target_addr;		/* address in the target */
+	float		 confidence;		/* 0.0 - 1.0 */
+	uint32_t	 method;			/* MACH_SYMMATCH_* */
+} mach_symbol_match_t;
+
+
+/**
+ * 	All recovered symbols for a reference/target pair, sorted by target
+ * 	address. These may be shared with the match cache, so they must be
+ * 	treated as read-only and released with mach_symbol_matches_free().
+ */
+typedef struct mach_symbol_matches_t {
+	mach_symbol_match_t		*matches;
+	uint32_t				 count;
+
+	uint8_t					 ref_uuid[16];
+	uint8_t					 target_uuid[16];
+
+	uint32_t				 refs;			/* reference count, see above */
+} mach_symbol_matches_t;
+
+
+/**
+ * 	Options for mach_symbols_recover(). Pass NULL for the defaults: one
+ * 	thread per CPU, and an in-memory cache only.
+ */
+typedef struct mach_symmatch_opts_t {
+	int				 nthreads;			/* 0 for one per CPU */
+	const char		*cache_dir;			/* on-disk cache directory, or NULL */
+	int				 no_cache;			/* skip both caches */
+} mach_symmatch_opts_t;
+
+
+mach_symbol_matches_t		*mach_symbols_recover (macho_t *ref, macho_t *target, mach_symmatch_opts_t *opts);
+mach_symbol_match_t			*mach_symbol_matches_lookup (mach_symbol_matches_t *matches, uint64_t target_addr);
+void						 mach_symbol_matches_free (mach_symbol_matches_t *matches);
+void						 mach_symmatch_cache_clear (void);
+
+char						*mach_symmatch_method_string (uint32_t method);
+
+
+#endif /* libhelper_macho_symmatch_ll_h */
@@ -55,6 +55,7 @@
 #include "libhelper-macho/macho-segment.h"
 #include "libhelper/hslist.h"
 #include "libhelper/strutils.h"
+#include "libhelper/hasync.h"
 
 
 /***********************************************************************
@@ -107,6 +108,7 @@
 #define MACH_TYPE_DYLIB         0x6
 
 #define MACH_TYPE_KEXT_BUNDLE   0xb
+#define MACH_TYPE_FILESET       0xc
 
 
 /**
@@ -274,22 +276,68 @@ typedef struct macho_t {
     HSList          *dylibs;        // list of dynamic libraries
     HSList          *symbols;       // list of symbols;
     HSList          *strings;       // list of strings;
+
+    /* what macho_free() releases besides the parsed properties */
+    uint32_t         owns;          // MACHO_OWNS_*
     /* add the rest */
 } macho_t;
 
+/**
+ *  Ownership.
+ *
+ *      `path` and `data` belong to whoever created the macho_t, unless the
+ *  flag for them is set in `owns`, in which case macho_free() frees them.
+ *  macho_load() and macho_create_from_file() read the file into a buffer
+ *  that the macho_t owns. A macho_t from macho_load_async() owns both its
+ *  buffer and its copy of the path. macho_create_from_buffer() and
+ *  macho_create_embedded() own neither.
+ */
+#define MACHO_OWNS_DATA     0x1
+#define MACHO_OWNS_PATH     0x2
+
 
 // Functions
 macho_t *macho_create ();
 
 macho_t *macho_load (const char *filename);
+macho_t *macho_create_from_buffer (char *path, uint8_t *data, uint32_t size);
+macho_t *macho_create_embedded (macho_t *container, uint32_t offset);
 void *macho_load_bytes (macho_t *macho, size_t size, uint32_t offset);
 void macho_free (macho_t *macho);
 
+/**
+ *  Asynchronous loading.
+ *
+ *  `macho_load_async()` reads the file on libhelper's I/O pool, parses it
+ *  on the default pool, and calls `callback` with the macho_t, or NULL and
+ *  an errno value: ENOEXEC if it isn't a thin Mach-O, EFBIG if it's over
+ *  `max_size`, ECANCELED if cancelled. It returns straight away with a
+ *  handle for h_async_cancel() / h_async_release(), see hasync.h. The
+ *  callback owns the macho_t, and macho_free() releases all of it.
+ */
+typedef struct macho_load_opts_t {
+    uint32_t     max_size;      /* largest file to load, 0 for no limit */
+} macho_load_opts_t;
+
+typedef void (*macho_load_callback_t) (macho_t *macho, int error, void *ctx);
+
+HAsync *macho_load_async (const char *path, const macho_load_opts_t *opts, macho_load_callback_t callback, void *ctx);
+
 // has to be here because segment.h includes this header
 HSList *mach_segment_get_list (macho_t *mach);
 
 mach_section_info_t *mach_section_info_from_name (macho_t *macho, char *segment, char *section);
 
+/**
+ *  Translate between VM addresses and file offsets using the segment
+ *  commands. Both return MACH_ADDR_INVALID if the address or offset isn't
+ *  backed by the file.
+ */
+#define MACH_ADDR_INVALID       ((uint64_t) -1)
+
+uint64_t mach_vmaddr_to_offset (macho_t *macho, uint64_t vmaddr);
+uint64_t mach_offset_to_vmaddr (macho_t *macho, uint64_t offset);
+
 /***********************************************************************
 * FAT & Mach-O Header functions.
 ***********************************************************************/
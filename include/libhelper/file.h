@@ -49,6 +49,11 @@ typedef struct file_t {
     size_t   size;      /* Size of the file */
 //  unsigned char *data;    /* WIP */
     char    *path;      /* Original path */
+
+    unsigned char   *data;          /* Mapping from `file_map()`, or NULL */
+    size_t           map_size;      /* Size of the region at `data` */
+    int              map_flags;     /* Flags it was mapped with */
+    int              hugepages;     /* Huge pages backed it at map time, see file_map() */
 } file_t;
 
 /**
@@ -60,7 +65,7 @@ typedef struct file_t {
  * 
  *  Use `file_close()` to safely close a file, similar to `fclose()`.
  * 
- *  Use `file_free()` to free and NULL out the file_t structure.
+ *  Use `file_free()` to free the file_t structure without closing it.
  */ 
 file_t  *file_create ();
 file_t  *file_load (const char *path);
@@ -83,5 +88,54 @@ void     file_free (file_t *file);
 int      file_write_new (char *filename, unsigned char *buf, size_t size);
 char    *file_load_bytes (file_t *f, size_t size, uint32_t offset);
 
+/**
+ *  Flags for `file_map()`.
+ *
+ *  LH_FILE_MAP_HUGEPAGE asks for transparent huge pages. Walking a
+ *  multi-GB dyld cache or kernelcache (rebasing, hashing, xref scans)
+ *  with 4K pages spends much of its time on TLB misses, and 2MB pages
+ *  cut those by 512x. It only applies to files of at least
+ *  LH_FILE_HUGEPAGE_SIZE, and needs THP enabled for the kernel's page
+ *  cache (CONFIG_READ_ONLY_THP_FOR_FS) for a read-only mapping.
+ *
+ *  LH_FILE_MAP_COPY gives a private, writable copy of the file in
+ *  anonymous memory instead of a file mapping. Combined with
+ *  LH_FILE_MAP_HUGEPAGE, the copy is 2MB aligned and huge page backed,
+ *  which works with any THP setting other than "never".
+ */
+#define     LH_FILE_MAP_HUGEPAGE    0x1
+#define     LH_FILE_MAP_COPY        0x2
+
+#define     LH_FILE_HUGEPAGE_SIZE   (2 * 1024 * 1024)
+
+/**
+ *  Use `file_map()` to map the whole of a loaded file into memory with
+ *  the given flags. The mapping is stored in the file_t, and is unmapped
+ *  by `file_unmap()` or `file_close()`.
+ *
+ *  `hugepages` is a snapshot, taken as file_map() returns, of whether any
+ *  huge pages back the mapping. A LH_FILE_MAP_COPY mapping has been read
+ *  into by then, so it's a fair answer. A file mapping hasn't been touched
+ *  yet and has no pages at all, so for those it's almost always 0.
+ *
+ *  Use `file_hugepage_bytes()` to get how much of the mapping is backed
+ *  by huge pages right now. Query it after touching the mapping: file
+ *  mappings only get huge pages as they fault in, and any mapping can gain
+ *  more as the kernel collapses pages in the background.
+ */
+unsigned char   *file_map (file_t *file, int flags);
+void             file_unmap (file_t *file);
+size_t           file_hugepage_bytes (file_t *file);
+
+/**
+ *  Use `file_resident_bytes()` to get how much of any memory range, e.g.
+ *  a mapping or a heap buffer holding a file, is in RAM, from mincore().
+ *  If `dirty` isn't NULL it's set to the resident bytes that would have
+ *  to be written out rather than dropped to evict the range: the anonymous
+ *  and copied-on-write pages. Where that can't be told, every resident
+ *  page is counted as dirty.
+ */
+size_t           file_resident_bytes (const void *addr, size_t len, size_t *dirty);
+
 
 #endif /* FILE_H_ */
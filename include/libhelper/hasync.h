@@ -0,0 +1,90 @@
+//===---------------------------- hasync -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  Asynchronous operations with completion callbacks, for callers like
+ *  event loops that can't block on a slow file.
+ *
+ *  An operation has an I/O stage, run on the I/O pool, and a compute
+ *  stage, run on the default pool with the I/O stage's output. Either
+ *  may be NULL. The callback is called exactly once, from a pool thread,
+ *  with the compute stage's result or an errno value. An event loop
+ *  should hand the result back to its own thread from there.
+ *
+ *  Cancelling is best effort. Stages poll `h_async_cancelled()` and give
+ *  up early, and a result that arrives after the cancel is freed instead
+ *  of delivered. Either way the callback still runs, with ECANCELED.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_ASYNC_H_
+#define _LIBHELPER_H_ASYNC_H_
+
+#include <stddef.h>
+
+typedef struct __hasync HAsync;
+
+/**
+ *  A stage. Returns its output, or NULL with `*error` set to an errno
+ *  value, e.g. ECANCELED. A stage owns its input, and must free it if it
+ *  fails.
+ */
+typedef void *(*HAsyncFunc) (HAsync *op, void *input, int *error);
+
+/**
+ *  Called once with the result, which the callback then owns, or NULL
+ *  and an errno value.
+ */
+typedef void (*HAsyncCallback) (void *result, int error, void *ctx);
+
+/**
+ *  Frees a result that won't be delivered.
+ */
+typedef void (*HAsyncFreeFunc) (void *result);
+
+/**
+ *  Use `h_async_run()` to start an operation. `arg` is the input of the
+ *  first stage. The returned handle stays valid until it's passed to
+ *  `h_async_release()`, which can be done at any time, even before the
+ *  callback.
+ *
+ *  Use `h_async_cancel()` to cancel an operation, and `h_async_wait()`
+ *  to block until its callback has returned.
+ */
+HAsync      *h_async_run (HAsyncFunc io, HAsyncFunc compute, HAsyncFreeFunc free_result,
+                          void *arg, HAsyncCallback callback, void *ctx);
+
+void         h_async_cancel (HAsync *op);
+int          h_async_cancelled (HAsync *op);
+void         h_async_wait (HAsync *op);
+void         h_async_release (HAsync *op);
+
+#endif /* _libhelper_h_async_h_ */
@@ -0,0 +1,106 @@
+//===--------------------------- hdigest -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  File fingerprints: SHA-256 for identity, and XXH3 (64-bit, seed 0,
+ *  compatible with the reference implementation) for deduplication.
+ *
+ *  == SHA-256.
+ *
+ *      SHA-256 is a serial chain of rounds, so a single message can't be
+ *  spread over SIMD lanes. Instead there are two fast paths:
+ *
+ *      -   SHA-NI, on x86 CPUs that have it, hashes one message at a time
+ *          with the dedicated round instructions.
+ *      -   Otherwise, the batch API hashes eight independent messages at
+ *          once, one per 32-bit lane (AVX2 on x86). Messages are sorted by
+ *          length first, so lanes finish at about the same time.
+ *
+ *  Both fall back to a portable implementation.
+ *
+ *  == Batches.
+ *
+ *      `h_digest_batch()` hashes many buffers, and `h_digest_files()` many
+ *  files, in groups of eight spread over a thread pool. Files are mapped
+ *  one group at a time, so the memory in use stays bounded. With
+ *  H_DIGEST_NUMA, each NUMA node's pinned pool gets a contiguous block
+ *  of the files, so their pages are read into local memory.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_DIGEST_H_
+#define _LIBHELPER_H_DIGEST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define H_SHA256_LEN            32
+
+/**
+ *  Digests to compute in a batch.
+ */
+#define H_DIGEST_SHA256         0x1
+#define H_DIGEST_XXH3           0x2
+#define H_DIGEST_NUMA           0x100   /* h_digest_files(): read each file on one NUMA node */
+
+/**
+ *  One item in a batch. Set `data` and `len` for h_digest_batch(), or
+ *  `path` for h_digest_files(). `error` is an errno value if the file
+ *  couldn't be read, in which case the digests are zero.
+ */
+typedef struct h_digest_t {
+    const void      *data;
+    size_t           len;
+    const char      *path;
+
+    int              error;
+    uint8_t          sha256[H_SHA256_LEN];
+    uint64_t         xxh3;
+} h_digest_t;
+
+/**
+ *  Use `h_sha256()` and `h_xxh3()` to hash a single buffer.
+ *
+ *  Use `h_digest_batch()` to hash `count` buffers with `nthreads` threads
+ *  (0 for one per CPU), and `h_digest_files()` to do the same for files.
+ *
+ *  Use `h_digest_impl()` to get the name of the SHA-256 implementation in
+ *  use, e.g. "sha-ni".
+ */
+void         h_sha256 (const void *data, size_t len, uint8_t out[H_SHA256_LEN]);
+uint64_t     h_xxh3 (const void *data, size_t len);
+
+void         h_digest_batch (h_digest_t *items, size_t count, int flags, int nthreads);
+void         h_digest_files (h_digest_t *items, size_t count, int flags, int nthreads);
+
+const char  *h_digest_impl (void);
+
+#endif /* _libhelper_h_digest_h_ */
@@ -0,0 +1,80 @@
+//===--------------------------- hentropy ----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  Byte histograms and Shannon entropy. Useful for spotting compressed,
+ *  encrypted or padded regions of a file: compressed and encrypted data
+ *  sits close to 8 bits per byte, code around 5-6, and padding near 0.
+ *
+ *  == Histograms.
+ *
+ *      A naive `hist[data[i]]++` loop stalls whenever the same byte value
+ *  appears several times in a row (which is most of the time in padding),
+ *  because each increment has to wait for the previous store to the same
+ *  counter. h_byte_histogram() spreads consecutive bytes over four
+ *  separate tables and sums them at the end, so neighbouring increments
+ *  never touch the same counter.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_ENTROPY_H_
+#define _LIBHELPER_H_ENTROPY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  Use `h_byte_histogram()` to count each byte value in `data`. The counts
+ *  are added to `hist`, so it must be zeroed (or hold a previous count)
+ *  beforehand. `h_byte_histogram_parallel()` does the same, splitting the
+ *  data across `nthreads` threads (0 for one per CPU).
+ *
+ *  Use `h_entropy_from_histogram()` to turn a histogram of `total` bytes
+ *  into bits per byte (0.0 - 8.0), or `h_entropy()` to do both at once.
+ */
+void     h_byte_histogram (const uint8_t *data, size_t len, uint64_t hist[256]);
+void     h_byte_histogram_parallel (const uint8_t *data, size_t len, uint64_t hist[256], int nthreads);
+
+double   h_entropy_from_histogram (const uint64_t hist[256], uint64_t total);
+double   h_entropy (const uint8_t *data, size_t len);
+
+/**
+ *  Use `h_entropy_windows()` to compute the entropy of every `window`
+ *  bytes of `data`, moving `step` bytes each time. The histogram is slid
+ *  along rather than rebuilt, so small steps are cheap. If `data` is
+ *  shorter than `window` a single value covering all of it is returned.
+ *
+ *  The result is an allocated array of `*count` values, in order.
+ */
+double  *h_entropy_windows (const uint8_t *data, size_t len, size_t window, size_t step,
+                            int nthreads, size_t *count);
+
+#endif /* _libhelper_h_entropy_h_ */
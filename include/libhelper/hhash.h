@@ -0,0 +1,108 @@
+//===----------------------------- hhash -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  Implementation of Hash Tables, loosely based on GLib's GHashTable. Like
+ *  HSList and HString, this is here so libhelper doesn't need to link GLib
+ *  when comparing large sets of symbols, sections and so on.
+ *
+ *  == My Implementation: HHashTable.
+ *
+ *      The table uses open addressing with linear probing. Each slot
+ *  caches the full hash of its key, so most failed probes are rejected
+ *  without calling the equality function. The table grows whenever it
+ *  becomes more than half full, and the capacity is always a power of two.
+ *
+ *  Keys and values are not owned by the table, so freeing them is up to
+ *  the caller.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_HASH_H_
+#define _LIBHELPER_H_HASH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *  Hash and key comparison functions. A hash function must return the
+ *  same value for any two keys the equal function considers equal.
+ *
+ */
+typedef uint64_t (*HHashFunc) (const void *key);
+typedef int (*HEqualFunc) (const void *a, const void *b);
+typedef void (*HHFunc) (void *key, void *value, void *user_data);
+
+typedef struct __hhash_node HHashNode;
+struct __hhash_node
+{
+    uint64_t     hash;      /* cached hash, 0 marks an empty slot */
+    void        *key;
+    void        *value;
+};
+
+typedef struct __hhash_table HHashTable;
+struct __hhash_table
+{
+    HHashNode   *nodes;
+    size_t       size;      /* number of keys stored */
+    size_t       capacity;  /* number of slots, power of two */
+
+    HHashFunc    hash_func;
+    HEqualFunc   key_equal_func;
+};
+
+
+/**
+ *  Hashing and equality helpers for the common key types. `h_str_*` take
+ *  NUL-terminated strings, `h_direct_*` compare the pointer value itself,
+ *  and `h_mem_hash` hashes an arbitrary region (FNV-1a, 64-bit).
+ *
+ */
+uint64_t h_str_hash (const void *key);
+int      h_str_equal (const void *a, const void *b);
+uint64_t h_direct_hash (const void *key);
+int      h_direct_equal (const void *a, const void *b);
+uint64_t h_mem_hash (const void *data, size_t len);
+
+
+HHashTable  *h_hash_table_new (HHashFunc hash_func, HEqualFunc key_equal_func);
+HHashTable  *h_hash_table_sized_new (HHashFunc hash_func, HEqualFunc key_equal_func, size_t size);
+void         h_hash_table_destroy (HHashTable *table);
+
+int          h_hash_table_insert (HHashTable *table, void *key, void *value);
+void        *h_hash_table_lookup (HHashTable *table, const void *key);
+int          h_hash_table_contains (HHashTable *table, const void *key);
+size_t       h_hash_table_size (HHashTable *table);
+void         h_hash_table_foreach (HHashTable *table, HHFunc func, void *user_data);
+
+#endif /* _libhelper_h_hash_h_ */
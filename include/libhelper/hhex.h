@@ -0,0 +1,67 @@
+//===----------------------------- hhex ------------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  Hex encoding and hexdumps. Sixteen bytes at a time are split into
+ *  nibbles and turned into ASCII digits with SIMD (SSE2 or NEON), and
+ *  hexdump lines are built whole from a template, so dumping a region
+ *  costs about as much as copying it.
+ *
+ *  Lines are in the `hexdump -C` layout:
+ *
+ *      00000000  cf fa ed fe 0c 00 00 01  00 00 00 00 02 00 00 00  |................|
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_HEX_H_
+#define _LIBHELPER_H_HEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libhelper/hwriter.h"
+
+/**
+ *  Use `h_hex_encode()` to write `len` bytes as 2 * `len` lowercase hex
+ *  digits to `dst`, which isn't NUL terminated. Returns the number of
+ *  characters written.
+ *
+ *  Use `h_hexdump()` to add a hexdump of `len` bytes to a writer, with
+ *  offsets starting from `addr`, and `h_hexdump_fd()` to write one
+ *  straight to a file descriptor. `h_hexdump_fd()` returns 0, or -1 if
+ *  the write failed.
+ */
+size_t       h_hex_encode (char *dst, const void *src, size_t len);
+
+void         h_hexdump (h_writer_t *w, const void *data, size_t len, uint64_t addr);
+int          h_hexdump_fd (int fd, const void *data, size_t len, uint64_t addr);
+
+#endif /* _libhelper_h_hex_h_ */
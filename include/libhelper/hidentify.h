@@ -0,0 +1,105 @@
+//===-------------------------- hidentify ----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  File format identification, for routing a file to the right parser
+ *  from its first page. Every format libhelper handles is recognised
+ *  from a single dispatch on the first byte, followed by one masked
+ *  compare of the first eight bytes against that format's magic, so an
+ *  unknown file costs a couple of instructions.
+ *
+ *  Along with the format, a few header facts that are cheap to read are
+ *  filled in: the CPU type of a Mach-O, the architecture of a dyld
+ *  shared cache, the four character type of an IM4P and the format of
+ *  its payload, the sizes in a compression header, and so on.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_IDENTIFY_H_
+#define _LIBHELPER_H_IDENTIFY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum lh_format_t {
+    LH_FORMAT_UNKNOWN = 0,
+    LH_FORMAT_MACHO,                /* thin Mach-O, 32 or 64-bit */
+    LH_FORMAT_FAT,                  /* universal binary */
+    LH_FORMAT_DYLD_CACHE,           /* dyld shared cache */
+    LH_FORMAT_IMG4,                 /* IMG4 container */
+    LH_FORMAT_IM4P,                 /* IMG4 payload */
+    LH_FORMAT_IM4M,                 /* IMG4 manifest */
+    LH_FORMAT_COMPLZSS,             /* "complzss" compressed kernelcache */
+    LH_FORMAT_LZFSE,                /* LZFSE / LZVN block, "bvx*" */
+    LH_FORMAT_SEP,                  /* decrypted SEP firmware */
+} lh_format_t;
+
+/**
+ *  Header facts. Only the fields that apply to the format are set, the
+ *  rest are zero.
+ */
+typedef struct lh_identity_t {
+    lh_format_t     format;
+
+    /* Mach-O and FAT */
+    int             is64;
+    int             swapped;        /* byte order differs from ours */
+    uint32_t        cputype;        /* first slice, for FAT */
+    uint32_t        cpusubtype;
+    uint32_t        filetype;
+    uint32_t        ncmds;
+    uint32_t        narchs;
+
+    /* dyld shared cache */
+    char            arch[16];       /* e.g. "arm64e" */
+
+    /* IMG4 / IM4P */
+    char            tag[5];         /* e.g. "krnl", "sepi" */
+    lh_format_t     payload;        /* format of the payload, if it starts in the buffer */
+    size_t          payload_offset;
+
+    /* complzss / LZFSE */
+    uint32_t        compressed_size;
+    uint32_t        uncompressed_size;  /* the whole file, or the first LZFSE block */
+    char            lzfse_block[5];     /* "bvx2", "bvx1", "bvxn" or "bvx-" */
+} lh_identity_t;
+
+/**
+ *  Use `lh_identify()` to classify the first `len` bytes of a file. One
+ *  page is enough for every format. If `id` isn't NULL it's filled in
+ *  with the header facts.
+ *
+ *  Use `lh_format_string()` to get a short name for a format.
+ */
+lh_format_t      lh_identify (const void *buf, size_t len, lh_identity_t *id);
+const char      *lh_format_string (lh_format_t format);
+
+#endif /* _libhelper_h_identify_h_ */
@@ -0,0 +1,181 @@
+//===--------------------------- hparallel ---------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  A small work-stealing thread pool. The parser, scanners and other
+ *  parts of libhelper that run a job over many independent inputs
+ *  share one process-wide pool instead of each starting its own threads.
+ *
+ *  == Tasks.
+ *
+ *      Tasks are spawned into a task group and joined by waiting on the
+ *  group. Each worker keeps its own deque of tasks. It pushes and pops
+ *  its own tasks at one end, and idle workers steal from the other end.
+ *  Tasks spawned from outside the pool go on a shared queue. A thread
+ *  waiting on a group runs other tasks until the group is done, so
+ *  tasks can spawn and wait on their own groups.
+ *
+ *  == Parallel-for.
+ *
+ *      `h_pool_parallel_for()` splits [0, count) into chunks of `grain`
+ *  indices. The caller and up to one helper task per worker take the
+ *  next chunk from a shared counter, so uneven chunks still balance out.
+ *  `h_parallel_for()` does the same on the default pool, one index at
+ *  a time.
+ *
+ *  == Scratch memory.
+ *
+ *      Every thread has its own scratch arena. `h_scratch_alloc()` is a
+ *  bump allocation from it, with no locking. The memory is released
+ *  when the task or parallel-for function that allocated it returns.
+ *
+ *  == Sizing.
+ *
+ *      The default pool has one worker per CPU the process may actually
+ *  use: the CPUs in its affinity mask, capped by a cgroup CPU quota if
+ *  there is one (e.g. in a container).
+ *
+ *  == NUMA.
+ *
+ *      On a multi-socket host, threads scanning mapped files keep touching
+ *  memory on the other node. Each NUMA node can get its own pool, with
+ *  its workers pinned to the node's CPUs. `h_numa_parallel_for()` gives
+ *  each node a contiguous block of the work items, e.g. files or images.
+ *  Pages a worker faults in first are then allocated on its own node.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_PARALLEL_H_
+#define _LIBHELPER_H_PARALLEL_H_
+
+#include <stddef.h>
+
+/**
+ *  Called once for every index in [0, count).
+ */
+typedef void (*HParallelFunc) (size_t index, void *user_data);
+
+/**
+ *  Called once for every chunk [start, end) of a parallel-for.
+ */
+typedef void (*HParallelRangeFunc) (size_t start, size_t end, void *user_data);
+
+/**
+ *  A task spawned into a task group.
+ */
+typedef void (*HTaskFunc) (void *arg);
+
+typedef struct __hpool HPool;
+typedef struct __htask_group HTaskGroup;
+
+/**
+ *  Use `h_parallel_ncpus()` to get the number of CPUs available to the
+ *  process, after CPU affinity and cgroup limits.
+ *
+ *  Use `h_parallel_for()` to run `func` over each index in [0, count)
+ *  on the default pool, using up to `nthreads` threads including the
+ *  caller. If `nthreads` is zero or less, every worker may help. The
+ *  call returns once every index has been processed.
+ */
+int          h_parallel_ncpus (void);
+void         h_parallel_for (size_t count, int nthreads, HParallelFunc func, void *user_data);
+
+/**
+ *  Use `h_pool_new()` to create a pool of `nthreads` workers, or one per
+ *  available CPU if `nthreads` is zero or less, and `h_pool_destroy()`
+ *  to stop it. Every task group must have been waited on first.
+ *
+ *  Use `h_pool_default()` to get the process-wide pool, which is created
+ *  on first use and never destroyed, and `h_pool_io()` for the same for
+ *  blocking I/O. Work that waits on the disk goes on the I/O pool, so it
+ *  doesn't hold up CPU-bound tasks.
+ *
+ *  Use `h_pool_spawn()` to run `func (arg)` on a pool without a task
+ *  group, for work nothing waits on.
+ *
+ *  Use `h_pool_parallel_for()` to run `func` over [0, count) in chunks
+ *  of `grain` indices (1 if zero).
+ */
+HPool       *h_pool_new (int nthreads);
+HPool       *h_pool_default (void);
+HPool       *h_pool_io (void);
+void         h_pool_destroy (HPool *pool);
+int          h_pool_nthreads (HPool *pool);
+void         h_pool_spawn (HPool *pool, HTaskFunc func, void *arg);
+
+void         h_pool_parallel_for (HPool *pool, size_t count, size_t grain, HParallelRangeFunc func, void *user_data);
+
+/**
+ *  Use `h_numa_nodes()` to get the number of NUMA nodes with CPUs the
+ *  process may use (1 without NUMA), and `h_pool_node()` to get the pool
+ *  pinned to node `node`, which is created on first use.
+ *
+ *  Use `h_numa_parallel_for()` to run `func` over [0, count) split into
+ *  one contiguous block per node, each run on that node's pool.
+ *  `h_numa_current_node()` returns the node the calling task runs on, or
+ *  -1 outside a node pool.
+ *
+ *  Use `h_numa_bind()` to prefer a node (-1 for the current one) for an
+ *  anonymous memory range, and `h_numa_touch()` to fault in every page
+ *  of a range from the calling thread.
+ */
+int          h_numa_nodes (void);
+HPool       *h_pool_node (int node);
+int          h_numa_current_node (void);
+
+void         h_numa_parallel_for (size_t count, HParallelFunc func, void *user_data);
+int          h_numa_bind (void *addr, size_t len, int node);
+void         h_numa_touch (const void *addr, size_t len);
+
+/**
+ *  Use `h_task_group_new()` to create a task group on `pool`, and
+ *  `h_task_group_spawn()` to run `func (arg)` on the pool as part of it.
+ *  Tasks may spawn more tasks into the same group.
+ *
+ *  Use `h_task_group_wait()` to block until every task in the group has
+ *  finished, helping to run tasks meanwhile. The group can be reused
+ *  after, or freed with `h_task_group_free()`.
+ */
+HTaskGroup  *h_task_group_new (HPool *pool);
+void         h_task_group_spawn (HTaskGroup *group, HTaskFunc func, void *arg);
+void         h_task_group_wait (HTaskGroup *group);
+void         h_task_group_free (HTaskGroup *group);
+
+/**
+ *  Use `h_scratch_alloc()` to get `size` bytes, 16 byte aligned, from the
+ *  calling thread's scratch arena. They're released when the current
+ *  task or parallel-for function returns, or at `h_scratch_reset()` on a
+ *  thread that isn't running one.
+ */
+void        *h_scratch_alloc (size_t size);
+void         h_scratch_reset (void);
+
+#endif /* _libhelper_h_parallel_h_ */
@@ -0,0 +1,120 @@
+//===---------------------------- hperf ------------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  Hardware counters for the expensive stages of the library: loading a
+ *  Mach-O, building a kernelcache symbol index, LZFSE and LZSS
+ *  decompression, and splitting SEP firmware.
+ *
+ *  Instrumentation is off by default, and then a stage costs one load
+ *  of a flag. Once enabled, each thread opens a perf_event group of
+ *  four counters (cycles, instructions, cache misses and branch misses)
+ *  the first time it enters a stage, and reads the group on the way in
+ *  and out. The difference is added to that thread's total for the
+ *  stage. Stages may nest, e.g. a decode inside a load, and each one
+ *  counts everything it contains.
+ *
+ *  Where perf_event_open() isn't available (not Linux, a restrictive
+ *  perf_event_paranoid, or a container without the syscall), only the
+ *  number of calls and the wall time are recorded.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_PERF_H_
+#define _LIBHELPER_H_PERF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum h_perf_stage_t {
+    H_PERF_MACHO_LOAD = 0,          /* macho_load() */
+    H_PERF_SYMBOL_INDEX,            /* mach_kc_symtab_build() */
+    H_PERF_LZFSE_DECODE,            /* lzfse_decode_buffer() */
+    H_PERF_LZSS_DECODE,             /* decompress_lzss() */
+    H_PERF_SEP_SPLIT,               /* sep_split_init() */
+
+    H_PERF_NSTAGES
+} h_perf_stage_t;
+
+/**
+ *  Totals for a stage. The hardware counts are zero if `hardware` isn't
+ *  set. When the kernel had to multiplex the counters, they're scaled
+ *  up to the time the group was enabled.
+ */
+typedef struct h_perf_counters_t {
+    uint64_t        calls;
+    uint64_t        nsec;               /* wall time */
+
+    int             hardware;
+    uint64_t        cycles;
+    uint64_t        instructions;
+    uint64_t        cache_misses;
+    uint64_t        branch_misses;
+} h_perf_counters_t;
+
+/**
+ *  Totals for every stage on one thread.
+ */
+typedef struct h_perf_thread_t {
+    long                 tid;
+    h_perf_counters_t    stages[H_PERF_NSTAGES];
+} h_perf_thread_t;
+
+/**
+ *  Use `h_perf_enable()` to start instrumenting stages, and
+ *  `h_perf_disable()` to stop. `h_perf_enable()` returns 1 if the
+ *  hardware counters work on the calling thread, or 0 if only calls and
+ *  time will be recorded.
+ *
+ *  Use `h_perf_begin()` and `h_perf_end()` around a stage. Both do
+ *  nothing while instrumentation is off.
+ *
+ *  Use `h_perf_stage()` to get the totals for a stage over every thread,
+ *  and `h_perf_threads()` to copy out the totals of up to `max` threads.
+ *  It returns the number of threads that have entered a stage, which
+ *  may be more than `max`. Threads that have exited are still counted.
+ *
+ *  Use `h_perf_reset()` to zero every total.
+ */
+int          h_perf_enable (void);
+void         h_perf_disable (void);
+int          h_perf_enabled (void);
+
+void         h_perf_begin (h_perf_stage_t stage);
+void         h_perf_end (h_perf_stage_t stage);
+
+void         h_perf_stage (h_perf_stage_t stage, h_perf_counters_t *out);
+size_t       h_perf_threads (h_perf_thread_t *out, size_t max);
+void         h_perf_reset (void);
+
+const char  *h_perf_stage_name (h_perf_stage_t stage);
+
+#endif /* _libhelper_h_perf_h_ */
@@ -0,0 +1,102 @@
+//===---------------------------- htrace -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  Trace events in the Chrome trace format, for looking at a whole job
+ *  in a trace viewer (chrome://tracing, Perfetto). The library marks its
+ *  own stages, in these categories:
+ *
+ *      -   "io":           file_load_bytes(), the copy made by file_map(),
+ *                          and the read stage of the asynchronous loaders.
+ *      -   "parse":        macho_load() and its load command parsing,
+ *                          mach_kc_symtab_build().
+ *      -   "decompress":   lzfse_decode_buffer(), decompress_lzss().
+ *      -   "extract":      sep_split_init().
+ *      -   "async":        each stage of an h_async_run() operation, with
+ *                          a flow from the caller through every stage to
+ *                          the callback, and an "async_in_flight" counter.
+ *
+ *  Tracing is off by default, and then an event costs one load of a
+ *  flag. Each thread appends to its own buffer, with no locks or atomic
+ *  read-modify-writes, and the buffers are written out in one go by
+ *  `h_trace_write()`.
+ *
+ *  Names and categories aren't copied, so they have to be string
+ *  literals, or at least outlive the trace.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_TRACE_H_
+#define _LIBHELPER_H_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ *  Use `h_trace_enable()` to start recording events and
+ *  `h_trace_disable()` to stop. Timestamps start from the first enable.
+ *
+ *  Use `h_trace_begin()` and `h_trace_end()` around a slice of work on
+ *  one thread, and `h_trace_counter()` to record the value of a counter.
+ *
+ *  Use `h_trace_flow_id()` to get a new flow id, and
+ *  `h_trace_flow_start()`, `h_trace_flow_step()` and `h_trace_flow_end()`
+ *  inside slices on any threads to draw arrows between them, e.g. from
+ *  the thread that queued some work to the one that ran it.
+ */
+void         h_trace_enable (void);
+void         h_trace_disable (void);
+int          h_trace_enabled (void);
+
+void         h_trace_begin (const char *cat, const char *name);
+void         h_trace_end (const char *cat, const char *name);
+void         h_trace_counter (const char *name, int64_t value);
+
+uint64_t     h_trace_flow_id (void);
+void         h_trace_flow_start (const char *cat, const char *name, uint64_t id);
+void         h_trace_flow_step (const char *cat, const char *name, uint64_t id);
+void         h_trace_flow_end (const char *cat, const char *name, uint64_t id);
+
+/**
+ *  Use `h_trace_write()` to write every event recorded so far as a
+ *  Chrome trace JSON file, and `h_trace_flush()` to write it to an open
+ *  stream. Both return 0, or -1 with errno set. Threads may still be
+ *  adding events while the trace is written, and those may be left out.
+ *
+ *  Use `h_trace_clear()` to drop every event. No thread may be adding
+ *  events at the same time.
+ */
+int          h_trace_write (const char *path);
+int          h_trace_flush (FILE *fp);
+void         h_trace_clear (void);
+
+#endif /* _libhelper_h_trace_h_ */
@@ -0,0 +1,96 @@
+//===--------------------------- hwriter -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+/**
+ *                  === The Libhelper Project ===
+ *                          HLibc? Maybe...
+ *
+ *  A buffered writer for output that's produced in bulk, e.g. a hexdump
+ *  of a whole segment. Formatters ask for room with `h_writer_reserve()`
+ *  and write straight into the buffer, so nothing is formatted twice or
+ *  allocated per field. The buffer goes out with one write() each time
+ *  it fills up.
+ *
+ *  A writer with no descriptor (fd -1) just collects the output in
+ *  memory, so each thread of a parallel job can build up its own part,
+ *  to be written out in order afterwards.
+ *
+ *  ----------------
+ *  Original Author:
+ *      Harry Moulton, @h3adsh0tzz  -   me@h3adsh0tzz.com.
+ *
+ */
+
+#ifndef _LIBHELPER_H_WRITER_H_
+#define _LIBHELPER_H_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define H_WRITER_DEFAULT_SIZE       (1024 * 1024)
+
+typedef struct h_writer_t {
+    int          fd;            /* -1 to keep everything in memory */
+    char        *buf;
+    size_t       len;
+    size_t       cap;
+    int          error;         /* errno of the first failed write */
+} h_writer_t;
+
+/**
+ *  Use `h_writer_init()` to set up a writer to `fd` with a buffer of
+ *  `cap` bytes, or H_WRITER_DEFAULT_SIZE if zero.
+ *
+ *  Use `h_writer_reserve()` to get room for at least `n` bytes, and
+ *  `h_writer_commit()` once `n` or fewer of them have been filled in.
+ *  Reserving may flush the buffer, or grow it if `n` is larger.
+ *
+ *  Use `h_writer_write()`, `h_writer_puts()` and `h_writer_printf()` to
+ *  append data, a string or formatted text.
+ *
+ *  Use `h_writer_flush()` to write out the buffer, and
+ *  `h_writer_finish()` to flush and free it. The descriptor isn't
+ *  closed. Both return 0, or -1 if a write has failed. For an in-memory
+ *  writer, `h_writer_take()` hands back the buffer instead, which the
+ *  caller frees. After either, the writer is empty and can be written to
+ *  again, starting a new buffer.
+ */
+void         h_writer_init (h_writer_t *w, int fd, size_t cap);
+char        *h_writer_reserve (h_writer_t *w, size_t n);
+
+static inline void h_writer_commit (h_writer_t *w, size_t n)
+{
+    w->len += n;
+}
+
+void         h_writer_write (h_writer_t *w, const void *data, size_t n);
+void         h_writer_puts (h_writer_t *w, const char *str);
+void         h_writer_printf (h_writer_t *w, const char *fmt, ...)
+                 __attribute__ ((format (printf, 2, 3)));
+
+int          h_writer_flush (h_writer_t *w);
+int          h_writer_finish (h_writer_t *w);
+char        *h_writer_take (h_writer_t *w, size_t *len);
+
+#endif /* _libhelper_h_writer_h_ */
@@ -22,6 +22,11 @@
 //
 //===------------------------------------------------------------------===//
 
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "libhelper-dyld/dyld.h"
 
 /***********************************************************************
@@ -38,4 +43,89 @@ dyld_cache_header_t *dyld_cache_header_create ()
 /*dyld_cache_header_t *dyld_cache_header_load (dyld_cache_t *dyld)
 {
 
-}*/
\ No newline at end of file
+}*/
+
+
+/***********************************************************************
+* Asynchronous loading.
+***********************************************************************/
+
+typedef struct dyld_cache_async_t {
+    char                        *path;
+    dyld_cache_load_callback_t   callback;
+    void                        *ctx;
+} dyld_cache_async_t;
+
+
+static void *dyld_cache_async_read (HAsync *op, void *input, int *error)
+{
+    dyld_cache_async_t *job = (dyld_cache_async_t *) input;
+
+    if (h_async_cancelled (op)) {
+        *error = ECANCELED;
+        return NULL;
+    }
+
+    int fd = open (job->path, O_RDONLY);
+    if (fd < 0) {
+        *error = errno;
+        return NULL;
+    }
+
+    dyld_cache_header_t *header = dyld_cache_header_create ();
+    ssize_t n = pread (fd, header, sizeof (dyld_cache_header_t), 0);
+    close (fd);
+
+    if (n != (ssize_t) sizeof (dyld_cache_header_t)) {
+        *error = (n < 0) ? errno : ENOEXEC;
+        free (header);
+        return NULL;
+    }
+    return header;
+}
+
+
+static void *dyld_cache_async_verify (HAsync *op, void *input, int *error)
+{
+    dyld_cache_header_t *header = (dyld_cache_header_t *) input;
+
+    if (h_async_cancelled (op) || strncmp (header->magic, "dyld_v1", 7)) {
+        *error = (h_async_cancelled (op)) ? ECANCELED : ENOEXEC;
+        free (header);
+        return NULL;
+    }
+    return header;
+}
+
+
+static void dyld_cache_async_done (void *result, int error, void *ctx)
+{
+    dyld_cache_async_t *job = (dyld_cache_async_t *) ctx;
+
+    if (job->callback)
+        job->callback ((dyld_cache_header_t *) result, error, job->ctx);
+
+    free (job->path);
+    free (job);
+}
+
+
+/**
+ *  Function:   dyld_cache_load_async
+ *  -----------------------------------
+ *
+ *  Reads and checks the header of a dyld shared cache without blocking
+ *  the caller, the same way as macho_load_async(). The callback gets the
+ *  header, which it then owns, or NULL and ENOEXEC if the file isn't a
+ *  dyld cache.
+ *
+ */
+HAsync *dyld_cache_load_async (const char *path, dyld_cache_load_callback_t callback, void *ctx)
+{
+    dyld_cache_async_t *job = calloc (1, sizeof (dyld_cache_async_t));
+    job->path = strdup (path);
+    job->callback = callback;
+    job->ctx = ctx;
+
+    return h_async_run (dyld_cache_async_read, dyld_cache_async_verify, free, job, dyld_cache_async_done, job);
+}
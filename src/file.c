@@ -22,7 +22,13 @@
 //
 //===------------------------------------------------------------------===//
 
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "libhelper/file.h"
+#include "libhelper/htrace.h"
 
 
 file_t *file_create ()
@@ -41,6 +47,7 @@ file_t *file_load (const char *path)
 	/* Set the file path */
 	if (!path) {
 		errorf ("File path not valid.\n");
+		file_free (file);
 		return NULL;
 	}
 	file->path = path;
@@ -49,6 +56,7 @@ file_t *file_load (const char *path)
 	file->desc = fopen (file->path, "rb");
 	if (!file->desc) {
 		errorf ("File could not be loaded.\n");
+		file_free (file);
 		return NULL;
 	}
 
@@ -64,6 +72,7 @@ file_t *file_load (const char *path)
 
 void file_close (file_t *file)
 {
+	file_unmap (file);
 	fclose (file->desc);
 	file_free (file);
 }
@@ -71,7 +80,6 @@ void file_close (file_t *file)
 
 void file_free (file_t *file)
 {
-	file = NULL;
 	free (file);
 }
 
@@ -93,8 +101,241 @@ char *file_load_bytes (file_t *f, size_t size, uint32_t offset)
 {
 	char *buf = malloc (size);
 
+	h_trace_begin ("io", "file_load_bytes");
 	fseek (f->desc, offset, SEEK_SET);
 	fread (buf, size, 1, f->desc);
+	h_trace_end ("io", "file_load_bytes");
 
 	return buf;
-}
\ No newline at end of file
+}
+
+/**
+ *	Reads `size` bytes at `offset` of the file into `buf`, through the
+ *	descriptor so the FILE's buffering and position are left alone.
+ */
+static int file_read_fully (file_t *file, unsigned char *buf, size_t size, off_t offset)
+{
+	int fd = fileno (file->desc);
+	size_t done = 0;
+	int ret = LH_FILE_SUCCESS;
+
+	h_trace_begin ("io", "file_read");
+	while (done < size) {
+		ssize_t n = pread (fd, buf + done, size - done, offset + done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			ret = LH_FILE_FAILURE;
+			break;
+		}
+		done += n;
+	}
+	h_trace_end ("io", "file_read");
+
+	return ret;
+}
+
+
+/**
+ *	Maps `size` bytes of anonymous memory aligned to a huge page, by
+ *	over-allocating and trimming either side.
+ */
+static unsigned char *file_map_aligned (size_t size)
+{
+	size_t span = size + LH_FILE_HUGEPAGE_SIZE;
+	unsigned char *raw = mmap (NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+		return NULL;
+
+	uintptr_t start = ((uintptr_t) raw + LH_FILE_HUGEPAGE_SIZE - 1) & ~((uintptr_t) LH_FILE_HUGEPAGE_SIZE - 1);
+	size_t head = start - (uintptr_t) raw;
+	if (head)
+		munmap (raw, head);
+	munmap ((unsigned char *) start + size, span - head - size);
+
+	return (unsigned char *) start;
+}
+
+
+/**
+ *	Function:	file_map
+ *	--------------------
+ *
+ *	Maps the whole of a loaded file into memory.
+ *
+ *	file:		The file, from file_load().
+ *	flags:		LH_FILE_MAP_* flags.
+ *
+ *	returns:	The mapping, or NULL on failure. A file that's already
+ *				mapped keeps its existing mapping.
+ *
+ */
+unsigned char *file_map (file_t *file, int flags)
+{
+	if (!file || !file->desc)
+		return NULL;
+	if (file->data)
+		return file->data;
+	if (!file->size) {
+		errorf ("file_map: cannot map an empty file.\n");
+		return NULL;
+	}
+
+	size_t size = file->size;
+	int huge = (flags & LH_FILE_MAP_HUGEPAGE) && size >= LH_FILE_HUGEPAGE_SIZE;
+	unsigned char *data = NULL;
+
+	if (flags & LH_FILE_MAP_COPY) {
+		// Round up so the tail can be a huge page too
+		if (huge)
+			size = (size + LH_FILE_HUGEPAGE_SIZE - 1) & ~((size_t) LH_FILE_HUGEPAGE_SIZE - 1);
+
+		data = (huge) ? file_map_aligned (size) : mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (data == MAP_FAILED)
+			data = NULL;
+		if (!data) {
+			errorf ("file_map: could not allocate %zu bytes.\n", size);
+			return NULL;
+		}
+
+#ifdef MADV_HUGEPAGE
+		// Before the first write, so the faults allocate huge pages directly
+		if (huge)
+			madvise (data, size, MADV_HUGEPAGE);
+#endif
+
+		if (file_read_fully (file, data, file->size, 0) != LH_FILE_SUCCESS) {
+			errorf ("file_map: could not read %s.\n", file->path);
+			munmap (data, size);
+			return NULL;
+		}
+	} else {
+		data = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fileno (file->desc), 0);
+		if (data == MAP_FAILED) {
+			errorf ("file_map: could not map %s.\n", file->path);
+			return NULL;
+		}
+
+#ifdef MADV_HUGEPAGE
+		if (huge)
+			madvise (data, size, MADV_HUGEPAGE);
+#endif
+	}
+
+	file->data = data;
+	file->map_size = size;
+	file->map_flags = flags;
+	// Only a snapshot. A file mapping has no pages yet, see file.h
+	file->hugepages = (huge && file_hugepage_bytes (file) > 0);
+	return data;
+}
+
+
+void file_unmap (file_t *file)
+{
+	if (!file || !file->data)
+		return;
+
+	munmap (file->data, file->map_size);
+	file->data = NULL;
+	file->map_size = 0;
+	file->map_flags = 0;
+	file->hugepages = 0;
+}
+
+
+/**
+ *	Function:	file_hugepage_bytes
+ *	-------------------------------
+ *
+ *	Sums the huge page backed memory of the mappings covering the file's
+ *	mapping, from /proc/self/smaps. Always 0 where that isn't available.
+ *
+ */
+size_t file_hugepage_bytes (file_t *file)
+{
+	if (!file || !file->data)
+		return 0;
+
+	FILE *smaps = fopen ("/proc/self/smaps", "r");
+	if (!smaps)
+		return 0;
+
+	uintptr_t lo = (uintptr_t) file->data, hi = lo + file->map_size;
+	size_t total = 0;
+	int inside = 0;
+	char line[512];
+
+	while (fgets (line, sizeof (line), smaps)) {
+		unsigned long start, end, kb;
+
+		// Mapping headers start "start-end perms ...", fields "Name:  N kB"
+		if (sscanf (line, "%lx-%lx ", &start, &end) == 2) {
+			inside = (start < hi && end > lo);
+			continue;
+		}
+		if (!inside)
+			continue;
+
+		if (sscanf (line, "AnonHugePages: %lu kB", &kb) == 1 ||
+			sscanf (line, "FilePmdMapped: %lu kB", &kb) == 1 ||
+			sscanf (line, "ShmemPmdMapped: %lu kB", &kb) == 1)
+			total += (size_t) kb * 1024;
+	}
+
+	fclose (smaps);
+	return total;
+}
+
+
+/**
+ *	Function:	file_resident_bytes
+ *	-------------------------------
+ *
+ *	Counts the resident pages of a range with mincore(). On Linux, dirty
+ *	pages are told apart with /proc/self/pagemap: a present page that
+ *	isn't a file page (bit 61) is anonymous, or a private copy of a file
+ *	page, and can't just be dropped.
+ *
+ */
+size_t file_resident_bytes (const void *addr, size_t len, size_t *dirty)
+{
+	if (dirty)
+		*dirty = 0;
+	if (!addr || !len)
+		return 0;
+
+	size_t page = (size_t) sysconf (_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t) addr & ~((uintptr_t) page - 1);
+	size_t npages = ((uintptr_t) addr + len - start + page - 1) / page;
+
+	unsigned char *vec = malloc (npages);
+	if (mincore ((void *) start, npages * page, (void *) vec)) {
+		free (vec);
+		return 0;
+	}
+
+	size_t resident = 0;
+	for (size_t i = 0; i < npages; i++)
+		resident += (vec[i] & 1);
+
+	if (dirty) {
+		size_t ndirty = resident;
+#if defined(__linux__)
+		int fd = open ("/proc/self/pagemap", O_RDONLY);
+		uint64_t *entries = (fd >= 0) ? malloc (npages * sizeof (uint64_t)) : NULL;
+		if (entries && pread (fd, entries, npages * sizeof (uint64_t), (off_t) (start / page * sizeof (uint64_t))) == (ssize_t) (npages * sizeof (uint64_t))) {
+			ndirty = 0;
+			for (size_t i = 0; i < npages; i++)
+				ndirty += ((entries[i] >> 63) & 1) && !((entries[i] >> 61) & 1);
+		}
+		free (entries);
+		if (fd >= 0)
+			close (fd);
+#endif
+		*dirty = ndirty * page;
+	}
+
+	free (vec);
+	return resident * page;
+}
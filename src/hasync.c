@@ -0,0 +1,211 @@
+//===---------------------------- hasync -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "libhelper/hasync.h"
+#include "libhelper/hparallel.h"
+#include "libhelper/htrace.h"
+
+struct __hasync
+{
+    atomic_int           refs;          /* the caller's and the pool's */
+    atomic_int           cancelled;
+
+    HAsyncFunc           io;
+    HAsyncFunc           compute;
+    HAsyncFreeFunc       free_result;
+    HAsyncCallback       callback;
+    void                *ctx;
+
+    void                *value;         /* input of the next stage */
+    int                  error;
+
+    pthread_mutex_t      lock;
+    pthread_cond_t       cond;
+    int                  done;          /* the callback has returned */
+
+    uint64_t             flow;          /* trace flow from the caller to the callback */
+};
+
+static atomic_int h_async_in_flight;
+
+
+static void h_async_unref (HAsync *op)
+{
+    if (atomic_fetch_sub (&op->refs, 1) != 1)
+        return;
+
+    pthread_mutex_destroy (&op->lock);
+    pthread_cond_destroy (&op->cond);
+    free (op);
+}
+
+static void h_async_finish (HAsync *op)
+{
+    void *result = op->value;
+    int error = op->error;
+
+    if (!error && atomic_load (&op->cancelled)) {
+        if (result && op->free_result)
+            op->free_result (result);
+        result = NULL;
+        error = ECANCELED;
+    }
+    if (error)
+        result = NULL;
+
+    h_trace_begin ("async", "callback");
+    h_trace_flow_end ("async", "h_async", op->flow);
+    h_trace_counter ("async_in_flight", atomic_fetch_sub (&h_async_in_flight, 1) - 1);
+
+    if (op->callback)
+        op->callback (result, error, op->ctx);
+    h_trace_end ("async", "callback");
+
+    pthread_mutex_lock (&op->lock);
+    op->done = 1;
+    pthread_cond_broadcast (&op->cond);
+    pthread_mutex_unlock (&op->lock);
+
+    h_async_unref (op);
+}
+
+/**
+ *  Runs a stage, unless an earlier one failed. Stages run even once the
+ *  operation is cancelled, as only they know how to free their input.
+ */
+static void h_async_stage (HAsync *op, HAsyncFunc func)
+{
+    if (!func || op->error)
+        return;
+
+    int error = 0;
+    op->value = func (op, op->value, &error);
+    op->error = error;
+}
+
+static void h_async_compute_task (void *arg)
+{
+    HAsync *op = (HAsync *) arg;
+
+    h_trace_begin ("async", "compute");
+    h_trace_flow_step ("async", "h_async", op->flow);
+    h_async_stage (op, op->compute);
+    h_trace_end ("async", "compute");
+
+    h_async_finish (op);
+}
+
+static void h_async_io_task (void *arg)
+{
+    HAsync *op = (HAsync *) arg;
+
+    h_trace_begin ("io", "async read");
+    h_trace_flow_step ("async", "h_async", op->flow);
+    h_async_stage (op, op->io);
+    h_trace_end ("io", "async read");
+
+    if (op->compute && !op->error)
+        h_pool_spawn (h_pool_default (), h_async_compute_task, op);
+    else
+        h_async_finish (op);
+}
+
+
+/**
+ *  Function:   h_async_run
+ *  -----------------------
+ *
+ *  Starts an asynchronous operation.
+ *
+ *  io:             Stage run on the I/O pool, or NULL.
+ *  compute:        Stage run on the default pool, or NULL.
+ *  free_result:    Frees the output of the last stage if it can't be
+ *                  delivered, or NULL.
+ *  arg:            Input of the first stage.
+ *  callback:       Called once the operation completes.
+ *  ctx:            Passed to `callback`.
+ *
+ *  returns:        A handle, to be released with h_async_release().
+ *
+ */
+HAsync *h_async_run (HAsyncFunc io, HAsyncFunc compute, HAsyncFreeFunc free_result,
+                     void *arg, HAsyncCallback callback, void *ctx)
+{
+    HAsync *op = calloc (1, sizeof (HAsync));
+    atomic_init (&op->refs, 2);
+    atomic_init (&op->cancelled, 0);
+    op->io = io;
+    op->compute = compute;
+    op->free_result = free_result;
+    op->callback = callback;
+    op->ctx = ctx;
+    op->value = arg;
+    pthread_mutex_init (&op->lock, NULL);
+    pthread_cond_init (&op->cond, NULL);
+
+    op->flow = h_trace_flow_id ();
+    h_trace_begin ("async", "h_async_run");
+    h_trace_flow_start ("async", "h_async", op->flow);
+    h_trace_counter ("async_in_flight", atomic_fetch_add (&h_async_in_flight, 1) + 1);
+    h_trace_end ("async", "h_async_run");
+
+    if (io)
+        h_pool_spawn (h_pool_io (), h_async_io_task, op);
+    else
+        h_pool_spawn (h_pool_default (), h_async_compute_task, op);
+    return op;
+}
+
+
+void h_async_cancel (HAsync *op)
+{
+    atomic_store (&op->cancelled, 1);
+}
+
+
+int h_async_cancelled (HAsync *op)
+{
+    return atomic_load (&op->cancelled);
+}
+
+
+void h_async_wait (HAsync *op)
+{
+    pthread_mutex_lock (&op->lock);
+    while (!op->done)
+        pthread_cond_wait (&op->cond, &op->lock);
+    pthread_mutex_unlock (&op->lock);
+}
+
+
+void h_async_release (HAsync *op)
+{
+    if (op)
+        h_async_unref (op);
+}
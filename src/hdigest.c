@@ -0,0 +1,730 @@
+//===--------------------------- hdigest -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libhelper/hdigest.h"
+#include "libhelper/hparallel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#   define H_DIGEST_X86         1
+#   include <cpuid.h>
+#   include <immintrin.h>
+#   define H_TARGET_SHANI       __attribute__ ((target ("sha,sse4.1")))
+#   define H_TARGET_AVX2        __attribute__ ((target ("avx2")))
+#else
+#   define H_DIGEST_X86         0
+#   define H_TARGET_AVX2
+#endif
+
+// Messages hashed together by the multi-buffer SHA-256
+#define H_DIGEST_LANES          8
+
+typedef uint32_t h_u32x8 __attribute__ ((vector_size (32)));
+typedef uint64_t h_u64x4 __attribute__ ((vector_size (32)));
+
+
+//===-----------------------------------------------------------------------===//
+/*-- CPU features                         									 --*/
+//===-----------------------------------------------------------------------===//
+
+enum { H_IMPL_SCALAR, H_IMPL_MULTI, H_IMPL_SHANI };
+
+static int h_digest_sha_impl = -1;
+static int h_digest_avx2 = 0;
+
+static void h_digest_init (void)
+{
+    if (h_digest_sha_impl >= 0)
+        return;
+
+    int impl = H_IMPL_MULTI;
+#if H_DIGEST_X86
+    unsigned a, b, c, d;
+    h_digest_avx2 = __builtin_cpu_supports ("avx2");
+    if (__get_cpuid_count (7, 0, &a, &b, &c, &d) && (b & (1u << 29)) && __builtin_cpu_supports ("sse4.1"))
+        impl = H_IMPL_SHANI;
+    else if (!h_digest_avx2)
+        impl = H_IMPL_SCALAR;
+#endif
+
+    // Benign race: every thread computes the same value
+    h_digest_sha_impl = impl;
+}
+
+
+const char *h_digest_impl (void)
+{
+    h_digest_init ();
+    switch (h_digest_sha_impl) {
+        case H_IMPL_SHANI:
+            return "sha-ni";
+        case H_IMPL_MULTI:
+            return (H_DIGEST_X86) ? "avx2 x8" : "simd x8";
+        default:
+            return "scalar";
+    }
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- SHA-256                              									 --*/
+//===-----------------------------------------------------------------------===//
+
+static const uint32_t h_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t h_sha256_init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#define H_ROR32(x, n)       (((x) >> (n)) | ((x) << (32 - (n))))
+#define H_S0(x)             (H_ROR32 (x, 2) ^ H_ROR32 (x, 13) ^ H_ROR32 (x, 22))
+#define H_S1(x)             (H_ROR32 (x, 6) ^ H_ROR32 (x, 11) ^ H_ROR32 (x, 25))
+#define H_s0(x)             (H_ROR32 (x, 7) ^ H_ROR32 (x, 18) ^ ((x) >> 3))
+#define H_s1(x)             (H_ROR32 (x, 17) ^ H_ROR32 (x, 19) ^ ((x) >> 10))
+#define H_CH(x, y, z)       (((x) & (y)) ^ (~(x) & (z)))
+#define H_MAJ(x, y, z)      (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+static uint32_t h_be32 (const uint8_t *p)
+{
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static void h_sha256_blocks_scalar (uint32_t state[8], const uint8_t *data, size_t nblocks)
+{
+    for (; nblocks; nblocks--, data += 64) {
+        uint32_t w[64];
+        for (int t = 0; t < 16; t++)
+            w[t] = h_be32 (data + t * 4);
+        for (int t = 16; t < 64; t++)
+            w[t] = H_s1 (w[t - 2]) + w[t - 7] + H_s0 (w[t - 15]) + w[t - 16];
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int t = 0; t < 64; t++) {
+            uint32_t t1 = h + H_S1 (e) + H_CH (e, f, g) + h_sha256_k[t] + w[t];
+            uint32_t t2 = H_S0 (a) + H_MAJ (a, b, c);
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#if H_DIGEST_X86
+/**
+ *  SHA-NI keeps the state as two vectors, ABEF and CDGH. Each
+ *  sha256rnds2 does two rounds, and sha256msg1/msg2 compute the next
+ *  four words of the message schedule from the previous sixteen.
+ */
+H_TARGET_SHANI
+static void h_sha256_blocks_shani (uint32_t state[8], const uint8_t *data, size_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x (0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) &state[0]), 0xb1);   // CDAB
+    __m128i st1 = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) &state[4]), 0x1b);   // EFGH
+    __m128i st0 = _mm_alignr_epi8 (tmp, st1, 8);                                            // ABEF
+    st1 = _mm_blend_epi16 (st1, tmp, 0xf0);                                                 // CDGH
+
+    for (; nblocks; nblocks--, data += 64) {
+        __m128i abef = st0, cdgh = st1;
+        __m128i msg[4];
+
+        for (int i = 0; i < 4; i++)
+            msg[i] = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (data + i * 16)), bswap);
+
+        for (int g = 0; g < 16; g++) {
+            __m128i m = _mm_add_epi32 (msg[g & 3], _mm_loadu_si128 ((const __m128i *) &h_sha256_k[g * 4]));
+            st1 = _mm_sha256rnds2_epu32 (st1, st0, m);
+            st0 = _mm_sha256rnds2_epu32 (st0, st1, _mm_shuffle_epi32 (m, 0x0e));
+
+            // W[t..t+3] from W[t-16..t-1], replacing the oldest four
+            if (g < 12) {
+                __m128i w = _mm_sha256msg1_epu32 (msg[g & 3], msg[(g + 1) & 3]);
+                w = _mm_add_epi32 (w, _mm_alignr_epi8 (msg[(g + 3) & 3], msg[(g + 2) & 3], 4));
+                msg[g & 3] = _mm_sha256msg2_epu32 (w, msg[(g + 3) & 3]);
+            }
+        }
+
+        st0 = _mm_add_epi32 (st0, abef);
+        st1 = _mm_add_epi32 (st1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32 (st0, 0x1b);                    // FEBA
+    st1 = _mm_shuffle_epi32 (st1, 0xb1);                    // DCHG
+    _mm_storeu_si128 ((__m128i *) &state[0], _mm_blend_epi16 (tmp, st1, 0xf0));    // DCBA
+    _mm_storeu_si128 ((__m128i *) &state[4], _mm_alignr_epi8 (st1, tmp, 8));       // HGFE
+}
+#endif
+
+static void h_sha256_blocks (uint32_t state[8], const uint8_t *data, size_t nblocks)
+{
+#if H_DIGEST_X86
+    if (h_digest_sha_impl == H_IMPL_SHANI) {
+        h_sha256_blocks_shani (state, data, nblocks);
+        return;
+    }
+#endif
+    h_sha256_blocks_scalar (state, data, nblocks);
+}
+
+/**
+ *  Builds the final one or two blocks of a message: the bytes after the
+ *  last full block, the 0x80 terminator, and the bit length. Returns the
+ *  number of blocks.
+ */
+static int h_sha256_tail (const uint8_t *data, size_t len, uint8_t tail[128])
+{
+    size_t rem = len % 64;
+    int nblocks = (rem + 9 <= 64) ? 1 : 2;
+
+    memset (tail, '\0', 128);
+    memcpy (tail, data + len - rem, rem);
+    tail[rem] = 0x80;
+
+    uint64_t bits = (uint64_t) len * 8;
+    for (int i = 0; i < 8; i++)
+        tail[nblocks * 64 - 1 - i] = (uint8_t) (bits >> (i * 8));
+    return nblocks;
+}
+
+static void h_sha256_output (const uint32_t state[8], uint8_t out[H_SHA256_LEN])
+{
+    for (int i = 0; i < 8; i++) {
+        out[i * 4] = (uint8_t) (state[i] >> 24);
+        out[i * 4 + 1] = (uint8_t) (state[i] >> 16);
+        out[i * 4 + 2] = (uint8_t) (state[i] >> 8);
+        out[i * 4 + 3] = (uint8_t) state[i];
+    }
+}
+
+void h_sha256 (const void *data, size_t len, uint8_t out[H_SHA256_LEN])
+{
+    h_digest_init ();
+
+    uint32_t state[8];
+    uint8_t tail[128];
+    memcpy (state, h_sha256_init, sizeof (state));
+
+    h_sha256_blocks (state, (const uint8_t *) data, len / 64);
+    h_sha256_blocks (state, tail, h_sha256_tail ((const uint8_t *) data, len, tail));
+    h_sha256_output (state, out);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Multi-buffer SHA-256                 									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  One block of each of eight messages, one message per 32-bit lane.
+ *  `state` is transposed, state[word][lane].
+ */
+H_TARGET_AVX2
+static void h_sha256_blocks_x8 (uint32_t state[8][H_DIGEST_LANES], const uint8_t *blocks[H_DIGEST_LANES])
+{
+    h_u32x8 w[16], s[8];
+
+    for (int t = 0; t < 16; t++) {
+        uint32_t tmp[H_DIGEST_LANES];
+        for (int l = 0; l < H_DIGEST_LANES; l++)
+            tmp[l] = h_be32 (blocks[l] + t * 4);
+        memcpy (&w[t], tmp, sizeof (h_u32x8));
+    }
+    for (int i = 0; i < 8; i++)
+        memcpy (&s[i], state[i], sizeof (h_u32x8));
+
+    h_u32x8 a = s[0], b = s[1], c = s[2], d = s[3];
+    h_u32x8 e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int t = 0; t < 64; t++) {
+        if (t >= 16)
+            w[t & 15] += H_s1 (w[(t - 2) & 15]) + w[(t - 7) & 15] + H_s0 (w[(t - 15) & 15]);
+
+        h_u32x8 t1 = h + H_S1 (e) + H_CH (e, f, g) + h_sha256_k[t] + w[t & 15];
+        h_u32x8 t2 = H_S0 (a) + H_MAJ (a, b, c);
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+    s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+    for (int i = 0; i < 8; i++)
+        memcpy (state[i], &s[i], sizeof (h_u32x8));
+}
+
+/**
+ *  Hashes up to eight messages together. Lanes that run out of blocks
+ *  are fed a dummy block, and each digest is taken as soon as its last
+ *  block is done.
+ */
+static void h_sha256_multi (h_digest_t **items, int n)
+{
+    static const uint8_t zero[64];
+    uint32_t state[8][H_DIGEST_LANES];
+    uint8_t tail[H_DIGEST_LANES][128];
+    size_t nfull[H_DIGEST_LANES], total[H_DIGEST_LANES], max = 0;
+
+    for (int i = 0; i < 8; i++)
+        for (int l = 0; l < H_DIGEST_LANES; l++)
+            state[i][l] = h_sha256_init[i];
+
+    for (int l = 0; l < n; l++) {
+        nfull[l] = items[l]->len / 64;
+        total[l] = nfull[l] + h_sha256_tail (items[l]->data, items[l]->len, tail[l]);
+        if (total[l] > max)
+            max = total[l];
+    }
+
+    for (size_t blk = 0; blk < max; blk++) {
+        const uint8_t *blocks[H_DIGEST_LANES];
+        for (int l = 0; l < H_DIGEST_LANES; l++) {
+            if (l >= n || blk >= total[l])
+                blocks[l] = zero;
+            else if (blk < nfull[l])
+                blocks[l] = (const uint8_t *) items[l]->data + blk * 64;
+            else
+                blocks[l] = tail[l] + (blk - nfull[l]) * 64;
+        }
+
+        h_sha256_blocks_x8 (state, blocks);
+
+        for (int l = 0; l < n; l++) {
+            if (blk + 1 != total[l])
+                continue;
+
+            uint32_t lane[8];
+            for (int i = 0; i < 8; i++)
+                lane[i] = state[i][l];
+            h_sha256_output (lane, items[l]->sha256);
+        }
+    }
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- XXH3                                 									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  XXH3, 64-bit, with the default secret and a seed of 0. The output
+ *  matches XXH3_64bits() from the reference xxHash.
+ */
+
+static const uint8_t h_xxh3_secret[192] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+#define H_PRIME32_1         0x9E3779B1U
+#define H_PRIME32_2         0x85EBCA77U
+#define H_PRIME32_3         0xC2B2AE3DU
+#define H_PRIME64_1         0x9E3779B185EBCA87ULL
+#define H_PRIME64_2         0xC2B2AE3D27D4EB4FULL
+#define H_PRIME64_3         0x165667B19E3779F9ULL
+#define H_PRIME64_4         0x85EBCA77C2B2AE63ULL
+#define H_PRIME64_5         0x27D4EB2F165667C5ULL
+#define H_PRIME_MX1         0x165667919E3779F9ULL
+#define H_PRIME_MX2         0x9FB21C651E98DF25ULL
+
+#define H_XXH3_STRIPE       64
+#define H_XXH3_STRIPES      ((sizeof (h_xxh3_secret) - H_XXH3_STRIPE) / 8)
+#define H_XXH3_BLOCK        (H_XXH3_STRIPE * H_XXH3_STRIPES)
+
+static uint32_t h_le32 (const uint8_t *p)
+{
+    uint32_t v;
+    memcpy (&v, p, sizeof (uint32_t));
+    return v;
+}
+
+static uint64_t h_le64 (const uint8_t *p)
+{
+    uint64_t v;
+    memcpy (&v, p, sizeof (uint64_t));
+    return v;
+}
+
+static uint64_t h_rotl64 (uint64_t x, int n)
+{
+    return (x << n) | (x >> (64 - n));
+}
+
+static uint64_t h_swap64 (uint64_t x)
+{
+    return __builtin_bswap64 (x);
+}
+
+static uint64_t h_mul128_fold64 (uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128) a * b;
+    return (uint64_t) r ^ (uint64_t) (r >> 64);
+#else
+    uint64_t lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    uint64_t hi_lo = (a >> 32) * (b & 0xffffffff);
+    uint64_t lo_hi = (a & 0xffffffff) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xffffffff);
+    return lower ^ upper;
+#endif
+}
+
+static uint64_t h_xxh64_avalanche (uint64_t h)
+{
+    h ^= h >> 33;
+    h *= H_PRIME64_2;
+    h ^= h >> 29;
+    h *= H_PRIME64_3;
+    return h ^ (h >> 32);
+}
+
+static uint64_t h_xxh3_avalanche (uint64_t h)
+{
+    h ^= h >> 37;
+    h *= H_PRIME_MX1;
+    return h ^ (h >> 32);
+}
+
+static uint64_t h_xxh3_rrmxmx (uint64_t h, uint64_t len)
+{
+    h ^= h_rotl64 (h, 49) ^ h_rotl64 (h, 24);
+    h *= H_PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= H_PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+static uint64_t h_xxh3_mix16 (const uint8_t *in, const uint8_t *secret)
+{
+    return h_mul128_fold64 (h_le64 (in) ^ h_le64 (secret), h_le64 (in + 8) ^ h_le64 (secret + 8));
+}
+
+static uint64_t h_xxh3_short (const uint8_t *in, size_t len)
+{
+    const uint8_t *s = h_xxh3_secret;
+
+    if (len > 8) {
+        uint64_t lo = h_le64 (in) ^ (h_le64 (s + 24) ^ h_le64 (s + 32));
+        uint64_t hi = h_le64 (in + len - 8) ^ (h_le64 (s + 40) ^ h_le64 (s + 48));
+        return h_xxh3_avalanche (len + h_swap64 (lo) + hi + h_mul128_fold64 (lo, hi));
+    }
+    if (len >= 4) {
+        uint64_t v = h_le32 (in + len - 4) + ((uint64_t) h_le32 (in) << 32);
+        return h_xxh3_rrmxmx (v ^ (h_le64 (s + 8) ^ h_le64 (s + 16)), len);
+    }
+    if (len) {
+        uint32_t v = ((uint32_t) in[0] << 16) | ((uint32_t) in[len >> 1] << 24) | in[len - 1] | ((uint32_t) len << 8);
+        return h_xxh64_avalanche (v ^ (uint64_t) (h_le32 (s) ^ h_le32 (s + 4)));
+    }
+    return h_xxh64_avalanche (h_le64 (s + 56) ^ h_le64 (s + 64));
+}
+
+static uint64_t h_xxh3_mid (const uint8_t *in, size_t len)
+{
+    const uint8_t *s = h_xxh3_secret;
+    uint64_t acc = len * H_PRIME64_1;
+
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += h_xxh3_mix16 (in + 48, s + 96);
+                    acc += h_xxh3_mix16 (in + len - 64, s + 112);
+                }
+                acc += h_xxh3_mix16 (in + 32, s + 64);
+                acc += h_xxh3_mix16 (in + len - 48, s + 80);
+            }
+            acc += h_xxh3_mix16 (in + 16, s + 32);
+            acc += h_xxh3_mix16 (in + len - 32, s + 48);
+        }
+        acc += h_xxh3_mix16 (in, s);
+        acc += h_xxh3_mix16 (in + len - 16, s + 16);
+        return h_xxh3_avalanche (acc);
+    }
+
+    for (int i = 0; i < 8; i++)
+        acc += h_xxh3_mix16 (in + 16 * i, s + 16 * i);
+    acc = h_xxh3_avalanche (acc);
+
+    for (size_t i = 8; i < len / 16; i++)
+        acc += h_xxh3_mix16 (in + 16 * i, s + 16 * (i - 8) + 3);
+    acc += h_xxh3_mix16 (in + len - 16, s + 136 - 17);
+    return h_xxh3_avalanche (acc);
+}
+
+/**
+ *  The long input loop, on four-lane vectors of 64-bit accumulators:
+ *  acc[i ^ 1] += data[i], acc[i] += lo32(data[i] ^ key[i]) * hi32(...).
+ *  It's built twice, once for AVX2.
+ */
+#define H_XXH3_ACCUMULATE(acc, in, secret, nstripes)                         \
+    for (size_t n = 0; n < (nstripes); n++) {                               \
+        const uint8_t *p = (in) + n * H_XXH3_STRIPE;                        \
+        const uint8_t *k = (secret) + n * 8;                                \
+        for (int v = 0; v < 2; v++) {                                       \
+            h_u64x4 data, key;                                              \
+            memcpy (&data, p + v * 32, sizeof (h_u64x4));                   \
+            memcpy (&key, k + v * 32, sizeof (h_u64x4));                    \
+            key ^= data;                                                    \
+            (acc)[v] += __builtin_shuffle (data, (h_u64x4) { 1, 0, 3, 2 }); \
+            (acc)[v] += (key & 0xffffffff) * (key >> 32);                   \
+        }                                                                   \
+    }
+
+static void h_xxh3_accumulate (h_u64x4 acc[2], const uint8_t *in, const uint8_t *secret, size_t nstripes)
+{
+    H_XXH3_ACCUMULATE (acc, in, secret, nstripes)
+}
+
+H_TARGET_AVX2
+static void h_xxh3_accumulate_avx2 (h_u64x4 acc[2], const uint8_t *in, const uint8_t *secret, size_t nstripes)
+{
+    H_XXH3_ACCUMULATE (acc, in, secret, nstripes)
+}
+
+static void h_xxh3_scramble (h_u64x4 acc[2], const uint8_t *secret)
+{
+    for (int v = 0; v < 2; v++) {
+        h_u64x4 key;
+        memcpy (&key, secret + v * 32, sizeof (h_u64x4));
+        acc[v] ^= acc[v] >> 47;
+        acc[v] ^= key;
+        acc[v] *= H_PRIME32_1;
+    }
+}
+
+static uint64_t h_xxh3_long (const uint8_t *in, size_t len)
+{
+    const uint8_t *s = h_xxh3_secret;
+    void (*accumulate) (h_u64x4 *, const uint8_t *, const uint8_t *, size_t) =
+        (h_digest_avx2) ? h_xxh3_accumulate_avx2 : h_xxh3_accumulate;
+
+    h_u64x4 acc[2] = {
+        { H_PRIME32_3, H_PRIME64_1, H_PRIME64_2, H_PRIME64_3 },
+        { H_PRIME64_4, H_PRIME32_2, H_PRIME64_5, H_PRIME32_1 },
+    };
+
+    size_t nblocks = (len - 1) / H_XXH3_BLOCK;
+    for (size_t b = 0; b < nblocks; b++) {
+        accumulate (acc, in + b * H_XXH3_BLOCK, s, H_XXH3_STRIPES);
+        h_xxh3_scramble (acc, s + sizeof (h_xxh3_secret) - H_XXH3_STRIPE);
+    }
+
+    size_t nstripes = ((len - 1) - H_XXH3_BLOCK * nblocks) / H_XXH3_STRIPE;
+    accumulate (acc, in + nblocks * H_XXH3_BLOCK, s, nstripes);
+
+    // The last stripe, which may overlap the previous one
+    accumulate (acc, in + len - H_XXH3_STRIPE, s + sizeof (h_xxh3_secret) - H_XXH3_STRIPE - 7, 1);
+
+    uint64_t a[8];
+    memcpy (a, acc, sizeof (a));
+
+    uint64_t result = len * H_PRIME64_1;
+    for (int i = 0; i < 4; i++)
+        result += h_mul128_fold64 (a[2 * i] ^ h_le64 (s + 11 + 16 * i), a[2 * i + 1] ^ h_le64 (s + 11 + 16 * i + 8));
+    return h_xxh3_avalanche (result);
+}
+
+uint64_t h_xxh3 (const void *data, size_t len)
+{
+    const uint8_t *in = (const uint8_t *) data;
+
+    if (len <= 16)
+        return h_xxh3_short (in, len);
+    if (len <= 240)
+        return h_xxh3_mid (in, len);
+
+    h_digest_init ();
+    return h_xxh3_long (in, len);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Batches                              									 --*/
+//===-----------------------------------------------------------------------===//
+
+typedef struct h_digest_batch_t {
+    h_digest_t     **items;
+    size_t           count;
+    int              flags;
+    int              files;
+} h_digest_batch_t;
+
+static int h_digest_len_compare (const void *x, const void *y)
+{
+    size_t a = (*(h_digest_t * const *) x)->len;
+    size_t b = (*(h_digest_t * const *) y)->len;
+    return (a > b) - (a < b);
+}
+
+static void h_digest_map (h_digest_t *item)
+{
+    item->data = NULL;
+    item->len = 0;
+
+    int fd = open (item->path, O_RDONLY);
+    if (fd < 0) {
+        item->error = errno;
+        return;
+    }
+
+    struct stat st;
+    if (fstat (fd, &st)) {
+        item->error = errno;
+    } else if (st.st_size > 0) {
+        void *map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            item->error = errno;
+        } else {
+            madvise (map, st.st_size, MADV_SEQUENTIAL);
+            item->data = map;
+            item->len = st.st_size;
+        }
+    }
+    close (fd);
+}
+
+static void h_digest_group (size_t index, void *user_data)
+{
+    h_digest_batch_t *batch = (h_digest_batch_t *) user_data;
+    h_digest_t **items = batch->items + index * H_DIGEST_LANES;
+    int n = (int) ((batch->count - index * H_DIGEST_LANES < H_DIGEST_LANES)
+                   ? batch->count - index * H_DIGEST_LANES : H_DIGEST_LANES);
+
+    if (batch->files)
+        for (int i = 0; i < n; i++)
+            h_digest_map (items[i]);
+
+    if (batch->flags & H_DIGEST_SHA256) {
+        if (h_digest_sha_impl == H_IMPL_MULTI && n > 1) {
+            h_sha256_multi (items, n);
+        } else {
+            for (int i = 0; i < n; i++)
+                h_sha256 (items[i]->data, items[i]->len, items[i]->sha256);
+        }
+    }
+
+    if (batch->flags & H_DIGEST_XXH3)
+        for (int i = 0; i < n; i++)
+            items[i]->xxh3 = h_xxh3 (items[i]->data, items[i]->len);
+
+    for (int i = 0; i < n && batch->files; i++) {
+        if (items[i]->error) {
+            memset (items[i]->sha256, '\0', H_SHA256_LEN);
+            items[i]->xxh3 = 0;
+        }
+        if (items[i]->data)
+            munmap ((void *) items[i]->data, items[i]->len);
+        items[i]->data = NULL;
+    }
+}
+
+static void h_digest_run (h_digest_t *items, size_t count, int flags, int nthreads, int files)
+{
+    h_digest_init ();
+
+    h_digest_batch_t batch;
+    batch.items = malloc (sizeof (h_digest_t *) * (count + 1));
+    batch.count = count;
+    batch.flags = flags;
+    batch.files = files;
+
+    for (size_t i = 0; i < count; i++) {
+        batch.items[i] = &items[i];
+        items[i].error = 0;
+    }
+
+    // Similar lengths in each group keep the multi-buffer lanes busy
+    if (!files && h_digest_sha_impl == H_IMPL_MULTI && (flags & H_DIGEST_SHA256))
+        qsort (batch.items, count, sizeof (h_digest_t *), h_digest_len_compare);
+
+    size_t ngroups = (count + H_DIGEST_LANES - 1) / H_DIGEST_LANES;
+    if (files && (flags & H_DIGEST_NUMA))
+        h_numa_parallel_for (ngroups, h_digest_group, &batch);
+    else
+        h_parallel_for (ngroups, nthreads, h_digest_group, &batch);
+    free (batch.items);
+}
+
+
+/**
+ *  Function:   h_digest_batch
+ *  --------------------------
+ *
+ *  Computes the digests in `flags` for every item's data.
+ *
+ */
+void h_digest_batch (h_digest_t *items, size_t count, int flags, int nthreads)
+{
+    h_digest_run (items, count, flags, nthreads, 0);
+}
+
+
+/**
+ *  Function:   h_digest_files
+ *  --------------------------
+ *
+ *  Computes the digests in `flags` for every item's file. Each file is
+ *  mapped only while its group is hashed. With H_DIGEST_NUMA the files
+ *  are split into a block per NUMA node, and each file is read by a
+ *  thread on its node.
+ *
+ */
+void h_digest_files (h_digest_t *items, size_t count, int flags, int nthreads)
+{
+    h_digest_run (items, count, flags, nthreads, 1);
+}
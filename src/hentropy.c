@@ -0,0 +1,261 @@
+//===--------------------------- hentropy ----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhelper/hentropy.h"
+#include "libhelper/hparallel.h"
+
+// Each table counts a quarter of a block, so this keeps the 32-bit
+// counters well clear of overflow
+#define H_HISTOGRAM_BLOCK       (1UL << 30)
+
+// Size of the chunks handed to each thread by the parallel variants
+#define H_HISTOGRAM_CHUNK       (8UL << 20)
+#define H_ENTROPY_WINDOW_BATCH  512
+
+// Windows up to this size use a lookup table for c * log2(c)
+#define H_ENTROPY_TABLE_MAX     (1UL << 20)
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Histograms                           									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void h_byte_histogram_block (const uint8_t *data, size_t len, uint64_t hist[256])
+{
+    uint32_t t[4][256];
+    memset (t, '\0', sizeof (t));
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy (&w, data + i, 8);
+
+        t[0][(uint8_t) (w)]++;
+        t[1][(uint8_t) (w >> 8)]++;
+        t[2][(uint8_t) (w >> 16)]++;
+        t[3][(uint8_t) (w >> 24)]++;
+        t[0][(uint8_t) (w >> 32)]++;
+        t[1][(uint8_t) (w >> 40)]++;
+        t[2][(uint8_t) (w >> 48)]++;
+        t[3][(uint8_t) (w >> 56)]++;
+    }
+    for (; i < len; i++)
+        t[0][data[i]]++;
+
+    for (int b = 0; b < 256; b++)
+        hist[b] += (uint64_t) t[0][b] + t[1][b] + t[2][b] + t[3][b];
+}
+
+
+void h_byte_histogram (const uint8_t *data, size_t len, uint64_t hist[256])
+{
+    while (len) {
+        size_t n = (len > H_HISTOGRAM_BLOCK) ? H_HISTOGRAM_BLOCK : len;
+        h_byte_histogram_block (data, n, hist);
+        data += n;
+        len -= n;
+    }
+}
+
+
+typedef struct h_histogram_job_t {
+    const uint8_t   *data;
+    size_t           len;
+    uint64_t        *hists;         // 256 counters per chunk
+} h_histogram_job_t;
+
+static void h_histogram_worker (size_t index, void *user_data)
+{
+    h_histogram_job_t *job = (h_histogram_job_t *) user_data;
+    size_t off = index * H_HISTOGRAM_CHUNK;
+    size_t n = (job->len - off > H_HISTOGRAM_CHUNK) ? H_HISTOGRAM_CHUNK : job->len - off;
+
+    h_byte_histogram (job->data + off, n, &job->hists[index * 256]);
+}
+
+
+void h_byte_histogram_parallel (const uint8_t *data, size_t len, uint64_t hist[256], int nthreads)
+{
+    size_t nchunks = (len + H_HISTOGRAM_CHUNK - 1) / H_HISTOGRAM_CHUNK;
+    if (nchunks <= 1 || nthreads == 1) {
+        h_byte_histogram (data, len, hist);
+        return;
+    }
+
+    h_histogram_job_t job = { data, len, calloc (nchunks * 256, sizeof (uint64_t)) };
+    h_parallel_for (nchunks, nthreads, h_histogram_worker, &job);
+
+    for (size_t c = 0; c < nchunks; c++)
+        for (int b = 0; b < 256; b++)
+            hist[b] += job.hists[c * 256 + b];
+
+    free (job.hists);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Entropy                              									 --*/
+//===-----------------------------------------------------------------------===//
+
+static double h_entropy_clamp (double e)
+{
+    // Rounding can push a constant or uniform region just outside [0, 8]
+    if (e < 0.0) return 0.0;
+    if (e > 8.0) return 8.0;
+    return e;
+}
+
+
+double h_entropy_from_histogram (const uint64_t hist[256], uint64_t total)
+{
+    if (!total) return 0.0;
+
+    double e = 0.0;
+    for (int b = 0; b < 256; b++) {
+        if (!hist[b]) continue;
+        double p = (double) hist[b] / (double) total;
+        e -= p * log2 (p);
+    }
+    return h_entropy_clamp (e);
+}
+
+
+double h_entropy (const uint8_t *data, size_t len)
+{
+    uint64_t hist[256];
+    memset (hist, '\0', sizeof (hist));
+    h_byte_histogram (data, len, hist);
+    return h_entropy_from_histogram (hist, len);
+}
+
+
+/**
+ *  For a window of W bytes with counts c_i, the entropy is
+ *
+ *      H = log2(W) - (1/W) * sum(c_i * log2(c_i))
+ *
+ *  so sliding the window only has to adjust the sum for the counters
+ *  that change, rather than walking all 256 of them.
+ */
+typedef struct h_window_job_t {
+    const uint8_t   *data;
+    size_t           window;
+    size_t           step;
+    size_t           count;
+    double          *out;
+    double          *clogc;         // c * log2(c), or NULL
+} h_window_job_t;
+
+static inline double h_clogc (h_window_job_t *job, uint32_t c)
+{
+    if (job->clogc) return job->clogc[c];
+    return c ? (double) c * log2 ((double) c) : 0.0;
+}
+
+static void h_window_worker (size_t index, void *user_data)
+{
+    h_window_job_t *job = (h_window_job_t *) user_data;
+    size_t first = index * H_ENTROPY_WINDOW_BATCH;
+    size_t last = first + H_ENTROPY_WINDOW_BATCH;
+    if (last > job->count)
+        last = job->count;
+
+    double w = (double) job->window, logw = log2 (w);
+
+    // Windows that don't overlap gain nothing from sliding
+    if (job->step >= job->window) {
+        for (size_t i = first; i < last; i++)
+            job->out[i] = h_entropy (job->data + i * job->step, job->window);
+        return;
+    }
+
+    uint32_t c[256];
+    memset (c, '\0', sizeof (c));
+    double sum = 0.0;
+
+    const uint8_t *p = job->data + first * job->step;
+    for (size_t i = 0; i < job->window; i++)
+        c[p[i]]++;
+    for (int b = 0; b < 256; b++)
+        sum += h_clogc (job, c[b]);
+    job->out[first] = h_entropy_clamp (logw - sum / w);
+
+    for (size_t i = first + 1; i < last; i++) {
+        const uint8_t *out = job->data + (i - 1) * job->step;
+        const uint8_t *in = out + job->window;
+
+        for (size_t j = 0; j < job->step; j++) {
+            uint8_t b = out[j];
+            sum -= h_clogc (job, c[b]);
+            sum += h_clogc (job, --c[b]);
+
+            b = in[j];
+            sum -= h_clogc (job, c[b]);
+            sum += h_clogc (job, ++c[b]);
+        }
+        job->out[i] = h_entropy_clamp (logw - sum / w);
+    }
+}
+
+
+double *h_entropy_windows (const uint8_t *data, size_t len, size_t window, size_t step,
+                           int nthreads, size_t *count)
+{
+    *count = 0;
+    if (!data || !len || !window || !step)
+        return NULL;
+
+    if (len <= window) {
+        double *ret = malloc (sizeof (double));
+        *ret = h_entropy (data, len);
+        *count = 1;
+        return ret;
+    }
+
+    h_window_job_t job;
+    job.data = data;
+    job.window = window;
+    job.step = step;
+    job.count = (len - window) / step + 1;
+    job.out = malloc (sizeof (double) * job.count);
+    job.clogc = NULL;
+
+    if (step < window && window <= H_ENTROPY_TABLE_MAX) {
+        job.clogc = malloc (sizeof (double) * (window + 1));
+        job.clogc[0] = 0.0;
+        for (size_t c = 1; c <= window; c++)
+            job.clogc[c] = (double) c * log2 ((double) c);
+    }
+
+    size_t nbatches = (job.count + H_ENTROPY_WINDOW_BATCH - 1) / H_ENTROPY_WINDOW_BATCH;
+    h_parallel_for (nbatches, nthreads, h_window_worker, &job);
+
+    free (job.clogc);
+    *count = job.count;
+    return job.out;
+}
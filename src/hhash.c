@@ -0,0 +1,232 @@
+//===----------------------------- hhash -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper/hhash.h"
+#include "libhelper/hslist.h"
+
+#define FNV_OFFSET_BASIS    0xcbf29ce484222325ULL
+#define FNV_PRIME           0x100000001b3ULL
+
+#define HHASH_MIN_CAPACITY  16
+
+
+uint64_t h_mem_hash (const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) data;
+    uint64_t h = FNV_OFFSET_BASIS;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+
+uint64_t h_str_hash (const void *key)
+{
+    const uint8_t *p = (const uint8_t *) key;
+    uint64_t h = FNV_OFFSET_BASIS;
+
+    while (*p) {
+        h ^= *p++;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+
+int h_str_equal (const void *a, const void *b)
+{
+    return strcmp ((const char *) a, (const char *) b) == 0;
+}
+
+
+uint64_t h_direct_hash (const void *key)
+{
+    // splitmix64 finaliser, so sequential pointers/integers spread out
+    uint64_t x = (uint64_t) (uintptr_t) key;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+
+int h_direct_equal (const void *a, const void *b)
+{
+    return a == b;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- HHashTable                           									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  A hash value of zero is reserved to mark empty slots, so any key that
+ *  hashes to zero is nudged to one.
+ */
+static inline uint64_t
+h_hash_table_hash_key (HHashTable *table, const void *key)
+{
+    uint64_t h = table->hash_func (key);
+    return h ? h : 1;
+}
+
+
+static size_t
+h_hash_table_find_slot (HHashTable *table, const void *key, uint64_t hash)
+{
+    size_t mask = table->capacity - 1;
+    size_t i = (size_t) hash & mask;
+
+    while (table->nodes[i].hash) {
+        if (table->nodes[i].hash == hash &&
+            table->key_equal_func (table->nodes[i].key, key))
+            return i;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+
+static void
+h_hash_table_resize (HHashTable *table, size_t capacity)
+{
+    HHashNode *old = table->nodes;
+    size_t old_capacity = table->capacity;
+
+    table->nodes = h_slice_alloc0 (capacity * sizeof (HHashNode));
+    table->capacity = capacity;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (!old[i].hash) continue;
+
+        size_t mask = capacity - 1;
+        size_t k = (size_t) old[i].hash & mask;
+        while (table->nodes[k].hash)
+            k = (k + 1) & mask;
+        table->nodes[k] = old[i];
+    }
+
+    free (old);
+}
+
+
+HHashTable *h_hash_table_sized_new (HHashFunc hash_func, HEqualFunc key_equal_func, size_t size)
+{
+    HHashTable *table = h_slice_alloc0 (sizeof (HHashTable));
+    size_t capacity = HHASH_MIN_CAPACITY;
+
+    // keep the load factor under one half for the expected size
+    while (capacity < size * 2)
+        capacity <<= 1;
+
+    table->hash_func = hash_func ? hash_func : h_direct_hash;
+    table->key_equal_func = key_equal_func ? key_equal_func : h_direct_equal;
+    table->capacity = capacity;
+    table->nodes = h_slice_alloc0 (capacity * sizeof (HHashNode));
+
+    return table;
+}
+
+
+HHashTable *h_hash_table_new (HHashFunc hash_func, HEqualFunc key_equal_func)
+{
+    return h_hash_table_sized_new (hash_func, key_equal_func, 0);
+}
+
+
+void h_hash_table_destroy (HHashTable *table)
+{
+    if (!table) return;
+    free (table->nodes);
+    free (table);
+}
+
+
+/**
+ *  Inserts `key` into the table, replacing the value if the key is already
+ *  present. Returns 1 if a new key was added, or 0 if it was replaced.
+ */
+int h_hash_table_insert (HHashTable *table, void *key, void *value)
+{
+    if ((table->size + 1) * 2 > table->capacity)
+        h_hash_table_resize (table, table->capacity << 1);
+
+    uint64_t hash = h_hash_table_hash_key (table, key);
+    size_t slot = h_hash_table_find_slot (table, key, hash);
+
+    if (table->nodes[slot].hash) {
+        table->nodes[slot].value = value;
+        return 0;
+    }
+
+    table->nodes[slot].hash = hash;
+    table->nodes[slot].key = key;
+    table->nodes[slot].value = value;
+    table->size++;
+    return 1;
+}
+
+
+void *h_hash_table_lookup (HHashTable *table, const void *key)
+{
+    if (!table) return NULL;
+
+    uint64_t hash = h_hash_table_hash_key (table, key);
+    size_t slot = h_hash_table_find_slot (table, key, hash);
+
+    return table->nodes[slot].hash ? table->nodes[slot].value : NULL;
+}
+
+
+int h_hash_table_contains (HHashTable *table, const void *key)
+{
+    if (!table) return 0;
+
+    uint64_t hash = h_hash_table_hash_key (table, key);
+    size_t slot = h_hash_table_find_slot (table, key, hash);
+
+    return table->nodes[slot].hash != 0;
+}
+
+
+size_t h_hash_table_size (HHashTable *table)
+{
+    return table ? table->size : 0;
+}
+
+
+void h_hash_table_foreach (HHashTable *table, HHFunc func, void *user_data)
+{
+    if (!table) return;
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->nodes[i].hash)
+            func (table->nodes[i].key, table->nodes[i].value, user_data);
+    }
+}
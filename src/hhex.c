@@ -0,0 +1,241 @@
+//===----------------------------- hhex ------------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <string.h>
+
+#include "libhelper/hhex.h"
+
+// Lines formatted per reserve from the writer
+#define HEX_LINES_PER_BATCH     4096
+
+static const char hex_digits[] = "0123456789abcdef";
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Sixteen bytes at a time              									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  `hex_encode16()` writes the 32 hex digits of src[0..16), and
+ *  `hex_printable16()` writes src[0..16) with every byte outside
+ *  0x20 - 0x7e replaced by a '.'.
+ */
+#if defined(__SSE2__)
+
+static inline __m128i hex_nibbles_to_ascii (__m128i n)
+{
+    // n + '0', and another 'a' - '0' - 10 for the digits above 9
+    __m128i adj = _mm_and_si128 (_mm_cmpgt_epi8 (n, _mm_set1_epi8 (9)), _mm_set1_epi8 ('a' - '0' - 10));
+    return _mm_add_epi8 (_mm_add_epi8 (n, _mm_set1_epi8 ('0')), adj);
+}
+
+static inline void hex_encode16 (char *dst, const uint8_t *src)
+{
+    const __m128i mask = _mm_set1_epi8 (0x0f);
+
+    __m128i x = _mm_loadu_si128 ((const __m128i *) src);
+    __m128i hi = hex_nibbles_to_ascii (_mm_and_si128 (_mm_srli_epi16 (x, 4), mask));
+    __m128i lo = hex_nibbles_to_ascii (_mm_and_si128 (x, mask));
+
+    _mm_storeu_si128 ((__m128i *) dst, _mm_unpacklo_epi8 (hi, lo));
+    _mm_storeu_si128 ((__m128i *) (dst + 16), _mm_unpackhi_epi8 (hi, lo));
+}
+
+static inline void hex_printable16 (char *dst, const uint8_t *src)
+{
+    const __m128i lo = _mm_set1_epi8 (0x20);
+    const __m128i bias = _mm_set1_epi8 ((char) 0x80);
+    const __m128i limit = _mm_set1_epi8 ((char) (0x5f ^ 0x80));
+
+    // (x - 0x20) < 0x5f, unsigned, done as a signed compare
+    __m128i x = _mm_loadu_si128 ((const __m128i *) src);
+    __m128i keep = _mm_cmplt_epi8 (_mm_xor_si128 (_mm_sub_epi8 (x, lo), bias), limit);
+    __m128i out = _mm_or_si128 (_mm_and_si128 (keep, x), _mm_andnot_si128 (keep, _mm_set1_epi8 ('.')));
+
+    _mm_storeu_si128 ((__m128i *) dst, out);
+}
+
+#elif defined(__ARM_NEON)
+
+static inline uint8x16_t hex_nibbles_to_ascii (uint8x16_t n)
+{
+    uint8x16_t adj = vandq_u8 (vcgtq_u8 (n, vdupq_n_u8 (9)), vdupq_n_u8 ('a' - '0' - 10));
+    return vaddq_u8 (vaddq_u8 (n, vdupq_n_u8 ('0')), adj);
+}
+
+static inline void hex_encode16 (char *dst, const uint8_t *src)
+{
+    uint8x16_t x = vld1q_u8 (src);
+    uint8x16_t hi = hex_nibbles_to_ascii (vshrq_n_u8 (x, 4));
+    uint8x16_t lo = hex_nibbles_to_ascii (vandq_u8 (x, vdupq_n_u8 (0x0f)));
+
+    uint8x16x2_t z = vzipq_u8 (hi, lo);
+    vst1q_u8 ((uint8_t *) dst, z.val[0]);
+    vst1q_u8 ((uint8_t *) dst + 16, z.val[1]);
+}
+
+static inline void hex_printable16 (char *dst, const uint8_t *src)
+{
+    uint8x16_t x = vld1q_u8 (src);
+    uint8x16_t keep = vcltq_u8 (vsubq_u8 (x, vdupq_n_u8 (0x20)), vdupq_n_u8 (0x5f));
+    vst1q_u8 ((uint8_t *) dst, vbslq_u8 (keep, x, vdupq_n_u8 ('.')));
+}
+
+#else
+
+static inline void hex_encode16 (char *dst, const uint8_t *src)
+{
+    for (int i = 0; i < 16; i++) {
+        dst[i * 2] = hex_digits[src[i] >> 4];
+        dst[i * 2 + 1] = hex_digits[src[i] & 0xf];
+    }
+}
+
+static inline void hex_printable16 (char *dst, const uint8_t *src)
+{
+    for (int i = 0; i < 16; i++)
+        dst[i] = ((uint8_t) (src[i] - 0x20) < 0x5f) ? (char) src[i] : '.';
+}
+
+#endif
+
+
+size_t h_hex_encode (char *dst, const void *src, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) src;
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16)
+        hex_encode16 (dst + i * 2, p + i);
+
+    for (; i < len; i++) {
+        dst[i * 2] = hex_digits[p[i] >> 4];
+        dst[i * 2 + 1] = hex_digits[p[i] & 0xf];
+    }
+    return len * 2;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Hexdump                              									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Layout of a line, after an offset of `aw` digits:
+ *
+ *      2 spaces, 16 * "xx " with one more space after the eighth, another
+ *      space, '|', 16 characters, '|', '\n'.
+ *
+ *  That's 71 characters, so a full line with 8 offset digits is 79.
+ */
+#define HEX_LINE_BODY           71
+#define HEX_COL_HEX             2
+#define HEX_COL_BAR             52
+#define HEX_COL_ASCII           53
+
+static inline void hex_offset (char *dst, uint64_t addr, int aw)
+{
+    for (int i = aw - 1; i >= 0; i--, addr >>= 4)
+        dst[i] = hex_digits[addr & 0xf];
+}
+
+/**
+ *  Formats one line of `n` bytes, `n` at most 16, and returns its length.
+ *  Full lines are done with the 16 byte helpers; the short last line is
+ *  padded so its ASCII column lines up with the rest.
+ */
+static size_t hex_line (char *dst, const uint8_t *src, size_t n, uint64_t addr, int aw)
+{
+    char digits[32];
+    char *body = dst + aw;
+
+    hex_offset (dst, addr, aw);
+    memset (body, ' ', HEX_COL_BAR);
+
+    if (n == 16)
+        hex_encode16 (digits, src);
+    else
+        h_hex_encode (digits, src, n);
+
+    for (size_t i = 0; i < n; i++) {
+        char *q = body + HEX_COL_HEX + i * 3 + (i >= 8);
+        q[0] = digits[i * 2];
+        q[1] = digits[i * 2 + 1];
+    }
+
+    body[HEX_COL_BAR] = '|';
+    if (n == 16) {
+        hex_printable16 (body + HEX_COL_ASCII, src);
+    } else {
+        for (size_t i = 0; i < n; i++)
+            body[HEX_COL_ASCII + i] = ((uint8_t) (src[i] - 0x20) < 0x5f) ? (char) src[i] : '.';
+    }
+    body[HEX_COL_ASCII + n] = '|';
+    body[HEX_COL_ASCII + n + 1] = '\n';
+
+    return aw + HEX_COL_ASCII + n + 2;
+}
+
+
+void h_hexdump (h_writer_t *w, const void *data, size_t len, uint64_t addr)
+{
+    const uint8_t *p = (const uint8_t *) data;
+
+    // Offsets past 4GB get all 16 digits
+    int aw = (addr + len > 0xffffffffull) ? 16 : 8;
+    size_t line = aw + HEX_LINE_BODY;
+
+    while (len) {
+        size_t lines = (len + 15) / 16;
+        if (lines > HEX_LINES_PER_BATCH)
+            lines = HEX_LINES_PER_BATCH;
+
+        char *out = h_writer_reserve (w, lines * line);
+        size_t used = 0;
+
+        for (size_t i = 0; i < lines; i++) {
+            size_t n = (len < 16) ? len : 16;
+            used += hex_line (out + used, p, n, addr, aw);
+            p += n;
+            addr += n;
+            len -= n;
+        }
+        h_writer_commit (w, used);
+    }
+}
+
+
+int h_hexdump_fd (int fd, const void *data, size_t len, uint64_t addr)
+{
+    h_writer_t w;
+    h_writer_init (&w, fd, 0);
+    h_hexdump (&w, data, len, addr);
+    return h_writer_finish (&w);
+}
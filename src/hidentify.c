@@ -0,0 +1,349 @@
+//===-------------------------- hidentify ----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include <string.h>
+
+#include "libhelper/hidentify.h"
+
+// Little-endian words built from the bytes of a magic, in file order
+#define H_WORD4(a, b, c, d)                                                  \
+    ((uint32_t) (a) | (uint32_t) (b) << 8 | (uint32_t) (c) << 16 | (uint32_t) (d) << 24)
+#define H_WORD8(a, b, c, d, e, f, g, h)                                      \
+    ((uint64_t) H_WORD4 (a, b, c, d) | (uint64_t) H_WORD4 (e, f, g, h) << 32)
+
+#define H_MAGIC_MACHO           H_WORD4 (0xce, 0xfa, 0xed, 0xfe)    // 0xfeedface, low bit is 64-bit
+#define H_MAGIC_MACHO_SWAPPED   H_WORD4 (0xfe, 0xed, 0xfa, 0xce)
+#define H_MAGIC_FAT             H_WORD4 (0xca, 0xfe, 0xba, 0xbe)    // 0xcafebabe, stored big-endian
+#define H_MAGIC_DYLD            H_WORD8 ('d', 'y', 'l', 'd', '_', 'v', '1', 0)
+#define H_MAGIC_COMPLZSS        H_WORD8 ('c', 'o', 'm', 'p', 'l', 'z', 's', 's')
+#define H_MAGIC_BVX             H_WORD4 ('b', 'v', 'x', 0)
+
+#define H_MASK_MACHO            (~(uint32_t) 0x01)
+#define H_MASK_MACHO_SWAPPED    (~(uint32_t) 0x01000000)
+#define H_MASK_DYLD             0x00ffffffffffffffULL
+#define H_MASK_BVX              0x00ffffffU
+
+// 0xcafebabe is also the Java class file magic, followed by a version
+// major version of at least 45, more than any real number of slices
+#define H_FAT_MAX_ARCHS         20
+
+// Strings unique to the SEP firmware, searched for when the file starts
+// with a branch like the SEP boot code does
+#define H_SEP_SIGNATURE         "Built by legion2"
+
+#define H_DER_SEQUENCE          0x30
+#define H_DER_IA5STRING         0x16
+#define H_DER_OCTET_STRING      0x04
+
+
+static uint32_t h_read32 (const uint8_t *p)
+{
+    uint32_t v;
+    memcpy (&v, p, sizeof (uint32_t));
+    return v;
+}
+
+static uint32_t h_read32_be (const uint8_t *p)
+{
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static uint32_t h_swap32 (uint32_t v)
+{
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+static int h_contains (const uint8_t *buf, size_t len, const char *needle)
+{
+    size_t n = strlen (needle);
+    for (size_t i = 0; i + n <= len; i++) {
+        const uint8_t *p = memchr (buf + i, needle[0], len - n + 1 - i);
+        if (!p)
+            return 0;
+        i = p - buf;
+        if (!memcmp (p, needle, n))
+            return 1;
+    }
+    return 0;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- IMG4                                 									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Reads a DER tag and length at `p`, returning a pointer to the contents
+ *  or NULL if the tag doesn't match. The contents may run past `end`,
+ *  since only the first page of the file is available.
+ */
+static const uint8_t *h_der_header (const uint8_t *p, const uint8_t *end, uint8_t tag, size_t *len)
+{
+    if (!p || end - p < 2 || p[0] != tag)
+        return NULL;
+
+    if (p[1] < 0x80) {
+        *len = p[1];
+        return p + 2;
+    }
+
+    size_t n = p[1] & 0x7f;
+    if (!n || n > 4 || (size_t) (end - p) < 2 + n)
+        return NULL;
+
+    *len = 0;
+    for (size_t i = 0; i < n; i++)
+        *len = (*len << 8) | p[2 + i];
+    return p + 2 + n;
+}
+
+/**
+ *  Reads a four character IA5String, like "IM4P" or "krnl".
+ */
+static const uint8_t *h_der_fourcc (const uint8_t *p, const uint8_t *end)
+{
+    size_t len;
+    const uint8_t *s = h_der_header (p, end, H_DER_IA5STRING, &len);
+    return (s && len == 4 && end - s >= 4) ? s : NULL;
+}
+
+static lh_format_t h_identify_bytes (const uint8_t *b, size_t len, lh_identity_t *id, int depth);
+
+/**
+ *  IM4P ::= SEQUENCE { "IM4P", type, description, OCTET STRING payload, ... }
+ *
+ *  `p` points just past the "IM4P" string.
+ */
+static void h_identify_im4p (const uint8_t *buf, const uint8_t *p, const uint8_t *end, lh_identity_t *id, int depth)
+{
+    const uint8_t *type = h_der_fourcc (p, end);
+    if (!type)
+        return;
+    memcpy (id->tag, type, 4);
+    id->tag[4] = '\0';
+
+    size_t len;
+    const uint8_t *desc = h_der_header (type + 4, end, H_DER_IA5STRING, &len);
+    if (!desc || len > (size_t) (end - desc))
+        return;
+
+    const uint8_t *payload = h_der_header (desc + len, end, H_DER_OCTET_STRING, &len);
+    if (!payload)
+        return;
+
+    lh_identity_t sub;
+    memset (&sub, '\0', sizeof (lh_identity_t));
+    id->payload_offset = payload - buf;
+    id->payload = h_identify_bytes (payload, end - payload, &sub, depth + 1);
+    id->compressed_size = sub.compressed_size;
+    id->uncompressed_size = sub.uncompressed_size;
+    memcpy (id->lzfse_block, sub.lzfse_block, sizeof (id->lzfse_block));
+}
+
+static lh_format_t h_identify_der (const uint8_t *b, size_t len, lh_identity_t *id, int depth)
+{
+    const uint8_t *end = b + len;
+    size_t seqlen;
+
+    const uint8_t *seq = h_der_header (b, end, H_DER_SEQUENCE, &seqlen);
+    const uint8_t *name = h_der_fourcc (seq, end);
+    if (!name)
+        return LH_FORMAT_UNKNOWN;
+
+    if (!memcmp (name, "IM4P", 4)) {
+        h_identify_im4p (b, name + 4, end, id, depth);
+        return LH_FORMAT_IM4P;
+    }
+    if (!memcmp (name, "IM4M", 4))
+        return LH_FORMAT_IM4M;
+    if (memcmp (name, "IMG4", 4))
+        return LH_FORMAT_UNKNOWN;
+
+    // IMG4 ::= SEQUENCE { "IMG4", IM4P, [0] IM4M, [1] IM4R }
+    const uint8_t *im4p = h_der_header (name + 4, end, H_DER_SEQUENCE, &seqlen);
+    const uint8_t *im4p_name = h_der_fourcc (im4p, end);
+    if (im4p_name && !memcmp (im4p_name, "IM4P", 4))
+        h_identify_im4p (b, im4p_name + 4, end, id, depth);
+
+    return LH_FORMAT_IMG4;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Identification                       									 --*/
+//===-----------------------------------------------------------------------===//
+
+static lh_format_t h_identify_bytes (const uint8_t *b, size_t len, lh_identity_t *id, int depth)
+{
+    if (len < 8 || depth > 1)
+        return LH_FORMAT_UNKNOWN;
+
+    uint64_t w8;
+    memcpy (&w8, b, sizeof (uint64_t));
+    uint32_t w4 = (uint32_t) w8;
+
+    switch (b[0]) {
+        case 0xce:
+        case 0xcf:
+        case 0xfe: {
+            int swapped = (b[0] == 0xfe);
+            if (swapped ? (w4 & H_MASK_MACHO_SWAPPED) != H_MAGIC_MACHO_SWAPPED
+                        : (w4 & H_MASK_MACHO) != H_MAGIC_MACHO)
+                break;
+            if (len < 28)
+                break;
+
+            id->is64 = swapped ? (b[3] & 1) : (b[0] & 1);
+            id->swapped = swapped;
+            id->cputype = h_read32 (b + 4);
+            id->cpusubtype = h_read32 (b + 8);
+            id->filetype = h_read32 (b + 12);
+            id->ncmds = h_read32 (b + 16);
+            if (swapped) {
+                id->cputype = h_swap32 (id->cputype);
+                id->cpusubtype = h_swap32 (id->cpusubtype);
+                id->filetype = h_swap32 (id->filetype);
+                id->ncmds = h_swap32 (id->ncmds);
+            }
+            return LH_FORMAT_MACHO;
+        }
+
+        case 0xca: {
+            // 0xcafebabf is the variant with 64-bit offsets
+            if ((w4 & H_MASK_MACHO_SWAPPED) != H_MAGIC_FAT)
+                break;
+
+            uint32_t narchs = h_read32_be (b + 4);
+            if (!narchs || narchs > H_FAT_MAX_ARCHS)
+                break;
+
+            id->is64 = (b[3] & 1);
+            id->narchs = narchs;
+            if (len >= 16) {
+                id->cputype = h_read32_be (b + 8);
+                id->cpusubtype = h_read32_be (b + 12);
+            }
+            return LH_FORMAT_FAT;
+        }
+
+        case 'd': {
+            if ((w8 & H_MASK_DYLD) != H_MAGIC_DYLD || len < 16)
+                break;
+
+            // "dyld_v1" followed by the space-padded arch name
+            size_t i = 7;
+            while (i < 16 && b[i] == ' ')
+                i++;
+            memcpy (id->arch, b + i, 16 - i);
+            id->arch[16 - i] = '\0';
+            id->is64 = 1;
+            return LH_FORMAT_DYLD_CACHE;
+        }
+
+        case H_DER_SEQUENCE:
+            return h_identify_der (b, len, id, depth);
+
+        case 'c': {
+            if (w8 != H_MAGIC_COMPLZSS || len < 20)
+                break;
+
+            // "complzss", adler32, uncompressed size, compressed size
+            id->uncompressed_size = h_read32_be (b + 12);
+            id->compressed_size = h_read32_be (b + 16);
+            return LH_FORMAT_COMPLZSS;
+        }
+
+        case 'b': {
+            if ((w4 & H_MASK_BVX) != H_MAGIC_BVX || !memchr ("12n-", b[3], 4))
+                break;
+
+            memcpy (id->lzfse_block, b, 4);
+            id->lzfse_block[4] = '\0';
+            id->uncompressed_size = h_read32 (b + 4);
+            if (b[3] == 'n' && len >= 12)
+                id->compressed_size = h_read32 (b + 8);
+            return LH_FORMAT_LZFSE;
+        }
+
+        default:
+            // SEP firmware starts with the boot code, an unconditional branch
+            if ((w4 >> 26) == 0x05 && h_contains (b, len, H_SEP_SIGNATURE))
+                return LH_FORMAT_SEP;
+            break;
+    }
+
+    return LH_FORMAT_UNKNOWN;
+}
+
+
+/**
+ *  Function:   lh_identify
+ *  -----------------------
+ *
+ *  Identifies the format of a file from its first bytes.
+ *
+ *  buf:        The start of the file, ideally a page or more.
+ *  len:        Number of bytes in `buf`.
+ *  id:         Filled in with header facts, may be NULL.
+ *
+ *  returns:    The format, or LH_FORMAT_UNKNOWN.
+ *
+ */
+lh_format_t lh_identify (const void *buf, size_t len, lh_identity_t *id)
+{
+    lh_identity_t tmp;
+    if (!id)
+        id = &tmp;
+
+    memset (id, '\0', sizeof (lh_identity_t));
+    id->format = h_identify_bytes ((const uint8_t *) buf, len, id, 0);
+    return id->format;
+}
+
+
+const char *lh_format_string (lh_format_t format)
+{
+    switch (format) {
+        case LH_FORMAT_MACHO:
+            return "Mach-O";
+        case LH_FORMAT_FAT:
+            return "Universal Binary";
+        case LH_FORMAT_DYLD_CACHE:
+            return "dyld shared cache";
+        case LH_FORMAT_IMG4:
+            return "IMG4";
+        case LH_FORMAT_IM4P:
+            return "IM4P";
+        case LH_FORMAT_IM4M:
+            return "IM4M";
+        case LH_FORMAT_COMPLZSS:
+            return "complzss";
+        case LH_FORMAT_LZFSE:
+            return "LZFSE";
+        case LH_FORMAT_SEP:
+            return "SEP firmware";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,1165 @@
+//===--------------------------- hparallel ---------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#   include <limits.h>
+#   include <sys/syscall.h>
+#endif
+
+#include "libhelper/hparallel.h"
+
+// Tasks a worker's deque starts with room for, it grows as needed
+#define H_DEQUE_INITIAL         256
+#define H_SCRATCH_CHUNK         (64 * 1024)
+#define H_IDLE_SPINS            64
+#define H_NUMA_MAX_NODES        64
+
+
+//===-----------------------------------------------------------------------===//
+/*-- CPU count                            									 --*/
+//===-----------------------------------------------------------------------===//
+
+#if defined(__linux__)
+/**
+ *  CPUs allowed by the cgroup v2 cpu.max in `dir`, a path under
+ *  /sys/fs/cgroup, rounded up to whole CPUs. 0 if it's "max", or -1 if
+ *  there isn't a cpu.max there.
+ */
+static int h_parallel_cpu_max (const char *dir)
+{
+    long long quota = -1, period = 0;
+    char path[PATH_MAX + 32], buf[64];
+
+    snprintf (path, sizeof (path), "/sys/fs/cgroup%s/cpu.max", dir);
+    FILE *f = fopen (path, "r");
+    if (!f)
+        return -1;
+    if (fscanf (f, "%63s %lld", buf, &period) == 2 && strcmp (buf, "max"))
+        quota = atoll (buf);
+    fclose (f);
+
+    if (quota <= 0 || period <= 0)
+        return 0;
+    return (int) ((quota + period - 1) / period);
+}
+
+/**
+ *  The process' own cgroup v2 path, from the "0::" line of
+ *  /proc/self/cgroup, without a trailing '/'. Empty for the root, if the
+ *  process isn't in a v2 hierarchy, or if the path doesn't fit in `dir`,
+ *  since a truncated path would name some other cgroup.
+ */
+static void h_parallel_cgroup_path (char *dir, size_t size)
+{
+    char line[PATH_MAX + 8];
+    dir[0] = '\0';
+
+    FILE *f = fopen ("/proc/self/cgroup", "r");
+    if (!f)
+        return;
+    while (fgets (line, sizeof (line), f)) {
+        if (strncmp (line, "0::", 3))
+            continue;
+
+        // fgets() stops short of the newline if the line is too long
+        size_t len = strcspn (line + 3, "\n");
+        if (line[3 + len] == '\n' && len < size) {
+            memcpy (dir, line + 3, len);
+            dir[len] = '\0';
+        }
+        break;
+    }
+    fclose (f);
+
+    size_t len = strlen (dir);
+    while (len && dir[len - 1] == '/')
+        dir[--len] = '\0';
+}
+
+/**
+ *  The CPU quota of the process' cgroup, rounded up to whole CPUs, or 0
+ *  if there isn't one. Checks cgroup v2 and then v1.
+ *
+ *  On v2 the process is usually in a child of /sys/fs/cgroup, and a limit
+ *  on any cgroup above it applies too, so the tightest cpu.max from its
+ *  own cgroup up to the root wins.
+ */
+static int h_parallel_cgroup_cpus (void)
+{
+    long long quota = -1, period = 0;
+    char dir[PATH_MAX];
+    int found = 0, cpus = 0;
+
+    h_parallel_cgroup_path (dir, sizeof (dir));
+    for (;;) {
+        int n = h_parallel_cpu_max (dir);
+        if (n >= 0)
+            found = 1;
+        if (n > 0 && (!cpus || n < cpus))
+            cpus = n;
+
+        char *slash = strrchr (dir, '/');
+        if (!slash)
+            break;
+        *slash = '\0';
+    }
+    if (found)
+        return cpus;
+
+    FILE *f = fopen ("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+    if (f) {
+        if (fscanf (f, "%lld", &quota) != 1)
+            quota = -1;
+        fclose (f);
+    }
+    f = fopen ("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+    if (f) {
+        if (fscanf (f, "%lld", &period) != 1)
+            period = 0;
+        fclose (f);
+    }
+
+    if (quota <= 0 || period <= 0)
+        return 0;
+    return (int) ((quota + period - 1) / period);
+}
+#endif
+
+
+int h_parallel_ncpus (void)
+{
+    static atomic_int cached;
+    int n = atomic_load (&cached);
+    if (n)
+        return n;
+
+    long online = sysconf (_SC_NPROCESSORS_ONLN);
+    n = (online > 0) ? (int) online : 1;
+
+#if defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity (0, sizeof (cpu_set_t), &set) == 0 && CPU_COUNT (&set) > 0)
+        n = CPU_COUNT (&set);
+
+    int quota = h_parallel_cgroup_cpus ();
+    if (quota > 0 && quota < n)
+        n = quota;
+#endif
+
+    atomic_store (&cached, n);
+    return n;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- NUMA topology                        									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  The NUMA nodes that have CPUs this process may run on, from sysfs.
+ *  Without NUMA (or off Linux) there's a single node, id -1, covering
+ *  every CPU.
+ */
+typedef struct h_numa_t {
+    int              nnodes;
+    int              ids[H_NUMA_MAX_NODES];
+    int              ncpus[H_NUMA_MAX_NODES];
+#if defined(__linux__)
+    cpu_set_t        cpus[H_NUMA_MAX_NODES];
+#endif
+    HPool           *pools[H_NUMA_MAX_NODES];
+} h_numa_t;
+
+static h_numa_t h_numa;
+static pthread_once_t h_numa_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t h_numa_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#if defined(__linux__)
+/**
+ *  Parses a sysfs CPU list, e.g. "0-15,32-47".
+ */
+static void h_numa_parse_cpulist (const char *list, cpu_set_t *set)
+{
+    CPU_ZERO (set);
+    while (*list) {
+        char *end;
+        long lo = strtol (list, &end, 10), hi = lo;
+        if (end == list)
+            break;
+        if (*end == '-')
+            hi = strtol (end + 1, &end, 10);
+        for (long c = lo; c <= hi && c < CPU_SETSIZE; c++)
+            CPU_SET (c, set);
+        if (*end != ',')
+            break;
+        list = end + 1;
+    }
+}
+#endif
+
+static void h_numa_init (void)
+{
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if (sched_getaffinity (0, sizeof (cpu_set_t), &allowed))
+        CPU_ZERO (&allowed);
+
+    // Node ids can have gaps, so look a little past the last one found
+    for (int id = 0, missing = 0; h_numa.nnodes < H_NUMA_MAX_NODES && missing < 64; id++) {
+        char path[64], list[4096];
+        snprintf (path, sizeof (path), "/sys/devices/system/node/node%d/cpulist", id);
+
+        FILE *f = fopen (path, "r");
+        if (!f) {
+            missing++;
+            continue;
+        }
+        missing = 0;
+        if (!fgets (list, sizeof (list), f))
+            list[0] = '\0';
+        fclose (f);
+
+        cpu_set_t *set = &h_numa.cpus[h_numa.nnodes];
+        h_numa_parse_cpulist (list, set);
+        CPU_AND (set, set, &allowed);
+        if (!CPU_COUNT (set))
+            continue;
+
+        h_numa.ids[h_numa.nnodes] = id;
+        h_numa.ncpus[h_numa.nnodes] = CPU_COUNT (set);
+        h_numa.nnodes++;
+    }
+#endif
+
+    if (h_numa.nnodes <= 1) {
+        h_numa.nnodes = 1;
+        h_numa.ids[0] = -1;
+        h_numa.ncpus[0] = h_parallel_ncpus ();
+    }
+}
+
+
+int h_numa_nodes (void)
+{
+    pthread_once (&h_numa_once, h_numa_init);
+    return h_numa.nnodes;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Scratch arenas                       									 --*/
+//===-----------------------------------------------------------------------===//
+
+typedef struct h_scratch_chunk_t {
+    struct h_scratch_chunk_t    *next;
+    size_t                       size;
+    size_t                       used;
+    _Alignas (16) uint8_t        data[];
+} h_scratch_chunk_t;
+
+typedef struct h_scratch_t {
+    h_scratch_chunk_t   *head;
+    h_scratch_chunk_t   *cur;       /* NULL until the first allocation */
+} h_scratch_t;
+
+typedef struct h_scratch_mark_t {
+    h_scratch_chunk_t   *chunk;
+    size_t               used;
+} h_scratch_mark_t;
+
+static pthread_key_t h_scratch_key;
+static pthread_once_t h_scratch_once = PTHREAD_ONCE_INIT;
+
+static void h_scratch_destroy (void *arg)
+{
+    h_scratch_t *scratch = (h_scratch_t *) arg;
+    for (h_scratch_chunk_t *c = scratch->head, *next; c; c = next) {
+        next = c->next;
+        free (c);
+    }
+    free (scratch);
+}
+
+static void h_scratch_key_init (void)
+{
+    pthread_key_create (&h_scratch_key, h_scratch_destroy);
+}
+
+static h_scratch_t *h_scratch_get (int create)
+{
+    pthread_once (&h_scratch_once, h_scratch_key_init);
+
+    h_scratch_t *scratch = pthread_getspecific (h_scratch_key);
+    if (!scratch && create) {
+        scratch = calloc (1, sizeof (h_scratch_t));
+        pthread_setspecific (h_scratch_key, scratch);
+    }
+    return scratch;
+}
+
+static h_scratch_mark_t h_scratch_mark (void)
+{
+    h_scratch_mark_t mark = { NULL, 0 };
+    h_scratch_t *scratch = h_scratch_get (0);
+    if (scratch && scratch->cur) {
+        mark.chunk = scratch->cur;
+        mark.used = scratch->cur->used;
+    }
+    return mark;
+}
+
+static void h_scratch_release (h_scratch_mark_t mark)
+{
+    h_scratch_t *scratch = h_scratch_get (0);
+    if (!scratch)
+        return;
+
+    scratch->cur = mark.chunk;
+    if (mark.chunk)
+        mark.chunk->used = mark.used;
+}
+
+
+void *h_scratch_alloc (size_t size)
+{
+    h_scratch_t *scratch = h_scratch_get (1);
+    size = (size + 15) & ~(size_t) 15;
+
+    h_scratch_chunk_t *c = scratch->cur;
+    if (!c && scratch->head) {
+        c = scratch->cur = scratch->head;
+        c->used = 0;
+    }
+
+    // Chunks past the current one are free, reuse the next if it fits
+    while (c && c->used + size > c->size) {
+        if (!c->next || c->next->size < size)
+            break;
+        c = scratch->cur = c->next;
+        c->used = 0;
+    }
+
+    if (!c || c->used + size > c->size) {
+        size_t csize = (size > H_SCRATCH_CHUNK) ? size : H_SCRATCH_CHUNK;
+        h_scratch_chunk_t *n = malloc (sizeof (h_scratch_chunk_t) + csize);
+        n->size = csize;
+        n->used = 0;
+        if (c) {
+            n->next = c->next;
+            c->next = n;
+        } else {
+            n->next = scratch->head;
+            scratch->head = n;
+        }
+        c = scratch->cur = n;
+    }
+
+    void *p = c->data + c->used;
+    c->used += size;
+    return p;
+}
+
+
+void h_scratch_reset (void)
+{
+    h_scratch_mark_t none = { NULL, 0 };
+    h_scratch_release (none);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Work-stealing deque                  									 --*/
+//===-----------------------------------------------------------------------===//
+
+typedef struct h_task_t {
+    HTaskFunc            func;
+    void                *arg;
+    HTaskGroup          *group;     /* NULL for a detached task */
+    struct h_task_t     *next;      /* in the shared queue */
+} h_task_t;
+
+typedef struct h_deque_array_t {
+    int64_t                      size;      /* power of two */
+    struct h_deque_array_t      *retired;   /* previous, smaller array */
+    _Atomic (h_task_t *)         tasks[];
+} h_deque_array_t;
+
+/**
+ *  A Chase-Lev deque. Only the owning worker pushes and takes at the
+ *  bottom, any thread may steal from the top. Arrays replaced by a
+ *  bigger one are kept until the deque is freed, as a thief may still
+ *  be reading them.
+ */
+typedef struct h_deque_t {
+    atomic_llong                     top;
+    atomic_llong                     bottom;
+    _Atomic (h_deque_array_t *)      array;
+} h_deque_t;
+
+static h_deque_array_t *h_deque_array_new (int64_t size)
+{
+    h_deque_array_t *a = malloc (sizeof (h_deque_array_t) + sizeof (h_task_t *) * size);
+    a->size = size;
+    a->retired = NULL;
+    return a;
+}
+
+static void h_deque_init (h_deque_t *dq)
+{
+    atomic_init (&dq->top, 0);
+    atomic_init (&dq->bottom, 0);
+    atomic_init (&dq->array, h_deque_array_new (H_DEQUE_INITIAL));
+}
+
+static void h_deque_free (h_deque_t *dq)
+{
+    h_deque_array_t *a = atomic_load (&dq->array);
+    while (a) {
+        h_deque_array_t *prev = a->retired;
+        free (a);
+        a = prev;
+    }
+}
+
+static void h_deque_push (h_deque_t *dq, h_task_t *task)
+{
+    int64_t b = atomic_load_explicit (&dq->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit (&dq->top, memory_order_acquire);
+    h_deque_array_t *a = atomic_load_explicit (&dq->array, memory_order_relaxed);
+
+    if (b - t > a->size - 1) {
+        h_deque_array_t *grown = h_deque_array_new (a->size * 2);
+        for (int64_t i = t; i < b; i++)
+            atomic_store_explicit (&grown->tasks[i & (grown->size - 1)],
+                atomic_load_explicit (&a->tasks[i & (a->size - 1)], memory_order_relaxed), memory_order_relaxed);
+        grown->retired = a;
+        atomic_store_explicit (&dq->array, grown, memory_order_release);
+        a = grown;
+    }
+
+    atomic_store_explicit (&a->tasks[b & (a->size - 1)], task, memory_order_relaxed);
+    atomic_store_explicit (&dq->bottom, b + 1, memory_order_release);
+}
+
+static h_task_t *h_deque_take (h_deque_t *dq)
+{
+    int64_t b = atomic_load_explicit (&dq->bottom, memory_order_relaxed) - 1;
+    h_deque_array_t *a = atomic_load_explicit (&dq->array, memory_order_relaxed);
+    atomic_store_explicit (&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence (memory_order_seq_cst);
+    int64_t t = atomic_load_explicit (&dq->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit (&dq->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    h_task_t *task = atomic_load_explicit (&a->tasks[b & (a->size - 1)], memory_order_relaxed);
+    if (t == b) {
+        // The last task, race any thief for it
+        if (!atomic_compare_exchange_strong_explicit (&dq->top, &t, t + 1,
+                memory_order_seq_cst, memory_order_relaxed))
+            task = NULL;
+        atomic_store_explicit (&dq->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+static h_task_t *h_deque_steal (h_deque_t *dq)
+{
+    int64_t t = atomic_load_explicit (&dq->top, memory_order_acquire);
+    atomic_thread_fence (memory_order_seq_cst);
+    int64_t b = atomic_load_explicit (&dq->bottom, memory_order_acquire);
+
+    if (t >= b)
+        return NULL;
+
+    h_deque_array_t *a = atomic_load_explicit (&dq->array, memory_order_acquire);
+    h_task_t *task = atomic_load_explicit (&a->tasks[t & (a->size - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit (&dq->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed))
+        return NULL;
+    return task;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Pool                                 									 --*/
+//===-----------------------------------------------------------------------===//
+
+typedef struct h_worker_t {
+    HPool           *pool;
+    h_deque_t        deque;
+    pthread_t        thread;
+    int              started;
+    unsigned         seed;      /* for picking victims */
+} h_worker_t;
+
+struct __hpool
+{
+    h_worker_t          *workers;
+    int                  nthreads;
+    int                  node;      /* index of the NUMA node it's pinned to, or -1 */
+
+    /* tasks spawned from outside the pool */
+    pthread_mutex_t      queue_lock;
+    h_task_t            *queue_head;
+    h_task_t            *queue_tail;
+    atomic_size_t        queue_len;
+
+    /* idle workers sleep until `epoch` changes */
+    pthread_mutex_t      idle_lock;
+    pthread_cond_t       idle_cond;
+    atomic_uint          epoch;
+    atomic_int           sleepers;
+    atomic_int           stop;
+};
+
+struct __htask_group
+{
+    HPool               *pool;
+    atomic_size_t        pending;
+    atomic_int           done;
+    pthread_mutex_t      lock;
+    pthread_cond_t       cond;
+};
+
+// The worker the calling thread is, if it's one
+static _Thread_local h_worker_t *h_current_worker;
+
+static h_worker_t *h_pool_self (HPool *pool)
+{
+    return (h_current_worker && h_current_worker->pool == pool) ? h_current_worker : NULL;
+}
+
+static void h_pool_notify (HPool *pool)
+{
+    atomic_fetch_add (&pool->epoch, 1);
+    if (atomic_load (&pool->sleepers)) {
+        pthread_mutex_lock (&pool->idle_lock);
+        pthread_cond_signal (&pool->idle_cond);
+        pthread_mutex_unlock (&pool->idle_lock);
+    }
+}
+
+static h_task_t *h_pool_dequeue (HPool *pool)
+{
+    if (!atomic_load_explicit (&pool->queue_len, memory_order_relaxed))
+        return NULL;
+
+    pthread_mutex_lock (&pool->queue_lock);
+    h_task_t *task = pool->queue_head;
+    if (task) {
+        pool->queue_head = task->next;
+        if (!pool->queue_head)
+            pool->queue_tail = NULL;
+        atomic_fetch_sub (&pool->queue_len, 1);
+    }
+    pthread_mutex_unlock (&pool->queue_lock);
+    return task;
+}
+
+/**
+ *  Finds a task for `self`, which is NULL for a thread outside the pool:
+ *  its own deque first, then the shared queue, then the other workers.
+ */
+static h_task_t *h_pool_find (HPool *pool, h_worker_t *self)
+{
+    h_task_t *task;
+
+    if (self && (task = h_deque_take (&self->deque)))
+        return task;
+    if ((task = h_pool_dequeue (pool)))
+        return task;
+
+    unsigned start = (self) ? (unsigned) rand_r (&self->seed) : (unsigned) (uintptr_t) &task >> 4;
+    for (int i = 0; i < pool->nthreads; i++) {
+        h_worker_t *victim = &pool->workers[(start + i) % pool->nthreads];
+        if (victim != self && (task = h_deque_steal (&victim->deque)))
+            return task;
+    }
+    return NULL;
+}
+
+static void h_task_group_finish (HTaskGroup *group)
+{
+    if (atomic_fetch_sub (&group->pending, 1) != 1)
+        return;
+
+    pthread_mutex_lock (&group->lock);
+    if (!atomic_load (&group->pending)) {
+        atomic_store (&group->done, 1);
+        pthread_cond_broadcast (&group->cond);
+    }
+    pthread_mutex_unlock (&group->lock);
+}
+
+static void h_pool_run (h_task_t *task)
+{
+    HTaskGroup *group = task->group;
+    h_scratch_mark_t mark = h_scratch_mark ();
+
+    task->func (task->arg);
+
+    h_scratch_release (mark);
+    free (task);
+    if (group)
+        h_task_group_finish (group);
+}
+
+static void *h_pool_worker (void *arg)
+{
+    h_worker_t *self = (h_worker_t *) arg;
+    HPool *pool = self->pool;
+    h_current_worker = self;
+
+#if defined(__linux__)
+    if (pool->node >= 0)
+        pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &h_numa.cpus[pool->node]);
+#endif
+
+    while (!atomic_load (&pool->stop)) {
+        unsigned epoch = atomic_load (&pool->epoch);
+        h_task_t *task = NULL;
+
+        for (int spin = 0; spin < H_IDLE_SPINS && !task; spin++) {
+            task = h_pool_find (pool, self);
+            if (!task && spin)
+                sched_yield ();
+        }
+        if (task) {
+            h_pool_run (task);
+            continue;
+        }
+
+        pthread_mutex_lock (&pool->idle_lock);
+        atomic_fetch_add (&pool->sleepers, 1);
+        while (atomic_load (&pool->epoch) == epoch && !atomic_load (&pool->stop))
+            pthread_cond_wait (&pool->idle_cond, &pool->idle_lock);
+        atomic_fetch_sub (&pool->sleepers, 1);
+        pthread_mutex_unlock (&pool->idle_lock);
+    }
+
+    return NULL;
+}
+
+
+static HPool *h_pool_create (int nthreads, int node)
+{
+    HPool *pool = calloc (1, sizeof (HPool));
+    pool->node = node;
+    pool->workers = calloc (nthreads, sizeof (h_worker_t));
+    pthread_mutex_init (&pool->queue_lock, NULL);
+    pthread_mutex_init (&pool->idle_lock, NULL);
+    pthread_cond_init (&pool->idle_cond, NULL);
+    atomic_init (&pool->queue_len, 0);
+    atomic_init (&pool->epoch, 0);
+    atomic_init (&pool->sleepers, 0);
+    atomic_init (&pool->stop, 0);
+
+    for (int i = 0; i < nthreads; i++) {
+        h_worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->seed = (unsigned) i * 2654435761u + 1;
+        h_deque_init (&w->deque);
+    }
+
+    // Workers steal from every deque, so all must exist before any start.
+    // The deque of a worker that fails to start just stays empty.
+    pool->nthreads = nthreads;
+    for (int i = 0; i < nthreads; i++)
+        pool->workers[i].started = !pthread_create (&pool->workers[i].thread, NULL, h_pool_worker, &pool->workers[i]);
+    return pool;
+}
+
+
+/**
+ *  Function:   h_pool_new
+ *  ----------------------
+ *
+ *  Starts a pool of worker threads.
+ *
+ *  nthreads:   The number of workers, or 0 for one per available CPU.
+ *
+ *  returns:    The pool, free with h_pool_destroy().
+ *
+ */
+HPool *h_pool_new (int nthreads)
+{
+    if (nthreads <= 0)
+        nthreads = h_parallel_ncpus ();
+    return h_pool_create (nthreads, -1);
+}
+
+
+void h_pool_destroy (HPool *pool)
+{
+    if (!pool) return;
+
+    pthread_mutex_lock (&pool->idle_lock);
+    atomic_store (&pool->stop, 1);
+    pthread_cond_broadcast (&pool->idle_cond);
+    pthread_mutex_unlock (&pool->idle_lock);
+
+    for (int i = 0; i < pool->nthreads; i++) {
+        if (pool->workers[i].started)
+            pthread_join (pool->workers[i].thread, NULL);
+        h_deque_free (&pool->workers[i].deque);
+    }
+
+    pthread_mutex_destroy (&pool->queue_lock);
+    pthread_mutex_destroy (&pool->idle_lock);
+    pthread_cond_destroy (&pool->idle_cond);
+    free (pool->workers);
+    free (pool);
+}
+
+
+static HPool *h_default_pool;
+static pthread_once_t h_default_pool_once = PTHREAD_ONCE_INIT;
+
+static void h_default_pool_init (void)
+{
+    h_default_pool = h_pool_new (0);
+}
+
+HPool *h_pool_default (void)
+{
+    pthread_once (&h_default_pool_once, h_default_pool_init);
+    return h_default_pool;
+}
+
+
+static HPool *h_io_pool;
+static pthread_once_t h_io_pool_once = PTHREAD_ONCE_INIT;
+
+static void h_io_pool_init (void)
+{
+    // Its workers spend most of their time blocked on reads
+    int n = h_parallel_ncpus () * 2;
+    h_io_pool = h_pool_new ((n < 4) ? 4 : n);
+}
+
+HPool *h_pool_io (void)
+{
+    pthread_once (&h_io_pool_once, h_io_pool_init);
+    return h_io_pool;
+}
+
+
+int h_pool_nthreads (HPool *pool)
+{
+    return pool->nthreads;
+}
+
+
+/**
+ *  Function:   h_pool_node
+ *  -----------------------
+ *
+ *  The process-wide pool for a NUMA node, created on first use. Its
+ *  workers are pinned to the node's CPUs. The available CPUs are split
+ *  between the node pools by how many each node has.
+ *
+ *  node:       The node index, from 0 to h_numa_nodes() - 1.
+ *
+ *  returns:    The pool. Without NUMA that's the default pool.
+ *
+ */
+HPool *h_pool_node (int node)
+{
+    if (h_numa_nodes () == 1 || node < 0 || node >= h_numa.nnodes)
+        return h_pool_default ();
+
+    pthread_mutex_lock (&h_numa_pool_lock);
+    if (!h_numa.pools[node]) {
+        int total = 0;
+        for (int i = 0; i < h_numa.nnodes; i++)
+            total += h_numa.ncpus[i];
+
+        int nthreads = (int) ((long long) h_parallel_ncpus () * h_numa.ncpus[node] / total);
+        if (nthreads < 1)
+            nthreads = 1;
+        if (nthreads > h_numa.ncpus[node])
+            nthreads = h_numa.ncpus[node];
+        h_numa.pools[node] = h_pool_create (nthreads, node);
+    }
+    pthread_mutex_unlock (&h_numa_pool_lock);
+    return h_numa.pools[node];
+}
+
+
+int h_numa_current_node (void)
+{
+    return (h_current_worker) ? h_current_worker->pool->node : -1;
+}
+
+
+static void h_pool_submit (HPool *pool, HTaskFunc func, void *arg, HTaskGroup *group)
+{
+    h_task_t *task = malloc (sizeof (h_task_t));
+    task->func = func;
+    task->arg = arg;
+    task->group = group;
+    task->next = NULL;
+
+    h_worker_t *self = h_pool_self (pool);
+    if (self) {
+        h_deque_push (&self->deque, task);
+    } else {
+        pthread_mutex_lock (&pool->queue_lock);
+        if (pool->queue_tail)
+            pool->queue_tail->next = task;
+        else
+            pool->queue_head = task;
+        pool->queue_tail = task;
+        atomic_fetch_add (&pool->queue_len, 1);
+        pthread_mutex_unlock (&pool->queue_lock);
+    }
+
+    h_pool_notify (pool);
+}
+
+
+/**
+ *  Function:   h_pool_spawn
+ *  ------------------------
+ *
+ *  Runs `func (arg)` on the pool without a task group. Nothing can wait
+ *  for it, so it must signal its own completion.
+ *
+ */
+void h_pool_spawn (HPool *pool, HTaskFunc func, void *arg)
+{
+    h_pool_submit (pool, func, arg, NULL);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Task groups                          									 --*/
+//===-----------------------------------------------------------------------===//
+
+HTaskGroup *h_task_group_new (HPool *pool)
+{
+    HTaskGroup *group = calloc (1, sizeof (HTaskGroup));
+    group->pool = pool;
+    atomic_init (&group->pending, 0);
+    atomic_init (&group->done, 1);
+    pthread_mutex_init (&group->lock, NULL);
+    pthread_cond_init (&group->cond, NULL);
+    return group;
+}
+
+
+void h_task_group_spawn (HTaskGroup *group, HTaskFunc func, void *arg)
+{
+    HPool *pool = group->pool;
+
+    if (atomic_fetch_add (&group->pending, 1) == 0) {
+        pthread_mutex_lock (&group->lock);
+        atomic_store (&group->done, 0);
+        pthread_mutex_unlock (&group->lock);
+    }
+
+    h_pool_submit (pool, func, arg, group);
+}
+
+
+/**
+ *  A worker never blocks here, as every worker blocking on a group whose
+ *  tasks sit in their deques would deadlock. A thread outside the pool
+ *  runs tasks if `help` is set, and blocks once there's nothing left for
+ *  it to run.
+ */
+static void h_task_group_join (HTaskGroup *group, int help)
+{
+    HPool *pool = group->pool;
+    h_worker_t *self = h_pool_self (pool);
+
+    while (!atomic_load (&group->done)) {
+        h_task_t *task = (help || self) ? h_pool_find (pool, self) : NULL;
+        if (task) {
+            h_pool_run (task);
+            continue;
+        }
+
+        if (!self) {
+            pthread_mutex_lock (&group->lock);
+            while (!atomic_load (&group->done))
+                pthread_cond_wait (&group->cond, &group->lock);
+            pthread_mutex_unlock (&group->lock);
+            break;
+        }
+        sched_yield ();
+    }
+
+    // The last task sets `done` holding the lock, wait for it to let go
+    pthread_mutex_lock (&group->lock);
+    pthread_mutex_unlock (&group->lock);
+}
+
+
+/**
+ *  Function:   h_task_group_wait
+ *  -----------------------------
+ *
+ *  Waits for every task in the group. The caller runs other tasks while
+ *  it waits.
+ *
+ */
+void h_task_group_wait (HTaskGroup *group)
+{
+    h_task_group_join (group, 1);
+}
+
+
+void h_task_group_free (HTaskGroup *group)
+{
+    if (!group) return;
+
+    pthread_mutex_destroy (&group->lock);
+    pthread_cond_destroy (&group->cond);
+    free (group);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Parallel-for                         									 --*/
+//===-----------------------------------------------------------------------===//
+
+typedef struct h_parallel_job_t {
+    atomic_size_t            next;
+    size_t                   count;
+    size_t                   grain;
+    HParallelRangeFunc       func;
+    void                    *user_data;
+} h_parallel_job_t;
+
+static void h_parallel_chunks (void *arg)
+{
+    h_parallel_job_t *job = (h_parallel_job_t *) arg;
+    size_t start;
+
+    while ((start = atomic_fetch_add (&job->next, job->grain)) < job->count) {
+        size_t end = (job->count - start < job->grain) ? job->count : start + job->grain;
+
+        h_scratch_mark_t mark = h_scratch_mark ();
+        job->func (start, end, job->user_data);
+        h_scratch_release (mark);
+    }
+}
+
+static void h_parallel_run (HPool *pool, size_t count, size_t grain, int nhelpers, HParallelRangeFunc func, void *user_data)
+{
+    h_parallel_job_t job;
+    atomic_init (&job.next, 0);
+    job.count = count;
+    job.grain = (grain) ? grain : 1;
+    job.func = func;
+    job.user_data = user_data;
+
+    size_t nchunks = (count + job.grain - 1) / job.grain;
+    if (pool && nhelpers > pool->nthreads)
+        nhelpers = pool->nthreads;
+    if ((size_t) nhelpers >= nchunks)
+        nhelpers = (int) nchunks - 1;
+
+    // Nothing to gain from handing a single chunk to another thread
+    if (nhelpers <= 0) {
+        h_parallel_chunks (&job);
+        return;
+    }
+
+    HTaskGroup *group = h_task_group_new (pool);
+    for (int i = 0; i < nhelpers; i++)
+        h_task_group_spawn (group, h_parallel_chunks, &job);
+
+    // The calling thread works through chunks too
+    h_parallel_chunks (&job);
+    h_task_group_wait (group);
+    h_task_group_free (group);
+}
+
+
+void h_pool_parallel_for (HPool *pool, size_t count, size_t grain, HParallelRangeFunc func, void *user_data)
+{
+    if (!count || !func) return;
+    h_parallel_run (pool, count, grain, pool->nthreads, func, user_data);
+}
+
+
+typedef struct h_parallel_index_t {
+    HParallelFunc        func;
+    void                *user_data;
+} h_parallel_index_t;
+
+static void h_parallel_index (size_t start, size_t end, void *user_data)
+{
+    h_parallel_index_t *index = (h_parallel_index_t *) user_data;
+    for (size_t i = start; i < end; i++)
+        index->func (i, index->user_data);
+}
+
+
+void h_parallel_for (size_t count, int nthreads, HParallelFunc func, void *user_data)
+{
+    if (!count || !func) return;
+
+    h_parallel_index_t index = { func, user_data };
+
+    // A single thread doesn't need the pool started
+    HPool *pool = (nthreads == 1) ? NULL : h_pool_default ();
+    int nhelpers = (!pool) ? 0 : (nthreads > 0) ? nthreads - 1 : pool->nthreads;
+    h_parallel_run (pool, count, 1, nhelpers, h_parallel_index, &index);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- NUMA placement                       									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Function:   h_numa_parallel_for
+ *  -------------------------------
+ *
+ *  Like h_parallel_for(), but [0, count) is split into one contiguous
+ *  block per NUMA node, and each block runs only on that node's pool.
+ *  Index i should be a whole unit of work, like a file or an image, so
+ *  the memory it maps and first touches stays on one node. The caller
+ *  doesn't run any indices itself.
+ *
+ */
+void h_numa_parallel_for (size_t count, HParallelFunc func, void *user_data)
+{
+    if (!count || !func) return;
+
+    int nnodes = h_numa_nodes ();
+    if (nnodes == 1) {
+        h_parallel_for (count, 0, func, user_data);
+        return;
+    }
+
+    h_parallel_index_t index = { func, user_data };
+    h_parallel_job_t *jobs = calloc (nnodes, sizeof (h_parallel_job_t));
+    HTaskGroup **groups = calloc (nnodes, sizeof (HTaskGroup *));
+
+    for (int n = 0; n < nnodes; n++) {
+        size_t start = count * n / nnodes, end = count * (n + 1) / nnodes;
+        if (start == end)
+            continue;
+
+        h_parallel_job_t *job = &jobs[n];
+        atomic_init (&job->next, start);
+        job->count = end;
+        job->grain = 1;
+        job->func = h_parallel_index;
+        job->user_data = &index;
+
+        HPool *pool = h_pool_node (n);
+        size_t ntasks = ((size_t) pool->nthreads < end - start) ? (size_t) pool->nthreads : end - start;
+
+        groups[n] = h_task_group_new (pool);
+        for (size_t i = 0; i < ntasks; i++)
+            h_task_group_spawn (groups[n], h_parallel_chunks, job);
+    }
+
+    for (int n = 0; n < nnodes; n++) {
+        if (!groups[n])
+            continue;
+        h_task_group_join (groups[n], 0);
+        h_task_group_free (groups[n]);
+    }
+
+    free (groups);
+    free (jobs);
+}
+
+
+/**
+ *  Function:   h_numa_bind
+ *  -----------------------
+ *
+ *  Asks the kernel to place the pages of [addr, addr + len) on a node.
+ *  This applies to anonymous memory, e.g. a buffer a file is decompressed
+ *  into. Page cache pages of a mapped file are placed on the node of the
+ *  thread that first faults them, see h_numa_touch().
+ *
+ *  node:       The node index, or -1 for the node of the calling task.
+ *
+ *  returns:    0 on success, -1 if the memory couldn't be bound or there's
+ *              no NUMA.
+ *
+ */
+int h_numa_bind (void *addr, size_t len, int node)
+{
+    if (node < 0)
+        node = h_numa_current_node ();
+    if (h_numa_nodes () == 1 || node < 0 || node >= h_numa.nnodes || h_numa.ids[node] >= 64)
+        return -1;
+
+#if defined(__linux__) && defined(SYS_mbind)
+    const unsigned long mpol_preferred = 1;
+    unsigned long mask = 1ul << h_numa.ids[node];
+    uintptr_t page = (uintptr_t) sysconf (_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) addr & ~(page - 1);
+
+    // The kernel reads maxnode - 1 bits of the mask
+    return (int) syscall (SYS_mbind, start, (uintptr_t) addr + len - start, mpol_preferred, &mask, 65ul, 0ul);
+#else
+    (void) addr;
+    (void) len;
+    return -1;
+#endif
+}
+
+
+/**
+ *  Function:   h_numa_touch
+ *  ------------------------
+ *
+ *  Reads one byte of every page in [addr, addr + len), so the pages are
+ *  faulted in, and for a file not already cached read into memory local
+ *  to the calling thread.
+ *
+ */
+void h_numa_touch (const void *addr, size_t len)
+{
+    const volatile uint8_t *p = (const volatile uint8_t *) addr;
+    size_t page = (size_t) sysconf (_SC_PAGESIZE);
+
+    for (size_t off = 0; off < len; off += page)
+        (void) p[off];
+    if (len)
+        (void) p[len - 1];
+}
@@ -0,0 +1,400 @@
+//===---------------------------- hperf ------------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#   include <linux/perf_event.h>
+#   include <sys/syscall.h>
+#endif
+
+#include "libhelper/hperf.h"
+
+#define H_PERF_NCOUNTERS        4
+#define H_PERF_MAX_DEPTH        16
+
+
+/**
+ *  Counter values at one point in time. `enabled` and `running` are the
+ *  times the group was enabled and actually on the PMU, which differ
+ *  when the kernel multiplexes counters.
+ */
+typedef struct h_perf_sample_t {
+    uint64_t             nsec;
+    uint64_t             enabled;
+    uint64_t             running;
+    uint64_t             values[H_PERF_NCOUNTERS];
+} h_perf_sample_t;
+
+typedef struct h_perf_frame_t {
+    h_perf_stage_t       stage;
+    h_perf_sample_t      start;
+} h_perf_frame_t;
+
+/**
+ *  One per thread. Only the owning thread opens, reads and closes the
+ *  counters and touches the frames; `lock` guards the totals, which are
+ *  also read by h_perf_stage() and h_perf_threads(). Records are kept
+ *  after their thread exits, so its totals aren't lost.
+ */
+typedef struct h_perf_record_t {
+    struct h_perf_record_t  *next;
+    long                     tid;
+
+    int                      hardware;
+    int                      fds[H_PERF_NCOUNTERS];
+    int                      slot[H_PERF_NCOUNTERS];    /* position in a group read, or -1 */
+    int                      nopen;
+
+    int                      depth;
+    h_perf_frame_t           frames[H_PERF_MAX_DEPTH];
+
+    pthread_mutex_t          lock;
+    h_perf_counters_t        stages[H_PERF_NSTAGES];
+} h_perf_record_t;
+
+static atomic_int h_perf_on;
+
+static pthread_mutex_t h_perf_lock = PTHREAD_MUTEX_INITIALIZER;
+static h_perf_record_t *h_perf_records;
+
+static pthread_key_t h_perf_key;
+static pthread_once_t h_perf_once = PTHREAD_ONCE_INIT;
+static _Thread_local h_perf_record_t *h_perf_self;
+
+static const char *h_perf_stage_names[H_PERF_NSTAGES] = {
+    "macho_load",
+    "symbol_index",
+    "lzfse_decode",
+    "lzss_decode",
+    "sep_split",
+};
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Counters                             									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Opens the counter group for the calling thread. The first counter is
+ *  the group leader, and without it there are no hardware counts at
+ *  all. Any of the others the PMU doesn't support just read as zero.
+ */
+static int h_perf_open (h_perf_record_t *rec)
+{
+    for (int i = 0; i < H_PERF_NCOUNTERS; i++) {
+        rec->fds[i] = -1;
+        rec->slot[i] = -1;
+    }
+
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    static const uint64_t events[H_PERF_NCOUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+
+    for (int i = 0; i < H_PERF_NCOUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset (&attr, '\0', sizeof (struct perf_event_attr));
+        attr.size = sizeof (struct perf_event_attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = events[i];
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // User space only, which is all an unprivileged process may count
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        int fd = (int) syscall (SYS_perf_event_open, &attr, 0, -1, rec->fds[0], 0);
+        if (fd < 0) {
+            if (i == 0)
+                return 0;
+            continue;
+        }
+        rec->fds[i] = fd;
+        rec->slot[i] = rec->nopen++;
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+
+static void h_perf_close (h_perf_record_t *rec)
+{
+    // Members first, the leader owns the group
+    for (int i = H_PERF_NCOUNTERS - 1; i >= 0; i--) {
+        if (rec->fds[i] >= 0)
+            close (rec->fds[i]);
+        rec->fds[i] = -1;
+    }
+    rec->hardware = 0;
+}
+
+
+static void h_perf_sample (h_perf_record_t *rec, h_perf_sample_t *s)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    s->nsec = (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+
+    if (!rec->hardware)
+        return;
+
+    // nr, time enabled, time running, then one value per counter
+    uint64_t buf[3 + H_PERF_NCOUNTERS];
+    ssize_t want = (ssize_t) ((3 + rec->nopen) * sizeof (uint64_t));
+    if (read (rec->fds[0], buf, sizeof (buf)) < want) {
+        h_perf_close (rec);
+        return;
+    }
+
+    s->enabled = buf[1];
+    s->running = buf[2];
+    for (int i = 0; i < H_PERF_NCOUNTERS; i++)
+        s->values[i] = (rec->slot[i] >= 0) ? buf[3 + rec->slot[i]] : 0;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Per-thread records                   									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void h_perf_thread_exit (void *arg)
+{
+    h_perf_record_t *rec = (h_perf_record_t *) arg;
+
+    pthread_mutex_lock (&rec->lock);
+    h_perf_close (rec);
+    pthread_mutex_unlock (&rec->lock);
+}
+
+static void h_perf_key_init (void)
+{
+    pthread_key_create (&h_perf_key, h_perf_thread_exit);
+}
+
+static h_perf_record_t *h_perf_self_record (void)
+{
+    if (h_perf_self)
+        return h_perf_self;
+
+    pthread_once (&h_perf_once, h_perf_key_init);
+
+    h_perf_record_t *rec = calloc (1, sizeof (h_perf_record_t));
+#if defined(__linux__) && defined(SYS_gettid)
+    rec->tid = (long) syscall (SYS_gettid);
+#endif
+    rec->hardware = h_perf_open (rec);
+    pthread_mutex_init (&rec->lock, NULL);
+
+    pthread_mutex_lock (&h_perf_lock);
+    rec->next = h_perf_records;
+    h_perf_records = rec;
+    pthread_mutex_unlock (&h_perf_lock);
+
+    pthread_setspecific (h_perf_key, rec);
+    h_perf_self = rec;
+    return rec;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Stages                               									 --*/
+//===-----------------------------------------------------------------------===//
+
+int h_perf_enable (void)
+{
+    h_perf_record_t *rec = h_perf_self_record ();
+    atomic_store (&h_perf_on, 1);
+    return rec->hardware;
+}
+
+
+void h_perf_disable (void)
+{
+    atomic_store (&h_perf_on, 0);
+}
+
+
+int h_perf_enabled (void)
+{
+    return atomic_load_explicit (&h_perf_on, memory_order_relaxed);
+}
+
+
+void h_perf_begin (h_perf_stage_t stage)
+{
+    if (!atomic_load_explicit (&h_perf_on, memory_order_relaxed) || stage >= H_PERF_NSTAGES)
+        return;
+
+    h_perf_record_t *rec = h_perf_self_record ();
+
+    // Past the limit stages aren't timed, but the depth still has to balance
+    if (rec->depth < H_PERF_MAX_DEPTH) {
+        h_perf_frame_t *frame = &rec->frames[rec->depth];
+        frame->stage = stage;
+        h_perf_sample (rec, &frame->start);
+    }
+    rec->depth++;
+}
+
+
+void h_perf_end (h_perf_stage_t stage)
+{
+    // Not checking the flag, a stage that began before a disable still ends
+    h_perf_record_t *rec = h_perf_self;
+    if (!rec || !rec->depth)
+        return;
+
+    if (rec->depth > H_PERF_MAX_DEPTH) {
+        rec->depth--;
+        return;
+    }
+
+    // An end without a matching begin, e.g. one from before an enable
+    h_perf_frame_t *frame = &rec->frames[rec->depth - 1];
+    if (frame->stage != stage)
+        return;
+    rec->depth--;
+
+    h_perf_sample_t now;
+    memset (&now, '\0', sizeof (h_perf_sample_t));
+    h_perf_sample (rec, &now);
+
+    pthread_mutex_lock (&rec->lock);
+
+    h_perf_counters_t *c = &rec->stages[stage];
+    c->calls++;
+    c->nsec += now.nsec - frame->start.nsec;
+
+    if (rec->hardware) {
+        uint64_t delta[H_PERF_NCOUNTERS];
+        uint64_t enabled = now.enabled - frame->start.enabled;
+        uint64_t running = now.running - frame->start.running;
+
+        // Scale up counts the kernel multiplexed off the PMU for a while
+        for (int i = 0; i < H_PERF_NCOUNTERS; i++) {
+            delta[i] = now.values[i] - frame->start.values[i];
+            if (running && running < enabled)
+                delta[i] = (uint64_t) ((double) delta[i] * enabled / running);
+        }
+
+        c->hardware = 1;
+        c->cycles += delta[0];
+        c->instructions += delta[1];
+        c->cache_misses += delta[2];
+        c->branch_misses += delta[3];
+    }
+
+    pthread_mutex_unlock (&rec->lock);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Queries                              									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void h_perf_add (h_perf_counters_t *to, const h_perf_counters_t *from)
+{
+    to->calls += from->calls;
+    to->nsec += from->nsec;
+    to->hardware |= from->hardware;
+    to->cycles += from->cycles;
+    to->instructions += from->instructions;
+    to->cache_misses += from->cache_misses;
+    to->branch_misses += from->branch_misses;
+}
+
+
+void h_perf_stage (h_perf_stage_t stage, h_perf_counters_t *out)
+{
+    memset (out, '\0', sizeof (h_perf_counters_t));
+    if (stage >= H_PERF_NSTAGES)
+        return;
+
+    pthread_mutex_lock (&h_perf_lock);
+    for (h_perf_record_t *rec = h_perf_records; rec; rec = rec->next) {
+        pthread_mutex_lock (&rec->lock);
+        h_perf_add (out, &rec->stages[stage]);
+        pthread_mutex_unlock (&rec->lock);
+    }
+    pthread_mutex_unlock (&h_perf_lock);
+}
+
+
+size_t h_perf_threads (h_perf_thread_t *out, size_t max)
+{
+    size_t n = 0;
+
+    pthread_mutex_lock (&h_perf_lock);
+    for (h_perf_record_t *rec = h_perf_records; rec; rec = rec->next) {
+        pthread_mutex_lock (&rec->lock);
+
+        int used = 0;
+        for (int s = 0; s < H_PERF_NSTAGES; s++)
+            used |= (rec->stages[s].calls != 0);
+
+        if (used) {
+            if (out && n < max) {
+                out[n].tid = rec->tid;
+                memcpy (out[n].stages, rec->stages, sizeof (rec->stages));
+            }
+            n++;
+        }
+
+        pthread_mutex_unlock (&rec->lock);
+    }
+    pthread_mutex_unlock (&h_perf_lock);
+
+    return n;
+}
+
+
+void h_perf_reset (void)
+{
+    pthread_mutex_lock (&h_perf_lock);
+    for (h_perf_record_t *rec = h_perf_records; rec; rec = rec->next) {
+        pthread_mutex_lock (&rec->lock);
+        memset (rec->stages, '\0', sizeof (rec->stages));
+        pthread_mutex_unlock (&rec->lock);
+    }
+    pthread_mutex_unlock (&h_perf_lock);
+}
+
+
+const char *h_perf_stage_name (h_perf_stage_t stage)
+{
+    return (stage < H_PERF_NSTAGES) ? h_perf_stage_names[stage] : "unknown";
+}
@@ -0,0 +1,310 @@
+//===---------------------------- htrace -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#   include <sys/syscall.h>
+#endif
+
+#include "libhelper/htrace.h"
+
+// Events per buffer chunk, about 160KB
+#define H_TRACE_CHUNK_EVENTS        4096
+
+
+typedef struct h_trace_event_t {
+    uint64_t             ts;            /* ns since the first enable */
+    const char          *cat;
+    const char          *name;
+    uint64_t             arg;           /* flow id, or counter value */
+    char                 ph;            /* Chrome trace phase */
+} h_trace_event_t;
+
+/**
+ *  Only the owning thread writes events. It publishes each one with a
+ *  release store of `count`, and a new chunk with a release store of
+ *  `next`, so h_trace_flush() can read the buffer at any time.
+ */
+typedef struct h_trace_chunk_t {
+    _Atomic (struct h_trace_chunk_t *)   next;
+    atomic_size_t                        count;
+    h_trace_event_t                      events[H_TRACE_CHUNK_EVENTS];
+} h_trace_chunk_t;
+
+typedef struct h_trace_buffer_t {
+    struct h_trace_buffer_t     *next;
+    long                         tid;
+    h_trace_chunk_t             *head;
+    h_trace_chunk_t             *tail;          /* owner only */
+} h_trace_buffer_t;
+
+static atomic_int h_trace_on;
+static atomic_uint_fast64_t h_trace_epoch;
+static atomic_uint_fast64_t h_trace_next_flow = 1;
+
+// Buffers are pushed on, never taken off, so a CAS is all this needs
+static _Atomic (h_trace_buffer_t *) h_trace_buffers;
+static _Thread_local h_trace_buffer_t *h_trace_self;
+
+
+static uint64_t h_trace_now (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+
+/**
+ *  The calling thread's buffer, created and added to the list on its
+ *  first event. Buffers outlive their threads, so a trace written at
+ *  the end of a job still has the events of pool workers that exited.
+ */
+static h_trace_buffer_t *h_trace_buffer (void)
+{
+    if (h_trace_self)
+        return h_trace_self;
+
+    h_trace_buffer_t *buf = calloc (1, sizeof (h_trace_buffer_t));
+    buf->head = buf->tail = calloc (1, sizeof (h_trace_chunk_t));
+#if defined(__linux__) && defined(SYS_gettid)
+    buf->tid = (long) syscall (SYS_gettid);
+#else
+    buf->tid = (long) (uintptr_t) buf;
+#endif
+
+    buf->next = atomic_load_explicit (&h_trace_buffers, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit (&h_trace_buffers, &buf->next, buf,
+                                                   memory_order_release, memory_order_relaxed))
+        ;
+
+    h_trace_self = buf;
+    return buf;
+}
+
+
+static void h_trace_emit (char ph, const char *cat, const char *name, uint64_t arg)
+{
+    if (!atomic_load_explicit (&h_trace_on, memory_order_relaxed))
+        return;
+
+    h_trace_buffer_t *buf = h_trace_buffer ();
+    h_trace_chunk_t *chunk = buf->tail;
+
+    size_t n = atomic_load_explicit (&chunk->count, memory_order_relaxed);
+    if (n == H_TRACE_CHUNK_EVENTS) {
+        h_trace_chunk_t *next = calloc (1, sizeof (h_trace_chunk_t));
+        atomic_store_explicit (&chunk->next, next, memory_order_release);
+        buf->tail = chunk = next;
+        n = 0;
+    }
+
+    h_trace_event_t *ev = &chunk->events[n];
+    ev->ts = h_trace_now () - atomic_load_explicit (&h_trace_epoch, memory_order_relaxed);
+    ev->cat = cat;
+    ev->name = name;
+    ev->arg = arg;
+    ev->ph = ph;
+
+    atomic_store_explicit (&chunk->count, n + 1, memory_order_release);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Events                               									 --*/
+//===-----------------------------------------------------------------------===//
+
+void h_trace_enable (void)
+{
+    uint_fast64_t zero = 0;
+    atomic_compare_exchange_strong (&h_trace_epoch, &zero, h_trace_now ());
+    atomic_store (&h_trace_on, 1);
+}
+
+
+void h_trace_disable (void)
+{
+    atomic_store (&h_trace_on, 0);
+}
+
+
+int h_trace_enabled (void)
+{
+    return atomic_load_explicit (&h_trace_on, memory_order_relaxed);
+}
+
+
+void h_trace_begin (const char *cat, const char *name)
+{
+    h_trace_emit ('B', cat, name, 0);
+}
+
+
+void h_trace_end (const char *cat, const char *name)
+{
+    h_trace_emit ('E', cat, name, 0);
+}
+
+
+void h_trace_counter (const char *name, int64_t value)
+{
+    h_trace_emit ('C', "counter", name, (uint64_t) value);
+}
+
+
+uint64_t h_trace_flow_id (void)
+{
+    return atomic_fetch_add_explicit (&h_trace_next_flow, 1, memory_order_relaxed);
+}
+
+
+void h_trace_flow_start (const char *cat, const char *name, uint64_t id)
+{
+    h_trace_emit ('s', cat, name, id);
+}
+
+
+void h_trace_flow_step (const char *cat, const char *name, uint64_t id)
+{
+    h_trace_emit ('t', cat, name, id);
+}
+
+
+void h_trace_flow_end (const char *cat, const char *name, uint64_t id)
+{
+    h_trace_emit ('f', cat, name, id);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Output                               									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void h_trace_write_string (FILE *fp, const char *str)
+{
+    fputc ('"', fp);
+    for (const unsigned char *p = (const unsigned char *) ((str) ? str : ""); *p; p++) {
+        if (*p == '"' || *p == '\\')
+            fprintf (fp, "\\%c", *p);
+        else if (*p < 0x20)
+            fprintf (fp, "\\u%04x", *p);
+        else
+            fputc (*p, fp);
+    }
+    fputc ('"', fp);
+}
+
+
+static void h_trace_write_event (FILE *fp, const h_trace_event_t *ev, long pid, long tid)
+{
+    fprintf (fp, "{\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%ld,\"tid\":%ld,\"name\":",
+             ev->ph, (unsigned long long) (ev->ts / 1000), (unsigned) (ev->ts % 1000), pid, tid);
+    h_trace_write_string (fp, ev->name);
+    fputs (",\"cat\":", fp);
+    h_trace_write_string (fp, ev->cat);
+
+    switch (ev->ph) {
+        case 'C':
+            fprintf (fp, ",\"args\":{\"value\":%lld}", (long long) ev->arg);
+            break;
+        case 'f':
+            // Bind to the slice the end is in, not the next one to begin
+            fputs (",\"bp\":\"e\"", fp);
+            /* fallthrough */
+        case 's':
+        case 't':
+            fprintf (fp, ",\"id\":%llu", (unsigned long long) ev->arg);
+            break;
+    }
+    fputc ('}', fp);
+}
+
+
+int h_trace_flush (FILE *fp)
+{
+    long pid = (long) getpid ();
+    int first = 1;
+
+    fputs ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", fp);
+
+    h_trace_buffer_t *buf = atomic_load_explicit (&h_trace_buffers, memory_order_acquire);
+    for (; buf; buf = buf->next) {
+        h_trace_chunk_t *chunk = buf->head;
+        while (chunk) {
+            size_t count = atomic_load_explicit (&chunk->count, memory_order_acquire);
+            for (size_t i = 0; i < count; i++) {
+                fputs ((first) ? "\n" : ",\n", fp);
+                h_trace_write_event (fp, &chunk->events[i], pid, buf->tid);
+                first = 0;
+            }
+            chunk = atomic_load_explicit (&chunk->next, memory_order_acquire);
+        }
+    }
+
+    fputs ("\n]}\n", fp);
+    if (fflush (fp) || ferror (fp)) {
+        if (!errno)
+            errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+
+int h_trace_write (const char *path)
+{
+    FILE *fp = fopen (path, "w");
+    if (!fp)
+        return -1;
+
+    int ret = h_trace_flush (fp);
+    if (fclose (fp) && !ret)
+        ret = -1;
+    return ret;
+}
+
+
+void h_trace_clear (void)
+{
+    h_trace_buffer_t *buf = atomic_load_explicit (&h_trace_buffers, memory_order_acquire);
+    for (; buf; buf = buf->next) {
+        h_trace_chunk_t *chunk = atomic_load (&buf->head->next);
+        while (chunk) {
+            h_trace_chunk_t *next = atomic_load (&chunk->next);
+            free (chunk);
+            chunk = next;
+        }
+
+        atomic_store (&buf->head->next, NULL);
+        atomic_store (&buf->head->count, 0);
+        buf->tail = buf->head;
+    }
+}
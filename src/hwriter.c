@@ -0,0 +1,161 @@
+//===--------------------------- hwriter -----------------------------===//
+//
+//                         The Libhelper Project
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libhelper/hwriter.h"
+
+
+void h_writer_init (h_writer_t *w, int fd, size_t cap)
+{
+    w->fd = fd;
+    w->cap = (cap) ? cap : H_WRITER_DEFAULT_SIZE;
+    w->buf = malloc (w->cap);
+    w->len = 0;
+    w->error = 0;
+}
+
+
+int h_writer_flush (h_writer_t *w)
+{
+    if (w->fd < 0 || !w->len)
+        return (w->error) ? -1 : 0;
+
+    size_t done = 0;
+    while (done < w->len && !w->error) {
+        ssize_t n = write (w->fd, w->buf + done, w->len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            w->error = (n < 0) ? errno : EIO;
+        else
+            done += n;
+    }
+
+    // After a failure the rest is dropped, the error is reported instead
+    w->len = 0;
+    return (w->error) ? -1 : 0;
+}
+
+
+char *h_writer_reserve (h_writer_t *w, size_t n)
+{
+    if (w->cap - w->len >= n)
+        return w->buf + w->len;
+
+    if (w->fd >= 0)
+        h_writer_flush (w);
+
+    if (w->cap - w->len < n) {
+        // cap is 0 after h_writer_take() or h_writer_finish()
+        size_t cap = (w->cap) ? w->cap * 2 : H_WRITER_DEFAULT_SIZE;
+        while (cap - w->len < n)
+            cap *= 2;
+        w->buf = realloc (w->buf, cap);
+        w->cap = cap;
+    }
+    return w->buf + w->len;
+}
+
+
+void h_writer_write (h_writer_t *w, const void *data, size_t n)
+{
+    // Big blocks skip the buffer, rather than growing it
+    if (w->fd >= 0 && n >= w->cap) {
+        h_writer_flush (w);
+
+        const char *p = (const char *) data;
+        while (n && !w->error) {
+            ssize_t r = write (w->fd, p, n);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0)
+                w->error = (r < 0) ? errno : EIO;
+            else {
+                p += r;
+                n -= r;
+            }
+        }
+        return;
+    }
+
+    memcpy (h_writer_reserve (w, n), data, n);
+    h_writer_commit (w, n);
+}
+
+
+void h_writer_puts (h_writer_t *w, const char *str)
+{
+    h_writer_write (w, str, strlen (str));
+}
+
+
+void h_writer_printf (h_writer_t *w, const char *fmt, ...)
+{
+    va_list args;
+
+    // Format in place, and only again if it didn't fit
+    va_start (args, fmt);
+    size_t room = w->cap - w->len;
+    int n = vsnprintf (w->buf + w->len, room, fmt, args);
+    va_end (args);
+
+    if (n < 0)
+        return;
+
+    if ((size_t) n >= room) {
+        char *p = h_writer_reserve (w, (size_t) n + 1);
+        va_start (args, fmt);
+        vsnprintf (p, (size_t) n + 1, fmt, args);
+        va_end (args);
+    }
+    h_writer_commit (w, (size_t) n);
+}
+
+
+int h_writer_finish (h_writer_t *w)
+{
+    int ret = h_writer_flush (w);
+    free (w->buf);
+    w->buf = NULL;
+    w->len = w->cap = 0;
+    return ret;
+}
+
+
+char *h_writer_take (h_writer_t *w, size_t *len)
+{
+    char *buf = w->buf;
+    if (len)
+        *len = w->len;
+
+    w->buf = NULL;
+    w->len = w->cap = 0;
+    return buf;
+}
@@ -31,13 +31,26 @@
  */
 
 #include "libhelper-img4/sep.h"
+#include "libhelper/hidentify.h"
+#include "libhelper/hperf.h"
+#include "libhelper/htrace.h"
 
 uint8_t     *kernel         = MAP_FAILED;
 size_t       kernel_size    = 0;
 static int   kernel_fd      = -1;
 
-#define IS64(image) (*(uint8_t *)(image) & 1)
-#define MACHO(p) ((*(unsigned int *)(p) & ~1) == 0xfeedface)
+/**
+ *  Whether `ptr` is a thin Mach-O in our byte order, going by lh_identify()
+ *  so there's one definition of the magic. `is64` is set from the header.
+ */
+static int sep_is_macho (const uint8_t *ptr, size_t size, int *is64)
+{
+    lh_identity_t id;
+    if (lh_identify (ptr, size, &id) != LH_FORMAT_MACHO || id.swapped)
+        return 0;
+    *is64 = id.is64;
+    return 1;
+}
 
 /*****************************************************************
 ******************************************************************/
@@ -148,9 +161,10 @@ size_t calc_size (const uint8_t *ptr, size_t sz)
     //
     if (sz < 1024) return 0;
 
-    if (!MACHO(ptr)) return 0;
+    int is64;
+    if (!sep_is_macho (ptr, sz, &is64)) return 0;
 
-    if (IS64(ptr)) {
+    if (is64) {
         lc_ptr += 4;
     } else {
         errorf ("Cannot handle 32bit\n");
@@ -201,8 +215,8 @@ size_t restore_linkedit (uint8_t *ptr, size_t size)
     //  that the size is less than 4096 bytes, and that it is 64bit
     //
     if (size < 4096) return -1;
-    if (!MACHO (ptr)) return -1;
-    if (IS64 (ptr)) is64 = 4;
+    if (!sep_is_macho (ptr, size, &is64)) return -1;
+    if (is64) is64 = 4;
 
 
     //  Set lc_ptr to the end of the mach header, plus it's current value and
@@ -333,6 +347,13 @@ int restore_file (unsigned index, const unsigned char *buf, size_t size, int res
 
 }
 
+/**
+ *  Function:   sep_split_init
+ *  --------------------------
+ *
+ *  Maps a SEP firmware file and splits it with `sep_split_buffer()`.
+ *
+ */
 void sep_split_init (char *filename)
 {
     // Try to open and load the file into 'kernel_fd'
@@ -354,6 +375,34 @@ void sep_split_init (char *filename)
     }
 
     printf ("[*] File loaded okay. Attempting to identify Mach-O regions...\n");
+    sep_split_buffer (kernel, kernel_size);
+}
+
+
+/**
+ *  Function:   sep_split_buffer
+ *  ----------------------------
+ *
+ *  Splits SEP firmware that is already in memory, like a mapping shared
+ *  with other tools, into sepdumpNN_name files in the current directory.
+ *  The buffer is only read. Uses the same global state as
+ *  `sep_split_init()`, so only one split can run at a time.
+ *
+ *  data:       The firmware.
+ *  size:       Size of `data`.
+ *
+ */
+void sep_split_buffer (const uint8_t *data, size_t size)
+{
+    kernel = (uint8_t *) data;
+    kernel_size = size;
+
+    // The app table is found again in each firmware
+    apps = NULL;
+    sizeof_sepapp = sizeof (struct sepapp_t);
+
+    h_perf_begin (H_PERF_SEP_SPLIT);
+    h_trace_begin ("extract", "sep_split");
     
     //  Now we start trying to split the sepos firmware. There are 9 areas
     //  we need to extract, the first being the bootloader, the second being
@@ -385,4 +434,6 @@ void sep_split_init (char *filename)
     }
     restore_file(j, kernel + last, i - last, restore);
 
+    h_trace_end ("extract", "sep_split");
+    h_perf_end (H_PERF_SEP_SPLIT);
 }
\ No newline at end of file
@@ -47,6 +47,8 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 
 #include "libhelper-lzfse/lzfse.h"
 #include "libhelper-lzfse/lzfse_internal.h"
+#include "libhelper/hperf.h"
+#include "libhelper/htrace.h"
 
 size_t lzfse_decode_scratch_size() { return sizeof(lzfse_decoder_state); }
 
@@ -87,9 +89,13 @@ size_t lzfse_decode_buffer(uint8_t *__restrict dst_buffer, size_t dst_size,
   }
   if (scratch_buffer == NULL)
     return 0;
+  h_perf_begin(H_PERF_LZFSE_DECODE);
+  h_trace_begin("decompress", "lzfse_decode_buffer");
   ret = lzfse_decode_buffer_with_scratch(dst_buffer, 
                                dst_size, src_buffer, 
                                src_size, scratch_buffer);
+  h_trace_end("decompress", "lzfse_decode_buffer");
+  h_perf_end(H_PERF_LZFSE_DECODE);
   if (has_malloc)
     free(scratch_buffer);
   return ret;
@@ -26,6 +26,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include "libhelper-lzss/lzss.h"
+#include "libhelper/hperf.h"
+#include "libhelper/htrace.h"
 
 #define BASE 65521L /* largest prime smaller than 65536 */
 #define NMAX 5000  
@@ -108,6 +110,9 @@ decompress_lzss(uint8_t *dst, uint8_t *src, uint32_t srclen)
     int  i, j, k, r, c;
     unsigned int flags;
     
+    h_perf_begin (H_PERF_LZSS_DECODE);
+    h_trace_begin ("decompress", "decompress_lzss");
+
     dst = dststart;
     srcend = src + srclen;
     for (i = 0; i < N - F; i++)
@@ -138,6 +143,8 @@ decompress_lzss(uint8_t *dst, uint8_t *src, uint32_t srclen)
         }
     }
     
+    h_trace_end ("decompress", "decompress_lzss");
+    h_perf_end (H_PERF_LZSS_DECODE);
     return dst - dststart;
 }
 
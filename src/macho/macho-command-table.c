@@ -0,0 +1,313 @@
+//===------------------------ macho_command_table ---------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper-macho/macho-command-table.h"
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Descriptor Table                     									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Every command id is a number below 0x40, possibly with LC_REQ_DYLD
+ *  (0x80000000) set, so the low six bits and the top bit make a 7-bit
+ *  key that's unique across the table. LC_DYLD_INFO and LC_DYLD_INFO_ONLY
+ *  only differ in the top bit.
+ */
+#define MACH_LC_REQ_DYLD            0x80000000u
+#define MACH_LC_KEY(cmd)            ((((uint32_t) (cmd)) & 0x3f) | ((((uint32_t) (cmd)) >> 25) & 0x40))
+#define MACH_LC_KEY_VALID(cmd)      ((((uint32_t) (cmd)) & ~(MACH_LC_REQ_DYLD | 0x3f)) == 0)
+
+#define MACH_LC_MAP_ENTRY(NAME, TYPE, MIN_SIZE, STR)    [MACH_LC_KEY (NAME)] = MACH_LC_INDEX_##NAME,
+#define MACH_LC_DESC_ENTRY(NAME, TYPE, MIN_SIZE, STR)   [MACH_LC_INDEX_##NAME] = { NAME, #NAME, MIN_SIZE, STR },
+
+static const uint8_t mach_lc_index_map[128] = {
+    MACH_LOAD_COMMANDS (MACH_LC_MAP_ENTRY)
+};
+
+static const mach_load_command_desc_t mach_lc_desc_table[MACH_LC_INDEX_COUNT] = {
+    [MACH_LC_INDEX_UNKNOWN] = { 0, "LC_UNKNOWN", sizeof (mach_load_command_t), 0 },
+    MACH_LOAD_COMMANDS (MACH_LC_DESC_ENTRY)
+};
+
+#undef MACH_LC_MAP_ENTRY
+#undef MACH_LC_DESC_ENTRY
+
+/**
+ *  On 64-bit hosts the structs have no pointers in them, so each should
+ *  fit in the minimum size the table gives for it, and the string field
+ *  should be inside that.
+ */
+#if defined(__LP64__)
+#define MACH_LC_CHECK_ENTRY(NAME, TYPE, MIN_SIZE, STR)                                      \
+    _Static_assert (sizeof (TYPE) <= MIN_SIZE, #NAME " is smaller than " #TYPE);            \
+    _Static_assert (STR == 0 || STR + sizeof (uint32_t) <= MIN_SIZE, #NAME " string field");
+
+MACH_LOAD_COMMANDS (MACH_LC_CHECK_ENTRY)
+
+#undef MACH_LC_CHECK_ENTRY
+#endif
+
+
+/**
+ *  Function:   mach_load_command_index
+ *  -----------------------------------
+ *
+ *  Finds the table index of a load command type.
+ *
+ *  cmd:        The LC_* command type.
+ *
+ *  returns:    The index, or MACH_LC_INDEX_UNKNOWN if `cmd` isn't in the
+ *              table.
+ *
+ */
+mach_lc_index_t mach_load_command_index (uint32_t cmd)
+{
+    if (!MACH_LC_KEY_VALID (cmd))
+        return MACH_LC_INDEX_UNKNOWN;
+
+    mach_lc_index_t index = (mach_lc_index_t) mach_lc_index_map[MACH_LC_KEY (cmd)];
+    return (mach_lc_desc_table[index].cmd == cmd) ? index : MACH_LC_INDEX_UNKNOWN;
+}
+
+
+/**
+ *  Function:   mach_load_command_desc
+ *  ----------------------------------
+ *
+ *  Finds the table entry for a load command type.
+ *
+ *  cmd:        The LC_* command type.
+ *
+ *  returns:    The entry, or NULL if `cmd` isn't in the table.
+ *
+ */
+const mach_load_command_desc_t *mach_load_command_desc (uint32_t cmd)
+{
+    mach_lc_index_t index = mach_load_command_index (cmd);
+    return (index != MACH_LC_INDEX_UNKNOWN) ? &mach_lc_desc_table[index] : NULL;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Checked Access                       									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  The start and end of the load command area, clamped to the file. The
+ *  commands start at macho->offset, which is past the header of an
+ *  embedded Mach-O.
+ */
+static uint64_t mach_lc_area_start (macho_t *macho)
+{
+    return (macho->offset) ? macho->offset : sizeof (mach_header_t);
+}
+
+static uint64_t mach_lc_area_end (macho_t *macho)
+{
+    uint64_t end = mach_lc_area_start (macho) + (uint64_t) macho->header->sizeofcmds;
+    return (end > macho->size) ? macho->size : end;
+}
+
+
+/**
+ *  Reads the command at `off`, checking it holds a mach_load_command_t
+ *  and ends by `end`. Returns 0 if it doesn't.
+ */
+static int mach_lc_read (macho_t *macho, uint64_t off, uint64_t end, mach_load_command_t *lc)
+{
+    if (off < mach_lc_area_start (macho) || off + sizeof (mach_load_command_t) > end)
+        return 0;
+
+    memcpy (lc, macho->data + off, sizeof (mach_load_command_t));
+    return lc->cmdsize >= sizeof (mach_load_command_t) && lc->cmdsize <= end - off;
+}
+
+
+/**
+ *  Function:   mach_load_command_valid
+ *  -----------------------------------
+ *
+ *  Checks the load command at `offset` is inside the load command area and
+ *  the file, and is at least as big as the table says.
+ *
+ *  macho:      The Mach-O containing the command.
+ *  offset:     The offset of the command.
+ *
+ *  returns:    1 if the command is valid, otherwise 0.
+ *
+ */
+int mach_load_command_valid (macho_t *macho, uint32_t offset)
+{
+    mach_load_command_t lc;
+    if (!mach_lc_read (macho, offset, mach_lc_area_end (macho), &lc))
+        return 0;
+
+    const mach_load_command_desc_t *desc = mach_load_command_desc (lc.cmd);
+    return !desc || lc.cmdsize >= desc->min_size;
+}
+
+
+/**
+ *  Function:   mach_load_command_str
+ *  ---------------------------------
+ *
+ *  Finds the string of the load command at `offset`, using the lc_str field
+ *  the table gives for the command type.
+ *
+ *  macho:      The Mach-O containing the command.
+ *  offset:     The offset of the command.
+ *
+ *  returns:    A pointer to the string in the Mach-O, or NULL if the command
+ *              is invalid, has no string, or the string isn't NUL terminated
+ *              inside the command.
+ *
+ */
+const char *mach_load_command_str (macho_t *macho, uint32_t offset)
+{
+    if (!mach_load_command_valid (macho, offset))
+        return NULL;
+
+    mach_load_command_t lc;
+    memcpy (&lc, macho->data + offset, sizeof (mach_load_command_t));
+
+    const mach_load_command_desc_t *desc = mach_load_command_desc (lc.cmd);
+    if (!desc || !desc->str_offset)
+        return NULL;
+
+    uint32_t str;
+    memcpy (&str, macho->data + offset + desc->str_offset, sizeof (str));
+    if (str < desc->min_size || str >= lc.cmdsize)
+        return NULL;
+
+    const char *ret = (const char *) macho->data + offset + str;
+    return (memchr (ret, '\0', lc.cmdsize - str)) ? ret : NULL;
+}
+
+
+/**
+ *  Function:   mach_lc_find_checked
+ *  --------------------------------
+ *
+ *  Finds the first load command of a given type that is valid by
+ *  mach_load_command_valid(). Unlike mach_lc_find_given_cmd() this walks the
+ *  commands in the file, so it finds segments too.
+ *
+ *  macho:      The Mach-O to search.
+ *  cmd:        The LC_* command type.
+ *  offset:     Set to the offset of the command, if not NULL.
+ *
+ *  returns:    A pointer to the command in the Mach-O, or NULL.
+ *
+ */
+const void *mach_lc_find_checked (macho_t *macho, uint32_t cmd, uint32_t *offset)
+{
+    const mach_load_command_desc_t *desc = mach_load_command_desc (cmd);
+    uint32_t min_size = (desc) ? desc->min_size : sizeof (mach_load_command_t);
+
+    uint64_t off = mach_lc_area_start (macho);
+    uint64_t end = mach_lc_area_end (macho);
+
+    for (uint32_t i = 0; i < macho->header->ncmds; i++) {
+        mach_load_command_t lc;
+        if (!mach_lc_read (macho, off, end, &lc))
+            break;
+
+        if (lc.cmd == cmd && lc.cmdsize >= min_size) {
+            if (offset)
+                *offset = (uint32_t) off;
+            return macho->data + off;
+        }
+        off += lc.cmdsize;
+    }
+    return NULL;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Typed Visitor                        									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Function:   mach_load_commands_visit
+ *  ------------------------------------
+ *
+ *  Walks the load commands of `macho`, calling the visitor's callback for
+ *  each command's type. The switch is on the dense table index, so it is
+ *  a single jump table however sparse the LC_* values are.
+ *
+ *  macho:      The Mach-O to walk.
+ *  visitor:    The callbacks, any of which may be NULL.
+ *  ctx:        Passed to each callback.
+ *
+ *  returns:    0 once every command has been visited, the first non-zero
+ *              value a callback returns, or -1 if a command runs past the
+ *              load command area or the file.
+ *
+ */
+int mach_load_commands_visit (macho_t *macho, const mach_lc_visitor_t *visitor, void *ctx)
+{
+    uint64_t off = mach_lc_area_start (macho);
+    uint64_t end = mach_lc_area_end (macho);
+
+    for (uint32_t i = 0; i < macho->header->ncmds; i++) {
+        if (off + sizeof (mach_load_command_t) > end)
+            return -1;
+
+        const mach_load_command_t *lc = (const mach_load_command_t *) (macho->data + off);
+        if (lc->cmdsize < sizeof (mach_load_command_t) || lc->cmdsize > end - off) {
+            if (visitor->on_invalid)
+                visitor->on_invalid (macho, lc, (uint32_t) off, ctx);
+            return -1;
+        }
+
+        int ret = 0;
+        switch (mach_load_command_index (lc->cmd)) {
+
+#define MACH_LC_VISIT_CASE(NAME, TYPE, MIN_SIZE, STR)                                       \
+            case MACH_LC_INDEX_##NAME:                                                      \
+                if (lc->cmdsize < MIN_SIZE) {                                               \
+                    if (visitor->on_invalid)                                                \
+                        ret = visitor->on_invalid (macho, lc, (uint32_t) off, ctx);         \
+                } else if (visitor->on_##NAME) {                                            \
+                    ret = visitor->on_##NAME (macho, (const TYPE *) lc, (uint32_t) off, ctx); \
+                }                                                                           \
+                break;
+
+            MACH_LOAD_COMMANDS (MACH_LC_VISIT_CASE)
+
+#undef MACH_LC_VISIT_CASE
+
+            default:
+                if (visitor->on_unknown)
+                    ret = visitor->on_unknown (macho, lc, (uint32_t) off, ctx);
+                break;
+        }
+
+        if (ret)
+            return ret;
+        off += lc->cmdsize;
+    }
+    return 0;
+}
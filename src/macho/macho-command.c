@@ -24,6 +24,8 @@
 
 #include "libhelper-macho/macho-command.h"
 #include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-command-table.h"
+#include "libhelper-macho/macho-leb128.h"
 
 //////////////////////////////////////////////////////////////////////////
 //                  Base Mach-O Load commands                           //
@@ -159,181 +161,14 @@ void mach_load_command_print (void *cmd, int flag)
  * 
  *  lc:         The Load Command to translate to a string
  * 
- *  returns:    The string representation of the Load Command.
+ *  returns:    The string representation of the Load Command, from the
+ *              descriptor table, or "LC_UNKNOWN".
  * 
  */
 char *mach_load_command_get_string (mach_load_command_t *lc)
 {
-    if (!lc->cmd) {
-        debugf ("[*] Error: lc->cmd not valid\n");
-        exit (0);
-    }
-    char *cmd_str = "";
-    switch (lc->cmd) {
-        case LC_SEGMENT:
-            cmd_str = "LC_SEGMENT";
-            break;
-        case LC_SYMTAB:
-            cmd_str = "LC_SYMTAB";
-            break;
-        case LC_SYMSEG:
-            cmd_str = "LC_SYMSEG";
-            break;
-        case LC_THREAD:
-            cmd_str = "LC_THREAD";
-            break;
-        case LC_UNIXTHREAD:
-            cmd_str = "LC_UNIXTHREAD";
-            break;
-        case LC_LOADFVMLIB:
-            cmd_str = "LC_LOADFVMLIB";
-            break;
-        case LC_IDFVMLIB:
-            cmd_str = "LC_IDFVMLIB";
-            break;
-        case LC_IDENT:
-            cmd_str = "LC_IDENT";
-            break;
-        case LC_FVMFILE:
-            cmd_str = "LC_FVMFILE";
-            break;
-        case LC_PREPAGE:
-            cmd_str = "LC_PREPAGE";
-            break;
-        case LC_DYSYMTAB:
-            cmd_str = "LC_DYSYMTAB";
-            break;
-        case LC_LOAD_DYLIB:
-            cmd_str = "LC_LOAD_DYLIB";
-            break;
-        case LC_ID_DYLIB:
-            cmd_str = "LC_ID_DYLIB";
-            break;
-        case LC_LOAD_DYLINKER:
-            cmd_str = "LC_LOAD_DYLINKER";
-            break;
-        case LC_ID_DYLINKER:
-            cmd_str = "LC_ID_DYLINKER";
-            break;
-        case LC_PREBOUND_DYLIB:
-            cmd_str = "LC_PREBOUND_DYLIB";
-            break;
-        case LC_ROUTINES:
-            cmd_str = "LC_ROUTINES";
-            break;
-        case LC_SUB_FRAMEWORK:
-            cmd_str = "LC_SUB_FRAMEWORK";
-            break;
-        case LC_SUB_UMBRELLA:
-            cmd_str = "LC_SUB_UMBRELLA";
-            break;
-        case LC_SUB_CLIENT:
-            cmd_str = "LC_SUB_CLIENT";
-            break;
-        case LC_SUB_LIBRARY:
-            cmd_str = "LC_SUB_LIBRARY";
-            break;
-        case LC_TWOLEVEL_HINTS:
-            cmd_str = "LC_TWOLEVEL_HINTS";
-            break;
-        case LC_PREBIND_CKSUM:
-            cmd_str = "LC_PREBIND_CKSUM";
-            break;
-        case LC_LOAD_WEAK_DYLIB:
-            cmd_str = "LC_LOAD_WEAK_DYLIB";
-            break;
-        case LC_SEGMENT_64:
-            cmd_str = "LC_SEGMENT_64";
-            break;
-        case LC_ROUTINES_64:
-            cmd_str = "LC_ROUTINES_64";
-            break;
-        case LC_UUID:
-            cmd_str = "LC_UUID";
-            break;
-        case LC_RPATH:
-            cmd_str = "LC_RPATH";
-            break;
-        case LC_CODE_SIGNATURE:
-            cmd_str = "LC_CODE_SIGNATURE";
-            break;
-        case LC_SEGMENT_SPLIT_INFO:
-            cmd_str = "LC_SEGMENT_SPLIT_INFO";
-            break;
-        case LC_REEXPORT_DYLIB:
-            cmd_str = "LC_REEXPORT_DYLIB";
-            break;
-        case LC_LAZY_LOAD_DYLIB:
-            cmd_str = "LC_LAZY_LOAD_DYLIB";
-            break;
-        case LC_ENCRYPTION_INFO:
-            cmd_str = "LC_ENCRYPTION_INFO";
-            break;
-        case LC_DYLD_INFO:
-            cmd_str = "LC_DYLD_INFO";
-            break;
-        case LC_DYLD_INFO_ONLY:
-            cmd_str = "LC_DYLD_INFO_ONLY";
-            break;
-        case LC_LOAD_UPWARD_DYLIB:
-            cmd_str = "LC_LOAD_UPWARD_DYLIB";
-            break;
-        case LC_VERSION_MIN_MACOSX:
-            cmd_str = "LC_VERSION_MIN_MACOSX";
-            break;
-        case LC_VERSION_MIN_IPHONEOS:
-            cmd_str = "LC_VERSION_MIN_IPHONEOS";
-            break;
-        case LC_FUNCTION_STARTS:
-            cmd_str = "LC_FUNCTION_STARTS";
-            break;
-        case LC_DYLD_ENVIRONMENT:
-            cmd_str = "LC_DYLD_ENVIRONMENT";
-            break;
-        case LC_MAIN:
-            cmd_str = "LC_MAIN";
-            break;
-        case LC_DATA_IN_CODE:
-            cmd_str = "LC_DATA_IN_CODE";
-            break;
-        case LC_SOURCE_VERSION:
-            cmd_str = "LC_SOURCE_VERSION";
-            break;
-        case LC_DYLIB_CODE_SIGN_DRS:
-            cmd_str = "LC_DYLIB_CODE_SIGN_DRS";
-            break;
-        case LC_ENCRYPTION_INFO_64:
-            cmd_str = "LC_ENCRYPTION_INFO_64";
-            break;
-        case LC_LINKER_OPTION:
-            cmd_str = "LC_LINKER_OPTION";
-            break;
-        case LC_LINKER_OPTIMIZATION_HINT:
-            cmd_str = "LC_LINKER_OPTIMIZATION_HINT";
-            break;
-        case LC_VERSION_MIN_TVOS:
-            cmd_str = "LC_VERSION_MIN_TVOS";
-            break;
-        case LC_VERSION_MIN_WATCHOS:
-            cmd_str = "LC_VERSION_MIN_WATCHOS";
-            break;
-        case LC_NOTE:
-            cmd_str = "LC_NOTE";
-            break;
-        case LC_BUILD_VERSION:
-            cmd_str = "LC_BUILD_VERSION";
-            break;
-        case LC_DYLD_EXPORTS_TRIE:
-            cmd_str = "LC_DYLD_EXPORTS_TRIE";
-            break;
-        case LC_DYLD_CHAINED_FIXUPS:
-            cmd_str = "LC_DYLD_CHAINED_FIXUPS";
-            break;
-        default:
-            cmd_str = "LC_UNKNOWN";
-            break;
-    }
-    return cmd_str;
+    const mach_load_command_desc_t *desc = mach_load_command_desc (lc->cmd);
+    return (char *) ((desc) ? desc->name : "LC_UNKNOWN");
 }
 
 
@@ -359,6 +194,21 @@ mach_command_info_t *mach_lc_find_given_cmd (macho_t *macho, int cmd)
     return NULL;
 }
 
+/**
+ *  Copies the first valid command of type `cmd` into a `size` byte buffer.
+ *  The descriptor table has already checked the command is at least that
+ *  big, so the find functions below don't repeat the size check.
+ */
+static void *mach_lc_copy_checked (macho_t *macho, uint32_t cmd, size_t size)
+{
+    uint32_t offset;
+    if (!mach_lc_find_checked (macho, cmd, &offset)) {
+        debugf ("[*] Error: No valid %s command\n", mach_load_command_desc (cmd)->name);
+        return NULL;
+    }
+    return macho_load_bytes (macho, size, offset);
+}
+
 /**
  *  Function:   mach_lc_find_source_version_cmd
  *  ------------------------------------
@@ -375,25 +225,7 @@ mach_command_info_t *mach_lc_find_given_cmd (macho_t *macho, int cmd)
  */
 mach_source_version_command_t *mach_lc_find_source_version_cmd (macho_t *macho)
 {
-    size_t size = sizeof (mach_source_version_command_t);
-    mach_source_version_command_t *ret = malloc (size);
-
-    HSList *cmds = macho->lcmds;
-    for (int i = 0; i < h_slist_length (cmds); i++) {
-        mach_command_info_t *tmp = (mach_command_info_t *) h_slist_nth_data (cmds, i);
-        if (tmp->type == LC_SOURCE_VERSION) {
-            ret = (mach_source_version_command_t *) macho_load_bytes (macho, size, tmp->offset);
-            
-            if (!ret) {
-                debugf ("[*] Error: Failed to load LC_SOURCE_VERSION command from offset: 0x%llx\n");
-                return NULL;
-            } else {
-                return ret;
-            }
-        }
-    }
-
-    return NULL;
+    return mach_lc_copy_checked (macho, LC_SOURCE_VERSION, sizeof (mach_source_version_command_t));
 }
 
 
@@ -445,46 +277,51 @@ char *mach_lc_source_version_string (mach_source_version_command_t *svc)
 ///////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////
 
-mach_build_version_info_t *mach_lc_build_version_info (mach_build_version_command_t *bvc, off_t offset, macho_t *macho)
+/**
+ *  Function:   mach_lc_platform_string
+ *  -----------------------------------
+ *
+ *  Returns the name of a PLATFORM_* value, from LC_BUILD_VERSION.
+ *
+ */
+char *mach_lc_platform_string (uint32_t platform)
 {
-    mach_build_version_info_t *ret = malloc (sizeof(mach_build_version_info_t));
-
-    // platform
-    switch (bvc->platform) {
+    switch (platform) {
         case PLATFORM_MACOS:
-            ret->platform = "macOS";
-            break;
+            return "macOS";
         case PLATFORM_IOS:
-            ret->platform = "iOS";
-            break;
+            return "iOS";
         case PLATFORM_TVOS:
-            ret->platform = "TvOS";
-            break;
+            return "TvOS";
         case PLATFORM_WATCHOS:
-            ret->platform = "WatchOS";
-            break;
+            return "WatchOS";
         case PLATFORM_BRIDGEOS:
-            ret->platform = "BridgeOS";
-            break;
+            return "BridgeOS";
         case PLATFORM_MACCATALYST:
-            ret->platform = "macOS Catalyst";
-            break;
+            return "macOS Catalyst";
         case PLATFORM_IOSSIMULATOR:
-            ret->platform = "iOS Simulator";
-            break;
+            return "iOS Simulator";
         case PLATFORM_TVOSSIMULATOR:
-            ret->platform = "TvOS Simulator";
-            break;
+            return "TvOS Simulator";
         case PLATFORM_WATCHOSSIMULATOR:
-            ret->platform = "WatchOS Simulator";
-            break;
+            return "WatchOS Simulator";
         case PLATFORM_DRIVERKIT:
-            ret->platform = "DriverKit";
-            break;
+            return "DriverKit";
         default:
-            ret->platform = "(null)";
-            break;
+            return "(null)";
     }
+}
+
+
+///////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////
+
+mach_build_version_info_t *mach_lc_build_version_info (mach_build_version_command_t *bvc, off_t offset, macho_t *macho)
+{
+    mach_build_version_info_t *ret = malloc (sizeof(mach_build_version_info_t));
+
+    // platform
+    ret->platform = mach_lc_platform_string (bvc->platform);
 
     // minos
     char *minos_tmp = malloc (10);
@@ -579,25 +416,7 @@ char *mach_lc_load_str (macho_t *macho, uint32_t cmdsize, uint32_t struct_size,
  */
 mach_uuid_command_t *mach_lc_find_uuid_cmd (macho_t *macho)
 {
-    size_t size = sizeof (mach_uuid_command_t);
-    mach_uuid_command_t *ret = malloc (size);
-
-    HSList *cmds = macho->lcmds;
-    for (int i = 0; i < h_slist_length (cmds); i++) {
-        mach_command_info_t *tmp = (mach_command_info_t *) h_slist_nth_data (cmds, i);
-        if (tmp->type == LC_UUID) {
-            ret = (mach_uuid_command_t *) macho_load_bytes (macho, size, tmp->offset);
-            
-            if (!ret) {
-                debugf ("[*] Error: Failed to load LC_UUID command from offset: 0x%llx\n");
-                return NULL;
-            } else {
-                return ret;
-            }
-        }
-    }
-
-    return NULL;
+    return mach_lc_copy_checked (macho, LC_UUID, sizeof (mach_uuid_command_t));
 }
 
 
@@ -639,17 +458,19 @@ char *mach_lc_uuid_string (mach_uuid_command_t *uuid)
 ///////////////////////////////////////////////////////////////
 
 /**
+ *  Function:   mach_lc_find_symtab_cmd
+ *  -----------------------------------
+ * 
+ *  Finds the LC_SYMTAB command of a given macho and copies it into a mach_symtab_command_t.
+ * 
+ *  macho:      The Mach-O file containing an LC_SYMTAB command.
+ * 
+ *  returns:    The copied command, or NULL if there isn't a valid one.
  * 
  */
 mach_symtab_command_t *mach_lc_find_symtab_cmd (macho_t *macho)
 {
-    size_t size = sizeof (mach_symtab_command_t);
-    mach_symtab_command_t *ret = malloc (size);
-    
-    mach_command_info_t *cmdinfo = mach_lc_find_given_cmd (macho, LC_SYMTAB);
-    ret = (mach_symtab_command_t *) macho_load_bytes (macho, size, cmdinfo->offset);
-
-    return ret;
+    return mach_lc_copy_checked (macho, LC_SYMTAB, sizeof (mach_symtab_command_t));
 }
 
 
@@ -658,20 +479,122 @@ mach_symtab_command_t *mach_lc_find_symtab_cmd (macho_t *macho)
 
 
 /**
+ *  Function:   mach_lc_find_dysymtab_cmd
+ *  -------------------------------------
+ * 
+ *  Finds the LC_DYSYMTAB command of a given macho and copies it into a mach_dysymtab_command_t.
+ * 
+ *  macho:      The Mach-O file containing an LC_DYSYMTAB command.
+ * 
+ *  returns:    The copied command, or NULL if there isn't a valid one.
  * 
  */
 mach_dysymtab_command_t *mach_lc_find_dysymtab_cmd (macho_t *macho)
 {
-    size_t size = sizeof (mach_dysymtab_command_t);
-    mach_dysymtab_command_t *ret = malloc (size);
-    
-    mach_command_info_t *cmdinfo = mach_lc_find_given_cmd (macho, LC_SYMTAB);
-    ret = (mach_dysymtab_command_t *) macho_load_bytes (macho, size, cmdinfo->offset);
+    return mach_lc_copy_checked (macho, LC_DYSYMTAB, sizeof (mach_dysymtab_command_t));
+}
 
-    debugf ("LC_DYSYMTAB: %d\n", LC_DYSYMTAB);
-    debugf ("test symtab: 0x%llx\n", ret->cmdsize);
 
-    return ret;
+///////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////
+
+/**
+ *  Function:   mach_lc_load_function_starts
+ *  ----------------------------------------
+ *
+ *  Decodes the LC_FUNCTION_STARTS table into an array of function start
+ *  addresses, in the order they appear in the table (ascending).
+ *
+ *  macho:      The Mach-O containing an LC_FUNCTION_STARTS command.
+ *  count:      Set to the number of addresses returned.
+ *
+ *  returns:    An allocated array of VM addresses, or NULL if there is no
+ *              function starts table.
+ *
+ */
+uint64_t *mach_lc_load_function_starts (macho_t *macho, uint32_t *count)
+{
+    *count = 0;
+
+    mach_command_info_t *cmdinfo = mach_lc_find_given_cmd (macho, LC_FUNCTION_STARTS);
+    if (!cmdinfo)
+        return NULL;
+
+    mach_linkedit_data_command_t cmd;
+    memcpy (&cmd, macho->data + cmdinfo->offset, sizeof (mach_linkedit_data_command_t));
+
+    if ((uint64_t) cmd.dataoff + cmd.datasize > macho->size) {
+        errorf ("LC_FUNCTION_STARTS data lies outside of the file\n");
+        return NULL;
+    }
+
+    // Offsets are relative to the segment that maps the start of the file
+    uint64_t addr = mach_offset_to_vmaddr (macho, 0);
+    if (addr == MACH_ADDR_INVALID)
+        addr = 0;
+
+    const uint8_t *p = macho->data + cmd.dataoff;
+    const uint8_t *end = p + cmd.datasize;
+
+    // Every entry is at least one byte, so datasize bounds the count
+    uint64_t *starts = malloc (sizeof (uint64_t) * (cmd.datasize + 1));
+    uint32_t n = 0;
+
+    while (p < end) {
+        uint64_t delta = mach_read_uleb128 (&p, end);
+        if (!delta)
+            break;
+        addr += delta;
+        starts[n++] = addr;
+    }
+
+    if (!n) {
+        free (starts);
+        return NULL;
+    }
+
+    *count = n;
+    return starts;
+}
+
+
+/**
+ *  Function:   mach_lc_load_data_in_code
+ *  -------------------------------------
+ *
+ *  Copies the LC_DATA_IN_CODE entries of a Mach-O into an array.
+ *
+ *  macho:      The Mach-O containing an LC_DATA_IN_CODE command.
+ *  count:      Set to the number of entries returned.
+ *
+ *  returns:    An allocated array of entries, or NULL if there are none.
+ *
+ */
+mach_data_in_code_entry_t *mach_lc_load_data_in_code (macho_t *macho, uint32_t *count)
+{
+    *count = 0;
+
+    mach_command_info_t *cmdinfo = mach_lc_find_given_cmd (macho, LC_DATA_IN_CODE);
+    if (!cmdinfo)
+        return NULL;
+
+    mach_linkedit_data_command_t cmd;
+    memcpy (&cmd, macho->data + cmdinfo->offset, sizeof (mach_linkedit_data_command_t));
+
+    if ((uint64_t) cmd.dataoff + cmd.datasize > macho->size) {
+        errorf ("LC_DATA_IN_CODE data lies outside of the file\n");
+        return NULL;
+    }
+
+    uint32_t n = cmd.datasize / sizeof (mach_data_in_code_entry_t);
+    if (!n)
+        return NULL;
+
+    mach_data_in_code_entry_t *entries = malloc (sizeof (mach_data_in_code_entry_t) * n);
+    memcpy (entries, macho->data + cmd.dataoff, sizeof (mach_data_in_code_entry_t) * n);
+
+    *count = n;
+    return entries;
 }
 
 
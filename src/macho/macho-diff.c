@@ -0,0 +1,545 @@
+//===---------------------------- macho_diff --------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include <stddef.h>
+
+#include "libhelper-macho/macho-diff.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-exports.h"
+#include "libhelper-macho/macho-symbol.h"
+#include "libhelper/hhash.h"
+#include "libhelper/hparallel.h"
+
+
+/**
+ *  Every category is flattened into an array of these before comparing.
+ *  `name` is only borrowed for the duration of the diff, and `hash`
+ *  covers whatever should be considered a change for that category.
+ */
+typedef struct diff_entry_t {
+    char        *name;
+    uint64_t     size;
+    uint64_t     hash;
+    int          owned;         // name was allocated for the entry
+} diff_entry_t;
+
+typedef struct diff_set_t {
+    diff_entry_t    *entries;
+    uint32_t         count;
+    uint32_t         cap;
+} diff_set_t;
+
+
+static void diff_set_add (diff_set_t *set, char *name, uint64_t size, uint64_t hash, int owned)
+{
+    if (set->count == set->cap) {
+        set->cap = set->cap ? set->cap * 2 : 32;
+        set->entries = realloc (set->entries, sizeof (diff_entry_t) * set->cap);
+    }
+    diff_entry_t *e = &set->entries[set->count++];
+    e->name = name;
+    e->size = size;
+    e->hash = hash;
+    e->owned = owned;
+}
+
+static void diff_set_free (diff_set_t *set)
+{
+    for (uint32_t i = 0; i < set->count; i++)
+        if (set->entries[i].owned) free (set->entries[i].name);
+    free (set->entries);
+    memset (set, '\0', sizeof (diff_set_t));
+}
+
+static char *diff_strndup (const char *s, size_t max)
+{
+    size_t len = 0;
+    while (len < max && s[len]) len++;
+
+    char *ret = malloc (len + 1);
+    memcpy (ret, s, len);
+    ret[len] = '\0';
+    return ret;
+}
+
+static uint64_t diff_hash_combine (uint64_t h, uint64_t v)
+{
+    return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Diff results                         									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void mach_diff_add_item (mach_diff_t *diff, uint32_t category, uint32_t kind,
+                                const char *name, uint64_t old_size, uint64_t new_size)
+{
+    if (diff->nitems == diff->capacity) {
+        diff->capacity = diff->capacity ? diff->capacity * 2 : 64;
+        diff->items = realloc (diff->items, sizeof (mach_diff_item_t) * diff->capacity);
+    }
+
+    mach_diff_item_t *item = &diff->items[diff->nitems++];
+    item->category = category;
+    item->kind = kind;
+    item->name = diff_strndup (name, (size_t) -1);
+    item->old_size = old_size;
+    item->new_size = new_size;
+
+    diff->counts[category][kind]++;
+}
+
+
+/**
+ *  Compares two sets by name. Items only in `a` are removed, items only in
+ *  `b` are added, and items in both with a different hash are changed. If
+ *  a name appears more than once in a set, only the first is compared.
+ */
+static void mach_diff_sets (mach_diff_t *diff, uint32_t category, diff_set_t *a, diff_set_t *b)
+{
+    HHashTable *ta = h_hash_table_sized_new (h_str_hash, h_str_equal, a->count);
+    HHashTable *tb = h_hash_table_sized_new (h_str_hash, h_str_equal, b->count);
+
+    for (uint32_t i = b->count; i > 0; i--)
+        h_hash_table_insert (tb, b->entries[i - 1].name, &b->entries[i - 1]);
+
+    for (uint32_t i = 0; i < a->count; i++) {
+        diff_entry_t *ea = &a->entries[i];
+        if (!h_hash_table_insert (ta, ea->name, ea))
+            continue;
+
+        diff_entry_t *eb = h_hash_table_lookup (tb, ea->name);
+        if (!eb)
+            mach_diff_add_item (diff, category, MACH_DIFF_REMOVED, ea->name, ea->size, 0);
+        else if (ea->hash != eb->hash)
+            mach_diff_add_item (diff, category, MACH_DIFF_CHANGED, ea->name, ea->size, eb->size);
+    }
+
+    for (uint32_t i = 0; i < b->count; i++) {
+        diff_entry_t *eb = &b->entries[i];
+        if (h_hash_table_lookup (tb, eb->name) != eb)
+            continue;
+        if (!h_hash_table_contains (ta, eb->name))
+            mach_diff_add_item (diff, category, MACH_DIFF_ADDED, eb->name, 0, eb->size);
+    }
+
+    h_hash_table_destroy (ta);
+    h_hash_table_destroy (tb);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Collecting items                     									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void diff_collect_load_commands (macho_t *macho, diff_set_t *set)
+{
+    // Count occurrences of each command type so repeated commands get a
+    // stable name, e.g. LC_LOAD_DYLIB#0, LC_LOAD_DYLIB#1.
+    HHashTable *seen = h_hash_table_new (h_direct_hash, h_direct_equal);
+
+    for (HSList *l = macho->lcmds; l; l = l->next) {
+        mach_command_info_t *info = (mach_command_info_t *) l->data;
+        mach_load_command_t *lc = info->lc;
+
+        if (!lc->cmd) continue;
+
+        uintptr_t n = (uintptr_t) h_hash_table_lookup (seen, (void *) (uintptr_t) lc->cmd);
+        h_hash_table_insert (seen, (void *) (uintptr_t) lc->cmd, (void *) (n + 1));
+
+        char *name = malloc (48);
+        char *type = mach_load_command_get_string (lc);
+        if (!strcmp (type, "LC_UNKNOWN"))
+            snprintf (name, 48, "LC_0x%x#%u", lc->cmd, (unsigned) n);
+        else
+            snprintf (name, 48, "%s#%u", type, (unsigned) n);
+
+        uint64_t size = lc->cmdsize;
+        if ((uint64_t) info->offset + size > macho->size)
+            size = macho->size - info->offset;
+
+        diff_set_add (set, name, lc->cmdsize, h_mem_hash (macho->data + info->offset, size), 1);
+    }
+
+    h_hash_table_destroy (seen);
+}
+
+
+static void diff_collect_segments (macho_t *macho, diff_set_t *segs, diff_set_t *sects)
+{
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        mach_segment_info_t *si = (mach_segment_info_t *) l->data;
+        mach_segment_command_64_t *seg = si->segcmd;
+
+        // The segment itself: compare the size and protections of the
+        // mapping, but not where it lives or what's in it
+        uint64_t h = diff_hash_combine (seg->vmsize, seg->filesize);
+        h = diff_hash_combine (h, ((uint64_t) seg->maxprot << 32) | (uint32_t) seg->initprot);
+        h = diff_hash_combine (h, ((uint64_t) seg->nsects << 32) | seg->flags);
+        diff_set_add (segs, diff_strndup (seg->segname, 16), seg->vmsize, h, 1);
+
+        for (HSList *s = si->sections; s; s = s->next) {
+            mach_section_64_t *sect = (mach_section_64_t *) s->data;
+
+            char *name = malloc (34);
+            snprintf (name, 34, "%.16s.%.16s", sect->segname, sect->sectname);
+
+            // Sections are compared by their content. Zerofill sections, or
+            // any that run outside the file, only compare by size and flags.
+            uint64_t h = diff_hash_combine (sect->size, sect->flags);
+            if (!MACH_SECTION_IS_ZEROFILL (sect->flags) && sect->offset &&
+                (uint64_t) sect->offset + sect->size <= macho->size)
+                h = diff_hash_combine (h, h_mem_hash (macho->data + sect->offset, sect->size));
+
+            diff_set_add (sects, name, sect->size, h, 1);
+        }
+    }
+}
+
+
+typedef struct sized_addr_t {
+    uint64_t    addr;
+    uint32_t    index;
+    uint32_t    group;          // n_sect, so sizes don't cross sections
+} sized_addr_t;
+
+static int sized_addr_compare (const void *x, const void *y)
+{
+    const sized_addr_t *a = x, *b = y;
+    if (a->group != b->group) return (a->group < b->group) ? -1 : 1;
+    if (a->addr != b->addr) return (a->addr < b->addr) ? -1 : 1;
+    return 0;
+}
+
+/**
+ *  Symbol tables and export tries don't record sizes, so approximate each
+ *  one as the distance to the next address in the same group. The last
+ *  address in a group is bounded by `group_end` when known.
+ */
+static void diff_approximate_sizes (sized_addr_t *addrs, uint32_t n, uint64_t *group_end, uint64_t *sizes)
+{
+    qsort (addrs, n, sizeof (sized_addr_t), sized_addr_compare);
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t end = 0;
+        if (i + 1 < n && addrs[i + 1].group == addrs[i].group)
+            end = addrs[i + 1].addr;
+        else if (group_end && addrs[i].group < 256)
+            end = group_end[addrs[i].group];
+
+        sizes[addrs[i].index] = (end > addrs[i].addr) ? end - addrs[i].addr : 0;
+    }
+}
+
+
+static void diff_collect_symbols (macho_t *macho, diff_set_t *set)
+{
+    uint32_t nsyms = 0;
+    mach_symbol_info_t *syms = mach_symtab_load_symbol_info (macho, &nsyms);
+    if (!syms) return;
+
+    // Section end addresses, indexed by n_sect (1-based)
+    uint64_t sect_end[256];
+    memset (sect_end, '\0', sizeof (sect_end));
+
+    int sect_index = 1;
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        mach_segment_info_t *si = (mach_segment_info_t *) l->data;
+        for (HSList *s = si->sections; s && sect_index < 256; s = s->next, sect_index++) {
+            mach_section_64_t *sect = (mach_section_64_t *) s->data;
+            sect_end[sect_index] = sect->addr + sect->size;
+        }
+    }
+
+    sized_addr_t *addrs = malloc (sizeof (sized_addr_t) * nsyms);
+    uint64_t *sizes = calloc (nsyms, sizeof (uint64_t));
+    uint32_t naddrs = 0;
+
+    for (uint32_t i = 0; i < nsyms; i++) {
+        if ((syms[i].type & N_STAB) || (syms[i].type & N_TYPE) != N_SECT)
+            continue;
+        addrs[naddrs].addr = syms[i].value;
+        addrs[naddrs].index = i;
+        addrs[naddrs].group = syms[i].sect;
+        naddrs++;
+    }
+    diff_approximate_sizes (addrs, naddrs, sect_end, sizes);
+
+    for (uint32_t i = 0; i < nsyms; i++) {
+        if (syms[i].type & N_STAB)
+            continue;
+        uint64_t h = diff_hash_combine (sizes[i], syms[i].type & ~N_PEXT);
+        diff_set_add (set, syms[i].name, sizes[i], h, 0);
+    }
+
+    free (addrs);
+    free (sizes);
+    free (syms);
+}
+
+
+static void diff_collect_dylibs (macho_t *macho, diff_set_t *set)
+{
+    for (HSList *l = macho->dylibs; l; l = l->next) {
+        mach_dylib_command_info_t *info = (mach_dylib_command_info_t *) l->data;
+
+        uint64_t h = diff_hash_combine (info->type, info->dylib->dylib.current_version);
+        h = diff_hash_combine (h, info->dylib->dylib.compatibility_version);
+
+        diff_set_add (set, info->name, info->dylib->cmdsize, h, 0);
+    }
+}
+
+
+/**
+ *  Exports are collected into the set with their names owned by the set,
+ *  so the export array itself can be released straight away.
+ */
+static void diff_collect_exports (macho_t *macho, diff_set_t *set)
+{
+    uint32_t nexports = 0;
+    mach_export_info_t *exports = mach_exports_load (macho, &nexports);
+    if (!exports) return;
+
+    sized_addr_t *addrs = malloc (sizeof (sized_addr_t) * nexports);
+    uint64_t *sizes = calloc (nexports, sizeof (uint64_t));
+    uint32_t naddrs = 0;
+
+    for (uint32_t i = 0; i < nexports; i++) {
+        if (exports[i].flags & EXPORT_SYMBOL_FLAGS_REEXPORT)
+            continue;
+        addrs[naddrs].addr = exports[i].address;
+        addrs[naddrs].index = i;
+        addrs[naddrs].group = exports[i].flags & EXPORT_SYMBOL_FLAGS_KIND_MASK;
+        naddrs++;
+    }
+    diff_approximate_sizes (addrs, naddrs, NULL, sizes);
+
+    for (uint32_t i = 0; i < nexports; i++) {
+        uint64_t h = diff_hash_combine (exports[i].flags, sizes[i]);
+        if (exports[i].flags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
+            h = diff_hash_combine (h, exports[i].other);
+            if (exports[i].import_name)
+                h = diff_hash_combine (h, h_str_hash (exports[i].import_name));
+        }
+        diff_set_add (set, exports[i].name, sizes[i], h, 1);
+        exports[i].name = NULL;
+    }
+
+    free (addrs);
+    free (sizes);
+    mach_exports_free (exports, nexports);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Public API                           									 --*/
+//===-----------------------------------------------------------------------===//
+
+
+/**
+ *  Function:   mach_diff
+ *  ---------------------
+ *
+ *  Structurally compares two Mach-O's. `a` is treated as the old file and
+ *  `b` as the new one. Either may be NULL, in which case the result is a
+ *  single header item marking the whole file as added or removed.
+ *
+ *  a:          The old Mach-O.
+ *  b:          The new Mach-O.
+ *
+ *  returns:    An allocated mach_diff_t, free with mach_diff_free().
+ *
+ */
+mach_diff_t *mach_diff (macho_t *a, macho_t *b)
+{
+    mach_diff_t *diff = calloc (1, sizeof (mach_diff_t));
+
+    if (!a || !b) {
+        if (a)
+            mach_diff_add_item (diff, MACH_DIFF_HEADER, MACH_DIFF_REMOVED, a->path ? a->path : "(null)", a->size, 0);
+        else if (b)
+            mach_diff_add_item (diff, MACH_DIFF_HEADER, MACH_DIFF_ADDED, b->path ? b->path : "(null)", 0, b->size);
+        return diff;
+    }
+
+    // Header. The reserved field isn't present in 32-bit headers.
+    size_t hsize = offsetof (mach_header_t, reserved);
+    if (memcmp (a->header, b->header, hsize))
+        mach_diff_add_item (diff, MACH_DIFF_HEADER, MACH_DIFF_CHANGED, "mach_header",
+                            a->header->sizeofcmds, b->header->sizeofcmds);
+
+    diff_set_t sa, sb, sa2, sb2;
+    memset (&sa, '\0', sizeof (diff_set_t));
+    memset (&sb, '\0', sizeof (diff_set_t));
+    memset (&sa2, '\0', sizeof (diff_set_t));
+    memset (&sb2, '\0', sizeof (diff_set_t));
+
+    // Load commands
+    diff_collect_load_commands (a, &sa);
+    diff_collect_load_commands (b, &sb);
+    mach_diff_sets (diff, MACH_DIFF_LOAD_COMMAND, &sa, &sb);
+    diff_set_free (&sa);
+    diff_set_free (&sb);
+
+    // Segments & sections
+    diff_collect_segments (a, &sa, &sa2);
+    diff_collect_segments (b, &sb, &sb2);
+    mach_diff_sets (diff, MACH_DIFF_SEGMENT, &sa, &sb);
+    mach_diff_sets (diff, MACH_DIFF_SECTION, &sa2, &sb2);
+    diff_set_free (&sa);
+    diff_set_free (&sb);
+    diff_set_free (&sa2);
+    diff_set_free (&sb2);
+
+    // Symbols
+    diff_collect_symbols (a, &sa);
+    diff_collect_symbols (b, &sb);
+    mach_diff_sets (diff, MACH_DIFF_SYMBOL, &sa, &sb);
+    diff_set_free (&sa);
+    diff_set_free (&sb);
+
+    // Dylibs
+    diff_collect_dylibs (a, &sa);
+    diff_collect_dylibs (b, &sb);
+    mach_diff_sets (diff, MACH_DIFF_DYLIB, &sa, &sb);
+    diff_set_free (&sa);
+    diff_set_free (&sb);
+
+    // Exports
+    diff_collect_exports (a, &sa);
+    diff_collect_exports (b, &sb);
+    mach_diff_sets (diff, MACH_DIFF_EXPORT, &sa, &sb);
+    diff_set_free (&sa);
+    diff_set_free (&sb);
+
+    return diff;
+}
+
+
+static void mach_diff_batch_worker (size_t index, void *user_data)
+{
+    mach_diff_pair_t *pairs = (mach_diff_pair_t *) user_data;
+    pairs[index].diff = mach_diff (pairs[index].a, pairs[index].b);
+}
+
+
+/**
+ *  Function:   mach_diff_batch
+ *  ---------------------------
+ *
+ *  Diffs each pair in `pairs` in parallel, storing the result in the
+ *  pair's `diff` field. The Mach-O's are only read, so the same macho_t
+ *  may safely appear in more than one pair.
+ *
+ *  pairs:      Array of pairs to compare.
+ *  count:      Number of pairs.
+ *  nthreads:   Number of threads to use, or 0 for one per CPU.
+ *
+ */
+void mach_diff_batch (mach_diff_pair_t *pairs, size_t count, int nthreads)
+{
+    h_parallel_for (count, nthreads, mach_diff_batch_worker, pairs);
+}
+
+
+void mach_diff_free (mach_diff_t *diff)
+{
+    if (!diff) return;
+    for (uint32_t i = 0; i < diff->nitems; i++)
+        free (diff->items[i].name);
+    free (diff->items);
+    free (diff);
+}
+
+
+char *mach_diff_kind_string (uint32_t kind)
+{
+    switch (kind) {
+        case MACH_DIFF_ADDED:
+            return "added";
+        case MACH_DIFF_REMOVED:
+            return "removed";
+        case MACH_DIFF_CHANGED:
+            return "changed";
+        default:
+            return "unknown";
+    }
+}
+
+
+char *mach_diff_category_string (uint32_t category)
+{
+    switch (category) {
+        case MACH_DIFF_HEADER:
+            return "Header";
+        case MACH_DIFF_LOAD_COMMAND:
+            return "Load Command";
+        case MACH_DIFF_SEGMENT:
+            return "Segment";
+        case MACH_DIFF_SECTION:
+            return "Section";
+        case MACH_DIFF_SYMBOL:
+            return "Symbol";
+        case MACH_DIFF_DYLIB:
+            return "Dylib";
+        case MACH_DIFF_EXPORT:
+            return "Export";
+        default:
+            return "Unknown";
+    }
+}
+
+
+/**
+ *  Function:   mach_diff_print
+ *  ---------------------------
+ *
+ *  Prints a summary of each category, followed by every item.
+ *
+ */
+void mach_diff_print (mach_diff_t *diff)
+{
+    printf ("==================\nMach-O Diff\n==================\n\n");
+
+    for (int c = 0; c < MACH_DIFF_CATEGORY_COUNT; c++) {
+        printf ("%-14s\t+%u -%u ~%u\n", mach_diff_category_string (c),
+                diff->counts[c][MACH_DIFF_ADDED], diff->counts[c][MACH_DIFF_REMOVED],
+                diff->counts[c][MACH_DIFF_CHANGED]);
+    }
+    printf ("------------------\n\n");
+
+    for (uint32_t i = 0; i < diff->nitems; i++) {
+        mach_diff_item_t *item = &diff->items[i];
+        char mark = (item->kind == MACH_DIFF_ADDED) ? '+' : (item->kind == MACH_DIFF_REMOVED) ? '-' : '~';
+
+        printf ("%c %-12s %s", mark, mach_diff_category_string (item->category), item->name);
+        if (item->kind == MACH_DIFF_CHANGED)
+            printf ("\t(%llu -> %llu bytes)\n", (unsigned long long) item->old_size, (unsigned long long) item->new_size);
+        else
+            printf ("\t(%llu bytes)\n", (unsigned long long) (item->old_size ? item->old_size : item->new_size));
+    }
+}
@@ -0,0 +1,213 @@
+//===--------------------------- macho_entropy ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper-macho/macho-entropy.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper/hparallel.h"
+
+// Sections are split into chunks of this size, so one large section
+// (e.g. a kernelcache's __PRELINK_TEXT) still spreads across threads
+#define ENTROPY_CHUNK       (4UL << 20)
+
+
+typedef struct entropy_chunk_t {
+    const uint8_t   *data;
+    size_t           len;
+    uint32_t         section;
+    uint64_t         hist[256];
+} entropy_chunk_t;
+
+static void entropy_chunk_worker (size_t index, void *user_data)
+{
+    entropy_chunk_t *chunk = &((entropy_chunk_t *) user_data)[index];
+    h_byte_histogram (chunk->data, chunk->len, chunk->hist);
+}
+
+
+/**
+ *  Function:   mach_entropy_sections
+ *  ---------------------------------
+ *
+ *  Computes the byte histogram and entropy of every section in a Mach-O.
+ *
+ *  macho:      The Mach-O.
+ *  nthreads:   Number of threads to use, or 0 for one per CPU.
+ *  count:      Set to the number of sections returned.
+ *
+ *  returns:    An allocated array of section entropies, in load command
+ *              order, or NULL if there are no sections.
+ *
+ */
+mach_section_entropy_t *mach_entropy_sections (macho_t *macho, int nthreads, uint32_t *count)
+{
+    *count = 0;
+
+    uint32_t nsects = 0;
+    uint64_t nchunks = 0;
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        for (HSList *s = ((mach_segment_info_t *) l->data)->sections; s; s = s->next) {
+            mach_section_64_t *sect = (mach_section_64_t *) s->data;
+            nchunks += (sect->size + ENTROPY_CHUNK - 1) / ENTROPY_CHUNK;
+            nsects++;
+        }
+    }
+    if (!nsects)
+        return NULL;
+
+    mach_section_entropy_t *ret = calloc (nsects, sizeof (mach_section_entropy_t));
+    entropy_chunk_t *chunks = calloc (nchunks + 1, sizeof (entropy_chunk_t));
+    size_t n = 0;
+
+    uint32_t i = 0;
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        for (HSList *s = ((mach_segment_info_t *) l->data)->sections; s; s = s->next, i++) {
+            mach_section_64_t *sect = (mach_section_64_t *) s->data;
+            mach_section_entropy_t *e = &ret[i];
+
+            memcpy (e->segname, sect->segname, 16);
+            memcpy (e->sectname, sect->sectname, 16);
+            e->addr = sect->addr;
+            e->offset = sect->offset;
+            e->size = sect->size;
+            e->entropy = -1.0;
+
+            if (MACH_SECTION_IS_ZEROFILL (sect->flags) || !sect->size ||
+                (uint64_t) sect->offset + sect->size > macho->size)
+                continue;
+
+            e->entropy = 0.0;
+            for (uint64_t off = 0; off < sect->size; off += ENTROPY_CHUNK) {
+                chunks[n].data = macho->data + sect->offset + off;
+                chunks[n].len = (sect->size - off > ENTROPY_CHUNK) ? ENTROPY_CHUNK : sect->size - off;
+                chunks[n].section = i;
+                n++;
+            }
+        }
+    }
+
+    h_parallel_for (n, nthreads, entropy_chunk_worker, chunks);
+
+    for (size_t c = 0; c < n; c++)
+        for (int b = 0; b < 256; b++)
+            ret[chunks[c].section].hist[b] += chunks[c].hist[b];
+
+    for (i = 0; i < nsects; i++)
+        if (ret[i].entropy == 0.0)
+            ret[i].entropy = h_entropy_from_histogram (ret[i].hist, ret[i].size);
+
+    free (chunks);
+    *count = nsects;
+    return ret;
+}
+
+
+/**
+ *  Function:   mach_entropy_range
+ *  ------------------------------
+ *
+ *  Computes the entropy of a range of the file.
+ *
+ *  macho:      The Mach-O.
+ *  offset:     File offset of the range.
+ *  size:       Size of the range.
+ *  nthreads:   Number of threads to use, or 0 for one per CPU.
+ *
+ *  returns:    Entropy in bits per byte, or -1 if the range is outside of
+ *              the file.
+ *
+ */
+double mach_entropy_range (macho_t *macho, uint64_t offset, uint64_t size, int nthreads)
+{
+    if (!size || offset > macho->size || size > macho->size - offset)
+        return -1.0;
+
+    uint64_t hist[256];
+    memset (hist, '\0', sizeof (hist));
+    h_byte_histogram_parallel (macho->data + offset, size, hist, nthreads);
+
+    return h_entropy_from_histogram (hist, size);
+}
+
+
+/**
+ *  Function:   mach_entropy_encrypted_range
+ *  ----------------------------------------
+ *
+ *  Computes the entropy of the range described by LC_ENCRYPTION_INFO or
+ *  LC_ENCRYPTION_INFO_64. An encrypted range should be close to 8.0; a
+ *  much lower value means it has already been decrypted.
+ *
+ *  returns:    Entropy in bits per byte, or -1 if there is no encryption
+ *              info or the range is outside of the file.
+ *
+ */
+double mach_entropy_encrypted_range (macho_t *macho, int nthreads)
+{
+    mach_command_info_t *info = mach_lc_find_given_cmd (macho, LC_ENCRYPTION_INFO_64);
+    if (!info)
+        info = mach_lc_find_given_cmd (macho, LC_ENCRYPTION_INFO);
+    if (!info || (uint64_t) info->offset + 16 > macho->size)
+        return -1.0;
+
+    // cryptoff and cryptsize sit at the same place in both versions
+    mach_crypto_command_64_t cmd;
+    memset (&cmd, '\0', sizeof (cmd));
+    memcpy (&cmd, macho->data + info->offset, 16);
+
+    return mach_entropy_range (macho, cmd.cryptoff, cmd.cryptsize, nthreads);
+}
+
+
+/**
+ *  Function:   mach_entropy_profile
+ *  --------------------------------
+ *
+ *  Computes the entropy over a sliding window across the whole file. The
+ *  n'th value covers the `window` bytes starting at n * `step`.
+ *
+ *  returns:    An allocated array of `*count` values.
+ *
+ */
+double *mach_entropy_profile (macho_t *macho, size_t window, size_t step, int nthreads, size_t *count)
+{
+    return h_entropy_windows (macho->data, macho->size, window, step, nthreads, count);
+}
+
+
+void mach_entropy_sections_print (mach_section_entropy_t *sects, uint32_t count)
+{
+    printf ("==================\nSection Entropy\n==================\n\n");
+
+    for (uint32_t i = 0; i < count; i++) {
+        mach_section_entropy_t *e = &sects[i];
+        printf ("%-16s %-16s 0x%016llx  %10llu  ", e->segname, e->sectname,
+                (unsigned long long) e->addr, (unsigned long long) e->size);
+
+        if (e->entropy < 0.0)
+            printf ("   -\n");
+        else
+            printf ("%.3f\n", e->entropy);
+    }
+}
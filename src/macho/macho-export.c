@@ -0,0 +1,548 @@
+//===--------------------------- macho_export -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "libhelper-macho/macho-export.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-segment.h"
+#include "libhelper-macho/macho-symbol.h"
+#include "libhelper/hparallel.h"
+
+// Room for a record's fixed fields, strings are reserved on top of this
+#define EXPORT_RECORD_SIZE      1024
+#define EXPORT_MAX_TOOLS        64
+
+// Files loaded per round of mach_export_files(), per thread
+#define EXPORT_FILES_PER_THREAD 4
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Records                              									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  A record being written. `export_begin()` reserves room for the whole
+ *  record, so the field writers just advance `p` without checking, and
+ *  `export_end()` commits it.
+ */
+typedef struct export_rec_t {
+    h_writer_t      *w;
+    int              format;
+    char            *start;
+    char            *p;
+} export_rec_t;
+
+static const char export_hex_digits[] = "0123456789abcdef";
+
+
+static inline char *export_put_le (char *p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++, v >>= 8)
+        *p++ = (char) (v & 0xff);
+    return p;
+}
+
+static inline char *export_put_dec (char *p, uint64_t v)
+{
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char) ('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n)
+        *p++ = tmp[--n];
+    return p;
+}
+
+/**
+ *  Room a JSON string of `len` bytes needs, with every byte escaped.
+ */
+static inline size_t export_str_bound (size_t len)
+{
+    return len * 6 + 32;
+}
+
+
+static void export_begin (export_rec_t *rec, h_writer_t *w, int format, int type,
+                          const char *name, size_t extra)
+{
+    rec->w = w;
+    rec->format = format;
+    rec->start = rec->p = h_writer_reserve (w, EXPORT_RECORD_SIZE + extra);
+
+    if (format == MACH_EXPORT_BINARY) {
+        // The length is filled in by export_end()
+        rec->p += 4;
+        *rec->p++ = (char) type;
+    } else {
+        size_t n = strlen (name);
+        memcpy (rec->p, "{\"type\":\"", 9);
+        memcpy (rec->p + 9, name, n);
+        rec->p[9 + n] = '"';
+        rec->p += 10 + n;
+    }
+}
+
+static void export_end (export_rec_t *rec)
+{
+    if (rec->format == MACH_EXPORT_BINARY) {
+        export_put_le (rec->start, (uint64_t) (rec->p - rec->start - 4), 4);
+    } else {
+        *rec->p++ = '}';
+        *rec->p++ = '\n';
+    }
+    h_writer_commit (rec->w, rec->p - rec->start);
+}
+
+static inline void export_key (export_rec_t *rec, const char *key)
+{
+    size_t n = strlen (key);
+    *rec->p++ = ',';
+    *rec->p++ = '"';
+    memcpy (rec->p, key, n);
+    rec->p += n;
+    *rec->p++ = '"';
+    *rec->p++ = ':';
+}
+
+/**
+ *  Field writers. In binary, `export_int()` writes `bytes` bytes and
+ *  `export_hex()` and `export_version()` 8 and 4. In JSON they write a
+ *  number, a "0x..." string and an "X.Y.Z" string.
+ */
+static void export_int (export_rec_t *rec, const char *key, uint64_t v, int bytes)
+{
+    if (rec->format == MACH_EXPORT_BINARY) {
+        rec->p = export_put_le (rec->p, v, bytes);
+        return;
+    }
+    export_key (rec, key);
+    rec->p = export_put_dec (rec->p, v);
+}
+
+static void export_hex (export_rec_t *rec, const char *key, uint64_t v)
+{
+    if (rec->format == MACH_EXPORT_BINARY) {
+        rec->p = export_put_le (rec->p, v, 8);
+        return;
+    }
+    export_key (rec, key);
+
+    int digits = 1;
+    while (digits < 16 && (v >> (digits * 4)))
+        digits++;
+
+    memcpy (rec->p, "\"0x", 3);
+    rec->p += 3;
+    for (int i = digits - 1; i >= 0; i--)
+        *rec->p++ = export_hex_digits[(v >> (i * 4)) & 0xf];
+    *rec->p++ = '"';
+}
+
+static char *export_put_version (char *p, uint32_t v)
+{
+    *p++ = '"';
+    p = export_put_dec (p, v >> 16);
+    *p++ = '.';
+    p = export_put_dec (p, (v >> 8) & 0xff);
+    *p++ = '.';
+    p = export_put_dec (p, v & 0xff);
+    *p++ = '"';
+    return p;
+}
+
+static void export_version (export_rec_t *rec, const char *key, uint32_t v)
+{
+    if (rec->format == MACH_EXPORT_BINARY) {
+        rec->p = export_put_le (rec->p, v, 4);
+        return;
+    }
+    export_key (rec, key);
+    rec->p = export_put_version (rec->p, v);
+}
+
+/**
+ *  Strings must have had export_str_bound() reserved for them. Bytes
+ *  from 0x80 up are passed through, as names are expected to be UTF-8.
+ */
+static void export_str (export_rec_t *rec, const char *key, const char *str, size_t len)
+{
+    if (rec->format == MACH_EXPORT_BINARY) {
+        rec->p = export_put_le (rec->p, len, 4);
+        memcpy (rec->p, str, len);
+        rec->p += len;
+        return;
+    }
+    export_key (rec, key);
+
+    char *p = rec->p;
+    *p++ = '"';
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) str[i];
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = (char) c;
+        } else if (c < 0x20) {
+            memcpy (p, "\\u00", 4);
+            p[4] = export_hex_digits[c >> 4];
+            p[5] = export_hex_digits[c & 0xf];
+            p += 6;
+        } else {
+            *p++ = (char) c;
+        }
+    }
+    *p++ = '"';
+    rec->p = p;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Mach-O                               									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void export_header (h_writer_t *w, macho_t *macho, int format)
+{
+    mach_header_t *hdr = macho->header;
+    const char *path = (macho->path) ? macho->path : "";
+    size_t plen = strlen (path);
+
+    export_rec_t rec;
+    export_begin (&rec, w, format, MACH_EXPORT_REC_MACHO, "macho", export_str_bound (plen));
+    export_str (&rec, "path", path, plen);
+    export_int (&rec, "magic", hdr->magic, 4);
+    export_int (&rec, "cputype", (uint32_t) hdr->cputype, 4);
+    export_int (&rec, "cpusubtype", (uint32_t) hdr->cpusubtype, 4);
+    export_int (&rec, "filetype", hdr->filetype, 4);
+    export_int (&rec, "ncmds", hdr->ncmds, 4);
+    export_int (&rec, "sizeofcmds", hdr->sizeofcmds, 4);
+    export_int (&rec, "flags", hdr->flags, 4);
+    export_int (&rec, "size", macho->size, 8);
+    export_end (&rec);
+}
+
+
+static void export_build_version (h_writer_t *w, int format, uint32_t platform, uint32_t minos,
+                                  uint32_t sdk, const uint8_t *tools, uint32_t ntools)
+{
+    export_rec_t rec;
+    export_begin (&rec, w, format, MACH_EXPORT_REC_BUILD_VERSION, "build_version", ntools * 64);
+    export_int (&rec, "platform", platform, 4);
+    export_version (&rec, "minos", minos);
+    export_version (&rec, "sdk", sdk);
+
+    if (format == MACH_EXPORT_BINARY) {
+        rec.p = export_put_le (rec.p, ntools, 4);
+        memcpy (rec.p, tools, ntools * sizeof (struct build_tool_version));
+        rec.p += ntools * sizeof (struct build_tool_version);
+    } else {
+        export_key (&rec, "tools");
+        *rec.p++ = '[';
+        for (uint32_t i = 0; i < ntools; i++) {
+            struct build_tool_version tool;
+            memcpy (&tool, tools + i * sizeof (tool), sizeof (tool));
+
+            memcpy (rec.p, (i) ? ",{\"tool\":" : "{\"tool\":", (i) ? 9 : 8);
+            rec.p += (i) ? 9 : 8;
+            rec.p = export_put_dec (rec.p, tool.tool);
+            memcpy (rec.p, ",\"version\":", 11);
+            rec.p = export_put_version (rec.p + 11, tool.version);
+            *rec.p++ = '}';
+        }
+        *rec.p++ = ']';
+    }
+    export_end (&rec);
+}
+
+
+/**
+ *  One record per load command, straight from the load command area, as
+ *  macho->lcmds leaves the segments out. The walk stops at the first
+ *  command that runs past sizeofcmds or the file. The build version is
+ *  written after the walk, from LC_BUILD_VERSION or, without one, the
+ *  first LC_VERSION_MIN_*.
+ */
+static void export_load_commands (h_writer_t *w, macho_t *macho, int format)
+{
+    uint64_t off = sizeof (mach_header_t);
+    uint64_t end = off + macho->header->sizeofcmds;
+    if (end > macho->size)
+        end = macho->size;
+
+    const uint8_t *bv = NULL, *vmin = NULL;
+
+    for (uint32_t i = 0; i < macho->header->ncmds && off + sizeof (mach_load_command_t) <= end; i++) {
+        mach_load_command_t lc;
+        memcpy (&lc, macho->data + off, sizeof (mach_load_command_t));
+        if (lc.cmdsize < sizeof (mach_load_command_t) || lc.cmdsize > end - off)
+            break;
+
+        const char *name = (lc.cmd) ? mach_load_command_get_string (&lc) : "";
+        size_t nlen = strlen (name);
+
+        export_rec_t rec;
+        export_begin (&rec, w, format, MACH_EXPORT_REC_LOAD_COMMAND, "load_command", export_str_bound (nlen));
+        export_int (&rec, "index", i, 4);
+        export_int (&rec, "cmd", lc.cmd, 4);
+        if (format != MACH_EXPORT_BINARY)
+            export_str (&rec, "name", name, nlen);
+        export_int (&rec, "cmdsize", lc.cmdsize, 4);
+        export_int (&rec, "offset", off, 4);
+        export_end (&rec);
+
+        if (lc.cmd == LC_BUILD_VERSION && !bv && lc.cmdsize >= sizeof (mach_build_version_command_t))
+            bv = macho->data + off;
+        else if ((lc.cmd == LC_VERSION_MIN_MACOSX || lc.cmd == LC_VERSION_MIN_IPHONEOS ||
+                  lc.cmd == LC_VERSION_MIN_TVOS || lc.cmd == LC_VERSION_MIN_WATCHOS) &&
+                 !vmin && lc.cmdsize >= sizeof (mach_version_min_command_t))
+            vmin = macho->data + off;
+
+        off += lc.cmdsize;
+    }
+
+    if (bv) {
+        mach_build_version_command_t cmd;
+        memcpy (&cmd, bv, sizeof (mach_build_version_command_t));
+
+        uint32_t room = (cmd.cmdsize - sizeof (mach_build_version_command_t)) / sizeof (struct build_tool_version);
+        uint32_t ntools = (cmd.ntools < room) ? cmd.ntools : room;
+        if (ntools > EXPORT_MAX_TOOLS)
+            ntools = EXPORT_MAX_TOOLS;
+
+        export_build_version (w, format, cmd.platform, cmd.minos, cmd.sdk,
+                              bv + sizeof (mach_build_version_command_t), ntools);
+    } else if (vmin) {
+        mach_version_min_command_t cmd;
+        memcpy (&cmd, vmin, sizeof (mach_version_min_command_t));
+
+        uint32_t platform = (cmd.cmd == LC_VERSION_MIN_MACOSX) ? PLATFORM_MACOS :
+                            (cmd.cmd == LC_VERSION_MIN_IPHONEOS) ? PLATFORM_IOS :
+                            (cmd.cmd == LC_VERSION_MIN_TVOS) ? PLATFORM_TVOS : PLATFORM_WATCHOS;
+        export_build_version (w, format, platform, cmd.version, cmd.sdk, NULL, 0);
+    }
+}
+
+
+static void export_segments (h_writer_t *w, macho_t *macho, int format)
+{
+    for (HSList *s = macho->scmds; s; s = s->next) {
+        mach_segment_info_t *info = (mach_segment_info_t *) s->data;
+        mach_segment_command_64_t *seg = info->segcmd;
+        size_t slen = strnlen (seg->segname, sizeof (seg->segname));
+
+        export_rec_t rec;
+        export_begin (&rec, w, format, MACH_EXPORT_REC_SEGMENT, "segment", export_str_bound (slen));
+        export_str (&rec, "name", seg->segname, slen);
+        export_hex (&rec, "vmaddr", seg->vmaddr);
+        export_hex (&rec, "vmsize", seg->vmsize);
+        export_hex (&rec, "fileoff", seg->fileoff);
+        export_hex (&rec, "filesize", seg->filesize);
+        export_int (&rec, "maxprot", (uint32_t) seg->maxprot, 4);
+        export_int (&rec, "initprot", (uint32_t) seg->initprot, 4);
+        export_int (&rec, "nsects", seg->nsects, 4);
+        export_int (&rec, "flags", seg->flags, 4);
+        export_end (&rec);
+
+        for (HSList *l = info->sections; l; l = l->next) {
+            mach_section_64_t *sect = (mach_section_64_t *) l->data;
+            size_t seglen = strnlen (sect->segname, sizeof (sect->segname));
+            size_t nlen = strnlen (sect->sectname, sizeof (sect->sectname));
+
+            export_begin (&rec, w, format, MACH_EXPORT_REC_SECTION, "section",
+                          export_str_bound (seglen) + export_str_bound (nlen));
+            export_str (&rec, "segment", sect->segname, seglen);
+            export_str (&rec, "name", sect->sectname, nlen);
+            export_hex (&rec, "addr", sect->addr);
+            export_hex (&rec, "size", sect->size);
+            export_int (&rec, "offset", sect->offset, 4);
+            export_int (&rec, "align", sect->align, 4);
+            export_int (&rec, "flags", sect->flags, 4);
+            export_end (&rec);
+        }
+    }
+}
+
+
+static void export_dylibs (h_writer_t *w, macho_t *macho, int format)
+{
+    for (HSList *l = macho->dylibs; l; l = l->next) {
+        mach_dylib_command_info_t *info = (mach_dylib_command_info_t *) l->data;
+        mach_dylib_command_t *dylib = info->dylib;
+
+        // The name is copied with the padding after it, up to cmdsize
+        size_t max = (dylib->cmdsize > sizeof (mach_dylib_command_t)) ? dylib->cmdsize - sizeof (mach_dylib_command_t) : 0;
+        size_t nlen = (info->name) ? strnlen (info->name, max) : 0;
+
+        export_rec_t rec;
+        export_begin (&rec, w, format, MACH_EXPORT_REC_DYLIB, "dylib", export_str_bound (nlen));
+        export_int (&rec, "cmd", info->type, 4);
+        export_int (&rec, "timestamp", dylib->dylib.timestamp, 4);
+        export_version (&rec, "current_version", dylib->dylib.current_version);
+        export_version (&rec, "compatibility_version", dylib->dylib.compatibility_version);
+        export_str (&rec, "name", info->name, nlen);
+        export_end (&rec);
+    }
+}
+
+
+static void export_symbols (h_writer_t *w, macho_t *macho, int format)
+{
+    uint32_t count = 0;
+    mach_symbol_info_t *syms = mach_symtab_load_symbol_info (macho, &count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        size_t nlen = strlen (syms[i].name);
+
+        export_rec_t rec;
+        export_begin (&rec, w, format, MACH_EXPORT_REC_SYMBOL, "symbol", export_str_bound (nlen));
+        export_hex (&rec, "value", syms[i].value);
+        export_int (&rec, "n_type", syms[i].type, 1);
+        export_int (&rec, "sect", syms[i].sect, 1);
+        export_int (&rec, "desc", syms[i].desc, 2);
+        export_str (&rec, "name", syms[i].name, nlen);
+        export_end (&rec);
+    }
+    free (syms);
+}
+
+
+static void export_error (h_writer_t *w, int format, const char *path)
+{
+    size_t plen = strlen (path);
+
+    export_rec_t rec;
+    export_begin (&rec, w, format, MACH_EXPORT_REC_ERROR, "error", export_str_bound (plen));
+    export_str (&rec, "path", path, plen);
+    export_end (&rec);
+}
+
+
+/**
+ *  Function:   mach_export
+ *  -----------------------
+ *
+ *  Writes the records for a parsed Mach-O: the header, the load commands,
+ *  the build version, each segment followed by its sections, the dylibs
+ *  and then the symbols.
+ *
+ *  w:          Writer to add the records to.
+ *  macho:      The Mach-O.
+ *  format:     MACH_EXPORT_NDJSON or MACH_EXPORT_BINARY.
+ *
+ *  returns:    0, or -1 if the writer has failed.
+ *
+ */
+int mach_export (h_writer_t *w, macho_t *macho, int format)
+{
+    if (!macho || !macho->header)
+        return -1;
+
+    export_header (w, macho, format);
+    export_load_commands (w, macho, format);
+    export_segments (w, macho, format);
+    export_dylibs (w, macho, format);
+    export_symbols (w, macho, format);
+
+    return (w->error) ? -1 : 0;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Many files                           									 --*/
+//===-----------------------------------------------------------------------===//
+
+typedef struct export_job_t {
+    const char     **paths;
+    int              format;
+    char           **bufs;
+    size_t          *lens;
+} export_job_t;
+
+static void export_file_worker (size_t index, void *user_data)
+{
+    export_job_t *job = (export_job_t *) user_data;
+
+    h_writer_t w;
+    h_writer_init (&w, -1, 64 * 1024);
+
+    macho_t *macho = macho_load (job->paths[index]);
+    if (macho) {
+        mach_export (&w, macho, job->format);
+        macho_free (macho);
+    } else {
+        export_error (&w, job->format, job->paths[index]);
+    }
+
+    job->bufs[index] = h_writer_take (&w, &job->lens[index]);
+}
+
+
+/**
+ *  Function:   mach_export_files
+ *  -----------------------------
+ *
+ *  Loads and exports many files in parallel, with the output in the same
+ *  order as `paths`. Files are done a few per thread at a time, so only
+ *  that many exports are held in memory at once.
+ *
+ *  fd:         Where to write the records.
+ *  paths:      Files to export.
+ *  count:      Number of files.
+ *  format:     MACH_EXPORT_NDJSON or MACH_EXPORT_BINARY.
+ *  nthreads:   Number of threads, or 0 for one per CPU.
+ *
+ *  returns:    0, or -1 if writing to `fd` failed.
+ *
+ */
+int mach_export_files (int fd, const char **paths, size_t count, int format, int nthreads)
+{
+    size_t round = (size_t) ((nthreads > 0) ? nthreads : h_parallel_ncpus ()) * EXPORT_FILES_PER_THREAD;
+
+    export_job_t job;
+    job.format = format;
+    job.bufs = calloc (round, sizeof (char *));
+    job.lens = calloc (round, sizeof (size_t));
+
+    h_writer_t out;
+    h_writer_init (&out, fd, 0);
+
+    for (size_t base = 0; base < count; base += round) {
+        size_t n = (count - base < round) ? count - base : round;
+
+        job.paths = paths + base;
+        h_parallel_for (n, nthreads, export_file_worker, &job);
+
+        for (size_t i = 0; i < n; i++) {
+            h_writer_write (&out, job.bufs[i], job.lens[i]);
+            free (job.bufs[i]);
+        }
+    }
+
+    free (job.bufs);
+    free (job.lens);
+    return h_writer_finish (&out);
+}
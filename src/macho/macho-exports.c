@@ -0,0 +1,180 @@
+//===--------------------------- macho_exports ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper-macho/macho-exports.h"
+#include "libhelper-macho/macho-leb128.h"
+
+/**
+ *  The deepest a trie is allowed to go before we assume it's corrupt.
+ */
+#define EXPORT_TRIE_MAX_DEPTH       512
+
+
+typedef struct export_walk_t {
+    const uint8_t           *start;
+    const uint8_t           *end;
+
+    char                    *name;      // current name prefix
+    size_t                   name_cap;
+
+    mach_export_info_t      *exports;
+    uint32_t                 count;
+    uint32_t                 cap;
+
+    size_t                   visits;    // guards against cyclic tries
+} export_walk_t;
+
+
+static void export_trie_walk (export_walk_t *w, uint64_t node_off, size_t name_len, int depth)
+{
+    if (depth > EXPORT_TRIE_MAX_DEPTH || node_off >= (uint64_t) (w->end - w->start))
+        return;
+    if (++w->visits > (size_t) (w->end - w->start))
+        return;
+
+    const uint8_t *p = w->start + node_off;
+    uint64_t terminal_size = mach_read_uleb128 (&p, w->end);
+    const uint8_t *children = p + terminal_size;
+
+    if (terminal_size && children <= w->end) {
+
+        // Grow the output array
+        if (w->count == w->cap) {
+            w->cap = w->cap ? w->cap * 2 : 64;
+            w->exports = realloc (w->exports, sizeof (mach_export_info_t) * w->cap);
+        }
+
+        mach_export_info_t *exp = &w->exports[w->count++];
+        memset (exp, '\0', sizeof (mach_export_info_t));
+
+        exp->name = malloc (name_len + 1);
+        memcpy (exp->name, w->name, name_len);
+        exp->name[name_len] = '\0';
+
+        exp->flags = mach_read_uleb128 (&p, children);
+        if (exp->flags & EXPORT_SYMBOL_FLAGS_REEXPORT) {
+            exp->other = mach_read_uleb128 (&p, children);
+            if (p < children && *p && memchr (p, '\0', children - p))
+                exp->import_name = (char *) p;
+        } else {
+            exp->address = mach_read_uleb128 (&p, children);
+            if (exp->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER)
+                exp->other = mach_read_uleb128 (&p, children);
+        }
+    }
+
+    if (children >= w->end)
+        return;
+
+    // After the terminal info is the number of edges leaving this node
+    p = children;
+    uint8_t nchildren = *p++;
+
+    for (uint8_t i = 0; i < nchildren && p < w->end; i++) {
+
+        // Each edge is a NUL-terminated string followed by a uleb offset
+        const uint8_t *edge = p;
+        const uint8_t *nul = memchr (edge, '\0', w->end - edge);
+        if (!nul)
+            return;
+
+        size_t edge_len = nul - edge;
+        p = nul + 1;
+        uint64_t child_off = mach_read_uleb128 (&p, w->end);
+
+        if (name_len + edge_len + 1 > w->name_cap) {
+            w->name_cap = (name_len + edge_len + 1) * 2;
+            w->name = realloc (w->name, w->name_cap);
+        }
+        memcpy (w->name + name_len, edge, edge_len);
+
+        export_trie_walk (w, child_off, name_len + edge_len, depth + 1);
+    }
+}
+
+
+/**
+ *  Function:   mach_exports_load
+ *  -----------------------------
+ *
+ *  Walks the export trie of a Mach-O, which can be referenced by either
+ *  LC_DYLD_INFO(_ONLY) or LC_DYLD_EXPORTS_TRIE, and returns each exported
+ *  symbol in the order they appear in the trie.
+ *
+ *  macho:      The Mach-O to load exports from.
+ *  count:      Set to the number of exports in the returned array.
+ *
+ *  returns:    An allocated array of exports, or NULL if there is no trie.
+ *
+ */
+mach_export_info_t *mach_exports_load (macho_t *macho, uint32_t *count)
+{
+    uint32_t trie_off = 0, trie_size = 0;
+    mach_command_info_t *cmdinfo = NULL;
+
+    *count = 0;
+
+    if ((cmdinfo = mach_lc_find_given_cmd (macho, LC_DYLD_EXPORTS_TRIE))) {
+        mach_linkedit_data_command_t cmd;
+        memcpy (&cmd, macho->data + cmdinfo->offset, sizeof (cmd));
+        trie_off = cmd.dataoff;
+        trie_size = cmd.datasize;
+    } else if ((cmdinfo = mach_lc_find_given_cmd (macho, LC_DYLD_INFO_ONLY)) ||
+               (cmdinfo = mach_lc_find_given_cmd (macho, LC_DYLD_INFO))) {
+        mach_dyld_info_command_t cmd;
+        memcpy (&cmd, macho->data + cmdinfo->offset, sizeof (cmd));
+        trie_off = cmd.export_off;
+        trie_size = cmd.export_size;
+    }
+
+    if (!trie_size)
+        return NULL;
+
+    if ((uint64_t) trie_off + trie_size > macho->size) {
+        errorf ("Export trie lies outside of the file\n");
+        return NULL;
+    }
+
+    export_walk_t w;
+    memset (&w, '\0', sizeof (w));
+    w.start = macho->data + trie_off;
+    w.end = w.start + trie_size;
+    w.name_cap = 256;
+    w.name = malloc (w.name_cap);
+
+    export_trie_walk (&w, 0, 0, 0);
+
+    free (w.name);
+    *count = w.count;
+    return w.exports;
+}
+
+
+void mach_exports_free (mach_export_info_t *exports, uint32_t count)
+{
+    if (!exports) return;
+    for (uint32_t i = 0; i < count; i++)
+        free (exports[i].name);
+    free (exports);
+}
@@ -0,0 +1,430 @@
+//===---------------------------- macho_fixups ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper-macho/macho-fixups.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-leb128.h"
+#include "libhelper-macho/macho-segment.h"
+
+
+static void fixups_add_bind (mach_fixups_t *fixups, uint32_t *capacity, uint64_t vmaddr,
+                             const char *name, int64_t addend, int32_t ordinal)
+{
+    if (fixups->nbinds == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 256;
+        fixups->binds = realloc (fixups->binds, sizeof (mach_bind_t) * *capacity);
+    }
+
+    mach_bind_t *bind = &fixups->binds[fixups->nbinds++];
+    bind->vmaddr = vmaddr;
+    bind->name = name;
+    bind->addend = addend;
+    bind->ordinal = ordinal;
+}
+
+static int fixups_bind_compare (const void *x, const void *y)
+{
+    const mach_bind_t *a = x, *b = y;
+    return (a->vmaddr < b->vmaddr) ? -1 : (a->vmaddr > b->vmaddr);
+}
+
+static mach_segment_command_64_t *fixups_segment_at (macho_t *macho, uint32_t index)
+{
+    uint32_t i = 0;
+    for (HSList *l = macho->scmds; l; l = l->next, i++)
+        if (i == index)
+            return ((mach_segment_info_t *) l->data)->segcmd;
+    return NULL;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Bind opcodes                         									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void fixups_load_opcodes (macho_t *macho, mach_fixups_t *fixups, uint32_t *capacity)
+{
+    mach_command_info_t *info = mach_lc_find_given_cmd (macho, LC_DYLD_INFO_ONLY);
+    if (!info)
+        info = mach_lc_find_given_cmd (macho, LC_DYLD_INFO);
+    if (!info)
+        return;
+
+    mach_dyld_info_command_t cmd;
+    memcpy (&cmd, macho->data + info->offset, sizeof (mach_dyld_info_command_t));
+
+    if ((uint64_t) cmd.bind_off + cmd.bind_size > macho->size) {
+        errorf ("Bind info lies outside of the file\n");
+        return;
+    }
+
+    const uint8_t *p = macho->data + cmd.bind_off;
+    const uint8_t *end = p + cmd.bind_size;
+
+    const char *name = NULL;
+    int64_t addend = 0;
+    int32_t ordinal = 0;
+    uint64_t addr = 0;
+    mach_segment_command_64_t *seg = NULL;
+
+    while (p < end) {
+        uint8_t opcode = *p & BIND_OPCODE_MASK;
+        uint8_t imm = *p & BIND_IMMEDIATE_MASK;
+        p++;
+
+        switch (opcode) {
+            case BIND_OPCODE_DONE:
+                return;
+            case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
+                ordinal = imm;
+                break;
+            case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+                ordinal = (int32_t) mach_read_uleb128 (&p, end);
+                break;
+            case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
+                ordinal = (imm) ? (int32_t) (int8_t) (BIND_OPCODE_MASK | imm) : 0;
+                break;
+            case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM: {
+                const uint8_t *nul = memchr (p, '\0', end - p);
+                if (!nul)
+                    return;
+                name = (const char *) p;
+                p = nul + 1;
+                break;
+            }
+            case BIND_OPCODE_SET_TYPE_IMM:
+                break;
+            case BIND_OPCODE_SET_ADDEND_SLEB:
+                addend = mach_read_sleb128 (&p, end);
+                break;
+            case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+                seg = fixups_segment_at (macho, imm);
+                addr = mach_read_uleb128 (&p, end) + ((seg) ? seg->vmaddr : 0);
+                break;
+            case BIND_OPCODE_ADD_ADDR_ULEB:
+                addr += mach_read_uleb128 (&p, end);
+                break;
+            case BIND_OPCODE_DO_BIND:
+                fixups_add_bind (fixups, capacity, addr, name, addend, ordinal);
+                addr += 8;
+                break;
+            case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
+                fixups_add_bind (fixups, capacity, addr, name, addend, ordinal);
+                addr += 8 + mach_read_uleb128 (&p, end);
+                break;
+            case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
+                fixups_add_bind (fixups, capacity, addr, name, addend, ordinal);
+                addr += 8 + (uint64_t) imm * 8;
+                break;
+            case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB: {
+                uint64_t count = mach_read_uleb128 (&p, end);
+                uint64_t skip = mach_read_uleb128 (&p, end);
+                for (uint64_t i = 0; i < count && i < cmd.bind_size * 64ULL; i++) {
+                    fixups_add_bind (fixups, capacity, addr, name, addend, ordinal);
+                    addr += 8 + skip;
+                }
+                break;
+            }
+            default:
+                warningf ("Unsupported bind opcode 0x%02x\n", opcode);
+                return;
+        }
+    }
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Chained fixups                       									 --*/
+//===-----------------------------------------------------------------------===//
+
+static int fixups_chain_bind (uint16_t format, uint64_t raw, uint32_t *ordinal)
+{
+    switch (format) {
+        case DYLD_CHAINED_PTR_ARM64E:
+        case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+            *ordinal = raw & 0xffff;
+            return (raw >> 62) & 1;
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+            *ordinal = raw & 0xffffff;
+            return (raw >> 62) & 1;
+        case DYLD_CHAINED_PTR_64:
+        case DYLD_CHAINED_PTR_64_OFFSET:
+            *ordinal = raw & 0xffffff;
+            return (raw >> 63) & 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ *  The distance to the next pointer in a chain. The arm64e formats have an
+ *  11-bit `next`, counted in 8-byte strides except for the kernel format,
+ *  which like the others uses 4-byte strides.
+ */
+static uint64_t fixups_chain_next (uint16_t format, uint64_t raw)
+{
+    switch (format) {
+        case DYLD_CHAINED_PTR_ARM64E:
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+            return ((raw >> 51) & 0x7ff) * 8;
+        case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+            return ((raw >> 51) & 0x7ff) * 4;
+        default:
+            return ((raw >> 51) & 0xfff) * 4;
+    }
+}
+
+/**
+ *  Function:   fixups_load_chained
+ *  -------------------------------
+ *
+ *  Walks every pointer chain in the image to find the binds. Imports
+ *  are decoded once up front, so each bind only costs a table lookup.
+ *
+ */
+static void fixups_load_chained (macho_t *macho, mach_fixups_t *fixups, uint32_t *capacity)
+{
+    mach_command_info_t *info = mach_lc_find_given_cmd (macho, LC_DYLD_CHAINED_FIXUPS);
+    if (!info)
+        return;
+
+    mach_linkedit_data_command_t cmd;
+    memcpy (&cmd, macho->data + info->offset, sizeof (mach_linkedit_data_command_t));
+
+    if ((uint64_t) cmd.dataoff + cmd.datasize > macho->size ||
+        cmd.datasize < sizeof (mach_chained_fixups_header_t)) {
+        errorf ("LC_DYLD_CHAINED_FIXUPS data lies outside of the file\n");
+        return;
+    }
+
+    const uint8_t *base = macho->data + cmd.dataoff;
+    mach_chained_fixups_header_t hdr;
+    memcpy (&hdr, base, sizeof (mach_chained_fixups_header_t));
+
+    // Imports
+    uint32_t entsize = (hdr.imports_format == DYLD_CHAINED_IMPORT) ? 4 :
+                       (hdr.imports_format == DYLD_CHAINED_IMPORT_ADDEND) ? 8 :
+                       (hdr.imports_format == DYLD_CHAINED_IMPORT_ADDEND64) ? 16 : 0;
+    if (!entsize || (uint64_t) hdr.imports_offset + (uint64_t) hdr.imports_count * entsize > cmd.datasize ||
+        hdr.symbols_offset >= cmd.datasize || hdr.starts_offset + 4 > cmd.datasize) {
+        warningf ("Unsupported or malformed chained fixups\n");
+        return;
+    }
+
+    mach_bind_t *imports = calloc (hdr.imports_count + 1, sizeof (mach_bind_t));
+    for (uint32_t i = 0; i < hdr.imports_count; i++) {
+        const uint8_t *ent = base + hdr.imports_offset + (uint64_t) i * entsize;
+        uint64_t name_off;
+
+        if (hdr.imports_format == DYLD_CHAINED_IMPORT_ADDEND64) {
+            uint64_t v;
+            memcpy (&v, ent, 8);
+            memcpy (&imports[i].addend, ent + 8, 8);
+            imports[i].ordinal = (int32_t) (int16_t) (v & 0xffff);
+            name_off = v >> 32;
+        } else {
+            uint32_t v;
+            memcpy (&v, ent, 4);
+            if (hdr.imports_format == DYLD_CHAINED_IMPORT_ADDEND) {
+                int32_t addend;
+                memcpy (&addend, ent + 4, 4);
+                imports[i].addend = addend;
+            }
+            imports[i].ordinal = (int32_t) (int8_t) (v & 0xff);
+            name_off = v >> 9;
+        }
+
+        if (hdr.symbols_offset + name_off < cmd.datasize)
+            imports[i].name = (const char *) base + hdr.symbols_offset + name_off;
+    }
+
+    // Starts
+    const uint8_t *starts = base + hdr.starts_offset;
+    uint32_t seg_count;
+    memcpy (&seg_count, starts, 4);
+
+    for (uint32_t s = 0; s < seg_count && hdr.starts_offset + 8 + s * 4 <= cmd.datasize; s++) {
+        uint32_t seg_info_offset;
+        memcpy (&seg_info_offset, starts + 4 + s * 4, 4);
+        if (!seg_info_offset || (uint64_t) hdr.starts_offset + seg_info_offset + 22 > cmd.datasize)
+            continue;
+
+        const uint8_t *seg = starts + seg_info_offset;
+        uint16_t page_size, format, page_count;
+        uint64_t segment_offset;
+        memcpy (&page_size, seg + 4, 2);
+        memcpy (&format, seg + 6, 2);
+        memcpy (&segment_offset, seg + 8, 8);
+        memcpy (&page_count, seg + 20, 2);
+
+        if (!fixups->pointer_format)
+            fixups->pointer_format = format;
+
+        if ((uint64_t) hdr.starts_offset + seg_info_offset + 22 + page_count * 2 > cmd.datasize)
+            continue;
+
+        for (uint32_t pg = 0; pg < page_count; pg++) {
+            uint16_t start;
+            memcpy (&start, seg + 22 + pg * 2, 2);
+            if (start == DYLD_CHAINED_PTR_START_NONE)
+                continue;
+
+            uint64_t vmaddr = fixups->base + segment_offset + (uint64_t) pg * page_size + start;
+            uint64_t offset = mach_vmaddr_to_offset (macho, vmaddr);
+
+            while (offset != MACH_ADDR_INVALID && offset + 8 <= macho->size) {
+                uint64_t raw;
+                memcpy (&raw, macho->data + offset, 8);
+
+                uint32_t ordinal;
+                if (fixups_chain_bind (format, raw, &ordinal) && ordinal < hdr.imports_count)
+                    fixups_add_bind (fixups, capacity, vmaddr, imports[ordinal].name,
+                                     imports[ordinal].addend, imports[ordinal].ordinal);
+
+                uint64_t next = fixups_chain_next (format, raw);
+                if (!next)
+                    break;
+                vmaddr += next;
+                offset += next;
+            }
+        }
+    }
+
+    free (imports);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Fixups                               									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Function:   mach_fixups_load
+ *  ----------------------------
+ *
+ *  Loads the binds of a Mach-O, and notes the chained pointer format so
+ *  that rebased pointers can be decoded later.
+ *
+ *  macho:      The Mach-O.
+ *
+ *  returns:    The fixups, free with mach_fixups_free().
+ *
+ */
+mach_fixups_t *mach_fixups_load (macho_t *macho)
+{
+    mach_fixups_t *fixups = calloc (1, sizeof (mach_fixups_t));
+    uint32_t capacity = 0;
+
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        mach_segment_command_64_t *seg = ((mach_segment_info_t *) l->data)->segcmd;
+        if (!strncmp (seg->segname, "__TEXT", 16)) {
+            fixups->base = seg->vmaddr;
+            break;
+        }
+    }
+
+    fixups_load_chained (macho, fixups, &capacity);
+    fixups_load_opcodes (macho, fixups, &capacity);
+
+    qsort (fixups->binds, fixups->nbinds, sizeof (mach_bind_t), fixups_bind_compare);
+    return fixups;
+}
+
+
+void mach_fixups_free (mach_fixups_t *fixups)
+{
+    if (!fixups) return;
+    free (fixups->binds);
+    free (fixups);
+}
+
+
+mach_bind_t *mach_fixups_find_bind (mach_fixups_t *fixups, uint64_t vmaddr)
+{
+    uint32_t lo = 0, hi = fixups->nbinds;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (fixups->binds[mid].vmaddr < vmaddr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < fixups->nbinds && fixups->binds[lo].vmaddr == vmaddr) ? &fixups->binds[lo] : NULL;
+}
+
+
+/**
+ *  Function:   mach_fixups_read_pointer
+ *  ------------------------------------
+ *
+ *  Reads the pointer stored at `vmaddr`. Rebases are decoded to the
+ *  address they point at. If the pointer is bound instead, zero is
+ *  returned and `bind` (if given) is set to the bind.
+ *
+ *  returns:    The target address, or zero.
+ *
+ */
+uint64_t mach_fixups_read_pointer (macho_t *macho, mach_fixups_t *fixups, uint64_t vmaddr, mach_bind_t **bind)
+{
+    if (bind)
+        *bind = NULL;
+
+    mach_bind_t *b = mach_fixups_find_bind (fixups, vmaddr);
+    if (b) {
+        if (bind)
+            *bind = b;
+        return 0;
+    }
+
+    uint64_t offset = mach_vmaddr_to_offset (macho, vmaddr);
+    if (offset == MACH_ADDR_INVALID || offset + 8 > macho->size)
+        return 0;
+
+    uint64_t raw;
+    memcpy (&raw, macho->data + offset, 8);
+
+    switch (fixups->pointer_format) {
+        case DYLD_CHAINED_PTR_ARM64E:
+        case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND24: {
+            if (raw >> 63)
+                return fixups->base + (raw & 0xffffffff);
+
+            uint64_t target = (raw & 0x7ffffffffffULL) | (((raw >> 43) & 0xff) << 56);
+            return (fixups->pointer_format == DYLD_CHAINED_PTR_ARM64E) ? target : fixups->base + target;
+        }
+        case DYLD_CHAINED_PTR_64:
+            return (raw & 0xfffffffffULL) | (((raw >> 36) & 0xff) << 56);
+        case DYLD_CHAINED_PTR_64_OFFSET:
+            return fixups->base + ((raw & 0xfffffffffULL) | (((raw >> 36) & 0xff) << 56));
+        case DYLD_CHAINED_PTR_64_KERNEL_CACHE:
+            return fixups->base + (raw & 0x3fffffff);
+        default:
+            return raw;
+    }
+}
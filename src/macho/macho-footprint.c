@@ -0,0 +1,129 @@
+//===-------------------------- macho_footprint -----------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper-macho/macho-footprint.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper/file.h"
+
+#if defined(__GLIBC__)
+#   include <malloc.h>
+#elif defined(__APPLE__)
+#   include <malloc/malloc.h>
+#endif
+
+
+/**
+ *  The size of a heap allocation, or `nominal` if the allocator can't
+ *  say.
+ */
+static size_t footprint_heap (const void *ptr, size_t nominal)
+{
+    if (!ptr)
+        return 0;
+#if defined(__GLIBC__)
+    (void) nominal;
+    return malloc_usable_size ((void *) ptr);
+#elif defined(__APPLE__)
+    (void) nominal;
+    return malloc_size (ptr);
+#else
+    return nominal;
+#endif
+}
+
+/**
+ *  The nodes of a list count towards `indices`.
+ */
+static void footprint_list (HSList *list, mach_footprint_t *fp)
+{
+    for (HSList *l = list; l; l = l->next)
+        fp->indices += footprint_heap (l, sizeof (HSList));
+}
+
+
+/**
+ *  Function:   macho_footprint
+ *  ---------------------------
+ *
+ *  Measures the memory held by a macho_t.
+ *
+ *  macho:      The Mach-O.
+ *  fp:         Filled in with the sizes.
+ *
+ */
+void macho_footprint (macho_t *macho, mach_footprint_t *fp)
+{
+    memset (fp, '\0', sizeof (mach_footprint_t));
+    if (!macho)
+        return;
+
+    fp->header = footprint_heap (macho, sizeof (macho_t)) +
+                 footprint_heap (macho->header, sizeof (mach_header_t));
+
+    footprint_list (macho->lcmds, fp);
+    for (HSList *l = macho->lcmds; l; l = l->next) {
+        mach_command_info_t *info = (mach_command_info_t *) l->data;
+        fp->load_commands += footprint_heap (info, sizeof (mach_command_info_t)) +
+                             footprint_heap (info->lc, sizeof (mach_load_command_t));
+    }
+
+    footprint_list (macho->dylibs, fp);
+    for (HSList *l = macho->dylibs; l; l = l->next) {
+        mach_dylib_command_info_t *info = (mach_dylib_command_info_t *) l->data;
+        fp->load_commands += footprint_heap (info, sizeof (mach_dylib_command_info_t)) +
+                             footprint_heap (info->dylib, sizeof (mach_dylib_command_t)) +
+                             footprint_heap (info->name, (info->name) ? strlen (info->name) + 1 : 0);
+    }
+
+    footprint_list (macho->scmds, fp);
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        mach_segment_info_t *seg = (mach_segment_info_t *) l->data;
+        fp->sections += footprint_heap (seg, sizeof (mach_segment_info_t)) +
+                        footprint_heap (seg->segcmd, sizeof (mach_segment_command_64_t));
+
+        footprint_list (seg->sections, fp);
+        for (HSList *s = seg->sections; s; s = s->next)
+            fp->sections += footprint_heap (s->data, sizeof (mach_section_64_t));
+    }
+
+    // The element types of these are up to whoever fills them
+    for (HSList *l = macho->symbols; l; l = l->next)
+        fp->symbols += footprint_heap (l->data, 0);
+    for (HSList *l = macho->strings; l; l = l->next)
+        fp->strings += footprint_heap (l->data, 0);
+    footprint_list (macho->symbols, fp);
+    footprint_list (macho->strings, fp);
+
+    fp->heap = fp->header + fp->load_commands + fp->sections + fp->symbols + fp->strings + fp->indices;
+
+    // mincore() counts whole pages, so the first and last can take in
+    // bytes either side of the data
+    fp->mapped = macho->size;
+    fp->resident = file_resident_bytes (macho->data, macho->size, &fp->dirty);
+    if (fp->resident > fp->mapped)
+        fp->resident = fp->mapped;
+    if (fp->dirty > fp->resident)
+        fp->dirty = fp->resident;
+}
@@ -0,0 +1,696 @@
+//===---------------------------- macho_iokit -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include <stdio.h>
+
+#include "libhelper-macho/macho-iokit.h"
+#include "libhelper-macho/macho-arm64.h"
+#include "libhelper-macho/macho-segment.h"
+#include "libhelper-macho/macho-symbol.h"
+#include "libhelper/hparallel.h"
+
+
+#define IOKIT_CTOR_SYMBOL           "__ZN11OSMetaClassC2EPKcPKS_j"
+
+#define IOKIT_MAX_INSNS             0x4000
+#define IOKIT_MAX_NAME              128
+#define IOKIT_MAX_VTABLE_SLOTS      32
+
+// Stands in for the object returned by operator new while following alloc()
+#define IOKIT_ALLOC_TAG             0xa110ca7ea110ca7eULL
+
+// Registers that don't survive a call
+#define IOKIT_CALL_CLOBBERED        0x7ffffu
+
+
+enum {
+    IOKIT_MODE_COUNT,               // collect candidate constructor calls
+    IOKIT_MODE_EXTRACT,             // collect classes
+    IOKIT_MODE_ALLOC                // find the vtable an alloc() method stores
+};
+
+typedef struct iokit_regs_t {
+    uint64_t     x[32];
+    uint32_t     known;
+} iokit_regs_t;
+
+typedef struct iokit_kext_result_t {
+    mach_iokit_class_t  *classes;
+    uint32_t             count;
+    uint32_t             capacity;
+
+    uint64_t            *targets;
+    uint32_t             ntargets;
+    uint32_t             tcapacity;
+} iokit_kext_result_t;
+
+typedef struct iokit_ctx_t {
+    macho_t             *kernel;
+    mach_kext_list_t    *kexts;
+    uint64_t             ctor;
+    int                  mode;
+
+    HHashTable          *symbols;       // name -> mach_symbol_info_t
+    iokit_kext_result_t *results;
+} iokit_ctx_t;
+
+/**
+ *  State for a single function scan.
+ */
+typedef struct iokit_scan_t {
+    iokit_ctx_t         *ctx;
+    iokit_kext_result_t *res;
+    uint32_t             kext;
+    int                  mode;
+
+    uint32_t             first;         // first class found by this scan
+    uint32_t             size;          // IOKIT_MODE_ALLOC: size being allocated
+    int                  allocated;     // IOKIT_MODE_ALLOC: seen operator new
+    uint64_t             store;         // IOKIT_MODE_ALLOC: last vtable stored
+} iokit_scan_t;
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Memory                               									 --*/
+//===-----------------------------------------------------------------------===//
+
+static int iokit_read_insn (macho_t *kernel, uint64_t addr, uint32_t *insn)
+{
+    uint64_t offset = mach_vmaddr_to_offset (kernel, addr);
+    if (offset == MACH_ADDR_INVALID || offset + 4 > kernel->size)
+        return 0;
+
+    const uint8_t *p = kernel->data + offset;
+    *insn = (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    return 1;
+}
+
+/**
+ *  Returns the C string at `addr` if it looks like a class name, else NULL.
+ */
+static const char *iokit_class_name (macho_t *kernel, uint64_t addr)
+{
+    uint64_t offset = mach_vmaddr_to_offset (kernel, addr);
+    if (offset == MACH_ADDR_INVALID || offset >= kernel->size)
+        return NULL;
+
+    const char *name = (const char *) kernel->data + offset;
+    size_t max = kernel->size - offset;
+    if (max > IOKIT_MAX_NAME)
+        max = IOKIT_MAX_NAME;
+
+    for (size_t i = 0; i < max; i++) {
+        char c = name[i];
+        if (!c)
+            return (i) ? name : NULL;
+        if (!(c == '_' || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+              (i && c >= '0' && c <= '9')))
+            return NULL;
+    }
+    return NULL;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Code scanning                        									 --*/
+//===-----------------------------------------------------------------------===//
+
+static inline void iokit_set (iokit_regs_t *r, unsigned n, uint64_t value)
+{
+    if (n == ARM64_REG_XZR)
+        return;
+    r->x[n] = value;
+    r->known |= 1u << n;
+}
+
+static inline void iokit_clear (iokit_regs_t *r, unsigned n)
+{
+    r->known &= ~(1u << n);
+}
+
+static inline int iokit_known (iokit_regs_t *r, unsigned n)
+{
+    return (r->known >> n) & 1;
+}
+
+/**
+ *  Kexts call into the kernel through stubs. If `addr` is one, returns
+ *  where it jumps to.
+ */
+static uint64_t iokit_resolve_stub (iokit_ctx_t *ctx, uint64_t addr)
+{
+    iokit_regs_t r;
+    r.known = 0;
+
+    for (uint32_t i = 0; i < 4; i++) {
+        uint32_t insn;
+        uint64_t pc = addr + i * 4;
+        if (!iokit_read_insn (ctx->kernel, pc, &insn))
+            break;
+
+        unsigned rd = arm64_rd (insn), rn = arm64_rn (insn);
+        if (arm64_is_adrp (insn))
+            iokit_set (&r, rd, arm64_adrp_target (pc, insn));
+        else if (arm64_is_add_imm (insn) && iokit_known (&r, rn))
+            iokit_set (&r, rd, r.x[rn] + arm64_add_imm (insn));
+        else if (arm64_is_ldr_uimm_64 (insn) && iokit_known (&r, rn))
+            iokit_set (&r, rd, mach_kext_read_pointer (ctx->kernel, ctx->kexts, r.x[rn] + arm64_ldst_imm (insn)));
+        else if (arm64_is_br (insn))
+            return (iokit_known (&r, rn) && r.x[rn]) ? r.x[rn] : addr;
+        else
+            break;
+    }
+    return addr;
+}
+
+
+static void iokit_push_class (iokit_kext_result_t *res, mach_iokit_class_t *cls)
+{
+    if (res->count == res->capacity) {
+        res->capacity = res->capacity ? res->capacity * 2 : 32;
+        res->classes = realloc (res->classes, sizeof (mach_iokit_class_t) * res->capacity);
+    }
+    res->classes[res->count++] = *cls;
+}
+
+static void iokit_push_target (iokit_kext_result_t *res, uint64_t target)
+{
+    if (res->ntargets == res->tcapacity) {
+        res->tcapacity = res->tcapacity ? res->tcapacity * 2 : 32;
+        res->targets = realloc (res->targets, sizeof (uint64_t) * res->tcapacity);
+    }
+    res->targets[res->ntargets++] = target;
+}
+
+static void iokit_scan (iokit_scan_t *scan, uint64_t addr, iokit_regs_t *r, int depth);
+
+/**
+ *  Handles a BL or B to `target`. Returns non-zero if the callee returns
+ *  `this` in x0, which constructors do.
+ */
+static int iokit_call (iokit_scan_t *scan, uint64_t target, iokit_regs_t *r, int depth)
+{
+    iokit_ctx_t *ctx = scan->ctx;
+    target = iokit_resolve_stub (ctx, target);
+
+    switch (scan->mode) {
+        case IOKIT_MODE_COUNT:
+            if (iokit_known (r, 0) && iokit_known (r, 1) && iokit_class_name (ctx->kernel, r->x[1]))
+                iokit_push_target (scan->res, target);
+            return 0;
+
+        case IOKIT_MODE_EXTRACT: {
+            if (target != ctx->ctor || !iokit_known (r, 0) || !iokit_known (r, 1))
+                return 0;
+
+            const char *name = iokit_class_name (ctx->kernel, r->x[1]);
+            if (!name)
+                return 0;
+
+            mach_iokit_class_t cls;
+            memset (&cls, '\0', sizeof (mach_iokit_class_t));
+            cls.name = name;
+            cls.metaclass = r->x[0];
+            cls.super_metaclass = iokit_known (r, 2) ? r->x[2] : 0;
+            cls.size = iokit_known (r, 3) ? (uint32_t) r->x[3] : 0;
+            cls.super = MACH_IOKIT_NO_CLASS;
+            cls.kext = scan->kext;
+            iokit_push_class (scan->res, &cls);
+            return 1;
+        }
+
+        case IOKIT_MODE_ALLOC:
+            if (!scan->allocated && iokit_known (r, 0) && r->x[0] == scan->size) {
+                // operator new (size)
+                scan->allocated = 1;
+                r->x[0] = IOKIT_ALLOC_TAG;
+                return 1;
+            }
+            if (iokit_known (r, 0) && r->x[0] == IOKIT_ALLOC_TAG) {
+                // The constructor. Follow it, but not any further.
+                if (!depth) {
+                    iokit_regs_t callee;
+                    callee.known = 0;
+                    iokit_set (&callee, 0, IOKIT_ALLOC_TAG);
+                    iokit_scan (scan, target, &callee, depth + 1);
+                }
+                return 1;
+            }
+            return 0;
+    }
+    return 0;
+}
+
+static void iokit_store (iokit_scan_t *scan, uint64_t addr, uint64_t value)
+{
+    if (scan->mode == IOKIT_MODE_EXTRACT) {
+        // The metaclass vtable is stored right after the constructor returns
+        for (uint32_t i = scan->first; i < scan->res->count; i++) {
+            mach_iokit_class_t *cls = &scan->res->classes[i];
+            if (cls->metaclass == addr && !cls->metaclass_vtable)
+                cls->metaclass_vtable = value;
+        }
+    } else if (scan->mode == IOKIT_MODE_ALLOC && addr == IOKIT_ALLOC_TAG && scan->allocated) {
+        scan->store = value;
+    }
+}
+
+/**
+ *  Function:   iokit_scan
+ *  ----------------------
+ *
+ *  Follows register values through a function in a straight line, from
+ *  `addr` to the first return or unconditional branch. Only the values
+ *  built by ADRP/ADD, MOV and pointer loads are tracked, which is all
+ *  that's needed for the arguments of static constructor calls.
+ *
+ */
+static void iokit_scan (iokit_scan_t *scan, uint64_t addr, iokit_regs_t *r, int depth)
+{
+    iokit_ctx_t *ctx = scan->ctx;
+
+    for (uint32_t i = 0; i < IOKIT_MAX_INSNS; i++) {
+        uint64_t pc = addr + (uint64_t) i * 4;
+        uint32_t insn;
+        if (!iokit_read_insn (ctx->kernel, pc, &insn))
+            return;
+
+        unsigned rd = arm64_rd (insn), rn = arm64_rn (insn);
+
+        if (arm64_is_adrp (insn)) {
+            iokit_set (r, rd, arm64_adrp_target (pc, insn));
+        } else if (arm64_is_adr (insn)) {
+            iokit_set (r, rd, arm64_adr_target (pc, insn));
+        } else if (arm64_is_add_imm (insn)) {
+            if (rn != ARM64_REG_SP && iokit_known (r, rn))
+                iokit_set (r, rd, r->x[rn] + arm64_add_imm (insn));
+            else
+                iokit_clear (r, rd);
+        } else if (arm64_is_movz (insn)) {
+            iokit_set (r, rd, arm64_movw_imm (insn));
+        } else if (arm64_is_movk (insn)) {
+            if (iokit_known (r, rd)) {
+                uint64_t shift = ((insn >> 21) & 0x3) * 16;
+                iokit_set (r, rd, (r->x[rd] & ~(0xffffULL << shift)) | arm64_movw_imm (insn));
+            }
+        } else if (arm64_is_orr_imm (insn)) {
+            if (rn == ARM64_REG_XZR)
+                iokit_set (r, rd, arm64_bitmask_imm (insn));
+            else
+                iokit_clear (r, rd);
+        } else if (arm64_is_mov_reg (insn)) {
+            unsigned rm = arm64_rm (insn);
+            uint64_t mask = (insn >> 31) ? ~0ULL : 0xffffffffULL;
+            if (rm == ARM64_REG_XZR)
+                iokit_set (r, rd, 0);
+            else if (iokit_known (r, rm))
+                iokit_set (r, rd, r->x[rm] & mask);
+            else
+                iokit_clear (r, rd);
+        } else if (arm64_is_pac (insn)) {
+            // Signing doesn't change the address
+        } else if (arm64_is_ldr_uimm_64 (insn)) {
+            uint64_t value = 0;
+            if (rn != ARM64_REG_SP && iokit_known (r, rn) && r->x[rn] != IOKIT_ALLOC_TAG)
+                value = mach_kext_read_pointer (ctx->kernel, ctx->kexts, r->x[rn] + arm64_ldst_imm (insn));
+            if (value)
+                iokit_set (r, rd, value);
+            else
+                iokit_clear (r, rd);
+        } else if (arm64_is_str_uimm_64 (insn)) {
+            if (rn != ARM64_REG_SP && iokit_known (r, rn) && (rd == ARM64_REG_XZR || iokit_known (r, rd)))
+                iokit_store (scan, r->x[rn] + arm64_ldst_imm (insn), (rd == ARM64_REG_XZR) ? 0 : r->x[rd]);
+        } else if (arm64_is_bl (insn)) {
+            uint64_t x0 = r->x[0];
+            int this_returned = iokit_call (scan, arm64_branch_target (pc, insn), r, depth);
+            int x0_known = iokit_known (r, 0);
+            x0 = (scan->mode == IOKIT_MODE_ALLOC) ? r->x[0] : x0;
+
+            r->known &= ~IOKIT_CALL_CLOBBERED;
+            if (this_returned && x0_known)
+                iokit_set (r, 0, x0);
+        } else if (arm64_is_b (insn)) {
+            // Tail call
+            iokit_call (scan, arm64_branch_target (pc, insn), r, depth);
+            return;
+        } else if (arm64_is_ret (insn) || arm64_is_br (insn)) {
+            return;
+        } else if ((insn & 0xfe000000) == 0xd6000000) {
+            // BLR and friends
+            r->known &= ~IOKIT_CALL_CLOBBERED;
+        } else if ((insn & 0x1c000000) == 0x10000000 || (insn & 0x0e000000) == 0x0a000000) {
+            // Any other data processing instruction
+            iokit_clear (r, rd);
+        } else if ((insn & 0x0a000000) == 0x08000000 && !(insn & (1u << 26)) && (insn & (1u << 22))) {
+            // Any other load into a general purpose register
+            iokit_clear (r, rd);
+            if ((insn & 0x3a000000) == 0x28000000)
+                iokit_clear (r, (insn >> 10) & 0x1f);
+        }
+    }
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Kexts                                									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Collects the static initialisers of a kext: __mod_init_func (and the
+ *  __kmod_init of merged kernelcaches), or __init_offsets.
+ */
+static uint64_t *iokit_init_funcs (iokit_ctx_t *ctx, mach_kext_t *kext, uint32_t *count)
+{
+    uint64_t *funcs = NULL;
+    uint32_t n = 0;
+
+    for (HSList *l = kext->macho->scmds; l; l = l->next) {
+        for (HSList *s = ((mach_segment_info_t *) l->data)->sections; s; s = s->next) {
+            mach_section_64_t *sect = (mach_section_64_t *) s->data;
+            uint32_t type = sect->flags & SECTION_TYPE;
+
+            uint32_t entsize;
+            if (type == S_MOD_INIT_FUNC_POINTERS || !strncmp (sect->sectname, "__kmod_init", 16))
+                entsize = 8;
+            else if (type == S_INIT_FUNC_OFFSETS)
+                entsize = 4;
+            else
+                continue;
+
+            uint64_t offset = mach_vmaddr_to_offset (ctx->kernel, sect->addr);
+            if (offset == MACH_ADDR_INVALID || offset + sect->size > ctx->kernel->size)
+                continue;
+
+            uint64_t nent = sect->size / entsize;
+            funcs = realloc (funcs, sizeof (uint64_t) * (n + nent));
+
+            for (uint64_t i = 0; i < nent; i++) {
+                uint64_t func;
+                if (entsize == 8) {
+                    func = mach_kext_read_pointer (ctx->kernel, ctx->kexts, sect->addr + i * 8);
+                } else {
+                    uint32_t off;
+                    memcpy (&off, ctx->kernel->data + offset + i * 4, sizeof (uint32_t));
+                    func = kext->vmaddr + off;
+                }
+                if (func)
+                    funcs[n++] = func;
+            }
+        }
+    }
+
+    *count = n;
+    return funcs;
+}
+
+
+static uint64_t iokit_symbol_value (iokit_ctx_t *ctx, const char *fmt, const char *name)
+{
+    if (!ctx->symbols)
+        return 0;
+
+    char sym[IOKIT_MAX_NAME * 2];
+    snprintf (sym, sizeof (sym), fmt, (unsigned) strlen (name), name);
+
+    mach_symbol_info_t *info = h_hash_table_lookup (ctx->symbols, sym);
+    return (info) ? info->value : 0;
+}
+
+/**
+ *  Without symbols, the class vtable is the one that the metaclass's
+ *  alloc() stores into the object it creates: alloc() calls operator new
+ *  with the class size, then the class constructor, which stores the
+ *  vtable last.
+ */
+static uint64_t iokit_vtable_from_alloc (iokit_scan_t *parent, mach_iokit_class_t *cls)
+{
+    iokit_ctx_t *ctx = parent->ctx;
+
+    if (!cls->metaclass_vtable || !cls->size)
+        return 0;
+
+    for (uint32_t slot = 0; slot < IOKIT_MAX_VTABLE_SLOTS; slot++) {
+        uint64_t fn = mach_kext_read_pointer (ctx->kernel, ctx->kexts, cls->metaclass_vtable + slot * 8);
+        if (!fn)
+            break;
+
+        iokit_scan_t scan;
+        memset (&scan, '\0', sizeof (iokit_scan_t));
+        scan.ctx = ctx;
+        scan.res = parent->res;
+        scan.kext = parent->kext;
+        scan.mode = IOKIT_MODE_ALLOC;
+        scan.size = cls->size;
+
+        iokit_regs_t r;
+        r.known = 0;
+        iokit_scan (&scan, fn, &r, 0);
+
+        if (scan.allocated && scan.store)
+            return scan.store;
+    }
+    return 0;
+}
+
+static void iokit_kext_worker (size_t index, void *user_data)
+{
+    iokit_ctx_t *ctx = (iokit_ctx_t *) user_data;
+    iokit_kext_result_t *res = &ctx->results[index];
+
+    iokit_scan_t scan;
+    memset (&scan, '\0', sizeof (iokit_scan_t));
+    scan.ctx = ctx;
+    scan.res = res;
+    scan.kext = (uint32_t) index;
+    scan.mode = ctx->mode;
+
+    uint32_t nfuncs = 0;
+    uint64_t *funcs = iokit_init_funcs (ctx, &ctx->kexts->kexts[index], &nfuncs);
+
+    for (uint32_t i = 0; i < nfuncs; i++) {
+        iokit_regs_t r;
+        r.known = 0;
+        scan.first = res->count;
+        iokit_scan (&scan, funcs[i], &r, 0);
+    }
+    free (funcs);
+
+    if (ctx->mode != IOKIT_MODE_EXTRACT)
+        return;
+
+    for (uint32_t i = 0; i < res->count; i++) {
+        mach_iokit_class_t *cls = &res->classes[i];
+
+        if (!cls->metaclass_vtable) {
+            uint64_t vt = iokit_symbol_value (ctx, "__ZTVN%u%s9MetaClassE", cls->name);
+            cls->metaclass_vtable = (vt) ? vt + 0x10 : 0;
+        }
+
+        uint64_t vt = iokit_symbol_value (ctx, "__ZTV%u%s", cls->name);
+        cls->vtable = (vt) ? vt + 0x10 : iokit_vtable_from_alloc (&scan, cls);
+    }
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Class tables                         									 --*/
+//===-----------------------------------------------------------------------===//
+
+static uint64_t iokit_u64_hash (const void *key)
+{
+    return h_mem_hash (key, sizeof (uint64_t));
+}
+
+static int iokit_u64_equal (const void *a, const void *b)
+{
+    return *(const uint64_t *) a == *(const uint64_t *) b;
+}
+
+
+/**
+ *  Picks the function most often called with a class name string as its
+ *  second argument.
+ */
+static uint64_t iokit_guess_ctor (iokit_ctx_t *ctx, int nthreads)
+{
+    ctx->mode = IOKIT_MODE_COUNT;
+    h_parallel_for (ctx->kexts->count, nthreads, iokit_kext_worker, ctx);
+
+    HHashTable *counts = h_hash_table_new (iokit_u64_hash, iokit_u64_equal);
+    uint64_t best = 0;
+    uintptr_t best_count = 0;
+
+    for (uint32_t k = 0; k < ctx->kexts->count; k++) {
+        iokit_kext_result_t *res = &ctx->results[k];
+        for (uint32_t i = 0; i < res->ntargets; i++) {
+            uintptr_t n = (uintptr_t) h_hash_table_lookup (counts, &res->targets[i]) + 1;
+            h_hash_table_insert (counts, &res->targets[i], (void *) n);
+            if (n > best_count) {
+                best_count = n;
+                best = res->targets[i];
+            }
+        }
+    }
+
+    h_hash_table_destroy (counts);
+    for (uint32_t k = 0; k < ctx->kexts->count; k++) {
+        free (ctx->results[k].targets);
+        memset (&ctx->results[k], '\0', sizeof (iokit_kext_result_t));
+    }
+    return best;
+}
+
+
+/**
+ *  Function:   mach_iokit_classes_load
+ *  -----------------------------------
+ *
+ *  Extracts the IOKit classes registered by every kext in a kernelcache.
+ *
+ *  kernel:     The kernelcache.
+ *  kexts:      Its kexts, from mach_kexts_load().
+ *  nthreads:   Number of threads, or zero to use every CPU.
+ *
+ *  returns:    The class table, free with mach_iokit_classes_free(). It
+ *              refers to `kernel`'s data, so must not outlive it.
+ *
+ */
+mach_iokit_classes_t *mach_iokit_classes_load (macho_t *kernel, mach_kext_list_t *kexts, int nthreads)
+{
+    if (kernel->header->cputype != CPU_TYPE_ARM64) {
+        errorf ("IOKit class extraction is only supported for arm64 kernelcaches\n");
+        return NULL;
+    }
+
+    iokit_ctx_t ctx;
+    memset (&ctx, '\0', sizeof (iokit_ctx_t));
+    ctx.kernel = kernel;
+    ctx.kexts = kexts;
+    ctx.results = calloc (kexts->count, sizeof (iokit_kext_result_t));
+
+    // Symbols, if there are any, from every kext
+    mach_symbol_info_t **syms = calloc (kexts->count, sizeof (mach_symbol_info_t *));
+    for (uint32_t k = 0; k < kexts->count; k++) {
+        uint32_t nsyms = 0;
+        syms[k] = mach_symtab_load_symbol_info (kexts->kexts[k].macho, &nsyms);
+
+        for (uint32_t i = 0; i < nsyms; i++) {
+            if (!syms[k][i].value || !syms[k][i].name)
+                continue;
+            if (!ctx.symbols)
+                ctx.symbols = h_hash_table_new (h_str_hash, h_str_equal);
+            if (!h_hash_table_contains (ctx.symbols, syms[k][i].name))
+                h_hash_table_insert (ctx.symbols, syms[k][i].name, &syms[k][i]);
+        }
+    }
+
+    mach_symbol_info_t *ctor = (ctx.symbols) ? h_hash_table_lookup (ctx.symbols, IOKIT_CTOR_SYMBOL) : NULL;
+    ctx.ctor = (ctor) ? ctor->value : iokit_guess_ctor (&ctx, nthreads);
+
+    mach_iokit_classes_t *classes = calloc (1, sizeof (mach_iokit_classes_t));
+    classes->ctor = ctx.ctor;
+
+    if (ctx.ctor) {
+        ctx.mode = IOKIT_MODE_EXTRACT;
+        h_parallel_for (kexts->count, nthreads, iokit_kext_worker, &ctx);
+    } else {
+        warningf ("Could not find OSMetaClass::OSMetaClass\n");
+    }
+
+    // Merge, in kext order
+    uint32_t total = 0;
+    for (uint32_t k = 0; k < kexts->count; k++)
+        total += ctx.results[k].count;
+
+    classes->classes = calloc (total + 1, sizeof (mach_iokit_class_t));
+    for (uint32_t k = 0; k < kexts->count; k++) {
+        iokit_kext_result_t *res = &ctx.results[k];
+        memcpy (classes->classes + classes->count, res->classes, sizeof (mach_iokit_class_t) * res->count);
+        classes->count += res->count;
+        free (res->classes);
+        free (res->targets);
+    }
+
+    classes->by_name = h_hash_table_sized_new (h_str_hash, h_str_equal, classes->count);
+    classes->by_metaclass = h_hash_table_sized_new (iokit_u64_hash, iokit_u64_equal, classes->count);
+    for (uint32_t i = 0; i < classes->count; i++) {
+        mach_iokit_class_t *cls = &classes->classes[i];
+        if (!h_hash_table_contains (classes->by_name, cls->name))
+            h_hash_table_insert (classes->by_name, (void *) cls->name, cls);
+        if (!h_hash_table_contains (classes->by_metaclass, &cls->metaclass))
+            h_hash_table_insert (classes->by_metaclass, &cls->metaclass, cls);
+    }
+
+    for (uint32_t i = 0; i < classes->count; i++) {
+        mach_iokit_class_t *cls = &classes->classes[i];
+        mach_iokit_class_t *super = (cls->super_metaclass) ?
+            h_hash_table_lookup (classes->by_metaclass, &cls->super_metaclass) : NULL;
+        cls->super = (super) ? (uint32_t) (super - classes->classes) : MACH_IOKIT_NO_CLASS;
+    }
+
+    if (ctx.symbols)
+        h_hash_table_destroy (ctx.symbols);
+    for (uint32_t k = 0; k < kexts->count; k++)
+        free (syms[k]);
+    free (syms);
+    free (ctx.results);
+
+    debugf ("mach_iokit_classes_load: found %d classes\n", classes->count);
+    return classes;
+}
+
+
+void mach_iokit_classes_free (mach_iokit_classes_t *classes)
+{
+    if (!classes) return;
+    h_hash_table_destroy (classes->by_name);
+    h_hash_table_destroy (classes->by_metaclass);
+    free (classes->classes);
+    free (classes);
+}
+
+
+mach_iokit_class_t *mach_iokit_class_find (mach_iokit_classes_t *classes, const char *name)
+{
+    return h_hash_table_lookup (classes->by_name, name);
+}
+
+
+mach_iokit_class_t *mach_iokit_class_find_metaclass (mach_iokit_classes_t *classes, uint64_t metaclass)
+{
+    return h_hash_table_lookup (classes->by_metaclass, &metaclass);
+}
+
+
+void mach_iokit_classes_print (mach_iokit_classes_t *classes, mach_kext_list_t *kexts)
+{
+    for (uint32_t i = 0; i < classes->count; i++) {
+        mach_iokit_class_t *cls = &classes->classes[i];
+        const char *super = (cls->super != MACH_IOKIT_NO_CLASS) ? classes->classes[cls->super].name : "-";
+
+        printf ("0x%016llx  vtab=0x%016llx  size=0x%05x  %s : %s  (%s)\n",
+                (unsigned long long) cls->metaclass, (unsigned long long) cls->vtable,
+                cls->size, cls->name, super, kexts->kexts[cls->kext].name);
+    }
+}
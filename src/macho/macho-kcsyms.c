@@ -0,0 +1,648 @@
+//===--------------------------- macho_kcsyms -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libhelper-macho/macho-kcsyms.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-segment.h"
+#include "libhelper-macho/macho-symbol.h"
+#include "libhelper/hparallel.h"
+#include "libhelper/hperf.h"
+#include "libhelper/htrace.h"
+
+
+#define KCSYMS_CACHE_MAGIC      0x4d59534b      // 'KSYM'
+#define KCSYMS_CACHE_VERSION    1
+
+// On-disk sizes of a kext name offset, a range and a symbol
+#define KCSYMS_CACHE_KEXT_SIZE      4
+#define KCSYMS_CACHE_RANGE_SIZE     20
+#define KCSYMS_CACHE_SYMBOL_SIZE    16
+
+
+/**
+ *  A sorted run of symbols, either one kext's or the result of merging
+ *  two runs.
+ */
+typedef struct kcsyms_run_t {
+    mach_kc_symbol_t    *symbols;
+    uint32_t             count;
+} kcsyms_run_t;
+
+typedef struct kcsyms_build_t {
+    mach_kext_list_t    *kexts;
+    mach_kc_symtab_t    *symtab;
+    int                 *skip;          /* kext shares an earlier kext's symbol table */
+
+    kcsyms_run_t        *runs;
+    kcsyms_run_t        *merged;
+    uint32_t             nruns;
+} kcsyms_build_t;
+
+
+static int kcsyms_symbol_compare (const void *x, const void *y)
+{
+    const mach_kc_symbol_t *a = (const mach_kc_symbol_t *) x;
+    const mach_kc_symbol_t *b = (const mach_kc_symbol_t *) y;
+
+    if (a->addr != b->addr)
+        return (a->addr < b->addr) ? -1 : 1;
+    return strcmp (a->name, b->name);
+}
+
+static int kcsyms_range_compare (const void *x, const void *y)
+{
+    const mach_kc_range_t *a = (const mach_kc_range_t *) x;
+    const mach_kc_range_t *b = (const mach_kc_range_t *) y;
+    return (a->start > b->start) - (a->start < b->start);
+}
+
+static mach_kc_range_t *kcsyms_find_range (mach_kc_symtab_t *symtab, uint64_t addr)
+{
+    uint32_t lo = 0, hi = symtab->nranges;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (symtab->ranges[mid].start <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (!lo || addr >= symtab->ranges[lo - 1].end)
+        return NULL;
+    return &symtab->ranges[lo - 1];
+}
+
+static int kcsyms_uuid (macho_t *macho, uint8_t *uuid)
+{
+    mach_command_info_t *info = mach_lc_find_given_cmd (macho, LC_UUID);
+    if (!info || (uint64_t) info->offset + sizeof (mach_uuid_command_t) > macho->size)
+        return 0;
+
+    mach_uuid_command_t cmd;
+    memcpy (&cmd, macho->data + info->offset, sizeof (mach_uuid_command_t));
+    memcpy (uuid, cmd.uuid, 16);
+    return 1;
+}
+
+/**
+ *  The UUID a kernelcache's table is built and cached under: the kernel's,
+ *  or the first kext's if the kernel has none.
+ */
+static int kcsyms_kc_uuid (macho_t *kernel, mach_kext_list_t *kexts, uint8_t *uuid)
+{
+    if (kcsyms_uuid (kernel, uuid))
+        return 1;
+    return kexts->count && kcsyms_uuid (kexts->kexts[0].macho, uuid);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Building                             									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Collects the segments of every kext. The kernel's __PRELINK segments
+ *  in a prelinked kernelcache cover the kexts, so they're left out.
+ */
+static void kcsyms_load_ranges (mach_kc_symtab_t *symtab, mach_kext_list_t *kexts)
+{
+    uint32_t cap = 0;
+    for (uint32_t i = 0; i < kexts->count; i++)
+        cap += h_slist_length (kexts->kexts[i].macho->scmds);
+
+    symtab->ranges = calloc (cap + 1, sizeof (mach_kc_range_t));
+
+    for (uint32_t i = 0; i < kexts->count; i++) {
+        for (HSList *l = kexts->kexts[i].macho->scmds; l; l = l->next) {
+            mach_segment_command_64_t *seg = ((mach_segment_info_t *) l->data)->segcmd;
+
+            if (!seg->vmsize || !strncmp (seg->segname, "__LINKEDIT", 16) ||
+                (i == 0 && !strncmp (seg->segname, "__PRELINK", 9)))
+                continue;
+
+            mach_kc_range_t *r = &symtab->ranges[symtab->nranges++];
+            r->start = seg->vmaddr;
+            r->end = seg->vmaddr + seg->vmsize;
+            r->kext = i;
+        }
+    }
+
+    qsort (symtab->ranges, symtab->nranges, sizeof (mach_kc_range_t), kcsyms_range_compare);
+
+    // Clip overlaps, so a binary search finds at most one range
+    for (uint32_t i = 1; i < symtab->nranges; i++)
+        if (symtab->ranges[i].start < symtab->ranges[i - 1].end)
+            symtab->ranges[i - 1].end = symtab->ranges[i].start;
+}
+
+/**
+ *  File set entries usually share the collection's symbol table, so only
+ *  the first kext with a given LC_SYMTAB is loaded.
+ */
+static void kcsyms_find_shared (kcsyms_build_t *build)
+{
+    mach_kext_list_t *kexts = build->kexts;
+    uint32_t *symoffs = calloc (kexts->count + 1, sizeof (uint32_t));
+
+    for (uint32_t i = 0; i < kexts->count; i++) {
+        macho_t *macho = kexts->kexts[i].macho;
+        mach_command_info_t *info = mach_lc_find_given_cmd (macho, LC_SYMTAB);
+        if (!info || (uint64_t) info->offset + sizeof (mach_symtab_command_t) > macho->size) {
+            build->skip[i] = 1;
+            continue;
+        }
+
+        mach_symtab_command_t cmd;
+        memcpy (&cmd, macho->data + info->offset, sizeof (mach_symtab_command_t));
+        symoffs[i] = cmd.symoff;
+
+        for (uint32_t j = 0; j < i; j++)
+            if (!build->skip[j] && symoffs[j] == cmd.symoff) {
+                build->skip[i] = 1;
+                break;
+            }
+    }
+    free (symoffs);
+}
+
+static void kcsyms_load_worker (size_t index, void *user_data)
+{
+    kcsyms_build_t *build = (kcsyms_build_t *) user_data;
+    kcsyms_run_t *run = &build->runs[index];
+    if (build->skip[index])
+        return;
+
+    uint32_t nsyms = 0;
+    mach_symbol_info_t *syms = mach_symtab_load_symbol_info (build->kexts->kexts[index].macho, &nsyms);
+    if (!syms)
+        return;
+
+    run->symbols = malloc (sizeof (mach_kc_symbol_t) * nsyms);
+    for (uint32_t i = 0; i < nsyms; i++) {
+        mach_symbol_info_t *s = &syms[i];
+        if ((s->type & N_STAB) || (s->type & N_TYPE) != N_SECT || !s->name[0] ||
+            !strcmp (s->name, "(no name)"))
+            continue;
+
+        // Attribute to the kext that owns the address, not the symbol table
+        mach_kc_range_t *r = kcsyms_find_range (build->symtab, s->value);
+
+        mach_kc_symbol_t *sym = &run->symbols[run->count++];
+        sym->addr = s->value;
+        sym->name = s->name;
+        sym->kext = (r) ? r->kext : (uint32_t) index;
+    }
+    free (syms);
+
+    qsort (run->symbols, run->count, sizeof (mach_kc_symbol_t), kcsyms_symbol_compare);
+}
+
+/**
+ *  Merges runs 2n and 2n+1 into merged[n].
+ */
+static void kcsyms_merge_worker (size_t index, void *user_data)
+{
+    kcsyms_build_t *build = (kcsyms_build_t *) user_data;
+    kcsyms_run_t *a = &build->runs[index * 2];
+    kcsyms_run_t *out = &build->merged[index];
+
+    if (index * 2 + 1 >= build->nruns) {
+        *out = *a;
+        return;
+    }
+
+    kcsyms_run_t *b = &build->runs[index * 2 + 1];
+    out->count = a->count + b->count;
+    out->symbols = malloc (sizeof (mach_kc_symbol_t) * out->count + 1);
+
+    uint32_t i = 0, j = 0, k = 0;
+    while (i < a->count && j < b->count)
+        out->symbols[k++] = (kcsyms_symbol_compare (&a->symbols[i], &b->symbols[j]) <= 0)
+                            ? a->symbols[i++] : b->symbols[j++];
+    while (i < a->count)
+        out->symbols[k++] = a->symbols[i++];
+    while (j < b->count)
+        out->symbols[k++] = b->symbols[j++];
+
+    free (a->symbols);
+    free (b->symbols);
+}
+
+
+/**
+ *  Function:   mach_kc_symtab_build
+ *  --------------------------------
+ *
+ *  Builds an address to symbol table over the kernel and every kext in
+ *  a kernelcache. Each symbol table is loaded and sorted on its own
+ *  thread, and the sorted runs are then merged pairwise, also in
+ *  parallel, until one is left.
+ *
+ *  kernel:     The kernelcache.
+ *  kexts:      Its kexts, from mach_kexts_load().
+ *  nthreads:   Number of threads, or 0 for one per CPU.
+ *
+ *  returns:    The table. Free with mach_kc_symtab_free().
+ *
+ */
+mach_kc_symtab_t *mach_kc_symtab_build (macho_t *kernel, mach_kext_list_t *kexts, int nthreads)
+{
+    h_perf_begin (H_PERF_SYMBOL_INDEX);
+    h_trace_begin ("parse", "mach_kc_symtab_build");
+
+    mach_kc_symtab_t *symtab = calloc (1, sizeof (mach_kc_symtab_t));
+    kcsyms_kc_uuid (kernel, kexts, symtab->uuid);
+
+    // The kext names are copied, so the table outlives the kext list
+    size_t namesize = 0;
+    for (uint32_t i = 0; i < kexts->count; i++)
+        namesize += strlen (kexts->kexts[i].name) + 1;
+
+    symtab->nkexts = kexts->count;
+    symtab->kext_names = calloc (kexts->count + 1, sizeof (char *));
+    symtab->strings = malloc (namesize + 1);
+    for (uint32_t i = 0, off = 0; i < kexts->count; i++) {
+        size_t len = strlen (kexts->kexts[i].name) + 1;
+        memcpy (symtab->strings + off, kexts->kexts[i].name, len);
+        symtab->kext_names[i] = symtab->strings + off;
+        off += len;
+    }
+
+    kcsyms_load_ranges (symtab, kexts);
+
+    kcsyms_build_t build;
+    memset (&build, '\0', sizeof (kcsyms_build_t));
+    build.kexts = kexts;
+    build.symtab = symtab;
+    build.skip = calloc (kexts->count + 1, sizeof (int));
+    build.runs = calloc (kexts->count + 1, sizeof (kcsyms_run_t));
+    build.merged = calloc (kexts->count + 1, sizeof (kcsyms_run_t));
+    build.nruns = kexts->count;
+
+    kcsyms_find_shared (&build);
+    h_parallel_for (kexts->count, nthreads, kcsyms_load_worker, &build);
+
+    while (build.nruns > 1) {
+        uint32_t nmerged = (build.nruns + 1) / 2;
+        h_parallel_for (nmerged, nthreads, kcsyms_merge_worker, &build);
+
+        kcsyms_run_t *tmp = build.runs;
+        build.runs = build.merged;
+        build.merged = tmp;
+        build.nruns = nmerged;
+    }
+
+    if (build.nruns) {
+        symtab->symbols = build.runs[0].symbols;
+        symtab->count = build.runs[0].count;
+    }
+
+    // Drop symbols that appear in more than one symbol table
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < symtab->count; i++) {
+        if (n && !kcsyms_symbol_compare (&symtab->symbols[n - 1], &symtab->symbols[i]))
+            continue;
+        symtab->symbols[n++] = symtab->symbols[i];
+    }
+    symtab->count = n;
+
+    free (build.skip);
+    free (build.runs);
+    free (build.merged);
+
+    debugf ("mach_kc_symtab_build: %d symbols from %d kexts\n", symtab->count, symtab->nkexts);
+
+    h_trace_end ("parse", "mach_kc_symtab_build");
+    h_perf_end (H_PERF_SYMBOL_INDEX);
+    return symtab;
+}
+
+
+void mach_kc_symtab_free (mach_kc_symtab_t *symtab)
+{
+    if (!symtab) return;
+
+    free (symtab->symbols);
+    free (symtab->ranges);
+    free (symtab->kext_names);
+    free (symtab->strings);
+    free (symtab);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Lookup                               									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Function:   mach_kc_symtab_lookup
+ *  ---------------------------------
+ *
+ *  Finds the symbol an address belongs to: the closest symbol at or
+ *  below it within the same segment.
+ *
+ *  symtab:     The kernelcache symbol table.
+ *  addr:       The address, e.g. from a panic backtrace.
+ *  offset:     Set to the offset of `addr` from the symbol, may be NULL.
+ *
+ *  returns:    The symbol, or NULL.
+ *
+ */
+mach_kc_symbol_t *mach_kc_symtab_lookup (mach_kc_symtab_t *symtab, uint64_t addr, uint64_t *offset)
+{
+    mach_kc_range_t *range = kcsyms_find_range (symtab, addr);
+    if (!range)
+        return NULL;
+
+    uint32_t lo = 0, hi = symtab->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (symtab->symbols[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (!lo || symtab->symbols[lo - 1].addr < range->start)
+        return NULL;
+
+    mach_kc_symbol_t *sym = &symtab->symbols[lo - 1];
+
+    // Aliases share an address, prefer the first
+    while (sym > symtab->symbols && (sym - 1)->addr == sym->addr)
+        sym--;
+
+    if (offset)
+        *offset = addr - sym->addr;
+    return sym;
+}
+
+
+const char *mach_kc_symtab_kext_name (mach_kc_symtab_t *symtab, mach_kc_symbol_t *symbol)
+{
+    return (symbol->kext < symtab->nkexts) ? symtab->kext_names[symbol->kext] : NULL;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Serialisation                        									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  On-disk format: a magic, version, kext count, range count, symbol
+ *  count and string table size (all uint32_t), then the UUID. Then the
+ *  string table offset of every kext name, every range as its start, end
+ *  and kext, and every symbol as its address, string table offset and
+ *  kext. The string table comes last.
+ */
+
+/**
+ *  Function:   mach_kc_symtab_write
+ *  --------------------------------
+ *
+ *  Writes a symbol table to `path`. The file is written to a uniquely
+ *  named file next to it and renamed, so readers never see half a file,
+ *  and two writers of the same path can't write over each other.
+ *
+ *  returns:    1 on success, 0 otherwise.
+ *
+ */
+int mach_kc_symtab_write (mach_kc_symtab_t *symtab, const char *path)
+{
+    size_t len = strlen (path) + 8;
+    char *tmp = malloc (len);
+    snprintf (tmp, len, "%s.XXXXXX", path);
+
+    int fd = mkstemp (tmp);
+    FILE *fp = (fd >= 0) ? fdopen (fd, "wb") : NULL;
+    if (!fp) {
+        warningf ("kcsyms: could not write cache file: %s\n", tmp);
+        if (fd >= 0) {
+            close (fd);
+            remove (tmp);
+        }
+        free (tmp);
+        return 0;
+    }
+
+    // mkstemp() makes the file private to its owner
+    fchmod (fd, 0644);
+
+    uint64_t strsize = 0;
+    for (uint32_t i = 0; i < symtab->nkexts; i++)
+        strsize += strlen (symtab->kext_names[i]) + 1;
+    for (uint32_t i = 0; i < symtab->count; i++)
+        strsize += strlen (symtab->symbols[i].name) + 1;
+
+    int ok = (strsize <= UINT32_MAX);
+    uint32_t hdr[6] = { KCSYMS_CACHE_MAGIC, KCSYMS_CACHE_VERSION, symtab->nkexts,
+                        symtab->nranges, symtab->count, (uint32_t) strsize };
+    fwrite (hdr, sizeof (uint32_t), 6, fp);
+    fwrite (symtab->uuid, 1, 16, fp);
+
+    uint32_t stroff = 0;
+    for (uint32_t i = 0; ok && i < symtab->nkexts; i++) {
+        fwrite (&stroff, sizeof (uint32_t), 1, fp);
+        stroff += strlen (symtab->kext_names[i]) + 1;
+    }
+    for (uint32_t i = 0; ok && i < symtab->nranges; i++) {
+        mach_kc_range_t *r = &symtab->ranges[i];
+        fwrite (&r->start, sizeof (uint64_t), 1, fp);
+        fwrite (&r->end, sizeof (uint64_t), 1, fp);
+        fwrite (&r->kext, sizeof (uint32_t), 1, fp);
+    }
+    for (uint32_t i = 0; ok && i < symtab->count; i++) {
+        mach_kc_symbol_t *s = &symtab->symbols[i];
+        fwrite (&s->addr, sizeof (uint64_t), 1, fp);
+        fwrite (&stroff, sizeof (uint32_t), 1, fp);
+        fwrite (&s->kext, sizeof (uint32_t), 1, fp);
+        stroff += strlen (s->name) + 1;
+    }
+
+    for (uint32_t i = 0; ok && i < symtab->nkexts; i++)
+        fwrite (symtab->kext_names[i], 1, strlen (symtab->kext_names[i]) + 1, fp);
+    for (uint32_t i = 0; ok && i < symtab->count; i++)
+        fwrite (symtab->symbols[i].name, 1, strlen (symtab->symbols[i].name) + 1, fp);
+
+    if (ferror (fp))
+        ok = 0;
+    if (fclose (fp) == 0 && ok)
+        ok = !rename (tmp, path);
+    else
+        ok = 0;
+    if (!ok)
+        remove (tmp);
+
+    free (tmp);
+    return ok;
+}
+
+
+static const char *kcsyms_string (mach_kc_symtab_t *symtab, uint32_t strsize, uint32_t offset)
+{
+    if (offset >= strsize || !memchr (symtab->strings + offset, '\0', strsize - offset))
+        return NULL;
+    return symtab->strings + offset;
+}
+
+/**
+ *  Function:   mach_kc_symtab_read
+ *  -------------------------------
+ *
+ *  Reads a symbol table written by mach_kc_symtab_write().
+ *
+ *  path:       The file.
+ *  uuid:       If not NULL, the UUID the table must have been built from.
+ *
+ *  returns:    The table, or NULL if the file is missing, corrupt or for
+ *              another kernelcache.
+ *
+ */
+mach_kc_symtab_t *mach_kc_symtab_read (const char *path, const uint8_t *uuid)
+{
+    FILE *fp = fopen (path, "rb");
+    if (!fp)
+        return NULL;
+
+    mach_kc_symtab_t *symtab = calloc (1, sizeof (mach_kc_symtab_t));
+    uint32_t hdr[6], *kext_offs = NULL;
+
+    if (fread (hdr, sizeof (uint32_t), 6, fp) != 6 ||
+        hdr[0] != KCSYMS_CACHE_MAGIC || hdr[1] != KCSYMS_CACHE_VERSION ||
+        fread (symtab->uuid, 1, 16, fp) != 16 ||
+        (uuid && memcmp (uuid, symtab->uuid, 16)))
+        goto out;
+
+    // The counts aren't trusted until they add up to no more than the
+    // file holds.
+    uint64_t need = sizeof (hdr) + 16 + (uint64_t) hdr[2] * KCSYMS_CACHE_KEXT_SIZE +
+                    (uint64_t) hdr[3] * KCSYMS_CACHE_RANGE_SIZE +
+                    (uint64_t) hdr[4] * KCSYMS_CACHE_SYMBOL_SIZE + hdr[5];
+    long size = (fseek (fp, 0, SEEK_END) == 0) ? ftell (fp) : -1;
+    if (size < 0 || need > (uint64_t) size || fseek (fp, sizeof (hdr) + 16, SEEK_SET))
+        goto bad;
+
+    symtab->kext_names = calloc ((size_t) hdr[2] + 1, sizeof (char *));
+    symtab->ranges = calloc ((size_t) hdr[3] + 1, sizeof (mach_kc_range_t));
+    symtab->symbols = calloc ((size_t) hdr[4] + 1, sizeof (mach_kc_symbol_t));
+    symtab->strings = malloc ((size_t) hdr[5] + 1);
+    kext_offs = calloc ((size_t) hdr[2] + 1, sizeof (uint32_t));
+    if (!symtab->kext_names || !symtab->ranges || !symtab->symbols || !symtab->strings || !kext_offs)
+        goto bad;
+    symtab->nkexts = hdr[2];
+
+    if (fread (kext_offs, sizeof (uint32_t), hdr[2], fp) != hdr[2])
+        goto bad;
+
+    for (uint32_t i = 0; i < hdr[3]; i++) {
+        mach_kc_range_t *r = &symtab->ranges[i];
+        if (fread (&r->start, sizeof (uint64_t), 1, fp) != 1 ||
+            fread (&r->end, sizeof (uint64_t), 1, fp) != 1 ||
+            fread (&r->kext, sizeof (uint32_t), 1, fp) != 1)
+            goto bad;
+    }
+    symtab->nranges = hdr[3];
+
+    // Name offsets are parked in `name` until the strings are read
+    for (uint32_t i = 0; i < hdr[4]; i++) {
+        mach_kc_symbol_t *s = &symtab->symbols[i];
+        uint32_t stroff;
+        if (fread (&s->addr, sizeof (uint64_t), 1, fp) != 1 ||
+            fread (&stroff, sizeof (uint32_t), 1, fp) != 1 ||
+            fread (&s->kext, sizeof (uint32_t), 1, fp) != 1)
+            goto bad;
+        s->name = (const char *) (uintptr_t) stroff;
+    }
+
+    if (fread (symtab->strings, 1, hdr[5], fp) != hdr[5])
+        goto bad;
+
+    for (uint32_t i = 0; i < hdr[2]; i++)
+        if (!(symtab->kext_names[i] = kcsyms_string (symtab, hdr[5], kext_offs[i])))
+            goto bad;
+    for (uint32_t i = 0; i < hdr[4]; i++) {
+        mach_kc_symbol_t *s = &symtab->symbols[i];
+        if (!(s->name = kcsyms_string (symtab, hdr[5], (uint32_t) (uintptr_t) s->name)))
+            goto bad;
+    }
+    symtab->count = hdr[4];
+
+    free (kext_offs);
+    fclose (fp);
+    return symtab;
+
+bad:
+    warningf ("kcsyms: ignoring corrupt cache file\n");
+out:
+    free (kext_offs);
+    fclose (fp);
+    mach_kc_symtab_free (symtab);
+    return NULL;
+}
+
+
+/**
+ *  Function:   mach_kc_symtab_load
+ *  -------------------------------
+ *
+ *  Returns the symbol table for a kernelcache, from `cache_dir` if it was
+ *  built before, otherwise building it and saving it there. The cache
+ *  file is named after the kernelcache's UUID.
+ *
+ *  kernel:     The kernelcache.
+ *  kexts:      Its kexts, from mach_kexts_load().
+ *  nthreads:   Number of threads, or 0 for one per CPU.
+ *  cache_dir:  Cache directory, or NULL to always build.
+ *
+ *  returns:    The table. Free with mach_kc_symtab_free().
+ *
+ */
+mach_kc_symtab_t *mach_kc_symtab_load (macho_t *kernel, mach_kext_list_t *kexts, int nthreads,
+                                       const char *cache_dir)
+{
+    uint8_t uuid[16];
+    if (!cache_dir || !kcsyms_kc_uuid (kernel, kexts, uuid))
+        return mach_kc_symtab_build (kernel, kexts, nthreads);
+
+    size_t len = strlen (cache_dir) + 48;
+    char *path = malloc (len);
+    int n = snprintf (path, len, "%s/", cache_dir);
+    for (int i = 0; i < 16; i++)
+        n += snprintf (path + n, len - n, "%02X", uuid[i]);
+    snprintf (path + n, len - n, ".kcsyms");
+
+    mach_kc_symtab_t *symtab = mach_kc_symtab_read (path, uuid);
+    if (!symtab) {
+        symtab = mach_kc_symtab_build (kernel, kexts, nthreads);
+        mach_kc_symtab_write (symtab, path);
+    }
+
+    free (path);
+    return symtab;
+}
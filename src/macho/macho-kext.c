@@ -0,0 +1,321 @@
+//===----------------------------- macho_kext -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper-macho/macho-kext.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-segment.h"
+
+#define KEXT_KERNEL_NAME        "com.apple.kernel"
+#define KEXT_PLIST_MAX_DEPTH    64
+
+
+static char *kext_strndup (const char *s, size_t len)
+{
+    char *r = malloc (len + 1);
+    memcpy (r, s, len);
+    r[len] = '\0';
+    return r;
+}
+
+static void kext_list_append (mach_kext_list_t *list, macho_t *kernel, char *name, uint32_t offset)
+{
+    macho_t *macho = (offset) ? macho_create_embedded (kernel, offset) : kernel;
+    if (!macho) {
+        warningf ("Skipping kext %s at offset 0x%x\n", name, offset);
+        free (name);
+        return;
+    }
+
+    list->kexts = realloc (list->kexts, sizeof (mach_kext_t) * (list->count + 1));
+
+    mach_kext_t *kext = &list->kexts[list->count++];
+    kext->name = name;
+    kext->offset = offset;
+    kext->vmaddr = mach_offset_to_vmaddr (kernel, offset);
+    kext->macho = macho;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- File sets                            									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void kext_load_fileset (mach_kext_list_t *list, macho_t *kernel)
+{
+    for (HSList *l = kernel->lcmds; l; l = l->next) {
+        mach_command_info_t *info = (mach_command_info_t *) l->data;
+        if (info->type != LC_FILESET_ENTRY)
+            continue;
+
+        mach_fileset_entry_command_t cmd;
+        memcpy (&cmd, kernel->data + info->offset, sizeof (mach_fileset_entry_command_t));
+
+        if (cmd.entry_id >= cmd.cmdsize || cmd.fileoff > UINT32_MAX) {
+            warningf ("Malformed LC_FILESET_ENTRY at offset 0x%x\n", info->offset);
+            continue;
+        }
+
+        const char *id = (const char *) kernel->data + info->offset + cmd.entry_id;
+        const char *nul = memchr (id, '\0', cmd.cmdsize - cmd.entry_id);
+        size_t len = (nul) ? (size_t) (nul - id) : cmd.cmdsize - cmd.entry_id;
+        char *name = kext_strndup (id, len);
+
+        // Keep the kernel at the front of the list
+        kext_list_append (list, kernel, name, (uint32_t) cmd.fileoff);
+        if (!strcmp (name, KEXT_KERNEL_NAME) && list->count > 1) {
+            mach_kext_t kext = list->kexts[list->count - 1];
+            memmove (&list->kexts[1], &list->kexts[0], sizeof (mach_kext_t) * (list->count - 1));
+            list->kexts[0] = kext;
+        }
+    }
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Prelinked kernelcaches               									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Walks the __PRELINK_INFO plist just far enough to pair each kext's
+ *  CFBundleIdentifier with its _PrelinkExecutableLoadAddr. The two keys
+ *  must be in the same <dict>, which keeps the bundle identifiers of
+ *  nested IOKitPersonalities dicts from getting mixed in.
+ */
+static void kext_load_prelinked (mach_kext_list_t *list, macho_t *kernel)
+{
+    mach_segment_info_t *seg = mach_segment_info_search (kernel->scmds, "__PRELINK_INFO");
+    if (!seg || !seg->segcmd->filesize ||
+        seg->segcmd->fileoff + seg->segcmd->filesize > kernel->size)
+        return;
+
+    const char *p = (const char *) kernel->data + seg->segcmd->fileoff;
+    const char *end = p + seg->segcmd->filesize;
+
+    struct {
+        const char  *id;
+        size_t       idlen;
+        uint64_t     addr;
+    } stack[KEXT_PLIST_MAX_DEPTH];
+    int depth = 0;
+
+    enum { KEY_OTHER, KEY_ID, KEY_ADDR } key = KEY_OTHER;
+
+    while (p < end && (p = memchr (p, '<', end - p))) {
+        const char *tag = ++p;
+        const char *close = memchr (p, '>', end - p);
+        if (!close)
+            break;
+        p = close + 1;
+
+        size_t taglen = close - tag;
+        int empty = (taglen && close[-1] == '/');
+
+        // Text between this tag and the next one
+        const char *text = p;
+        const char *text_end = memchr (p, '<', end - p);
+        if (!text_end)
+            text_end = end;
+
+        if (taglen >= 4 && !strncmp (tag, "dict", 4) && !empty) {
+            if (depth < KEXT_PLIST_MAX_DEPTH)
+                memset (&stack[depth], '\0', sizeof (stack[0]));
+            depth++;
+            key = KEY_OTHER;
+
+        } else if (taglen >= 5 && !strncmp (tag, "/dict", 5)) {
+            if (depth > 0 && --depth < KEXT_PLIST_MAX_DEPTH && stack[depth].id && stack[depth].addr) {
+                uint64_t offset = mach_vmaddr_to_offset (kernel, stack[depth].addr);
+                if (offset != MACH_ADDR_INVALID && offset && offset <= UINT32_MAX)
+                    kext_list_append (list, kernel, kext_strndup (stack[depth].id, stack[depth].idlen),
+                                      (uint32_t) offset);
+            }
+            key = KEY_OTHER;
+
+        } else if (taglen >= 3 && !strncmp (tag, "key", 3)) {
+            size_t len = text_end - text;
+            if (len == 18 && !strncmp (text, "CFBundleIdentifier", len))
+                key = KEY_ID;
+            else if (len == 26 && !strncmp (text, "_PrelinkExecutableLoadAddr", len))
+                key = KEY_ADDR;
+            else
+                key = KEY_OTHER;
+
+        } else if (tag[0] == '/') {
+            // Closing tags don't change which key we're on
+
+        } else {
+            int top = depth - 1;
+            if (top >= 0 && top < KEXT_PLIST_MAX_DEPTH && !empty) {
+                if (key == KEY_ID && taglen >= 6 && !strncmp (tag, "string", 6)) {
+                    stack[top].id = text;
+                    stack[top].idlen = text_end - text;
+                } else if (key == KEY_ADDR && taglen >= 7 && !strncmp (tag, "integer", 7)) {
+                    char buf[32];
+                    size_t len = text_end - text;
+                    if (len >= sizeof (buf))
+                        len = sizeof (buf) - 1;
+                    memcpy (buf, text, len);
+                    buf[len] = '\0';
+                    stack[top].addr = strtoull (buf, NULL, 0);
+                }
+            }
+            key = KEY_OTHER;
+        }
+    }
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Kext lists                           									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Function:   mach_kexts_load
+ *  ---------------------------
+ *
+ *  Enumerates the kexts in a kernelcache. The kernel is always the first
+ *  entry, and for merged kernelcaches it is the only one.
+ *
+ *  kernel:     The kernelcache.
+ *
+ *  returns:    The list of kexts, free with mach_kexts_free().
+ *
+ */
+mach_kext_list_t *mach_kexts_load (macho_t *kernel)
+{
+    mach_kext_list_t *list = calloc (1, sizeof (mach_kext_list_t));
+    list->fileset = (kernel->header->filetype == MACH_TYPE_FILESET);
+
+    list->base = mach_offset_to_vmaddr (kernel, 0);
+    if (list->base == MACH_ADDR_INVALID)
+        list->base = 0;
+
+    if (list->fileset) {
+        kext_load_fileset (list, kernel);
+    } else {
+        kext_list_append (list, kernel, kext_strndup (KEXT_KERNEL_NAME, strlen (KEXT_KERNEL_NAME)), 0);
+        kext_load_prelinked (list, kernel);
+    }
+
+    debugf ("mach_kexts_load: found %d kexts\n", list->count);
+    return list;
+}
+
+
+void mach_kexts_free (mach_kext_list_t *list)
+{
+    if (!list) return;
+    for (uint32_t i = 0; i < list->count; i++) {
+        // The entry at offset 0 is the kernel itself, which the caller owns
+        if (list->kexts[i].offset)
+            macho_free (list->kexts[i].macho);
+        free (list->kexts[i].name);
+    }
+    free (list->kexts);
+    free (list);
+}
+
+
+mach_kext_t *mach_kext_find (mach_kext_list_t *list, const char *name)
+{
+    for (uint32_t i = 0; i < list->count; i++)
+        if (!strcmp (list->kexts[i].name, name))
+            return &list->kexts[i];
+    return NULL;
+}
+
+
+/**
+ *  Function:   mach_kext_containing
+ *  --------------------------------
+ *
+ *  Finds the kext with a segment containing `vmaddr`. In prelinked
+ *  kernelcaches the kernel's __PRELINK_TEXT covers every kext, so the
+ *  kernel is only checked last.
+ *
+ */
+mach_kext_t *mach_kext_containing (mach_kext_list_t *list, uint64_t vmaddr)
+{
+    for (uint32_t n = 1; n <= list->count; n++) {
+        mach_kext_t *kext = &list->kexts[n % list->count];
+
+        for (HSList *l = kext->macho->scmds; l; l = l->next) {
+            mach_segment_command_64_t *seg = ((mach_segment_info_t *) l->data)->segcmd;
+
+            // File set entries all share the one __LINKEDIT
+            if (!strncmp (seg->segname, "__LINKEDIT", 16))
+                continue;
+            if (vmaddr >= seg->vmaddr && vmaddr - seg->vmaddr < seg->vmsize)
+                return kext;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ *  Function:   mach_kext_untag_pointer
+ *  -----------------------------------
+ *
+ *  Pointers in arm64e kernelcaches are stored as chained fixups rather
+ *  than plain addresses. File sets use the kernel collection format, a
+ *  30-bit offset from the base of the collection. Older kernelcaches use
+ *  the arm64e format, where authenticated pointers hold a 32-bit offset
+ *  and the rest hold a 51-bit address that is sign-extended here, since
+ *  kernel addresses have the top bits set.
+ *
+ *  list:       The kernelcache's kext list.
+ *  raw:        The pointer as stored in the file.
+ *
+ *  returns:    The VM address it refers to.
+ *
+ */
+uint64_t mach_kext_untag_pointer (mach_kext_list_t *list, uint64_t raw)
+{
+    if (!raw || (raw >> 48) == 0xffff)
+        return raw;
+
+    if (list->fileset)
+        return list->base + (raw & 0x3fffffff);
+    if (raw >> 63)
+        return list->base + (raw & 0xffffffff);
+    return (uint64_t) ((int64_t) (raw << 13) >> 13);
+}
+
+
+/**
+ *  Reads and untags the pointer stored at `vmaddr`. Returns zero if the
+ *  address isn't backed by the file.
+ */
+uint64_t mach_kext_read_pointer (macho_t *kernel, mach_kext_list_t *list, uint64_t vmaddr)
+{
+    uint64_t offset = mach_vmaddr_to_offset (kernel, vmaddr);
+    if (offset == MACH_ADDR_INVALID || offset + 8 > kernel->size)
+        return 0;
+
+    uint64_t raw;
+    memcpy (&raw, kernel->data + offset, sizeof (uint64_t));
+    return mach_kext_untag_pointer (list, raw);
+}
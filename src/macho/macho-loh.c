@@ -0,0 +1,237 @@
+//===----------------------------- macho_loh --------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper-macho/macho-loh.h"
+#include "libhelper-macho/macho-arm64.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-leb128.h"
+
+
+static int mach_loh_index_compare (const void *x, const void *y)
+{
+    const mach_loh_index_t *a = x, *b = y;
+    return (a->addr < b->addr) ? -1 : (a->addr > b->addr);
+}
+
+
+/**
+ *  Function:   mach_loh_table_load
+ *  -------------------------------
+ *
+ *  Decodes the LC_LINKER_OPTIMIZATION_HINT payload of a Mach-O, and
+ *  indexes every instruction address it mentions. Hints with an unknown
+ *  kind or more addresses than any known kind uses are skipped.
+ *
+ *  macho:      The Mach-O containing an LC_LINKER_OPTIMIZATION_HINT command.
+ *
+ *  returns:    The hint table, or NULL if there are no hints.
+ *
+ */
+mach_loh_table_t *mach_loh_table_load (macho_t *macho)
+{
+    mach_command_info_t *cmdinfo = mach_lc_find_given_cmd (macho, LC_LINKER_OPTIMIZATION_HINT);
+    if (!cmdinfo)
+        return NULL;
+
+    mach_linkedit_data_command_t cmd;
+    memcpy (&cmd, macho->data + cmdinfo->offset, sizeof (mach_linkedit_data_command_t));
+
+    if ((uint64_t) cmd.dataoff + cmd.datasize > macho->size) {
+        errorf ("LC_LINKER_OPTIMIZATION_HINT data lies outside of the file\n");
+        return NULL;
+    }
+
+    const uint8_t *p = macho->data + cmd.dataoff;
+    const uint8_t *end = p + cmd.datasize;
+
+    // Every hint is at least three bytes, and every address at least one
+    mach_loh_table_t *table = calloc (1, sizeof (mach_loh_table_t));
+    table->hints = malloc (sizeof (mach_loh_t) * (cmd.datasize / 3 + 1));
+    table->index = malloc (sizeof (mach_loh_index_t) * (cmd.datasize + 1));
+
+    while (p < end) {
+        uint64_t kind = mach_read_uleb128 (&p, end);
+        if (!kind)
+            break;
+        uint64_t count = mach_read_uleb128 (&p, end);
+
+        mach_loh_t hint;
+        memset (&hint, '\0', sizeof (mach_loh_t));
+        hint.kind = (uint32_t) kind;
+        hint.count = (uint32_t) count;
+
+        for (uint64_t i = 0; i < count && p < end; i++) {
+            uint64_t addr = mach_read_uleb128 (&p, end);
+            if (i < MACH_LOH_MAX_ARGS)
+                hint.addrs[i] = addr;
+        }
+
+        if (kind > LOH_ARM64_ADRP_LDR_GOT || count < 2 || count > MACH_LOH_MAX_ARGS) {
+            debugf ("mach_loh_table_load: skipping hint kind %llu with %llu addresses\n",
+                    (unsigned long long) kind, (unsigned long long) count);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < hint.count; i++) {
+            mach_loh_index_t *ix = &table->index[table->nindex++];
+            ix->addr = hint.addrs[i];
+            ix->hint = table->count;
+            ix->position = i;
+        }
+        table->hints[table->count++] = hint;
+    }
+
+    if (!table->count) {
+        mach_loh_table_free (table);
+        return NULL;
+    }
+
+    qsort (table->index, table->nindex, sizeof (mach_loh_index_t), mach_loh_index_compare);
+    return table;
+}
+
+
+void mach_loh_table_free (mach_loh_table_t *table)
+{
+    if (!table) return;
+    free (table->hints);
+    free (table->index);
+    free (table);
+}
+
+
+/**
+ *  Function:   mach_loh_lookup
+ *  ---------------------------
+ *
+ *  Finds the hint that covers an instruction. An instruction can appear
+ *  in more than one hint (an ADRP shared by two loads, say), in which case
+ *  the first is returned.
+ *
+ *  table:      The hint table.
+ *  addr:       VM address of the instruction.
+ *  position:   Optional, set to the position of `addr` within the hint.
+ *
+ *  returns:    The hint, or NULL.
+ *
+ */
+mach_loh_t *mach_loh_lookup (mach_loh_table_t *table, uint64_t addr, uint32_t *position)
+{
+    if (!table)
+        return NULL;
+
+    uint32_t lo = 0, hi = table->nindex;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (table->index[mid].addr < addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == table->nindex || table->index[lo].addr != addr)
+        return NULL;
+
+    if (position)
+        *position = table->index[lo].position;
+    return &table->hints[table->index[lo].hint];
+}
+
+
+static int mach_loh_read_insn (macho_t *macho, uint64_t addr, uint32_t *insn)
+{
+    uint64_t offset = mach_vmaddr_to_offset (macho, addr);
+    if (offset == MACH_ADDR_INVALID || offset + 4 > macho->size)
+        return 0;
+
+    const uint8_t *p = macho->data + offset;
+    *insn = (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    return 1;
+}
+
+
+/**
+ *  Function:   mach_loh_resolve
+ *  ----------------------------
+ *
+ *  Computes the address formed by the ADRP and the following ADD or
+ *  LDR/STR of the hint covering `addr`, without any register tracking.
+ *  For the GOT kinds this is the address of the GOT slot. The
+ *  instructions are checked, so a stale hint is never trusted.
+ *
+ *  macho:      The Mach-O the hints were loaded from.
+ *  table:      The hint table.
+ *  addr:       VM address of any instruction in the hint.
+ *
+ *  returns:    The target address, or MACH_ADDR_INVALID.
+ *
+ */
+uint64_t mach_loh_resolve (macho_t *macho, mach_loh_table_t *table, uint64_t addr)
+{
+    mach_loh_t *hint = mach_loh_lookup (table, addr, NULL);
+    if (!hint || hint->kind == LOH_ARM64_ADRP_ADRP)
+        return MACH_ADDR_INVALID;
+
+    uint32_t adrp, second;
+    if (!mach_loh_read_insn (macho, hint->addrs[0], &adrp) ||
+        !mach_loh_read_insn (macho, hint->addrs[1], &second))
+        return MACH_ADDR_INVALID;
+
+    if (!arm64_is_adrp (adrp) || arm64_rn (second) != arm64_rd (adrp))
+        return MACH_ADDR_INVALID;
+
+    uint64_t page = arm64_adrp_target (hint->addrs[0], adrp);
+    if (arm64_is_add_imm (second))
+        return page + arm64_add_imm (second);
+    if (arm64_is_ldst_uimm (second))
+        return page + arm64_ldst_imm (second);
+
+    return MACH_ADDR_INVALID;
+}
+
+
+char *mach_loh_kind_string (uint32_t kind)
+{
+    switch (kind) {
+        case LOH_ARM64_ADRP_ADRP:
+            return "AdrpAdrp";
+        case LOH_ARM64_ADRP_LDR:
+            return "AdrpLdr";
+        case LOH_ARM64_ADRP_ADD_LDR:
+            return "AdrpAddLdr";
+        case LOH_ARM64_ADRP_LDR_GOT_LDR:
+            return "AdrpLdrGotLdr";
+        case LOH_ARM64_ADRP_ADD_STR:
+            return "AdrpAddStr";
+        case LOH_ARM64_ADRP_LDR_GOT_STR:
+            return "AdrpLdrGotStr";
+        case LOH_ARM64_ADRP_ADD:
+            return "AdrpAdd";
+        case LOH_ARM64_ADRP_LDR_GOT:
+            return "AdrpLdrGot";
+        default:
+            return "Unknown";
+    }
+}
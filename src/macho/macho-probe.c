@@ -0,0 +1,313 @@
+//===---------------------------- macho_probe -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libhelper-macho/macho-probe.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+
+
+#define PROBE_READ_SIZE         4096
+#define PROBE_MAX_CMDS_SIZE     (16 * 1024 * 1024)
+#define PROBE_MAX_ARCHS         20
+
+
+/**
+ *  pread() until `size` bytes are read or the file ends. Returns the
+ *  number of bytes read.
+ */
+static size_t probe_read (int fd, void *buf, size_t size, uint64_t offset)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread (fd, (uint8_t *) buf + done, size - done, (off_t) (offset + done));
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+
+/**
+ *  Fills in the summary of one slice from its load commands. Every
+ *  command is bounds checked against the region, and the walk stops at
+ *  the first malformed one.
+ */
+static void probe_parse_commands (mach_probe_arch_t *arch, uint32_t hdrsize)
+{
+    uint8_t *lc = arch->lcmds + hdrsize;
+    uint32_t size = arch->header.sizeofcmds;
+    uint32_t cap = 0;
+
+    for (uint32_t i = 0, off = 0; i < arch->header.ncmds && off + 8 <= size; i++) {
+        mach_load_command_t cmd;
+        memcpy (&cmd, lc + off, sizeof (mach_load_command_t));
+        if (cmd.cmdsize < 8 || cmd.cmdsize > size - off)
+            break;
+
+        uint8_t *p = lc + off;
+        switch (cmd.cmd) {
+            case LC_UUID:
+                if (cmd.cmdsize >= sizeof (mach_uuid_command_t)) {
+                    memcpy (arch->uuid, p + offsetof (mach_uuid_command_t, uuid), 16);
+                    arch->has_uuid = 1;
+                }
+                break;
+
+            case LC_BUILD_VERSION:
+                if (cmd.cmdsize >= sizeof (mach_build_version_command_t)) {
+                    mach_build_version_command_t bvc;
+                    memcpy (&bvc, p, sizeof (mach_build_version_command_t));
+                    arch->platform = bvc.platform;
+                    arch->minos = bvc.minos;
+                    arch->sdk = bvc.sdk;
+                }
+                break;
+
+            case LC_VERSION_MIN_MACOSX:
+            case LC_VERSION_MIN_IPHONEOS:
+            case LC_VERSION_MIN_TVOS:
+            case LC_VERSION_MIN_WATCHOS:
+                // LC_BUILD_VERSION takes precedence
+                if (!arch->platform && cmd.cmdsize >= sizeof (mach_version_min_command_t)) {
+                    mach_version_min_command_t vmc;
+                    memcpy (&vmc, p, sizeof (mach_version_min_command_t));
+                    arch->platform = (cmd.cmd == LC_VERSION_MIN_MACOSX) ? PLATFORM_MACOS :
+                                     (cmd.cmd == LC_VERSION_MIN_IPHONEOS) ? PLATFORM_IOS :
+                                     (cmd.cmd == LC_VERSION_MIN_TVOS) ? PLATFORM_TVOS : PLATFORM_WATCHOS;
+                    arch->minos = vmc.version;
+                    arch->sdk = vmc.sdk;
+                }
+                break;
+
+            case LC_ENCRYPTION_INFO:
+            case LC_ENCRYPTION_INFO_64:
+                if (cmd.cmdsize >= offsetof (mach_crypto_command_64_t, pad)) {
+                    uint32_t cryptid;
+                    memcpy (&cryptid, p + offsetof (mach_crypto_command_64_t, cryptid), sizeof (uint32_t));
+                    arch->encrypted = (cryptid != 0);
+                }
+                break;
+
+            case LC_ID_DYLIB:
+            case LC_LOAD_DYLIB:
+            case LC_LOAD_WEAK_DYLIB:
+            case LC_REEXPORT_DYLIB:
+            case LC_LAZY_LOAD_DYLIB:
+            case LC_LOAD_UPWARD_DYLIB: {
+                if (cmd.cmdsize < sizeof (mach_dylib_command_t))
+                    break;
+
+                uint32_t stroff;
+                memcpy (&stroff, p + 8, sizeof (uint32_t));
+                if (stroff >= cmd.cmdsize || !memchr (p + stroff, '\0', cmd.cmdsize - stroff))
+                    break;
+
+                const char *name = (const char *) p + stroff;
+                if (cmd.cmd == LC_ID_DYLIB) {
+                    arch->install_name = name;
+                    break;
+                }
+
+                if (arch->ndylibs == cap) {
+                    cap = (cap) ? cap * 2 : 16;
+                    arch->dylibs = realloc (arch->dylibs, sizeof (char *) * cap);
+                }
+                arch->dylibs[arch->ndylibs++] = name;
+                break;
+            }
+        }
+
+        off += cmd.cmdsize;
+    }
+}
+
+
+/**
+ *  Reads the header and load commands of the Mach-O at `offset`. `buf`
+ *  holds the first `got` bytes at that offset, so only load command
+ *  regions that don't fit need a second read.
+ */
+static int probe_arch (int fd, mach_probe_arch_t *arch, uint8_t *buf, size_t got, uint64_t offset)
+{
+    uint32_t magic;
+    if (got < sizeof (uint32_t))
+        return 0;
+    memcpy (&magic, buf, sizeof (uint32_t));
+
+    // Only native byte order Mach-Os are handled, as in macho_load()
+    uint32_t hdrsize;
+    if (magic == MACH_MAGIC_64)
+        hdrsize = sizeof (mach_header_t);
+    else if (magic == MACH_MAGIC_32)
+        hdrsize = sizeof (mach_header_t) - sizeof (uint32_t);
+    else
+        return 0;
+
+    if (got < hdrsize)
+        return 0;
+
+    memcpy (&arch->header, buf, hdrsize);
+    if (arch->header.sizeofcmds > PROBE_MAX_CMDS_SIZE)
+        return 0;
+
+    size_t total = (size_t) hdrsize + arch->header.sizeofcmds;
+    arch->lcmds = malloc (total);
+    memcpy (arch->lcmds, buf, (got < total) ? got : total);
+
+    if (got < total && probe_read (fd, arch->lcmds + got, total - got, offset + got) != total - got) {
+        free (arch->lcmds);
+        arch->lcmds = NULL;
+        return 0;
+    }
+
+    arch->offset = (uint32_t) offset;
+    probe_parse_commands (arch, hdrsize);
+    return 1;
+}
+
+
+/**
+ *  Function:   macho_probe_fd
+ *  --------------------------
+ *
+ *  Same as macho_probe(), for a file that's already open. The file
+ *  position isn't changed.
+ *
+ */
+mach_probe_t *macho_probe_fd (int fd)
+{
+    struct stat st;
+    if (fstat (fd, &st))
+        return NULL;
+
+    uint8_t *buf = malloc (PROBE_READ_SIZE);
+    size_t got = probe_read (fd, buf, PROBE_READ_SIZE, 0);
+
+    mach_probe_t *probe = calloc (1, sizeof (mach_probe_t));
+    probe->size = st.st_size;
+    probe->type = MH_TYPE_UNKNOWN;
+
+    uint32_t magic = 0;
+    if (got >= sizeof (uint32_t))
+        memcpy (&magic, buf, sizeof (uint32_t));
+
+    if (mach_header_verify (magic) == MH_TYPE_FAT && got >= sizeof (fat_header_t)) {
+        fat_header_t fat;
+        memcpy (&fat, buf, sizeof (fat_header_t));
+        swap_header_bytes (&fat);
+
+        // 0xcafebabe is also the Java class file magic, where the next
+        // word is the class file version: 45 and up. Real FAT files have
+        // far fewer slices, so this uses the same limit as lh_identify()
+        if (fat.nfat_arch && fat.nfat_arch <= PROBE_MAX_ARCHS &&
+            sizeof (fat_header_t) + fat.nfat_arch * sizeof (struct fat_arch) <= got) {
+
+            probe->type = MH_TYPE_FAT;
+            probe->archs = calloc (fat.nfat_arch, sizeof (mach_probe_arch_t));
+
+            uint8_t *slice = malloc (PROBE_READ_SIZE);
+            for (uint32_t i = 0; i < fat.nfat_arch; i++) {
+                struct fat_arch fa;
+                memcpy (&fa, buf + sizeof (fat_header_t) + i * sizeof (struct fat_arch), sizeof (struct fat_arch));
+                swap_fat_arch_bytes (&fa);
+
+                mach_probe_arch_t *arch = &probe->archs[probe->narchs];
+                size_t n = probe_read (fd, slice, PROBE_READ_SIZE, fa.offset);
+                if (probe_arch (fd, arch, slice, n, fa.offset)) {
+                    arch->size = fa.size;
+                    probe->narchs++;
+                }
+            }
+            free (slice);
+        }
+    } else {
+        mach_probe_arch_t *arch = calloc (1, sizeof (mach_probe_arch_t));
+        if (probe_arch (fd, arch, buf, got, 0)) {
+            probe->type = mach_header_verify (magic);
+            probe->archs = arch;
+            probe->narchs = 1;
+            arch->size = (uint32_t) st.st_size;
+        } else {
+            free (arch);
+        }
+    }
+
+    free (buf);
+    return probe;
+}
+
+
+/**
+ *  Function:   macho_probe
+ *  -----------------------
+ *
+ *  Summarises a Mach-O or universal binary by reading only its headers
+ *  and load commands.
+ *
+ *  path:       The file.
+ *
+ *  returns:    The summary, with type MH_TYPE_UNKNOWN if the file isn't a
+ *              Mach-O, or NULL if it can't be opened. Free with
+ *              macho_probe_free().
+ *
+ */
+mach_probe_t *macho_probe (const char *path)
+{
+    int fd = open (path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    mach_probe_t *probe = macho_probe_fd (fd);
+    close (fd);
+    return probe;
+}
+
+
+void macho_probe_free (mach_probe_t *probe)
+{
+    if (!probe) return;
+
+    for (uint32_t i = 0; i < probe->narchs; i++) {
+        free (probe->archs[i].dylibs);
+        free (probe->archs[i].lcmds);
+    }
+    free (probe->archs);
+    free (probe);
+}
+
+
+mach_probe_arch_t *macho_probe_find_arch (mach_probe_t *probe, cpu_type_t cputype)
+{
+    for (uint32_t i = 0; i < probe->narchs; i++)
+        if (probe->archs[i].header.cputype == cputype)
+            return &probe->archs[i];
+    return NULL;
+}
@@ -0,0 +1,236 @@
+//===--------------------------- macho_ranges -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper-macho/macho-ranges.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Range sets                           									 --*/
+//===-----------------------------------------------------------------------===//
+
+mach_range_set_t *mach_range_set_create ()
+{
+    mach_range_set_t *set = calloc (1, sizeof (mach_range_set_t));
+    set->sorted = 1;
+    return set;
+}
+
+
+void mach_range_set_add (mach_range_set_t *set, uint64_t start, uint64_t end, uint32_t flags)
+{
+    if (end <= start)
+        return;
+
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 64;
+        set->ranges = realloc (set->ranges, sizeof (mach_range_t) * set->capacity);
+    }
+
+    mach_range_t *r = &set->ranges[set->count++];
+    r->start = start;
+    r->end = end;
+    r->flags = flags;
+    set->sorted = 0;
+}
+
+
+static int mach_range_compare (const void *x, const void *y)
+{
+    const mach_range_t *a = x, *b = y;
+    return (a->start < b->start) ? -1 : (a->start > b->start);
+}
+
+/**
+ *  Sorts the set by start address and merges any ranges that overlap or
+ *  touch, combining their flags.
+ */
+void mach_range_set_finalise (mach_range_set_t *set)
+{
+    if (set->sorted)
+        return;
+
+    qsort (set->ranges, set->count, sizeof (mach_range_t), mach_range_compare);
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < set->count; i++) {
+        mach_range_t *r = &set->ranges[i];
+        if (n && r->start <= set->ranges[n - 1].end) {
+            mach_range_t *last = &set->ranges[n - 1];
+            if (r->end > last->end)
+                last->end = r->end;
+            last->flags |= r->flags;
+        } else {
+            set->ranges[n++] = *r;
+        }
+    }
+
+    set->count = n;
+    set->sorted = 1;
+}
+
+
+void mach_range_set_free (mach_range_set_t *set)
+{
+    if (!set) return;
+    free (set->ranges);
+    free (set);
+}
+
+
+/**
+ *  Function:   mach_range_set_find
+ *  -------------------------------
+ *
+ *  Finds the range containing an address. The set isn't changed, so any
+ *  number of threads can look up in a finalised set at once.
+ *
+ *  returns:    The range, or NULL if `addr` isn't in the set or the set
+ *              hasn't been finalised since it was last added to.
+ *
+ */
+mach_range_t *mach_range_set_find (mach_range_set_t *set, uint64_t addr)
+{
+    if (!set->sorted) {
+        debugf ("mach_range_set_find: range set isn't finalised\n");
+        return NULL;
+    }
+
+    uint32_t lo = 0, hi = set->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (set->ranges[mid].start <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo && addr < set->ranges[lo - 1].end)
+        return &set->ranges[lo - 1];
+    return NULL;
+}
+
+
+/**
+ *  Function:   mach_range_set_next_outside
+ *  ---------------------------------------
+ *
+ *  Returns `addr` if it isn't in the set, otherwise the end of the range
+ *  containing it. Since ranges are merged, the result is never in the
+ *  set, so a scanner can resume from there.
+ *
+ */
+uint64_t mach_range_set_next_outside (mach_range_set_t *set, uint64_t addr)
+{
+    mach_range_t *r = mach_range_set_find (set, addr);
+    return r ? r->end : addr;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Non-code ranges                      									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Adds a range of the file to the set, translated to VM addresses. The
+ *  range may span more than one segment.
+ */
+static void mach_range_set_add_file_range (mach_range_set_t *set, macho_t *macho, uint64_t offset,
+                                           uint64_t size, uint32_t flags)
+{
+    uint64_t end = offset + size;
+
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        mach_segment_command_64_t *seg = ((mach_segment_info_t *) l->data)->segcmd;
+        if (!seg->filesize)
+            continue;
+
+        uint64_t lo = (offset > seg->fileoff) ? offset : seg->fileoff;
+        uint64_t hi = (end < seg->fileoff + seg->filesize) ? end : seg->fileoff + seg->filesize;
+        if (lo < hi)
+            mach_range_set_add (set, seg->vmaddr + (lo - seg->fileoff), seg->vmaddr + (hi - seg->fileoff), flags);
+    }
+}
+
+
+/**
+ *  Function:   mach_noncode_ranges_load
+ *  ------------------------------------
+ *
+ *  Builds the set of VM ranges in a Mach-O that should never be decoded
+ *  as instructions:
+ *
+ *      -   LC_DATA_IN_CODE entries (jump tables, literal pools).
+ *      -   The LC_ENCRYPTION_INFO(_64) range, if still encrypted.
+ *      -   Zero-fill sections, and the part of each segment past the end
+ *          of its file data.
+ *
+ *  macho:      The Mach-O.
+ *
+ *  returns:    A finalised range set, free with mach_range_set_free().
+ *
+ */
+mach_range_set_t *mach_noncode_ranges_load (macho_t *macho)
+{
+    mach_range_set_t *set = mach_range_set_create ();
+
+    // Data in code. Offsets are from the mach header.
+    uint32_t ndice = 0;
+    mach_data_in_code_entry_t *dice = mach_lc_load_data_in_code (macho, &ndice);
+    for (uint32_t i = 0; i < ndice; i++)
+        mach_range_set_add_file_range (set, macho, dice[i].offset, dice[i].length, MACH_RANGE_DATA_IN_CODE);
+    free (dice);
+
+    // Encrypted range. cryptid is zero once the range has been decrypted.
+    mach_command_info_t *info = mach_lc_find_given_cmd (macho, LC_ENCRYPTION_INFO_64);
+    if (!info)
+        info = mach_lc_find_given_cmd (macho, LC_ENCRYPTION_INFO);
+    if (info && (uint64_t) info->offset + 20 <= macho->size) {
+        mach_crypto_command_64_t crypt;
+        memset (&crypt, '\0', sizeof (crypt));
+        memcpy (&crypt, macho->data + info->offset, 20);
+
+        if (crypt.cryptid)
+            mach_range_set_add_file_range (set, macho, crypt.cryptoff, crypt.cryptsize, MACH_RANGE_ENCRYPTED);
+    }
+
+    // Zero-fill
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        mach_segment_info_t *si = (mach_segment_info_t *) l->data;
+        mach_segment_command_64_t *seg = si->segcmd;
+
+        if (seg->vmsize > seg->filesize)
+            mach_range_set_add (set, seg->vmaddr + seg->filesize, seg->vmaddr + seg->vmsize, MACH_RANGE_ZEROFILL);
+
+        for (HSList *s = si->sections; s; s = s->next) {
+            mach_section_64_t *sect = (mach_section_64_t *) s->data;
+            if (MACH_SECTION_IS_ZEROFILL (sect->flags))
+                mach_range_set_add (set, sect->addr, sect->addr + sect->size, MACH_RANGE_ZEROFILL);
+        }
+    }
+
+    mach_range_set_finalise (set);
+    return set;
+}
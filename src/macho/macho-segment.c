@@ -276,4 +276,53 @@ mach_section_info_t *mach_section_info_from_name (macho_t *macho, char *segment,
     memcpy (ret->data, macho->data + __sect->offset, __sect->size);
 
     return ret;
-}
\ No newline at end of file
+}
+
+
+/**
+ *  Function:   mach_vmaddr_to_offset
+ *  ---------------------------------
+ *
+ *  Translates a VM address into a file offset, using the segment that
+ *  contains it.
+ *
+ *  macho:      The Mach-O.
+ *  vmaddr:     The address to translate.
+ *
+ *  returns:    The file offset, or MACH_ADDR_INVALID if the address is not
+ *              in a segment, or is in the zero-filled part of one.
+ *
+ */
+uint64_t mach_vmaddr_to_offset (macho_t *macho, uint64_t vmaddr)
+{
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        mach_segment_command_64_t *seg = ((mach_segment_info_t *) l->data)->segcmd;
+        if (vmaddr >= seg->vmaddr && vmaddr - seg->vmaddr < seg->filesize)
+            return seg->fileoff + (vmaddr - seg->vmaddr);
+    }
+    return MACH_ADDR_INVALID;
+}
+
+
+/**
+ *  Function:   mach_offset_to_vmaddr
+ *  ---------------------------------
+ *
+ *  Translates a file offset into the VM address it is mapped at.
+ *
+ *  macho:      The Mach-O.
+ *  offset:     The file offset to translate.
+ *
+ *  returns:    The VM address, or MACH_ADDR_INVALID if no segment maps the
+ *              offset.
+ *
+ */
+uint64_t mach_offset_to_vmaddr (macho_t *macho, uint64_t offset)
+{
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        mach_segment_command_64_t *seg = ((mach_segment_info_t *) l->data)->segcmd;
+        if (seg->filesize && offset >= seg->fileoff && offset - seg->fileoff < seg->filesize)
+            return seg->vmaddr + (offset - seg->fileoff);
+    }
+    return MACH_ADDR_INVALID;
+}
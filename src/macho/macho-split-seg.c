@@ -0,0 +1,465 @@
+//===-------------------------- macho_split_seg -----------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include "libhelper-macho/macho-split-seg.h"
+#include "libhelper-macho/macho-arm64.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-leb128.h"
+
+
+static void split_seg_add (mach_split_seg_info_t *info, uint64_t *cap, uint32_t kind,
+                           uint64_t from_section, uint64_t from_offset,
+                           uint64_t to_section, uint64_t to_offset)
+{
+    if (info->count == *cap) {
+        *cap = *cap ? *cap * 2 : 256;
+        info->refs = realloc (info->refs, sizeof (mach_split_seg_ref_t) * *cap);
+    }
+
+    mach_split_seg_ref_t *ref = &info->refs[info->count++];
+    ref->from_offset = from_offset;
+    ref->to_offset = to_offset;
+    ref->from_section = (uint16_t) from_section;
+    ref->to_section = (uint16_t) to_section;
+    ref->kind = kind;
+}
+
+
+/**
+ *  v1 entries are addresses relative to the mach header. Turn each one
+ *  into a section and offset so both formats look the same. Entries of a
+ *  kind with no v2 equivalent are only counted, in info->skipped.
+ */
+static void split_seg_load_v1 (mach_split_seg_info_t *info, const uint8_t *p, const uint8_t *end,
+                               uint64_t base, uint64_t *cap)
+{
+    while (p < end && *p) {
+        uint8_t kind = *p++;
+        uint64_t addr = base;
+
+        uint32_t v2kind = 0;
+        if (kind == DYLD_CACHE_ADJ_V1_POINTER_32) v2kind = DYLD_CACHE_ADJ_V2_POINTER_32;
+        else if (kind == DYLD_CACHE_ADJ_V1_POINTER_64) v2kind = DYLD_CACHE_ADJ_V2_POINTER_64;
+        else if (kind == DYLD_CACHE_ADJ_V1_ARM64_ADRP) v2kind = DYLD_CACHE_ADJ_V2_ARM64_ADRP;
+
+        uint64_t delta;
+        while (p < end && (delta = mach_read_uleb128 (&p, end))) {
+            addr += delta;
+            if (!v2kind) {
+                info->skipped++;
+                continue;
+            }
+
+            uint32_t s = 1;
+            for (; s < info->nsections; s++) {
+                mach_section_64_t *sect = info->sections[s];
+                if (addr >= sect->addr && addr - sect->addr < sect->size)
+                    break;
+            }
+
+            if (s < info->nsections)
+                split_seg_add (info, cap, v2kind, s, addr - info->sections[s]->addr, MACH_SPLIT_SEG_NO_SECTION, 0);
+            else
+                split_seg_add (info, cap, v2kind, 0, addr - base, MACH_SPLIT_SEG_NO_SECTION, 0);
+        }
+    }
+}
+
+
+static int split_seg_load_v2 (mach_split_seg_info_t *info, const uint8_t *p, const uint8_t *end, uint64_t *cap)
+{
+    uint64_t npairs = mach_read_uleb128 (&p, end);
+    for (uint64_t i = 0; i < npairs && p < end; i++) {
+        uint64_t from_section = mach_read_uleb128 (&p, end);
+        uint64_t to_section = mach_read_uleb128 (&p, end);
+        uint64_t nto = mach_read_uleb128 (&p, end);
+
+        if (from_section >= info->nsections || to_section >= info->nsections)
+            return 0;
+
+        uint64_t to_offset = 0;
+        for (uint64_t j = 0; j < nto && p < end; j++) {
+            to_offset += mach_read_uleb128 (&p, end);
+            uint64_t nkinds = mach_read_uleb128 (&p, end);
+
+            for (uint64_t k = 0; k < nkinds && p < end; k++) {
+                uint64_t kind = mach_read_uleb128 (&p, end);
+                uint64_t nfrom = mach_read_uleb128 (&p, end);
+                if (kind > DYLD_CACHE_ADJ_V2_THREADED_POINTER_64)
+                    return 0;
+
+                uint64_t from_offset = 0;
+                for (uint64_t l = 0; l < nfrom && p < end; l++) {
+                    from_offset += mach_read_uleb128 (&p, end);
+                    split_seg_add (info, cap, (uint32_t) kind, from_section, from_offset, to_section, to_offset);
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+
+/**
+ *  Function:   mach_split_seg_info_load
+ *  ------------------------------------
+ *
+ *  Decodes a Mach-O's LC_SEGMENT_SPLIT_INFO, in either format.
+ *
+ *  macho:      The Mach-O.
+ *
+ *  returns:    The decoded references, or NULL if there is no split seg
+ *              info or it is malformed.
+ *
+ */
+mach_split_seg_info_t *mach_split_seg_info_load (macho_t *macho)
+{
+    mach_command_info_t *cmdinfo = mach_lc_find_given_cmd (macho, LC_SEGMENT_SPLIT_INFO);
+    if (!cmdinfo)
+        return NULL;
+
+    mach_linkedit_data_command_t cmd;
+    memcpy (&cmd, macho->data + cmdinfo->offset, sizeof (mach_linkedit_data_command_t));
+
+    if ((uint64_t) cmd.dataoff + cmd.datasize > macho->size) {
+        errorf ("LC_SEGMENT_SPLIT_INFO data lies outside of the file\n");
+        return NULL;
+    }
+
+    mach_split_seg_info_t *info = calloc (1, sizeof (mach_split_seg_info_t));
+
+    // Section index table, with the mach header at 0
+    uint32_t nsections = 1;
+    for (HSList *l = macho->scmds; l; l = l->next)
+        nsections += h_slist_length (((mach_segment_info_t *) l->data)->sections);
+
+    info->sections = calloc (nsections, sizeof (mach_section_64_t *));
+    info->segments = calloc (nsections, sizeof (uint32_t));
+    info->nsections = 1;
+
+    uint32_t segindex = 0;
+    for (HSList *l = macho->scmds; l; l = l->next, segindex++) {
+        for (HSList *s = ((mach_segment_info_t *) l->data)->sections; s; s = s->next) {
+            info->sections[info->nsections] = (mach_section_64_t *) s->data;
+            info->segments[info->nsections] = segindex;
+            info->nsections++;
+        }
+    }
+
+    const uint8_t *p = macho->data + cmd.dataoff;
+    const uint8_t *end = p + cmd.datasize;
+    uint64_t cap = 0;
+
+    if (p < end && *p == DYLD_CACHE_ADJ_V2_FORMAT) {
+        info->version = 2;
+        if (!split_seg_load_v2 (info, p + 1, end, &cap)) {
+            errorf ("mach_split_seg_info_load: malformed v2 split seg info\n");
+            mach_split_seg_info_free (info);
+            return NULL;
+        }
+    } else {
+        uint64_t base = mach_offset_to_vmaddr (macho, 0);
+        info->version = 1;
+        split_seg_load_v1 (info, p, end, (base == MACH_ADDR_INVALID) ? 0 : base, &cap);
+    }
+
+    return info;
+}
+
+
+void mach_split_seg_info_free (mach_split_seg_info_t *info)
+{
+    if (!info) return;
+    free (info->refs);
+    free (info->sections);
+    free (info->segments);
+    free (info);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Sliding segments                     									 --*/
+//===-----------------------------------------------------------------------===//
+
+static int64_t split_seg_segment_for_vmaddr (macho_t *macho, uint64_t vmaddr)
+{
+    int64_t i = 0;
+    for (HSList *l = macho->scmds; l; l = l->next, i++) {
+        mach_segment_command_64_t *seg = ((mach_segment_info_t *) l->data)->segcmd;
+        if (vmaddr >= seg->vmaddr && vmaddr - seg->vmaddr < seg->vmsize)
+            return i;
+    }
+    return -1;
+}
+
+static int64_t split_seg_header_segment (macho_t *macho)
+{
+    int64_t i = 0;
+    for (HSList *l = macho->scmds; l; l = l->next, i++) {
+        mach_segment_command_64_t *seg = ((mach_segment_info_t *) l->data)->segcmd;
+        if (seg->fileoff == 0 && seg->filesize)
+            return i;
+    }
+    return -1;
+}
+
+
+/**
+ *  Function:   mach_split_seg_adjust
+ *  ---------------------------------
+ *
+ *  Rewrites every reference described by the split seg info, in place in
+ *  macho->data, as if each segment had been moved by deltas[i] bytes (in
+ *  macho->scmds order). Only the references are changed - the segment and
+ *  section commands are left for the caller to update.
+ *
+ *  References that can't be adjusted - 32-bit ARM kinds, v1 entries of an
+ *  unknown kind or whose target can't be worked out, or branches that
+ *  would go out of range - are left untouched and counted.
+ *
+ *  macho:      The Mach-O to patch.
+ *  info:       Split seg info from mach_split_seg_info_load().
+ *  deltas:     VM address delta for each segment.
+ *  ndeltas:    Number of entries in `deltas`.
+ *
+ *  returns:    The number of references that could not be adjusted, or
+ *              -1 if the arguments are invalid.
+ *
+ */
+int64_t mach_split_seg_adjust (macho_t *macho, mach_split_seg_info_t *info,
+                               const int64_t *deltas, uint32_t ndeltas)
+{
+    if (!macho || !info || !deltas)
+        return -1;
+
+    int64_t hseg = split_seg_header_segment (macho);
+    if (hseg < 0 || hseg >= ndeltas)
+        return -1;
+    uint64_t base = mach_offset_to_vmaddr (macho, 0);
+
+    int64_t failed = (int64_t) info->skipped;
+    for (uint64_t i = 0; i < info->count; i++) {
+        mach_split_seg_ref_t *ref = &info->refs[i];
+
+        // Where the reference is
+        uint64_t foff, from_vm;
+        int64_t fseg;
+        if (ref->from_section) {
+            mach_section_64_t *sect = info->sections[ref->from_section];
+            if (MACH_SECTION_IS_ZEROFILL (sect->flags) || ref->from_offset >= sect->size) {
+                failed++;
+                continue;
+            }
+            foff = sect->offset + ref->from_offset;
+            from_vm = sect->addr + ref->from_offset;
+            fseg = info->segments[ref->from_section];
+        } else {
+            foff = ref->from_offset;
+            from_vm = base + ref->from_offset;
+            fseg = hseg;
+        }
+
+        uint32_t size = (ref->kind == DYLD_CACHE_ADJ_V2_POINTER_64 || ref->kind == DYLD_CACHE_ADJ_V2_DELTA_64 ||
+                         ref->kind == DYLD_CACHE_ADJ_V2_THREADED_POINTER_64) ? 8 : 4;
+        if (foff + size > macho->size || fseg >= ndeltas) {
+            failed++;
+            continue;
+        }
+
+        uint8_t *loc = macho->data + foff;
+        uint32_t u32;
+        uint64_t u64 = 0;
+        memcpy (&u32, loc, 4);
+        if (size == 8)
+            memcpy (&u64, loc, 8);
+
+        // Where it points. v1 doesn't say, so work it out from the value.
+        int64_t tseg = -1;
+        uint64_t target = 0;
+        int exact = 0;
+        if (ref->to_section != MACH_SPLIT_SEG_NO_SECTION && ref->to_section < info->nsections) {
+            tseg = ref->to_section ? info->segments[ref->to_section] : hseg;
+            target = (ref->to_section ? info->sections[ref->to_section]->addr : base) + ref->to_offset;
+            exact = 1;
+        } else if (ref->kind == DYLD_CACHE_ADJ_V2_POINTER_64) {
+            tseg = split_seg_segment_for_vmaddr (macho, u64);
+        } else if (ref->kind == DYLD_CACHE_ADJ_V2_POINTER_32) {
+            tseg = split_seg_segment_for_vmaddr (macho, u32);
+        } else if (ref->kind == DYLD_CACHE_ADJ_V2_ARM64_ADRP && arm64_is_adrp (u32)) {
+            tseg = split_seg_segment_for_vmaddr (macho, arm64_adrp_target (from_vm, u32));
+        }
+
+        if (tseg < 0 || tseg >= ndeltas) {
+            failed++;
+            continue;
+        }
+
+        int64_t df = deltas[fseg], dt = deltas[tseg], dh = deltas[hseg];
+
+        switch (ref->kind) {
+            case DYLD_CACHE_ADJ_V2_POINTER_32:
+                u32 += (uint32_t) dt;
+                memcpy (loc, &u32, 4);
+                break;
+
+            case DYLD_CACHE_ADJ_V2_POINTER_64:
+                u64 += (uint64_t) dt;
+                memcpy (loc, &u64, 8);
+                break;
+
+            case DYLD_CACHE_ADJ_V2_DELTA_32:
+                u32 += (uint32_t) (dt - df);
+                memcpy (loc, &u32, 4);
+                break;
+
+            case DYLD_CACHE_ADJ_V2_DELTA_64:
+                u64 += (uint64_t) (dt - df);
+                memcpy (loc, &u64, 8);
+                break;
+
+            case DYLD_CACHE_ADJ_V2_IMAGE_OFF_32:
+                u32 += (uint32_t) (dt - dh);
+                memcpy (loc, &u32, 4);
+                break;
+
+            case DYLD_CACHE_ADJ_V2_THREADED_POINTER_64:
+                // Authenticated pointers hold an offset from the image,
+                // plain ones a 43-bit address
+                if (u64 & (1ULL << 63))
+                    u64 = (u64 & ~0xffffffffULL) | (uint32_t) ((uint32_t) u64 + (uint32_t) (dt - dh));
+                else
+                    u64 = (u64 & ~0x7ffffffffffULL) | ((u64 + (uint64_t) dt) & 0x7ffffffffffULL);
+                memcpy (loc, &u64, 8);
+                break;
+
+            case DYLD_CACHE_ADJ_V2_ARM64_ADRP: {
+                if (!arm64_is_adrp (u32)) {
+                    failed++;
+                    break;
+                }
+                if (!exact)
+                    target = arm64_adrp_target (from_vm, u32);
+
+                uint64_t pc = from_vm + (uint64_t) df;
+                int64_t pages = (int64_t) (((target + (uint64_t) dt) & ~0xfffULL) - (pc & ~0xfffULL)) >> 12;
+                if (pages < -(1LL << 20) || pages >= (1LL << 20)) {
+                    failed++;
+                    break;
+                }
+
+                u32 = (u32 & 0x9f00001f) | ((uint32_t) (pages & 0x3) << 29) |
+                      ((uint32_t) ((pages >> 2) & 0x7ffff) << 5);
+                memcpy (loc, &u32, 4);
+                break;
+            }
+
+            case DYLD_CACHE_ADJ_V2_ARM64_OFF12: {
+                // Only needs changing if the target moved within its page
+                if (!exact) {
+                    failed++;
+                    break;
+                }
+                uint32_t low = (uint32_t) ((target + (uint64_t) dt) & 0xfff);
+                unsigned scale = 0;
+
+                if (arm64_is_ldst_uimm (u32)) {
+                    scale = u32 >> 30;
+                    if ((u32 & 0x04800000) == 0x04800000 && scale == 0)
+                        scale = 4;
+                } else if (!arm64_is_add_imm (u32) || (u32 & (1u << 22))) {
+                    failed++;
+                    break;
+                }
+
+                if (low & ((1u << scale) - 1)) {
+                    failed++;
+                    break;
+                }
+                u32 = (u32 & ~(0xfffu << 10)) | ((low >> scale) << 10);
+                memcpy (loc, &u32, 4);
+                break;
+            }
+
+            case DYLD_CACHE_ADJ_V2_ARM64_BR26: {
+                if (!arm64_is_b (u32) && !arm64_is_bl (u32)) {
+                    failed++;
+                    break;
+                }
+                if (!exact)
+                    target = arm64_branch_target (from_vm, u32);
+
+                int64_t disp = (int64_t) ((target + (uint64_t) dt) - (from_vm + (uint64_t) df));
+                if ((disp & 3) || disp < -(1LL << 27) || disp >= (1LL << 27)) {
+                    failed++;
+                    break;
+                }
+                u32 = (u32 & 0xfc000000) | ((uint32_t) (disp >> 2) & 0x3ffffff);
+                memcpy (loc, &u32, 4);
+                break;
+            }
+
+            default:
+                // 32-bit ARM and Thumb
+                failed++;
+                break;
+        }
+    }
+
+    return failed;
+}
+
+
+char *mach_split_seg_kind_string (uint32_t kind)
+{
+    switch (kind) {
+        case DYLD_CACHE_ADJ_V2_POINTER_32:
+            return "POINTER_32";
+        case DYLD_CACHE_ADJ_V2_POINTER_64:
+            return "POINTER_64";
+        case DYLD_CACHE_ADJ_V2_DELTA_32:
+            return "DELTA_32";
+        case DYLD_CACHE_ADJ_V2_DELTA_64:
+            return "DELTA_64";
+        case DYLD_CACHE_ADJ_V2_ARM64_ADRP:
+            return "ARM64_ADRP";
+        case DYLD_CACHE_ADJ_V2_ARM64_OFF12:
+            return "ARM64_OFF12";
+        case DYLD_CACHE_ADJ_V2_ARM64_BR26:
+            return "ARM64_BR26";
+        case DYLD_CACHE_ADJ_V2_ARM_MOVW_MOVT:
+            return "ARM_MOVW_MOVT";
+        case DYLD_CACHE_ADJ_V2_ARM_BR24:
+            return "ARM_BR24";
+        case DYLD_CACHE_ADJ_V2_THUMB_MOVW_MOVT:
+            return "THUMB_MOVW_MOVT";
+        case DYLD_CACHE_ADJ_V2_THUMB_BR22:
+            return "THUMB_BR22";
+        case DYLD_CACHE_ADJ_V2_IMAGE_OFF_32:
+            return "IMAGE_OFF_32";
+        case DYLD_CACHE_ADJ_V2_THREADED_POINTER_64:
+            return "THREADED_POINTER_64";
+        default:
+            return "UNKNOWN";
+    }
+}
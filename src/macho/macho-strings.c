@@ -0,0 +1,446 @@
+//===--------------------------- macho_strings ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "libhelper-macho/macho-strings.h"
+#include "libhelper/hparallel.h"
+
+#define STRINGS_MIN_LENGTH      4
+#define STRINGS_CHUNK           (1UL << 20)
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Classification                       									 --*/
+//===-----------------------------------------------------------------------===//
+
+static inline int strings_is_printable (uint8_t c)
+{
+    return (uint8_t) (c - 0x20) < 0x5f || c == '\t';
+}
+
+/**
+ *  Classifies 64 bytes into two bitmasks: bit i of `printable` is set if
+ *  p[i] is a printable character, and bit i of `zero` if p[i] is NUL.
+ */
+#if defined(__SSE2__)
+
+static inline void strings_classify (const uint8_t *p, uint64_t *printable, uint64_t *zero)
+{
+    const __m128i lo = _mm_set1_epi8 (0x20);
+    const __m128i bias = _mm_set1_epi8 ((char) 0x80);
+    const __m128i limit = _mm_set1_epi8 ((char) (0x5f ^ 0x80));
+    const __m128i tab = _mm_set1_epi8 ('\t');
+    const __m128i nul = _mm_setzero_si128 ();
+
+    uint64_t pm = 0, zm = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i x = _mm_loadu_si128 ((const __m128i *) (p + i * 16));
+
+        // (x - 0x20) < 0x5f, unsigned, done as a signed compare
+        __m128i t = _mm_xor_si128 (_mm_sub_epi8 (x, lo), bias);
+        __m128i pr = _mm_or_si128 (_mm_cmplt_epi8 (t, limit), _mm_cmpeq_epi8 (x, tab));
+
+        pm |= (uint64_t) (uint16_t) _mm_movemask_epi8 (pr) << (i * 16);
+        zm |= (uint64_t) (uint16_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (x, nul)) << (i * 16);
+    }
+    *printable = pm;
+    *zero = zm;
+}
+
+#elif defined(__ARM_NEON)
+
+static inline uint16_t strings_neon_movemask (uint8x16_t v)
+{
+    static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t m = vandq_u8 (v, vld1q_u8 (bits));
+    return (uint16_t) (vaddv_u8 (vget_low_u8 (m)) | (vaddv_u8 (vget_high_u8 (m)) << 8));
+}
+
+static inline void strings_classify (const uint8_t *p, uint64_t *printable, uint64_t *zero)
+{
+    const uint8x16_t lo = vdupq_n_u8 (0x20);
+    const uint8x16_t limit = vdupq_n_u8 (0x5f);
+    const uint8x16_t tab = vdupq_n_u8 ('\t');
+    const uint8x16_t nul = vdupq_n_u8 (0);
+
+    uint64_t pm = 0, zm = 0;
+    for (int i = 0; i < 4; i++) {
+        uint8x16_t x = vld1q_u8 (p + i * 16);
+        uint8x16_t pr = vorrq_u8 (vcltq_u8 (vsubq_u8 (x, lo), limit), vceqq_u8 (x, tab));
+
+        pm |= (uint64_t) strings_neon_movemask (pr) << (i * 16);
+        zm |= (uint64_t) strings_neon_movemask (vceqq_u8 (x, nul)) << (i * 16);
+    }
+    *printable = pm;
+    *zero = zm;
+}
+
+#else
+
+static inline void strings_classify (const uint8_t *p, uint64_t *printable, uint64_t *zero)
+{
+    uint64_t pm = 0, zm = 0;
+    for (int i = 0; i < 64; i++) {
+        pm |= (uint64_t) strings_is_printable (p[i]) << i;
+        zm |= (uint64_t) (p[i] == 0) << i;
+    }
+    *printable = pm;
+    *zero = zm;
+}
+
+#endif
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Scanning                             									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  A region of the file to scan, either a section or the whole file.
+ */
+typedef struct strings_region_t {
+    uint64_t             start;
+    uint64_t             end;
+    mach_section_64_t   *section;
+} strings_region_t;
+
+/**
+ *  Regions are split into chunks that are scanned independently. A string
+ *  that crosses the end of a chunk is finished by the chunk it started
+ *  in, and skipped by the next.
+ */
+typedef struct strings_chunk_t {
+    strings_region_t    *region;
+    uint64_t             start;
+    uint64_t             end;
+
+    mach_string_t       *strings;
+    uint64_t             count;
+    uint64_t             cap;
+} strings_chunk_t;
+
+typedef struct strings_run_t {
+    int                  open;
+    uint64_t             start;
+    uint64_t             skip;          // continuation of the previous chunk
+} strings_run_t;
+
+typedef struct strings_job_t {
+    macho_t             *macho;
+    strings_chunk_t     *chunks;
+    uint32_t             min_length;
+    uint32_t             encodings;
+
+    // Whole-file scans look up the section of each string
+    mach_section_64_t  **sections;
+    uint32_t             nsections;
+} strings_job_t;
+
+
+static void strings_emit (strings_chunk_t *chunk, uint32_t min_length, uint64_t start,
+                          uint64_t end, uint32_t encoding, strings_run_t *run)
+{
+    uint64_t length = (encoding == MACH_STRING_UTF16) ? (end - start) / 2 : end - start;
+    if (length < min_length || start >= chunk->end || start == run->skip)
+        return;
+
+    if (chunk->count == chunk->cap) {
+        chunk->cap = chunk->cap ? chunk->cap * 2 : 256;
+        chunk->strings = realloc (chunk->strings, sizeof (mach_string_t) * chunk->cap);
+    }
+
+    mach_string_t *s = &chunk->strings[chunk->count++];
+    s->offset = start;
+    s->length = (length > UINT32_MAX) ? UINT32_MAX : (uint32_t) length;
+    s->encoding = encoding;
+    s->section = chunk->region->section;
+}
+
+/**
+ *  Opens and closes runs of set bits in `mask`, which covers the 64 bytes
+ *  starting at `base`.
+ */
+static void strings_runs (strings_chunk_t *chunk, uint32_t min_length, uint64_t mask,
+                          uint64_t base, uint32_t encoding, strings_run_t *run)
+{
+    uint32_t pos = 0;
+    while (pos < 64) {
+        uint64_t m = (run->open ? ~mask : mask) >> pos;
+        if (!m)
+            break;
+
+        pos += (uint32_t) __builtin_ctzll (m);
+        if (run->open) {
+            strings_emit (chunk, min_length, run->start, base + pos, encoding, run);
+            run->open = 0;
+        } else {
+            run->start = base + pos;
+            run->open = 1;
+        }
+    }
+}
+
+
+static void strings_scan_worker (size_t index, void *user_data)
+{
+    strings_job_t *job = (strings_job_t *) user_data;
+    strings_chunk_t *chunk = &job->chunks[index];
+    const uint8_t *data = job->macho->data;
+    uint64_t end = chunk->region->end;
+
+    strings_run_t ascii = { 0, 0, UINT64_MAX };
+    strings_run_t utf16 = { 0, 0, UINT64_MAX };
+
+    // Work out whether the chunk starts part way through a string
+    int carry = 0;
+    uint64_t c = chunk->start;
+    if (c > chunk->region->start) {
+        if (strings_is_printable (data[c - 1]))
+            ascii.skip = c;
+
+        carry = strings_is_printable (data[c - 1]) && data[c] == 0;
+        if (carry || (c >= chunk->region->start + 2 &&
+                      strings_is_printable (data[c - 2]) && data[c - 1] == 0))
+            utf16.skip = c;
+    }
+
+    uint8_t tail[64];
+    for (uint64_t b = chunk->start; b < end; b += 64) {
+        const uint8_t *p = data + b;
+        uint64_t valid = UINT64_MAX;
+
+        // Pad the last block with bytes that are neither printable nor NUL
+        if (end - b < 64) {
+            memset (tail, 0x01, sizeof (tail));
+            memcpy (tail, p, end - b);
+            p = tail;
+            valid = (1ULL << (end - b)) - 1;
+        }
+
+        uint64_t printable, zero;
+        strings_classify (p, &printable, &zero);
+
+        if (job->encodings & MACH_STRING_ASCII)
+            strings_runs (chunk, job->min_length, printable & valid, b, MACH_STRING_ASCII, &ascii);
+
+        /**
+         *  A UTF-16LE character starts at byte i if byte i is printable
+         *  and byte i + 1 is NUL. No two adjacent bytes can both start a
+         *  character, so marking both bytes of each one turns every
+         *  string into a single run of set bits, the same as for ASCII.
+         */
+        if (job->encodings & MACH_STRING_UTF16) {
+            uint64_t next_zero = (b + 64 < end) && data[b + 64] == 0;
+            uint64_t starts = printable & ((zero >> 1) | (next_zero << 63)) & valid;
+            uint64_t mask = (starts | (starts << 1) | (uint64_t) carry) & valid;
+
+            carry = (int) (starts >> 63);
+            strings_runs (chunk, job->min_length, mask, b, MACH_STRING_UTF16, &utf16);
+        }
+
+        // Past the end of the chunk, keep going only to finish strings
+        // that started inside it
+        if (b + 64 >= chunk->end &&
+            !(ascii.open && ascii.start < chunk->end) &&
+            !(utf16.open && utf16.start < chunk->end))
+            return;
+    }
+
+    if (ascii.open)
+        strings_emit (chunk, job->min_length, ascii.start, end, MACH_STRING_ASCII, &ascii);
+    if (utf16.open)
+        strings_emit (chunk, job->min_length, utf16.start, end, MACH_STRING_UTF16, &utf16);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Public API                           									 --*/
+//===-----------------------------------------------------------------------===//
+
+static int strings_offset_compare (const void *x, const void *y)
+{
+    const mach_string_t *a = x, *b = y;
+    return (a->offset < b->offset) ? -1 : (a->offset > b->offset);
+}
+
+static int strings_section_compare (const void *x, const void *y)
+{
+    const mach_section_64_t *a = *(mach_section_64_t *const *) x;
+    const mach_section_64_t *b = *(mach_section_64_t *const *) y;
+    return (a->offset < b->offset) ? -1 : (a->offset > b->offset);
+}
+
+static int strings_section_has_data (macho_t *macho, mach_section_64_t *sect)
+{
+    return !MACH_SECTION_IS_ZEROFILL (sect->flags) && sect->offset && sect->size &&
+           (uint64_t) sect->offset + sect->size <= macho->size;
+}
+
+static int strings_section_matches (mach_section_64_t *sect, const char *name)
+{
+    const char *dot = strchr (name, '.');
+    if (!dot || dot - name > 16)
+        return 0;
+
+    size_t seglen = (size_t) (dot - name);
+    return !strncmp (sect->segname, name, seglen) && (seglen == 16 || !sect->segname[seglen]) &&
+           !strncmp (sect->sectname, dot + 1, 16);
+}
+
+static mach_section_64_t *strings_find_section (strings_job_t *job, uint64_t offset)
+{
+    uint32_t lo = 0, hi = job->nsections;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (job->sections[mid]->offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo && offset - job->sections[lo - 1]->offset < job->sections[lo - 1]->size)
+        return job->sections[lo - 1];
+    return NULL;
+}
+
+
+/**
+ *  Function:   mach_strings_find
+ *  -----------------------------
+ *
+ *  Finds printable strings in a Mach-O, either in the sections listed in
+ *  `opts` or across the whole file.
+ *
+ *  macho:      The Mach-O.
+ *  opts:       Options, or NULL for the defaults.
+ *
+ *  returns:    The strings found, free with mach_strings_free(). The
+ *              strings themselves point into the macho_t.
+ *
+ */
+mach_strings_t *mach_strings_find (macho_t *macho, mach_strings_opts_t *opts)
+{
+    strings_job_t job;
+    memset (&job, '\0', sizeof (job));
+    job.macho = macho;
+    job.min_length = (opts && opts->min_length) ? opts->min_length : STRINGS_MIN_LENGTH;
+    job.encodings = (opts && opts->encodings) ? opts->encodings : MACH_STRING_ASCII;
+
+    // Every section with data, sorted by offset
+    uint32_t cap = 0;
+    for (HSList *l = macho->scmds; l; l = l->next)
+        cap += h_slist_length (((mach_segment_info_t *) l->data)->sections);
+
+    job.sections = calloc (cap + 1, sizeof (mach_section_64_t *));
+    for (HSList *l = macho->scmds; l; l = l->next)
+        for (HSList *s = ((mach_segment_info_t *) l->data)->sections; s; s = s->next)
+            if (strings_section_has_data (macho, (mach_section_64_t *) s->data))
+                job.sections[job.nsections++] = (mach_section_64_t *) s->data;
+    qsort (job.sections, job.nsections, sizeof (mach_section_64_t *), strings_section_compare);
+
+    // Regions to scan
+    strings_region_t *regions = calloc (job.nsections + 1, sizeof (strings_region_t));
+    uint32_t nregions = 0;
+
+    if (opts && opts->sections) {
+        for (uint32_t i = 0; i < job.nsections; i++) {
+            for (const char **name = opts->sections; *name; name++) {
+                if (!strings_section_matches (job.sections[i], *name))
+                    continue;
+                regions[nregions].start = job.sections[i]->offset;
+                regions[nregions].end = job.sections[i]->offset + job.sections[i]->size;
+                regions[nregions].section = job.sections[i];
+                nregions++;
+                break;
+            }
+        }
+    } else if (macho->size) {
+        regions[0].start = 0;
+        regions[0].end = macho->size;
+        nregions = 1;
+    }
+
+    uint64_t nchunks = 0;
+    for (uint32_t i = 0; i < nregions; i++)
+        nchunks += (regions[i].end - regions[i].start + STRINGS_CHUNK - 1) / STRINGS_CHUNK;
+
+    job.chunks = calloc (nchunks + 1, sizeof (strings_chunk_t));
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < nregions; i++) {
+        for (uint64_t off = regions[i].start; off < regions[i].end; off += STRINGS_CHUNK) {
+            job.chunks[n].region = &regions[i];
+            job.chunks[n].start = off;
+            job.chunks[n].end = (regions[i].end - off > STRINGS_CHUNK) ? off + STRINGS_CHUNK : regions[i].end;
+            n++;
+        }
+    }
+
+    h_parallel_for (n, opts ? opts->nthreads : 0, strings_scan_worker, &job);
+
+    // Gather the chunks in order
+    mach_strings_t *ret = calloc (1, sizeof (mach_strings_t));
+    for (uint64_t i = 0; i < n; i++)
+        ret->count += job.chunks[i].count;
+    ret->strings = malloc (sizeof (mach_string_t) * (ret->count + 1));
+
+    uint64_t k = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        strings_chunk_t *chunk = &job.chunks[i];
+
+        // ASCII and UTF-16 runs are emitted as they end, not as they start
+        if (job.encodings == (MACH_STRING_ASCII | MACH_STRING_UTF16))
+            qsort (chunk->strings, chunk->count, sizeof (mach_string_t), strings_offset_compare);
+
+        for (uint64_t j = 0; j < chunk->count; j++) {
+            mach_string_t *s = &ret->strings[k++];
+            *s = chunk->strings[j];
+
+            if (!s->section)
+                s->section = strings_find_section (&job, s->offset);
+            if (s->section)
+                s->vmaddr = s->section->addr + (s->offset - s->section->offset);
+            else
+                s->vmaddr = mach_offset_to_vmaddr (macho, s->offset);
+        }
+        free (chunk->strings);
+    }
+
+    free (job.chunks);
+    free (job.sections);
+    free (regions);
+    return ret;
+}
+
+
+void mach_strings_free (mach_strings_t *strings)
+{
+    if (!strings) return;
+    free (strings->strings);
+    free (strings);
+}
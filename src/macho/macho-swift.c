@@ -0,0 +1,611 @@
+//===---------------------------- macho_swift -------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#include <stdio.h>
+
+#include "libhelper-macho/macho-swift.h"
+#include "libhelper-macho/macho-segment.h"
+
+
+#define SWIFT_MAX_NAME          1024
+#define SWIFT_MAX_DEPTH         16
+
+// Type reference kinds, in conformance descriptor flags
+#define SWIFT_TYPEREF_DIRECT_DESCRIPTOR         0
+#define SWIFT_TYPEREF_INDIRECT_DESCRIPTOR       1
+#define SWIFT_TYPEREF_DIRECT_OBJC_NAME          2
+#define SWIFT_TYPEREF_INDIRECT_OBJC_CLASS       3
+
+
+static char *swift_strdup (const char *s)
+{
+    size_t len = strlen (s);
+    char *r = malloc (len + 1);
+    memcpy (r, s, len + 1);
+    return r;
+}
+
+static mach_section_64_t *swift_section (macho_t *macho, const char *name)
+{
+    for (HSList *l = macho->scmds; l; l = l->next)
+        for (HSList *s = ((mach_segment_info_t *) l->data)->sections; s; s = s->next) {
+            mach_section_64_t *sect = (mach_section_64_t *) s->data;
+            if (!strncmp (sect->sectname, name, 16))
+                return sect;
+        }
+    return NULL;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Relative pointers                    									 --*/
+//===-----------------------------------------------------------------------===//
+
+static const uint8_t *swift_data (mach_swift_index_t *index, uint64_t vmaddr, size_t len)
+{
+    uint64_t offset = mach_vmaddr_to_offset (index->macho, vmaddr);
+    if (offset == MACH_ADDR_INVALID || offset + len > index->macho->size)
+        return NULL;
+    return index->macho->data + offset;
+}
+
+static int swift_read32 (mach_swift_index_t *index, uint64_t vmaddr, int32_t *value)
+{
+    const uint8_t *p = swift_data (index, vmaddr, 4);
+    if (!p)
+        return 0;
+    memcpy (value, p, 4);
+    return 1;
+}
+
+/**
+ *  Resolves a relative pointer at `vmaddr`, ignoring the low bits in
+ *  `mask`. Returns zero for a null pointer.
+ */
+static uint64_t swift_rel (mach_swift_index_t *index, uint64_t vmaddr, int32_t mask)
+{
+    int32_t v;
+    if (!swift_read32 (index, vmaddr, &v) || !v)
+        return 0;
+    return vmaddr + (int64_t) (v & ~mask);
+}
+
+/**
+ *  Resolves a relative indirectable pointer. If the low bit is set, the
+ *  offset is to a pointer to the target, which may be bound to another
+ *  image, in which case zero is returned and `bind` is set.
+ */
+static uint64_t swift_rel_indirect (mach_swift_index_t *index, uint64_t vmaddr, int indirect, mach_bind_t **bind)
+{
+    if (bind)
+        *bind = NULL;
+
+    uint64_t target = swift_rel (index, vmaddr, 1);
+    if (!target || !indirect)
+        return target;
+    return mach_fixups_read_pointer (index->macho, index->fixups, target, bind);
+}
+
+static uint64_t swift_rel_indirectable (mach_swift_index_t *index, uint64_t vmaddr, mach_bind_t **bind)
+{
+    int32_t v;
+    if (!swift_read32 (index, vmaddr, &v))
+        return 0;
+    return swift_rel_indirect (index, vmaddr, v & 1, bind);
+}
+
+static const char *swift_cstr (mach_swift_index_t *index, uint64_t vmaddr)
+{
+    uint64_t offset = mach_vmaddr_to_offset (index->macho, vmaddr);
+    if (!vmaddr || offset == MACH_ADDR_INVALID || offset >= index->macho->size)
+        return NULL;
+
+    const char *s = (const char *) index->macho->data + offset;
+    return memchr (s, '\0', index->macho->size - offset) ? s : NULL;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Names                                									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  The standard library types and protocols that have a two character
+ *  "S" substitution in mangled names.
+ */
+static const struct { char c; const char *name; } swift_std_subst[] = {
+    { 'a', "Array" },           { 'b', "Bool" },            { 'D', "Dictionary" },
+    { 'd', "Double" },          { 'f', "Float" },           { 'h', "Set" },
+    { 'I', "DefaultIndices" },  { 'i', "Int" },             { 'J', "Character" },
+    { 'N', "ClosedRange" },     { 'n', "Range" },           { 'O', "ObjectIdentifier" },
+    { 'p', "UnsafeMutablePointer" },                        { 'P', "UnsafePointer" },
+    { 'R', "UnsafeBufferPointer" },                         { 'r', "UnsafeMutableBufferPointer" },
+    { 'S', "String" },          { 's', "Substring" },       { 'u', "UInt" },
+    { 'V', "UnsafeRawPointer" },                            { 'v', "UnsafeMutableRawPointer" },
+    { 'W', "UnsafeRawBufferPointer" },                      { 'w', "UnsafeMutableRawBufferPointer" },
+    { 'q', "Optional" },
+    { 'B', "BinaryFloatingPoint" },                         { 'E', "Encodable" },
+    { 'e', "Decodable" },       { 'F', "FloatingPoint" },   { 'G', "RandomNumberGenerator" },
+    { 'H', "Hashable" },        { 'j', "Numeric" },         { 'K', "BidirectionalCollection" },
+    { 'k', "RandomAccessCollection" },                      { 'L', "Comparable" },
+    { 'l', "Collection" },      { 'M', "MutableCollection" },
+    { 'm', "RangeReplaceableCollection" },                  { 'Q', "Equatable" },
+    { 'T', "Sequence" },        { 't', "IteratorProtocol" },
+    { 'U', "UnsignedInteger" }, { 'X', "RangeExpression" }, { 'x', "Strideable" },
+    { 'Y', "RawRepresentable" },                            { 'y', "StringProtocol" },
+    { 'Z', "SignedInteger" },   { 'z', "BinaryInteger" },
+};
+
+/**
+ *  Function:   swift_demangle_descriptor
+ *  -------------------------------------
+ *
+ *  Demangles the symbol of a protocol or nominal type descriptor, like
+ *  "_$s7Combine16ObservableObjectMp" or "_$sSQMp". Only plain module and
+ *  type identifiers are handled, anything else returns NULL so the
+ *  caller can fall back to the raw symbol.
+ *
+ */
+static char *swift_demangle_descriptor (const char *sym)
+{
+    if (*sym == '_')
+        sym++;
+    if (strncmp (sym, "$s", 2))
+        return NULL;
+    sym += 2;
+
+    char out[SWIFT_MAX_NAME];
+    size_t len = 0;
+    out[0] = '\0';
+
+    if (sym[0] == 'S' && sym[1] == 'o') {
+        len = snprintf (out, sizeof (out), "__C");
+        sym += 2;
+    } else if (sym[0] == 'S' && sym[1]) {
+        for (size_t i = 0; i < sizeof (swift_std_subst) / sizeof (swift_std_subst[0]); i++)
+            if (swift_std_subst[i].c == sym[1]) {
+                len = snprintf (out, sizeof (out), "Swift.%s", swift_std_subst[i].name);
+                break;
+            }
+        if (!len)
+            return NULL;
+        sym += 2;
+    }
+
+    while (*sym) {
+        if (*sym >= '1' && *sym <= '9') {
+            unsigned long n = strtoul (sym, (char **) &sym, 10);
+            if (n > strlen (sym) || len + n + 2 > sizeof (out))
+                return NULL;
+            if (len)
+                out[len++] = '.';
+            memcpy (out + len, sym, n);
+            len += n;
+            out[len] = '\0';
+            sym += n;
+        } else if (*sym == 'V' || *sym == 'C' || *sym == 'O') {
+            sym++;
+        } else if (!strcmp (sym, "Mp") || !strcmp (sym, "Mn")) {
+            break;
+        } else {
+            return NULL;
+        }
+    }
+
+    return (len) ? swift_strdup (out) : NULL;
+}
+
+static char *swift_bind_name (mach_bind_t *bind)
+{
+    if (!bind || !bind->name)
+        return swift_strdup ("<unknown>");
+
+    char *name = swift_demangle_descriptor (bind->name);
+    return (name) ? name : swift_strdup (bind->name);
+}
+
+/**
+ *  Builds the qualified name of a context descriptor by walking up its
+ *  parents. Extensions and anonymous contexts don't add to the name.
+ */
+static size_t swift_context_name (mach_swift_index_t *index, uint64_t desc, char *out, size_t size, int depth)
+{
+    int32_t flags;
+    if (!desc || depth > SWIFT_MAX_DEPTH || !swift_read32 (index, desc, &flags))
+        return 0;
+
+    mach_bind_t *bind;
+    uint64_t parent = swift_rel_indirectable (index, desc + 4, &bind);
+    size_t len = swift_context_name (index, parent, out, size, depth + 1);
+
+    uint32_t kind = flags & 0x1f;
+    if (kind == SWIFT_KIND_EXTENSION || kind == SWIFT_KIND_ANONYMOUS || kind == SWIFT_KIND_OPAQUE_TYPE)
+        return len;
+
+    const char *name = swift_cstr (index, swift_rel (index, desc + 8, 0));
+    if (!name)
+        return len;
+
+    int n = snprintf (out + len, size - len, "%s%s", (len) ? "." : "", name);
+    return (n < 0 || len + n >= size) ? size - 1 : len + n;
+}
+
+static char *swift_qualified_name (mach_swift_index_t *index, uint64_t desc)
+{
+    char out[SWIFT_MAX_NAME];
+    out[0] = '\0';
+    swift_context_name (index, desc, out, sizeof (out), 0);
+    return swift_strdup (out);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Index                                									 --*/
+//===-----------------------------------------------------------------------===//
+
+static uint64_t swift_u64_hash (const void *key)
+{
+    return h_mem_hash (key, sizeof (uint64_t));
+}
+
+static int swift_u64_equal (const void *a, const void *b)
+{
+    return *(const uint64_t *) a == *(const uint64_t *) b;
+}
+
+/**
+ *  Returns the index of the protocol with `name`, adding it if it's new.
+ *  Takes ownership of `name`.
+ */
+static uint32_t swift_protocol_add (mach_swift_index_t *index, char *name, uint64_t descriptor)
+{
+    uintptr_t found = (uintptr_t) h_hash_table_lookup (index->protocols_by_name, name);
+    if (found) {
+        free (name);
+        return (uint32_t) (found - 1);
+    }
+
+    uint32_t i = index->nprotocols++;
+    index->protocols[i].full_name = name;
+    index->protocols[i].descriptor = descriptor;
+    h_hash_table_insert (index->protocols_by_name, name, (void *) (uintptr_t) (i + 1));
+    return i;
+}
+
+static void swift_load_types (mach_swift_index_t *index)
+{
+    mach_section_64_t *sect = swift_section (index->macho, "__swift5_types");
+    if (!sect)
+        return;
+
+    index->types = calloc (sect->size / 4 + 1, sizeof (mach_swift_type_t));
+
+    for (uint64_t a = sect->addr; a + 4 <= sect->addr + sect->size; a += 4) {
+        int32_t v;
+        if (!swift_read32 (index, a, &v) || !v)
+            continue;
+
+        // Low two bits: 0 direct, 1 indirect
+        uint64_t desc = a + (int64_t) (v & ~3);
+        if ((v & 3) == 1)
+            desc = mach_fixups_read_pointer (index->macho, index->fixups, desc, NULL);
+
+        int32_t flags;
+        if (!desc || !swift_read32 (index, desc, &flags))
+            continue;
+
+        mach_swift_type_t *type = &index->types[index->ntypes++];
+        type->descriptor = desc;
+        type->kind = flags & 0x1f;
+        type->name = swift_cstr (index, swift_rel (index, desc + 8, 0));
+        type->full_name = swift_qualified_name (index, desc);
+        type->fields = swift_rel (index, desc + 16, 0);
+    }
+
+    index->types_by_name = h_hash_table_sized_new (h_str_hash, h_str_equal, index->ntypes);
+    index->types_by_descriptor = h_hash_table_sized_new (swift_u64_hash, swift_u64_equal, index->ntypes);
+    for (uint32_t i = 0; i < index->ntypes; i++) {
+        mach_swift_type_t *type = &index->types[i];
+        if (!h_hash_table_contains (index->types_by_name, type->full_name))
+            h_hash_table_insert (index->types_by_name, type->full_name, type);
+        h_hash_table_insert (index->types_by_descriptor, &type->descriptor, type);
+    }
+}
+
+static void swift_load_protocols (mach_swift_index_t *index, uint64_t capacity)
+{
+    index->protocols = calloc (capacity + 1, sizeof (mach_swift_protocol_t));
+    index->protocols_by_name = h_hash_table_new (h_str_hash, h_str_equal);
+
+    mach_section_64_t *sect = swift_section (index->macho, "__swift5_protos");
+    if (!sect)
+        return;
+
+    for (uint64_t a = sect->addr; a + 4 <= sect->addr + sect->size; a += 4) {
+        uint64_t desc = swift_rel_indirectable (index, a, NULL);
+        if (desc)
+            swift_protocol_add (index, swift_qualified_name (index, desc), desc);
+    }
+}
+
+static void swift_load_conformances (mach_swift_index_t *index, mach_section_64_t *sect)
+{
+    index->conformances = calloc (sect->size / 4 + 1, sizeof (mach_swift_conformance_t));
+
+    for (uint64_t a = sect->addr; a + 4 <= sect->addr + sect->size; a += 4) {
+        uint64_t desc = swift_rel (index, a, 3);
+        int32_t flags;
+        if (!desc || !swift_read32 (index, desc + 12, &flags))
+            continue;
+
+        mach_swift_conformance_t *conf = &index->conformances[index->nconformances];
+        conf->descriptor = desc;
+        conf->type = MACH_SWIFT_NONE;
+
+        // Protocol
+        mach_bind_t *bind;
+        uint64_t proto = swift_rel_indirectable (index, desc, &bind);
+        if (proto)
+            conf->protocol = swift_protocol_add (index, swift_qualified_name (index, proto), proto);
+        else
+            conf->protocol = swift_protocol_add (index, swift_bind_name (bind), 0);
+
+        // Conforming type
+        uint64_t type = 0;
+        switch ((flags >> 3) & 7) {
+            case SWIFT_TYPEREF_DIRECT_DESCRIPTOR:
+                type = swift_rel (index, desc + 4, 0);
+                break;
+            case SWIFT_TYPEREF_INDIRECT_DESCRIPTOR:
+                type = swift_rel_indirect (index, desc + 4, 1, &bind);
+                if (!type && bind)
+                    conf->type_name = bind->name;
+                break;
+            case SWIFT_TYPEREF_DIRECT_OBJC_NAME:
+                conf->type_name = swift_cstr (index, swift_rel (index, desc + 4, 0));
+                break;
+            case SWIFT_TYPEREF_INDIRECT_OBJC_CLASS:
+                swift_rel_indirect (index, desc + 4, 1, &bind);
+                if (bind)
+                    conf->type_name = bind->name;
+                break;
+        }
+
+        mach_swift_type_t *t = (type) ? h_hash_table_lookup (index->types_by_descriptor, &type) : NULL;
+        if (t) {
+            conf->type = (uint32_t) (t - index->types);
+        } else if (type) {
+            // Not in __swift5_types, e.g. a conformance on a nested generic
+            conf->type_name = swift_cstr (index, swift_rel (index, type + 8, 0));
+        }
+
+        index->nconformances++;
+    }
+}
+
+/**
+ *  Groups conformances by protocol with a counting sort, so the
+ *  conformers of a protocol are one contiguous run.
+ */
+static void swift_group_conformers (mach_swift_index_t *index)
+{
+    index->conformers_start = calloc (index->nprotocols + 1, sizeof (uint32_t));
+    index->conformers = calloc (index->nconformances + 1, sizeof (uint32_t));
+
+    for (uint32_t i = 0; i < index->nconformances; i++)
+        index->conformers_start[index->conformances[i].protocol + 1]++;
+    for (uint32_t p = 0; p < index->nprotocols; p++)
+        index->conformers_start[p + 1] += index->conformers_start[p];
+
+    uint32_t *next = malloc (sizeof (uint32_t) * (index->nprotocols + 1));
+    memcpy (next, index->conformers_start, sizeof (uint32_t) * (index->nprotocols + 1));
+    for (uint32_t i = 0; i < index->nconformances; i++)
+        index->conformers[next[index->conformances[i].protocol]++] = i;
+    free (next);
+}
+
+
+/**
+ *  Function:   mach_swift_index_load
+ *  ---------------------------------
+ *
+ *  Reads the Swift type, protocol and conformance metadata of a Mach-O
+ *  and builds lookup tables over it.
+ *
+ *  macho:      The Mach-O.
+ *
+ *  returns:    The index, or NULL if the Mach-O has no Swift 5 metadata.
+ *              Free with mach_swift_index_free().
+ *
+ */
+mach_swift_index_t *mach_swift_index_load (macho_t *macho)
+{
+    mach_section_64_t *types = swift_section (macho, "__swift5_types");
+    mach_section_64_t *protos = swift_section (macho, "__swift5_protos");
+    mach_section_64_t *proto = swift_section (macho, "__swift5_proto");
+    if (!types && !protos && !proto)
+        return NULL;
+
+    mach_swift_index_t *index = calloc (1, sizeof (mach_swift_index_t));
+    index->macho = macho;
+    index->fixups = mach_fixups_load (macho);
+
+    swift_load_types (index);
+    if (!index->types_by_name) {
+        index->types_by_name = h_hash_table_new (h_str_hash, h_str_equal);
+        index->types_by_descriptor = h_hash_table_new (swift_u64_hash, swift_u64_equal);
+    }
+
+    // Each conformance can add at most one protocol
+    uint64_t nprotos = (protos) ? protos->size / 4 : 0;
+    uint64_t nconfs = (proto) ? proto->size / 4 : 0;
+    swift_load_protocols (index, nprotos + nconfs);
+
+    if (proto)
+        swift_load_conformances (index, proto);
+    swift_group_conformers (index);
+
+    debugf ("mach_swift_index_load: %d types, %d protocols, %d conformances\n",
+            index->ntypes, index->nprotocols, index->nconformances);
+    return index;
+}
+
+
+void mach_swift_index_free (mach_swift_index_t *index)
+{
+    if (!index) return;
+
+    for (uint32_t i = 0; i < index->ntypes; i++)
+        free (index->types[i].full_name);
+    for (uint32_t i = 0; i < index->nprotocols; i++)
+        free (index->protocols[i].full_name);
+
+    h_hash_table_destroy (index->types_by_name);
+    h_hash_table_destroy (index->types_by_descriptor);
+    h_hash_table_destroy (index->protocols_by_name);
+
+    free (index->types);
+    free (index->protocols);
+    free (index->conformances);
+    free (index->conformers);
+    free (index->conformers_start);
+    mach_fixups_free (index->fixups);
+    free (index);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Queries                              									 --*/
+//===-----------------------------------------------------------------------===//
+
+mach_swift_type_t *mach_swift_type_find (mach_swift_index_t *index, const char *name)
+{
+    return h_hash_table_lookup (index->types_by_name, name);
+}
+
+
+mach_swift_protocol_t *mach_swift_protocol_find (mach_swift_index_t *index, const char *name)
+{
+    uintptr_t i = (uintptr_t) h_hash_table_lookup (index->protocols_by_name, name);
+    return (i) ? &index->protocols[i - 1] : NULL;
+}
+
+
+/**
+ *  Function:   mach_swift_conformers
+ *  ---------------------------------
+ *
+ *  Lists the conformances to a protocol, by qualified name.
+ *
+ *  index:      The Swift index.
+ *  protocol:   Qualified protocol name, e.g. "Swift.Hashable".
+ *  count:      Set to the number of conformances.
+ *
+ *  returns:    Indexes into index->conformances, or NULL. The array
+ *              belongs to the index.
+ *
+ */
+const uint32_t *mach_swift_conformers (mach_swift_index_t *index, const char *protocol, uint32_t *count)
+{
+    *count = 0;
+
+    uintptr_t i = (uintptr_t) h_hash_table_lookup (index->protocols_by_name, protocol);
+    if (!i)
+        return NULL;
+
+    uint32_t start = index->conformers_start[i - 1];
+    *count = index->conformers_start[i] - start;
+    return index->conformers + start;
+}
+
+
+/**
+ *  Function:   mach_swift_type_fields
+ *  ----------------------------------
+ *
+ *  Returns the field records of a type, in place in macho->data.
+ *
+ */
+mach_swift_field_record_t *mach_swift_type_fields (mach_swift_index_t *index, mach_swift_type_t *type, uint32_t *count)
+{
+    *count = 0;
+    if (!type->fields)
+        return NULL;
+
+    mach_swift_field_descriptor_t fd;
+    const uint8_t *p = swift_data (index, type->fields, sizeof (mach_swift_field_descriptor_t));
+    if (!p)
+        return NULL;
+    memcpy (&fd, p, sizeof (mach_swift_field_descriptor_t));
+
+    if (fd.field_record_size != sizeof (mach_swift_field_record_t) ||
+        !swift_data (index, type->fields, sizeof (fd) + (uint64_t) fd.num_fields * sizeof (mach_swift_field_record_t)))
+        return NULL;
+
+    *count = fd.num_fields;
+    return (mach_swift_field_record_t *) (p + sizeof (mach_swift_field_descriptor_t));
+}
+
+
+static uint64_t swift_record_vmaddr (mach_swift_index_t *index, const void *field)
+{
+    return mach_offset_to_vmaddr (index->macho, (const uint8_t *) field - index->macho->data);
+}
+
+const char *mach_swift_field_name (mach_swift_index_t *index, mach_swift_field_record_t *record)
+{
+    uint64_t vmaddr = swift_record_vmaddr (index, &record->field_name);
+    return (vmaddr == MACH_ADDR_INVALID) ? NULL : swift_cstr (index, swift_rel (index, vmaddr, 0));
+}
+
+const char *mach_swift_field_type (mach_swift_index_t *index, mach_swift_field_record_t *record)
+{
+    uint64_t vmaddr = swift_record_vmaddr (index, &record->mangled_type_name);
+    return (vmaddr == MACH_ADDR_INVALID) ? NULL : swift_cstr (index, swift_rel (index, vmaddr, 0));
+}
+
+
+char *mach_swift_kind_string (uint32_t kind)
+{
+    switch (kind) {
+        case SWIFT_KIND_MODULE:
+            return "module";
+        case SWIFT_KIND_EXTENSION:
+            return "extension";
+        case SWIFT_KIND_ANONYMOUS:
+            return "anonymous";
+        case SWIFT_KIND_PROTOCOL:
+            return "protocol";
+        case SWIFT_KIND_OPAQUE_TYPE:
+            return "opaque type";
+        case SWIFT_KIND_CLASS:
+            return "class";
+        case SWIFT_KIND_STRUCT:
+            return "struct";
+        case SWIFT_KIND_ENUM:
+            return "enum";
+        default:
+            return "unknown";
+    }
+}
@@ -23,6 +23,7 @@
 //===------------------------------------------------------------------===//
 
 #include "libhelper-macho/macho-symbol.h"
+#include "libhelper-macho/macho-command-types.h"
 
 
 /**
@@ -185,4 +186,67 @@ mach_symbol_table_t *mach_symtab_load_symbols (macho_t *macho, mach_symtab_comma
     }
 
     return NULL;
-}
\ No newline at end of file
+}
+
+
+/**
+ *  Function:   mach_symtab_load_symbol_info
+ *  ----------------------------------------
+ *
+ *  Loads every entry in the LC_SYMTAB symbol table into a flat array of
+ *  mach_symbol_info_t's. Names are not copied, they point into the string
+ *  table in macho->data. Entries whose string index is out of range, or
+ *  whose name isn't terminated within the string table, are given the
+ *  name "(no name)".
+ *
+ *  macho:      The Mach-O containing the LC_SYMTAB command.
+ *  count:      Set to the number of entries in the returned array.
+ *
+ *  returns:    An allocated array of symbols, or NULL if there is no symbol
+ *              table or it lies outside the file.
+ *
+ */
+mach_symbol_info_t *mach_symtab_load_symbol_info (macho_t *macho, uint32_t *count)
+{
+    *count = 0;
+
+    mach_command_info_t *cmdinfo = mach_lc_find_given_cmd (macho, LC_SYMTAB);
+    if (!cmdinfo) {
+        debugf ("[*] No LC_SYMTAB in %s\n", macho->path);
+        return NULL;
+    }
+
+    mach_symtab_command_t cmd;
+    memcpy (&cmd, macho->data + cmdinfo->offset, sizeof (mach_symtab_command_t));
+
+    // Check that both the nlist array and the string table are in the file
+    if ((uint64_t) cmd.symoff + (uint64_t) cmd.nsyms * sizeof (nlist) > macho->size ||
+        (uint64_t) cmd.stroff + cmd.strsize > macho->size) {
+        errorf ("Symbol table lies outside of the file\n");
+        return NULL;
+    }
+
+    if (!cmd.nsyms)
+        return NULL;
+
+    mach_symbol_info_t *syms = malloc (sizeof (mach_symbol_info_t) * cmd.nsyms);
+    char *strtab = (char *) macho->data + cmd.stroff;
+
+    for (uint32_t i = 0; i < cmd.nsyms; i++) {
+        nlist n;
+        memcpy (&n, macho->data + cmd.symoff + (uint64_t) i * sizeof (nlist), sizeof (nlist));
+
+        syms[i].name = "(no name)";
+        if (n.n_strx && n.n_strx < cmd.strsize &&
+            memchr (strtab + n.n_strx, '\0', cmd.strsize - n.n_strx))
+            syms[i].name = strtab + n.n_strx;
+
+        syms[i].value = n.n_value;
+        syms[i].type = n.n_type;
+        syms[i].sect = n.n_sect;
+        syms[i].desc = n.n_desc;
+    }
+
+    *count = cmd.nsyms;
+    return syms;
+}
@@ -0,0 +1,947 @@
+//===-------------------------- macho_symmatch ------------------------===//
+//
+//                          Libhelper Mach-O Parser
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===------------------------------------------------------------------===//
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libhelper-macho/macho-symmatch.h"
+#include "libhelper-macho/macho-arm64.h"
+#include "libhelper-macho/macho-command.h"
+#include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-loh.h"
+#include "libhelper-macho/macho-symbol.h"
+#include "libhelper/hhash.h"
+#include "libhelper/hparallel.h"
+
+
+#define SYMMATCH_NONE           UINT32_MAX
+#define SYMMATCH_DUPLICATE      ((void *) UINTPTR_MAX)
+#define SYMMATCH_BATCH          64
+
+#define SYMMATCH_CACHE_MAGIC    0x4d59534c      // 'LSYM'
+#define SYMMATCH_CACHE_VERSION  2
+
+// The smallest a cached match can be: addresses, confidence, method and
+// name length, with an empty name.
+#define SYMMATCH_CACHE_ENTRY_MIN    (2 * sizeof (uint64_t) + sizeof (float) + 2 * sizeof (uint32_t))
+
+
+/**
+ *  A section we care about while extracting features: either code, or C
+ *  string literals that code may reference.
+ */
+typedef struct symmatch_region_t {
+    uint64_t    addr;
+    uint64_t    size;
+    uint64_t    offset;
+} symmatch_region_t;
+
+/**
+ *  Everything we know about one function. `name` is only set for the
+ *  reference, and points into the reference's macho->data.
+ */
+typedef struct symmatch_func_t {
+    uint64_t     addr;
+    uint64_t     offset;
+    uint32_t     ninsns;
+
+    uint64_t     hash;          // normalised instruction hash
+    uint64_t     anchor;        // combined hash of referenced strings
+    uint32_t     nanchors;
+
+    uint64_t    *calls;         // BL targets, in order
+    uint32_t     ncalls;
+
+    char        *name;
+
+    uint32_t     match;         // index on the other side, or SYMMATCH_NONE
+    float        confidence;
+    uint32_t     method;
+} symmatch_func_t;
+
+typedef struct symmatch_image_t {
+    macho_t             *macho;
+    int                  arm64;
+
+    symmatch_region_t   *code;
+    uint32_t             ncode;
+    symmatch_region_t   *cstrings;
+    uint32_t             ncstrings;
+
+    symmatch_func_t     *funcs;
+    uint32_t             nfuncs;
+    HHashTable          *by_addr;       // &func->addr -> index + 1
+
+    mach_loh_table_t    *loh;           // linker optimisation hints, if any
+} symmatch_image_t;
+
+
+static uint64_t symmatch_mix (uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static uint64_t symmatch_u64_hash (const void *key)
+{
+    return symmatch_mix (*(const uint64_t *) key);
+}
+
+static int symmatch_u64_equal (const void *a, const void *b)
+{
+    return *(const uint64_t *) a == *(const uint64_t *) b;
+}
+
+static int symmatch_u64_compare (const void *x, const void *y)
+{
+    uint64_t a = *(const uint64_t *) x, b = *(const uint64_t *) y;
+    return (a < b) ? -1 : (a > b);
+}
+
+static char *symmatch_strdup (const char *s)
+{
+    size_t len = strlen (s);
+    char *ret = malloc (len + 1);
+    memcpy (ret, s, len + 1);
+    return ret;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Splitting into functions             									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void symmatch_load_regions (symmatch_image_t *img)
+{
+    macho_t *macho = img->macho;
+    uint32_t cap = 0;
+
+    for (HSList *l = macho->scmds; l; l = l->next)
+        cap += h_slist_length (((mach_segment_info_t *) l->data)->sections);
+
+    img->code = calloc (cap + 1, sizeof (symmatch_region_t));
+    img->cstrings = calloc (cap + 1, sizeof (symmatch_region_t));
+
+    for (HSList *l = macho->scmds; l; l = l->next) {
+        mach_segment_info_t *si = (mach_segment_info_t *) l->data;
+        for (HSList *s = si->sections; s; s = s->next) {
+            mach_section_64_t *sect = (mach_section_64_t *) s->data;
+
+            if (MACH_SECTION_IS_ZEROFILL (sect->flags) || !sect->offset ||
+                (uint64_t) sect->offset + sect->size > macho->size)
+                continue;
+
+            symmatch_region_t r = { sect->addr, sect->size, sect->offset };
+            if (sect->flags & (S_ATTR_PURE_INSTRUCTIONS | S_ATTR_SOME_INSTRUCTIONS))
+                img->code[img->ncode++] = r;
+            else if ((sect->flags & SECTION_TYPE) == S_CSTRING_LITERALS)
+                img->cstrings[img->ncstrings++] = r;
+        }
+    }
+}
+
+static symmatch_region_t *symmatch_find_region (symmatch_region_t *regions, uint32_t n, uint64_t addr)
+{
+    for (uint32_t i = 0; i < n; i++)
+        if (addr >= regions[i].addr && addr - regions[i].addr < regions[i].size)
+            return &regions[i];
+    return NULL;
+}
+
+
+/**
+ *  Functions are found using LC_FUNCTION_STARTS, falling back to the
+ *  symbol table for binaries without one. Each function runs until the
+ *  next start, or the end of its section.
+ */
+static void symmatch_load_functions (symmatch_image_t *img, mach_symbol_info_t *syms, uint32_t nsyms)
+{
+    uint32_t nstarts = 0;
+    uint64_t *starts = mach_lc_load_function_starts (img->macho, &nstarts);
+
+    if (!starts && syms) {
+        starts = malloc (sizeof (uint64_t) * (nsyms + 1));
+        for (uint32_t i = 0; i < nsyms; i++) {
+            if ((syms[i].type & N_STAB) || (syms[i].type & N_TYPE) != N_SECT)
+                continue;
+            if (symmatch_find_region (img->code, img->ncode, syms[i].value))
+                starts[nstarts++] = syms[i].value;
+        }
+    }
+    if (!nstarts) {
+        free (starts);
+        return;
+    }
+
+    qsort (starts, nstarts, sizeof (uint64_t), symmatch_u64_compare);
+
+    img->funcs = calloc (nstarts, sizeof (symmatch_func_t));
+    for (uint32_t i = 0; i < nstarts; i++) {
+        if (i && starts[i] == starts[i - 1])
+            continue;
+
+        symmatch_region_t *r = symmatch_find_region (img->code, img->ncode, starts[i]);
+        if (!r)
+            continue;
+
+        uint64_t end = r->addr + r->size;
+        if (i + 1 < nstarts && starts[i + 1] < end)
+            end = starts[i + 1];
+
+        symmatch_func_t *f = &img->funcs[img->nfuncs++];
+        f->addr = starts[i];
+        f->offset = r->offset + (starts[i] - r->addr);
+        f->ninsns = (uint32_t) ((end - starts[i]) / 4);
+        f->match = SYMMATCH_NONE;
+    }
+    free (starts);
+
+    img->by_addr = h_hash_table_sized_new (symmatch_u64_hash, symmatch_u64_equal, img->nfuncs);
+    for (uint32_t i = 0; i < img->nfuncs; i++)
+        h_hash_table_insert (img->by_addr, &img->funcs[i].addr, (void *) (uintptr_t) (i + 1));
+
+    // Names. External symbols win over locals at the same address.
+    for (uint32_t i = 0; syms && i < nsyms; i++) {
+        if ((syms[i].type & N_STAB) || (syms[i].type & N_TYPE) != N_SECT || !syms[i].name[0])
+            continue;
+
+        uintptr_t idx = (uintptr_t) h_hash_table_lookup (img->by_addr, &syms[i].value);
+        if (!idx)
+            continue;
+
+        symmatch_func_t *f = &img->funcs[idx - 1];
+        if (!f->name || (syms[i].type & N_EXT))
+            f->name = syms[i].name;
+    }
+}
+
+static uint32_t symmatch_func_index (symmatch_image_t *img, uint64_t addr)
+{
+    uintptr_t idx = (uintptr_t) h_hash_table_lookup (img->by_addr, &addr);
+    return idx ? (uint32_t) (idx - 1) : SYMMATCH_NONE;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Feature extraction                   									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void symmatch_add_anchor (symmatch_image_t *img, symmatch_func_t *f, uint64_t addr)
+{
+    symmatch_region_t *r = symmatch_find_region (img->cstrings, img->ncstrings, addr);
+    if (!r)
+        return;
+
+    const char *str = (const char *) img->macho->data + r->offset + (addr - r->addr);
+    size_t max = r->size - (addr - r->addr), len = 0;
+    while (len < max && str[len]) len++;
+
+    // Summed, so the anchor doesn't depend on the order strings are used in
+    f->anchor += symmatch_mix (h_mem_hash (str, len));
+    f->nanchors++;
+}
+
+static void symmatch_add_call (symmatch_func_t *f, uint64_t target, uint32_t *cap)
+{
+    if (f->ncalls == *cap) {
+        *cap = *cap ? *cap * 2 : 8;
+        f->calls = realloc (f->calls, sizeof (uint64_t) * *cap);
+    }
+    f->calls[f->ncalls++] = target;
+}
+
+
+/**
+ *  Hashes the normalised instruction stream of an arm64 function, and
+ *  follows ADRP'd registers far enough to see which strings are loaded
+ *  (ADRP + ADD) and which functions are called. Where the linker left
+ *  optimisation hints, an ADD they cover is resolved straight from its
+ *  ADRP, which also catches pairs split by a call or a branch.
+ */
+static void symmatch_extract_arm64 (symmatch_image_t *img, symmatch_func_t *f)
+{
+    const uint8_t *p = img->macho->data + f->offset;
+    uint64_t page[32];
+    uint32_t paged = 0, cap = 0;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (uint32_t i = 0; i < f->ninsns; i++, p += 4) {
+        uint32_t insn = (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+                        ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+        uint64_t pc = f->addr + (uint64_t) i * 4;
+        unsigned rd = arm64_rd (insn), rn = arm64_rn (insn);
+
+        // An ADD the hints resolve is a page offset however rn was set,
+        // even when its ADRP is out of sight, so it's masked like one
+        uint64_t target = (arm64_is_add_imm (insn) && img->loh) ?
+                          mach_loh_resolve (img->macho, img->loh, pc) : MACH_ADDR_INVALID;
+        uint32_t masked = (target != MACH_ADDR_INVALID) ? paged | (1u << rn) : paged;
+
+        h = (h ^ arm64_normalise (insn, masked)) * 0x100000001b3ULL;
+
+        if (arm64_is_adrp (insn)) {
+            page[rd] = arm64_adrp_target (pc, insn);
+            paged |= 1u << rd;
+        } else if (arm64_is_adr (insn)) {
+            symmatch_add_anchor (img, f, arm64_adr_target (pc, insn));
+            paged &= ~(1u << rd);
+        } else if (target != MACH_ADDR_INVALID) {
+            symmatch_add_anchor (img, f, target);
+            paged &= ~(1u << rd);
+        } else if (arm64_is_add_imm (insn) && (paged & (1u << rn))) {
+            symmatch_add_anchor (img, f, page[rn] + arm64_add_imm (insn));
+            paged &= ~(1u << rd);
+        } else if (arm64_is_ldst_uimm (insn) && (paged & (1u << rn))) {
+            if (insn & (1u << 22))          // loads clobber rd
+                paged &= ~(1u << rd);
+        } else if (arm64_is_bl (insn)) {
+            symmatch_add_call (f, arm64_branch_target (pc, insn), &cap);
+            paged &= ~0x3ffffu;             // x0 - x17 don't survive a call
+        }
+    }
+    f->hash = h;
+}
+
+static void symmatch_extract_worker (size_t index, void *user_data)
+{
+    symmatch_image_t *img = (symmatch_image_t *) user_data;
+    size_t end = (index + 1) * SYMMATCH_BATCH;
+    if (end > img->nfuncs)
+        end = img->nfuncs;
+
+    for (size_t i = index * SYMMATCH_BATCH; i < end; i++) {
+        symmatch_func_t *f = &img->funcs[i];
+        if (img->arm64)
+            symmatch_extract_arm64 (img, f);
+        else
+            f->hash = h_mem_hash (img->macho->data + f->offset, (size_t) f->ninsns * 4);
+    }
+}
+
+
+static void symmatch_image_load (symmatch_image_t *img, macho_t *macho, int nthreads)
+{
+    memset (img, '\0', sizeof (symmatch_image_t));
+    img->macho = macho;
+    img->arm64 = (macho->header->cputype == CPU_TYPE_ARM64);
+
+    uint32_t nsyms = 0;
+    mach_symbol_info_t *syms = mach_symtab_load_symbol_info (macho, &nsyms);
+
+    symmatch_load_regions (img);
+    symmatch_load_functions (img, syms, nsyms);
+    free (syms);
+
+    if (img->arm64)
+        img->loh = mach_loh_table_load (macho);
+
+    size_t nbatches = (img->nfuncs + SYMMATCH_BATCH - 1) / SYMMATCH_BATCH;
+    h_parallel_for (nbatches, nthreads, symmatch_extract_worker, img);
+}
+
+static void symmatch_image_free (symmatch_image_t *img)
+{
+    for (uint32_t i = 0; i < img->nfuncs; i++)
+        free (img->funcs[i].calls);
+    free (img->funcs);
+    free (img->code);
+    free (img->cstrings);
+    if (img->by_addr)
+        h_hash_table_destroy (img->by_addr);
+    mach_loh_table_free (img->loh);
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Matching                             									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Each pass picks a key for every function that hasn't been matched yet,
+ *  with zero meaning "no key". Functions whose key is unique on both
+ *  sides are matched.
+ */
+typedef uint64_t (*symmatch_key_func) (symmatch_func_t *f);
+
+static uint64_t symmatch_key_hash_anchor (symmatch_func_t *f)
+{
+    return f->nanchors ? symmatch_mix (f->hash ^ symmatch_mix (f->anchor)) : 0;
+}
+
+static uint64_t symmatch_key_anchor (symmatch_func_t *f)
+{
+    return f->nanchors ? f->anchor : 0;
+}
+
+static uint64_t symmatch_key_hash (symmatch_func_t *f)
+{
+    // Tiny functions (stubs, getters...) are too common to say anything
+    return (f->ninsns >= 3) ? f->hash : 0;
+}
+
+
+typedef struct symmatch_index_t {
+    HHashTable  *table;
+    uint64_t    *keys;
+} symmatch_index_t;
+
+static void symmatch_index_build (symmatch_index_t *index, symmatch_image_t *img, symmatch_key_func key)
+{
+    index->keys = calloc (img->nfuncs + 1, sizeof (uint64_t));
+    index->table = h_hash_table_sized_new (symmatch_u64_hash, symmatch_u64_equal, img->nfuncs);
+
+    for (uint32_t i = 0; i < img->nfuncs; i++) {
+        if (img->funcs[i].match != SYMMATCH_NONE)
+            continue;
+        if (!(index->keys[i] = key (&img->funcs[i])))
+            continue;
+
+        if (h_hash_table_contains (index->table, &index->keys[i]))
+            h_hash_table_insert (index->table, &index->keys[i], SYMMATCH_DUPLICATE);
+        else
+            h_hash_table_insert (index->table, &index->keys[i], (void *) (uintptr_t) (i + 1));
+    }
+}
+
+static void symmatch_index_free (symmatch_index_t *index)
+{
+    h_hash_table_destroy (index->table);
+    free (index->keys);
+}
+
+
+static float symmatch_confidence (uint32_t method, symmatch_func_t *r, symmatch_func_t *t)
+{
+    uint32_t lo = (r->ninsns < t->ninsns) ? r->ninsns : t->ninsns;
+    uint32_t hi = (r->ninsns < t->ninsns) ? t->ninsns : r->ninsns;
+
+    switch (method) {
+        case MACH_SYMMATCH_HASH_ANCHOR:
+            return 1.0f;
+        case MACH_SYMMATCH_ANCHOR:
+            // Same strings, but the code may have changed
+            if (lo == hi) return 0.95f;
+            return (lo * 4 >= hi * 3) ? 0.85f : 0.7f;
+        case MACH_SYMMATCH_HASH:
+            // Longer functions are less likely to collide by chance
+            if (lo >= 32) return 0.9f;
+            return (lo >= 12) ? 0.8f : 0.6f;
+        default:
+            return 0.0f;
+    }
+}
+
+static void symmatch_pair (symmatch_image_t *ref, uint32_t ri, symmatch_image_t *tgt, uint32_t ti,
+                           uint32_t method, float confidence)
+{
+    symmatch_func_t *r = &ref->funcs[ri], *t = &tgt->funcs[ti];
+    r->match = ti;
+    t->match = ri;
+    r->method = t->method = method;
+    r->confidence = t->confidence = confidence;
+}
+
+static uint32_t symmatch_pass (symmatch_image_t *ref, symmatch_image_t *tgt, symmatch_key_func key, uint32_t method)
+{
+    symmatch_index_t ri, ti;
+    symmatch_index_build (&ri, ref, key);
+    symmatch_index_build (&ti, tgt, key);
+
+    uint32_t matched = 0;
+    for (uint32_t i = 0; i < tgt->nfuncs; i++) {
+        if (!ti.keys[i] || h_hash_table_lookup (ti.table, &ti.keys[i]) == SYMMATCH_DUPLICATE)
+            continue;
+
+        void *r = h_hash_table_lookup (ri.table, &ti.keys[i]);
+        if (!r || r == SYMMATCH_DUPLICATE)
+            continue;
+
+        uint32_t rindex = (uint32_t) ((uintptr_t) r - 1);
+        symmatch_pair (ref, rindex, tgt, i, method,
+                       symmatch_confidence (method, &ref->funcs[rindex], &tgt->funcs[i]));
+        matched++;
+    }
+
+    symmatch_index_free (&ri);
+    symmatch_index_free (&ti);
+    return matched;
+}
+
+
+/**
+ *  Walks outwards from every matched function: if both sides make the
+ *  same number of calls, the n'th callee in each is assumed to be the
+ *  same function as long as their instruction hashes agree. Confidence
+ *  decays with every step away from a directly-matched function.
+ */
+static uint32_t symmatch_callgraph_pass (symmatch_image_t *ref, symmatch_image_t *tgt)
+{
+    uint32_t *queue = malloc (sizeof (uint32_t) * (tgt->nfuncs + 1));
+    uint32_t head = 0, tail = 0, matched = 0;
+
+    for (uint32_t i = 0; i < tgt->nfuncs; i++)
+        if (tgt->funcs[i].match != SYMMATCH_NONE)
+            queue[tail++] = i;
+
+    while (head < tail) {
+        symmatch_func_t *t = &tgt->funcs[queue[head++]];
+        symmatch_func_t *r = &ref->funcs[t->match];
+
+        if (r->ncalls != t->ncalls || t->confidence < 0.5f)
+            continue;
+
+        for (uint32_t c = 0; c < t->ncalls; c++) {
+            uint32_t rc = symmatch_func_index (ref, r->calls[c]);
+            uint32_t tc = symmatch_func_index (tgt, t->calls[c]);
+            if (rc == SYMMATCH_NONE || tc == SYMMATCH_NONE)
+                continue;
+            if (ref->funcs[rc].match != SYMMATCH_NONE || tgt->funcs[tc].match != SYMMATCH_NONE)
+                continue;
+            if (ref->funcs[rc].hash != tgt->funcs[tc].hash)
+                continue;
+
+            symmatch_pair (ref, rc, tgt, tc, MACH_SYMMATCH_CALLGRAPH, t->confidence * 0.9f);
+            queue[tail++] = tc;
+            matched++;
+        }
+    }
+
+    free (queue);
+    return matched;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Caching                              									 --*/
+//===-----------------------------------------------------------------------===//
+
+static pthread_mutex_t symmatch_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static HHashTable *symmatch_cache = NULL;
+
+// Keys are the 32 bytes of ref_uuid followed by target_uuid
+static uint64_t symmatch_cache_hash (const void *key)
+{
+    return h_mem_hash (key, 32);
+}
+
+static int symmatch_cache_equal (const void *a, const void *b)
+{
+    return !memcmp (a, b, 32);
+}
+
+static int symmatch_uuid (macho_t *macho, uint8_t *uuid)
+{
+    mach_command_info_t *info = mach_lc_find_given_cmd (macho, LC_UUID);
+    if (!info || (uint64_t) info->offset + sizeof (mach_uuid_command_t) > macho->size)
+        return 0;
+
+    mach_uuid_command_t cmd;
+    memcpy (&cmd, macho->data + info->offset, sizeof (mach_uuid_command_t));
+    memcpy (uuid, cmd.uuid, 16);
+    return 1;
+}
+
+static void symmatch_matches_destroy (mach_symbol_matches_t *matches)
+{
+    for (uint32_t i = 0; i < matches->count; i++)
+        free (matches->matches[i].name);
+    free (matches->matches);
+    free (matches);
+}
+
+
+static char *symmatch_cache_path (const char *dir, mach_symbol_matches_t *m)
+{
+    size_t len = strlen (dir) + 80;
+    char *path = malloc (len);
+    int n = snprintf (path, len, "%s/", dir);
+
+    for (int i = 0; i < 16; i++)
+        n += snprintf (path + n, len - n, "%02X", m->ref_uuid[i]);
+    n += snprintf (path + n, len - n, "-");
+    for (int i = 0; i < 16; i++)
+        n += snprintf (path + n, len - n, "%02X", m->target_uuid[i]);
+    snprintf (path + n, len - n, ".symmatch");
+
+    return path;
+}
+
+/**
+ *  On-disk format: a magic, version and count (all uint32_t), then for
+ *  every match its target address, reference address, confidence, method
+ *  and name length, followed by the name without a terminator.
+ *
+ *  The file isn't trusted: a count of more entries than the file could
+ *  hold is rejected before anything is allocated.
+ */
+static int symmatch_cache_read (const char *dir, mach_symbol_matches_t *m)
+{
+    char *path = symmatch_cache_path (dir, m);
+    FILE *fp = fopen (path, "rb");
+    free (path);
+    if (!fp)
+        return 0;
+
+    uint32_t hdr[3];
+    if (fread (hdr, sizeof (uint32_t), 3, fp) != 3 ||
+        hdr[0] != SYMMATCH_CACHE_MAGIC || hdr[1] != SYMMATCH_CACHE_VERSION) {
+        fclose (fp);
+        return 0;
+    }
+
+    long size = (fseek (fp, 0, SEEK_END) == 0) ? ftell (fp) : -1;
+    if (size < (long) sizeof (hdr) || fseek (fp, sizeof (hdr), SEEK_SET) ||
+        (uint64_t) hdr[2] > (uint64_t) (size - sizeof (hdr)) / SYMMATCH_CACHE_ENTRY_MIN) {
+        warningf ("symmatch: ignoring corrupt cache file\n");
+        fclose (fp);
+        return 0;
+    }
+
+    m->matches = calloc ((size_t) hdr[2] + 1, sizeof (mach_symbol_match_t));
+    m->count = 0;
+    if (!m->matches) {
+        fclose (fp);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < hdr[2]; i++) {
+        mach_symbol_match_t *e = &m->matches[i];
+        uint32_t namelen;
+
+        if (fread (&e->target_addr, sizeof (uint64_t), 1, fp) != 1 ||
+            fread (&e->ref_addr, sizeof (uint64_t), 1, fp) != 1 ||
+            fread (&e->confidence, sizeof (float), 1, fp) != 1 ||
+            fread (&e->method, sizeof (uint32_t), 1, fp) != 1 ||
+            fread (&namelen, sizeof (uint32_t), 1, fp) != 1 || namelen > 0x10000)
+            goto bad;
+
+        e->name = malloc (namelen + 1);
+        if (fread (e->name, 1, namelen, fp) != namelen) {
+            free (e->name);
+            goto bad;
+        }
+        e->name[namelen] = '\0';
+        m->count++;
+    }
+
+    fclose (fp);
+    return 1;
+
+bad:
+    warningf ("symmatch: ignoring corrupt cache file\n");
+    fclose (fp);
+    for (uint32_t i = 0; i < m->count; i++)
+        free (m->matches[i].name);
+    free (m->matches);
+    m->matches = NULL;
+    m->count = 0;
+    return 0;
+}
+
+static void symmatch_cache_write (const char *dir, mach_symbol_matches_t *m)
+{
+    char *path = symmatch_cache_path (dir, m);
+    size_t len = strlen (path) + 8;
+    char *tmp = malloc (len);
+    snprintf (tmp, len, "%s.XXXXXX", path);
+
+    // A unique name, so two processes caching the same pair don't write
+    // into the same temporary file
+    int fd = mkstemp (tmp);
+    FILE *fp = (fd >= 0) ? fdopen (fd, "wb") : NULL;
+    if (!fp) {
+        warningf ("symmatch: could not write cache file: %s\n", tmp);
+        if (fd >= 0) {
+            close (fd);
+            remove (tmp);
+        }
+        goto out;
+    }
+    fchmod (fd, 0644);
+
+    uint32_t hdr[3] = { SYMMATCH_CACHE_MAGIC, SYMMATCH_CACHE_VERSION, m->count };
+    fwrite (hdr, sizeof (uint32_t), 3, fp);
+
+    for (uint32_t i = 0; i < m->count; i++) {
+        mach_symbol_match_t *e = &m->matches[i];
+        uint32_t namelen = (uint32_t) strlen (e->name);
+
+        fwrite (&e->target_addr, sizeof (uint64_t), 1, fp);
+        fwrite (&e->ref_addr, sizeof (uint64_t), 1, fp);
+        fwrite (&e->confidence, sizeof (float), 1, fp);
+        fwrite (&e->method, sizeof (uint32_t), 1, fp);
+        fwrite (&namelen, sizeof (uint32_t), 1, fp);
+        fwrite (e->name, 1, namelen, fp);
+    }
+
+    // Written to the side and renamed, so readers never see half a file
+    if (fclose (fp) == 0)
+        rename (tmp, path);
+    else
+        remove (tmp);
+
+out:
+    free (tmp);
+    free (path);
+}
+
+
+/**
+ *  Looks up a pair in the in-memory cache, taking a reference if found.
+ */
+static mach_symbol_matches_t *symmatch_cache_get (const uint8_t *key)
+{
+    mach_symbol_matches_t *m = NULL;
+
+    pthread_mutex_lock (&symmatch_cache_lock);
+    if (symmatch_cache && (m = h_hash_table_lookup (symmatch_cache, key)))
+        m->refs++;
+    pthread_mutex_unlock (&symmatch_cache_lock);
+
+    return m;
+}
+
+/**
+ *  Adds `m` to the in-memory cache. If another thread got there first,
+ *  `m` is released and the cached copy is returned instead.
+ */
+static mach_symbol_matches_t *symmatch_cache_put (mach_symbol_matches_t *m)
+{
+    mach_symbol_matches_t *ret = m;
+
+    pthread_mutex_lock (&symmatch_cache_lock);
+    if (!symmatch_cache)
+        symmatch_cache = h_hash_table_new (symmatch_cache_hash, symmatch_cache_equal);
+
+    mach_symbol_matches_t *existing = h_hash_table_lookup (symmatch_cache, m->ref_uuid);
+    if (existing) {
+        existing->refs++;
+        ret = existing;
+    } else {
+        m->refs++;
+        h_hash_table_insert (symmatch_cache, m->ref_uuid, m);
+    }
+    pthread_mutex_unlock (&symmatch_cache_lock);
+
+    if (ret != m)
+        symmatch_matches_destroy (m);
+    return ret;
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Public API                           									 --*/
+//===-----------------------------------------------------------------------===//
+
+static mach_symbol_matches_t *symmatch_run (macho_t *ref, macho_t *target, int nthreads,
+                                            mach_symbol_matches_t *m)
+{
+    symmatch_image_t ri, ti;
+    symmatch_image_load (&ri, ref, nthreads);
+    symmatch_image_load (&ti, target, nthreads);
+
+    if (!ri.nfuncs || !ti.nfuncs)
+        warningf ("symmatch: could not find any functions in the %s\n", ri.nfuncs ? "target" : "reference");
+
+    uint32_t n1 = 0, n2 = 0, n3 = 0, n4 = 0;
+    if (ri.nfuncs && ti.nfuncs) {
+        n1 = symmatch_pass (&ri, &ti, symmatch_key_hash_anchor, MACH_SYMMATCH_HASH_ANCHOR);
+        n2 = symmatch_pass (&ri, &ti, symmatch_key_anchor, MACH_SYMMATCH_ANCHOR);
+        n3 = symmatch_pass (&ri, &ti, symmatch_key_hash, MACH_SYMMATCH_HASH);
+        n4 = symmatch_callgraph_pass (&ri, &ti);
+    }
+    debugf ("symmatch: %u/%u functions matched (hash+anchor %u, anchor %u, hash %u, callgraph %u)\n",
+            n1 + n2 + n3 + n4, ti.nfuncs, n1, n2, n3, n4);
+
+    // Target functions are already sorted by address
+    m->matches = calloc (n1 + n2 + n3 + n4 + 1, sizeof (mach_symbol_match_t));
+    for (uint32_t i = 0; i < ti.nfuncs; i++) {
+        symmatch_func_t *t = &ti.funcs[i];
+        if (t->match == SYMMATCH_NONE || !ri.funcs[t->match].name)
+            continue;
+
+        mach_symbol_match_t *e = &m->matches[m->count++];
+        e->name = symmatch_strdup (ri.funcs[t->match].name);
+        e->ref_addr = ri.funcs[t->match].addr;
+        e->target_addr = t->addr;
+        e->confidence = t->confidence;
+        e->method = t->method;
+    }
+
+    symmatch_image_free (&ri);
+    symmatch_image_free (&ti);
+    return m;
+}
+
+
+/**
+ *  Function:   mach_symbols_recover
+ *  --------------------------------
+ *
+ *  Recovers function names for a stripped `target` from a symbolicated
+ *  `ref`. Feature extraction runs across `opts->nthreads` threads, and the
+ *  result is cached by the UUIDs of both files - in memory for the life
+ *  of the process, and on disk if `opts->cache_dir` is set. Binaries
+ *  without an LC_UUID are never cached.
+ *
+ *  Every match carries a confidence. Callers wanting only reliable names
+ *  should ignore anything below ~0.8.
+ *
+ *  ref:        The reference Mach-O, with symbols.
+ *  target:     The stripped Mach-O.
+ *  opts:       Options, or NULL for the defaults.
+ *
+ *  returns:    The matches, release with mach_symbol_matches_free().
+ *
+ */
+mach_symbol_matches_t *mach_symbols_recover (macho_t *ref, macho_t *target, mach_symmatch_opts_t *opts)
+{
+    if (!ref || !target) {
+        errorf ("mach_symbols_recover: need both a reference and a target\n");
+        return NULL;
+    }
+
+    int nthreads = opts ? opts->nthreads : 0;
+    const char *cache_dir = opts ? opts->cache_dir : NULL;
+    int cache = !(opts && opts->no_cache);
+
+    mach_symbol_matches_t *m = calloc (1, sizeof (mach_symbol_matches_t));
+    m->refs = 1;
+
+    if (cache)
+        cache = symmatch_uuid (ref, m->ref_uuid) && symmatch_uuid (target, m->target_uuid);
+
+    if (cache) {
+        mach_symbol_matches_t *cached = symmatch_cache_get (m->ref_uuid);
+        if (cached) {
+            free (m);
+            return cached;
+        }
+        if (cache_dir && symmatch_cache_read (cache_dir, m))
+            return symmatch_cache_put (m);
+    }
+
+    symmatch_run (ref, target, nthreads, m);
+
+    if (cache) {
+        if (cache_dir)
+            symmatch_cache_write (cache_dir, m);
+        m = symmatch_cache_put (m);
+    }
+    return m;
+}
+
+
+/**
+ *  Function:   mach_symbol_matches_lookup
+ *  --------------------------------------
+ *
+ *  Finds the recovered symbol for a function in the target.
+ *
+ *  matches:        Result of mach_symbols_recover().
+ *  target_addr:    Start address of the function in the target.
+ *
+ *  returns:        The match, or NULL if none was found.
+ *
+ */
+mach_symbol_match_t *mach_symbol_matches_lookup (mach_symbol_matches_t *matches, uint64_t target_addr)
+{
+    if (!matches) return NULL;
+
+    uint32_t lo = 0, hi = matches->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (matches->matches[mid].target_addr < target_addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < matches->count && matches->matches[lo].target_addr == target_addr)
+        return &matches->matches[lo];
+    return NULL;
+}
+
+
+void mach_symbol_matches_free (mach_symbol_matches_t *matches)
+{
+    if (!matches) return;
+
+    pthread_mutex_lock (&symmatch_cache_lock);
+    uint32_t refs = --matches->refs;
+    pthread_mutex_unlock (&symmatch_cache_lock);
+
+    if (!refs)
+        symmatch_matches_destroy (matches);
+}
+
+
+static void symmatch_cache_release (void *key, void *value, void *user_data)
+{
+    (void) key;
+    (void) user_data;
+
+    mach_symbol_matches_t *m = (mach_symbol_matches_t *) value;
+    if (!--m->refs)
+        symmatch_matches_destroy (m);
+}
+
+/**
+ *  Drops the in-memory cache. Results still held by callers stay valid
+ *  until they are freed.
+ */
+void mach_symmatch_cache_clear (void)
+{
+    pthread_mutex_lock (&symmatch_cache_lock);
+    if (symmatch_cache) {
+        h_hash_table_foreach (symmatch_cache, symmatch_cache_release, NULL);
+        h_hash_table_destroy (symmatch_cache);
+        symmatch_cache = NULL;
+    }
+    pthread_mutex_unlock (&symmatch_cache_lock);
+}
+
+
+char *mach_symmatch_method_string (uint32_t method)
+{
+    switch (method) {
+        case MACH_SYMMATCH_HASH_ANCHOR:
+            return "hash+anchor";
+        case MACH_SYMMATCH_ANCHOR:
+            return "anchor";
+        case MACH_SYMMATCH_HASH:
+            return "hash";
+        case MACH_SYMMATCH_CALLGRAPH:
+            return "callgraph";
+        default:
+            return "unknown";
+    }
+}
@@ -22,8 +22,18 @@
 //
 //===------------------------------------------------------------------===//
 
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "libhelper-macho/macho-command-types.h"
+#include "libhelper-macho/macho-command-table.h"
 #include "libhelper-macho/macho.h"
+#include "libhelper/hidentify.h"
+#include "libhelper/hperf.h"
+#include "libhelper/htrace.h"
 
 
 //===-----------------------------------------------------------------------===//
@@ -49,34 +59,44 @@ macho_t *macho_create ()
 }
 
 
-// Private Function
-#define FAT(p) ((*(unsigned int *)(p) & ~1) == 0xbebafeca)
-
-macho_t *macho_create_from_file (file_t *file)
+// Private Functions
+static void macho_slist_free (HSList *list, void (*free_data) (void *))
 {
-    macho_t *macho = macho_create ();
-
-    macho->path = file->path;
+    while (list) {
+        HSList *next = list->next;
+        if (free_data)
+            free_data (list->data);
+        free (list);
+        list = next;
+    }
+}
 
-    macho->data = (uint8_t *) file_load_bytes (file, file->size, 0);
-    macho->size = file->size;
-    macho->offset = 0;
+static void macho_command_info_free (void *data)
+{
+    mach_command_info_t *info = (mach_command_info_t *) data;
+    free (info->lc);
+    free (info);
+}
 
-    // Try to detect if we are handling a fat file
-    if (FAT(macho->data)) {
-        warningf ("Cannot handle fat binary.\n");
-        return NULL;
-    }
+static void macho_segment_info_free (void *data)
+{
+    mach_segment_info_t *seginfo = (mach_segment_info_t *) data;
+    macho_slist_free (seginfo->sections, free);
+    free (seginfo->segcmd);
+    free (seginfo);
+}
 
-    // Try to load the mach header, and handle a failure if it occurs
-    macho->header = mach_header_load (macho);
-    if (macho->header == NULL) {
-        errorf ("Unable to load Mach-O\n");
-        macho_free (macho);
-        return NULL;
-    }
+static void macho_dylib_info_free (void *data)
+{
+    mach_dylib_command_info_t *dylibinfo = (mach_dylib_command_info_t *) data;
+    free (dylibinfo->name);
+    free (dylibinfo->dylib);
+    free (dylibinfo);
+}
 
 
+static void macho_load_commands (macho_t *macho, uint32_t offset)
+{
     /**
      *  The first major chunk of data we will pull from mach->file is the
      *  Load Commands. They will be be split into two GSLists, cmdlist
@@ -104,7 +124,9 @@ macho_t *macho_create_from_file (file_t *file)
     HSList *lcmds = NULL;
     HSList *dylibs = NULL;
 
-    uint32_t offset = sizeof (mach_header_t);
+    // Where the commands start, so the descriptor table's checks work for
+    // embedded Mach-Os too.
+    macho->offset = offset;
 
     for (int i = 0; i < (int) macho->header->ncmds; i++) {
 
@@ -127,11 +149,16 @@ macho_t *macho_create_from_file (file_t *file)
                 continue;
             }
 
-            // Append to the segments list
+            // Append to the segments list. The segment info has its own
+            // copy of the command, so the plain info isn't kept.
             scmds = h_slist_append (scmds, seginfo);
+            offset += lc->lc->cmdsize;
+            macho_command_info_free (lc);
+            continue;
 
-        } else if (lc->type == LC_ID_DYLIB || lc->type == LC_LOAD_DYLIB ||
-                   lc->type == LC_LOAD_WEAK_DYLIB || lc->type == LC_REEXPORT_DYLIB) {
+        } else if ((lc->type == LC_ID_DYLIB || lc->type == LC_LOAD_DYLIB ||
+                    lc->type == LC_LOAD_WEAK_DYLIB || lc->type == LC_REEXPORT_DYLIB) &&
+                   mach_load_command_valid (macho, offset)) {
 
             // Because a Mach-O can have multiple Dynamically linked libraries,
             // that means there are multiple LC_DYLIB-like commands, so it's
@@ -181,12 +208,123 @@ macho_t *macho_create_from_file (file_t *file)
         offset += lc->lc->cmdsize;
     }
 
-    macho->offset = offset;
-
     macho->lcmds = lcmds;
     macho->scmds = scmds;
     macho->dylibs = dylibs;
+}
+
+
+/**
+ *  Function:   macho_create_from_file
+ *  ----------------------------------
+ *
+ *  Reads a whole file into memory and parses it as a thin Mach-O. The
+ *  macho_t owns the buffer, so the file can be closed straight away.
+ *
+ *  file:       The file, from file_load(). Its path is kept, not copied.
+ *
+ *  returns:    The parsed Mach-O, or NULL.
+ *
+ */
+macho_t *macho_create_from_file (file_t *file)
+{
+    uint8_t *data = (uint8_t *) file_load_bytes (file, file->size, 0);
+    macho_t *macho = macho_create_from_buffer (file->path, data, file->size);
+    if (!macho) {
+        free (data);
+        return NULL;
+    }
+
+    macho->owns |= MACHO_OWNS_DATA;
+    return macho;
+}
+
+
+/**
+ *  Function:   macho_create_from_buffer
+ *  ------------------------------------
+ *
+ *  Parses a thin Mach-O that's already in memory.
+ *
+ *  path:       The path it was read from, kept for reference.
+ *  data:       The file. It isn't copied, so it must outlive the macho_t,
+ *              and macho_free() leaves it to the caller.
+ *  size:       Size of `data`.
+ *
+ *  returns:    The parsed Mach-O, or NULL.
+ *
+ */
+macho_t *macho_create_from_buffer (char *path, uint8_t *data, uint32_t size)
+{
+    macho_t *macho = macho_create ();
+
+    macho->path = path;
+
+    macho->data = data;
+    macho->size = size;
+    macho->offset = 0;
+
+    // Try to detect if we are handling a fat file
+    if (lh_identify (macho->data, macho->size, NULL) == LH_FORMAT_FAT) {
+        warningf ("Cannot handle fat binary.\n");
+        macho_free (macho);
+        return NULL;
+    }
+
+    // Try to load the mach header, and handle a failure if it occurs
+    macho->header = mach_header_load (macho);
+    if (macho->header == NULL) {
+        errorf ("Unable to load Mach-O\n");
+        macho_free (macho);
+        return NULL;
+    }
+
+    h_trace_begin ("parse", "macho_load_commands");
+    macho_load_commands (macho, sizeof (mach_header_t));
+    h_trace_end ("parse", "macho_load_commands");
+    return macho;
+}
+
+
+/**
+ *  Function:   macho_create_embedded
+ *  ---------------------------------
+ *
+ *  Creates a view of a Mach-O that is embedded in another, like the kexts
+ *  in a kernelcache. The view shares the container's data, so segment
+ *  file offsets - which are relative to the container - and any offsets
+ *  in the view's load commands can be used on macho->data as normal.
+ *
+ *  container:  The Mach-O containing the embedded image.
+ *  offset:     File offset of the embedded image's mach header.
+ *
+ *  returns:    A macho_t for the embedded image, or NULL.
+ *
+ */
+macho_t *macho_create_embedded (macho_t *container, uint32_t offset)
+{
+    if ((uint64_t) offset + sizeof (mach_header_t) > container->size) {
+        errorf ("Embedded Mach-O header at 0x%x lies outside of the file\n", offset);
+        return NULL;
+    }
+
+    mach_header_t *header = mach_header_create ();
+    memcpy (header, container->data + offset, sizeof (mach_header_t));
+
+    if (mach_header_verify (header->magic) != MH_TYPE_MACHO64 ||
+        (uint64_t) offset + sizeof (mach_header_t) + header->sizeofcmds > container->size) {
+        errorf ("No valid Mach-O header at 0x%x\n", offset);
+        free (header);
+        return NULL;
+    }
 
+    macho_t *macho = macho_create ();
+    macho->path = container->path;
+    macho->data = container->data;
+    macho->size = container->size;
+    macho->header = header;
+
+    macho_load_commands (macho, offset + sizeof (mach_header_t));
     return macho;
 }
 
@@ -198,22 +336,32 @@ macho_t *macho_load (const char *filename)
     uint32_t         size = 0;
     unsigned char   *data = NULL;
 
+    h_perf_begin (H_PERF_MACHO_LOAD);
+    h_trace_begin ("parse", "macho_load");
+
     if (filename) {
 
         debugf ("Reading Mach-O from filename: %s\n", filename);
 
         file = file_load (filename);
-        if (file->size == 0) {
+        if (!file || file->size == 0) {
             errorf ("File not loaded properly\n");
-            macho_free (macho);
+            if (file)
+                file_close (file);
+            h_trace_end ("parse", "macho_load");
+            h_perf_end (H_PERF_MACHO_LOAD);
             return NULL;
         }
 
+        // The macho_t has its own copy of the file, so it isn't kept open
         debugf ("Creating Mach-O struct\n");
         macho = macho_create_from_file (file);
+        file_close (file);
 
         if (macho == NULL) {
             errorf ("Error creating Mach-O\n");
+            h_trace_end ("parse", "macho_load");
+            h_perf_end (H_PERF_MACHO_LOAD);
             return NULL;
         }
 
@@ -221,10 +369,158 @@ macho_t *macho_load (const char *filename)
     } else {
         errorf ("No filename specified\n");
     }
+
+    h_trace_end ("parse", "macho_load");
+    h_perf_end (H_PERF_MACHO_LOAD);
     return macho;
 }
 
 
+//===-----------------------------------------------------------------------===//
+/*-- Asynchronous loading                 									 --*/
+//===-----------------------------------------------------------------------===//
+
+// Reads are split up so a cancel doesn't wait for a whole multi-GB file
+#define MACHO_ASYNC_READ_SIZE       (8 * 1024 * 1024)
+
+typedef struct macho_async_t {
+    char                    *path;
+    uint32_t                 max_size;
+    macho_load_callback_t    callback;
+    void                    *ctx;
+
+    uint8_t                 *data;
+    uint32_t                 size;
+} macho_async_t;
+
+
+static void *macho_async_read (HAsync *op, void *input, int *error)
+{
+    macho_async_t *job = (macho_async_t *) input;
+    struct stat st;
+
+    if (h_async_cancelled (op)) {
+        *error = ECANCELED;
+        return NULL;
+    }
+
+    int fd = open (job->path, O_RDONLY);
+    if (fd < 0) {
+        *error = errno;
+        return NULL;
+    }
+    if (fstat (fd, &st)) {
+        *error = errno;
+        close (fd);
+        return NULL;
+    }
+
+    uint64_t limit = (job->max_size) ? job->max_size : UINT32_MAX;
+    if ((uint64_t) st.st_size > limit || st.st_size < (off_t) sizeof (uint32_t)) {
+        *error = (st.st_size < (off_t) sizeof (uint32_t)) ? ENOEXEC : EFBIG;
+        close (fd);
+        return NULL;
+    }
+
+    job->size = (uint32_t) st.st_size;
+    job->data = malloc (job->size);
+
+    for (uint32_t done = 0; done < job->size && !*error; ) {
+        if (h_async_cancelled (op)) {
+            *error = ECANCELED;
+            break;
+        }
+
+        size_t want = (job->size - done < MACHO_ASYNC_READ_SIZE) ? job->size - done : MACHO_ASYNC_READ_SIZE;
+        ssize_t n = pread (fd, job->data + done, want, done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            *error = (n < 0) ? errno : EIO;
+        else
+            done += n;
+    }
+    close (fd);
+
+    if (*error) {
+        free (job->data);
+        job->data = NULL;
+        return NULL;
+    }
+    return job;
+}
+
+
+static void *macho_async_parse (HAsync *op, void *input, int *error)
+{
+    macho_async_t *job = (macho_async_t *) input;
+
+    if (h_async_cancelled (op)) {
+        *error = ECANCELED;
+        free (job->data);
+        return NULL;
+    }
+
+    macho_t *macho = macho_create_from_buffer (job->path, job->data, job->size);
+    if (!macho) {
+        *error = ENOEXEC;
+        free (job->data);
+        return NULL;
+    }
+
+    // The macho_t keeps the buffer and the path, and frees them with
+    // itself, whether it's delivered or dropped after a cancel
+    macho->owns |= MACHO_OWNS_DATA | MACHO_OWNS_PATH;
+    job->data = NULL;
+    job->path = NULL;
+    return macho;
+}
+
+
+static void macho_async_free (void *result)
+{
+    macho_free ((macho_t *) result);
+}
+
+
+static void macho_async_done (void *result, int error, void *ctx)
+{
+    macho_async_t *job = (macho_async_t *) ctx;
+
+    if (job->callback)
+        job->callback ((macho_t *) result, error, job->ctx);
+
+    free (job->path);
+    free (job);
+}
+
+
+/**
+ *  Function:   macho_load_async
+ *  ----------------------------
+ *
+ *  Loads a Mach-O without blocking the caller. See macho.h.
+ *
+ *  path:       The file, copied.
+ *  opts:       Options, or NULL for the defaults.
+ *  callback:   Called once, from a pool thread, with the result.
+ *  ctx:        Passed to `callback`.
+ *
+ *  returns:    A handle for the operation.
+ *
+ */
+HAsync *macho_load_async (const char *path, const macho_load_opts_t *opts, macho_load_callback_t callback, void *ctx)
+{
+    macho_async_t *job = calloc (1, sizeof (macho_async_t));
+    job->path = strdup (path);
+    job->max_size = (opts) ? opts->max_size : 0;
+    job->callback = callback;
+    job->ctx = ctx;
+
+    return h_async_run (macho_async_read, macho_async_parse, macho_async_free, job, macho_async_done, job);
+}
+
+
 void *macho_load_bytes (macho_t *macho, size_t size, uint32_t offset)
 {
     void *ret = malloc (size);
@@ -233,9 +529,37 @@ void *macho_load_bytes (macho_t *macho, size_t size, uint32_t offset)
 }
 
 
+/**
+ *  Function:   macho_free
+ *  ----------------------
+ *
+ *  Frees a macho_t and everything parsed from it: the header copy and the
+ *  load command, segment and dylib lists. `path` and `data` are only
+ *  freed if the macho_t owns them, see MACHO_OWNS_* in macho.h, so this is
+ *  also safe for views from macho_create_embedded().
+ *
+ *  macho:      The Mach-O to free, or NULL.
+ *
+ */
 void macho_free (macho_t *macho)
 {
-    macho = NULL;
+    if (!macho)
+        return;
+
+    macho_slist_free (macho->lcmds, macho_command_info_free);
+    macho_slist_free (macho->scmds, macho_segment_info_free);
+    macho_slist_free (macho->dylibs, macho_dylib_info_free);
+
+    // Nothing in the parser fills these in, so only the lists are known
+    macho_slist_free (macho->symbols, NULL);
+    macho_slist_free (macho->strings, NULL);
+
+    free (macho->header);
+
+    if (macho->owns & MACHO_OWNS_DATA)
+        free (macho->data);
+    if (macho->owns & MACHO_OWNS_PATH)
+        free (macho->path);
     free (macho);
 }
 
@@ -316,6 +640,7 @@ mach_header_t *mach_header_load (macho_t *macho)
         //  copy null bytes into the struct.
         if (!header->magic) {
             errorf ("No magic value, something went wrong.\n");
+            free (header);
             return NULL;
         }
 
@@ -340,9 +665,11 @@ mach_header_t *mach_header_load (macho_t *macho)
             debugf ("Detected Mach-O 32-bit\n");
         } else if (type == MH_TYPE_FAT) {
             errorf ("Detected Universal Binary, but cannot load it.\n");
+            free (header);
             header = NULL;
         } else {
             errorf ("Unknown file magic: 0x%08x\n", header->magic);
+            free (header);
             header = NULL;
         }
     }
@@ -112,10 +112,14 @@ char *mstrappend(char *toap, ...) {
     
         // allocated enough bytes in rt for all contents values + a null byte
         rt = malloc(len + 1);
+        size_t off = 0;
         for (size_t i = 0; i < count; i++) {
             // append content at i to rt
-            rt = strappend(rt, content[i]);
+            size_t n = strlen(content[i]);
+            memcpy(rt + off, content[i], n);
+            off += n;
         }
+        rt[off] = '\0';
     
     } else {
         // Not enough args to continue, present error
@@ -124,9 +128,6 @@ char *mstrappend(char *toap, ...) {
         return NULL;
     }
     
-    // append a Null byte to the end of rt
-    rt = strappend(rt, "\0");
-    
     // Stop the va_list
     va_end(arg);
             
@@ -0,0 +1,58 @@
+//===----------------------------- macho-diff.c --------------------------===//
+//
+//                                  macho-diff
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===-----------------------------------------------------------------------===//
+
+//
+//  Testing for the Mach-O diff engine. Takes pairs of files, old then
+//  new, and diffs every pair at once with mach_diff_batch ().
+//
+
+#include <libhelper-macho/macho.h>
+#include <libhelper-macho/macho-diff.h>
+
+int main (int argc, char *argv[])
+{
+    if (argc < 3 || (argc - 1) % 2) {
+        printf ("usage: %s OLD NEW [OLD NEW ...]\n", argv[0]);
+        return -1;
+    }
+
+    size_t count = (argc - 1) / 2;
+    mach_diff_pair_t *pairs = calloc (count, sizeof (mach_diff_pair_t));
+
+    for (size_t i = 0; i < count; i++) {
+        pairs[i].a = macho_load (argv[1 + i * 2]);
+        pairs[i].b = macho_load (argv[2 + i * 2]);
+    }
+
+    mach_diff_batch (pairs, count, 0);
+
+    for (size_t i = 0; i < count; i++) {
+        printf ("\n%s -> %s\n", argv[1 + i * 2], argv[2 + i * 2]);
+        mach_diff_print (pairs[i].diff);
+        mach_diff_free (pairs[i].diff);
+    }
+
+    free (pairs);
+    return 0;
+}
@@ -0,0 +1,115 @@
+//===---------------------------- macho-export.c -------------------------===//
+//
+//                                 macho-export
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===-----------------------------------------------------------------------===//
+
+//
+//  Testing for mach_export_files(). Writes two small Mach-Os to temporary
+//  files and exports both as NDJSON, checking a record comes out for each.
+//  Built with AddressSanitizer where the compiler has it, so an input
+//  that isn't freed after it's exported fails the test.
+//
+
+#define _DEFAULT_SOURCE
+#include <unistd.h>
+
+#include <libhelper-macho/macho.h>
+#include <libhelper-macho/macho-command-types.h>
+#include <libhelper-macho/macho-export.h>
+
+#define FILE_SIZE       0x2000
+#define NFILES          2
+
+static void put_macho (uint8_t *data)
+{
+    mach_segment_command_64_t seg = { 0 };
+    seg.cmd = LC_SEGMENT_64;
+    seg.cmdsize = sizeof (mach_segment_command_64_t);
+    strncpy (seg.segname, "__TEXT", sizeof (seg.segname));
+    seg.vmaddr = 0x10000;
+    seg.vmsize = FILE_SIZE;
+    seg.filesize = FILE_SIZE;
+    memcpy (data + sizeof (mach_header_t), &seg, sizeof (seg));
+
+    mach_header_t hdr = { 0 };
+    hdr.magic = MACH_MAGIC_64;
+    hdr.cputype = CPU_TYPE_ARM64;
+    hdr.filetype = MACH_TYPE_EXECUTE;
+    hdr.ncmds = 1;
+    hdr.sizeofcmds = sizeof (seg);
+    memcpy (data, &hdr, sizeof (hdr));
+}
+
+static int count (const char *s, const char *what)
+{
+    int n = 0;
+    for (const char *p = s; (p = strstr (p, what)); p += strlen (what))
+        n++;
+    return n;
+}
+
+int main (void)
+{
+    char paths[NFILES][32];
+    const char *argv[NFILES];
+    uint8_t *data = calloc (1, FILE_SIZE);
+    put_macho (data);
+
+    for (int i = 0; i < NFILES; i++) {
+        strcpy (paths[i], "/tmp/macho-export-XXXXXX");
+        int fd = mkstemp (paths[i]);
+        if (fd < 0 || write (fd, data, FILE_SIZE) != FILE_SIZE) {
+            printf ("FAIL: could not write %s\n", paths[i]);
+            return 1;
+        }
+        close (fd);
+        argv[i] = paths[i];
+    }
+    free (data);
+
+    char out[] = "/tmp/macho-export-out-XXXXXX";
+    int fd = mkstemp (out);
+    int ret = mach_export_files (fd, argv, NFILES, MACH_EXPORT_NDJSON, 2);
+
+    // Read the records back
+    off_t size = lseek (fd, 0, SEEK_END);
+    char *text = calloc (1, (size_t) size + 1);
+    if (pread (fd, text, (size_t) size, 0) != size)
+        size = 0;
+    close (fd);
+
+    unlink (out);
+    for (int i = 0; i < NFILES; i++)
+        unlink (paths[i]);
+
+    int fail = 0;
+    int nmachos = count (text, "{\"type\":\"macho\"");
+    if (ret || nmachos != NFILES) {
+        printf ("FAIL: expected %d Mach-O records, found %d (returned %d)\n", NFILES, nmachos, ret);
+        fail = 1;
+    }
+    free (text);
+
+    if (!fail)
+        printf ("ok: exported %d files\n", NFILES);
+    return fail;
+}
@@ -0,0 +1,150 @@
+//===---------------------------- macho-fixups.c -------------------------===//
+//
+//                                 macho-fixups
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===-----------------------------------------------------------------------===//
+
+//
+//  Testing for chained fixups. Builds a Mach-O in memory with a two-link
+//  DYLD_CHAINED_PTR_ARM64E_KERNEL chain in __DATA, and checks both binds
+//  are found where the 4-byte stride puts them.
+//
+
+#include <libhelper-macho/macho.h>
+#include <libhelper-macho/macho-command-types.h>
+#include <libhelper-macho/macho-fixups.h>
+
+#define TEXT_VMADDR     0x10000
+#define DATA_FILEOFF    0x1000
+#define FIXUPS_FILEOFF  0x2000
+#define FILE_SIZE       0x2100
+
+#define STARTS_OFF      32
+#define IMPORTS_OFF     80
+#define SYMBOLS_OFF     88
+
+static void put32 (uint8_t *p, uint32_t v) { memcpy (p, &v, 4); }
+static void put16 (uint8_t *p, uint16_t v) { memcpy (p, &v, 2); }
+static void put64 (uint8_t *p, uint64_t v) { memcpy (p, &v, 8); }
+
+static uint8_t *build_macho (void)
+{
+    uint8_t *data = calloc (1, FILE_SIZE);
+    uint32_t off = sizeof (mach_header_t);
+
+    // Segments: __TEXT maps the header, __DATA holds the chain.
+    const char *names[] = { "__TEXT", "__DATA" };
+    for (int i = 0; i < 2; i++) {
+        mach_segment_command_64_t seg = { 0 };
+        seg.cmd = LC_SEGMENT_64;
+        seg.cmdsize = sizeof (mach_segment_command_64_t);
+        strncpy (seg.segname, names[i], sizeof (seg.segname));
+        seg.vmaddr = TEXT_VMADDR + i * DATA_FILEOFF;
+        seg.vmsize = DATA_FILEOFF;
+        seg.fileoff = i * DATA_FILEOFF;
+        seg.filesize = DATA_FILEOFF;
+        memcpy (data + off, &seg, sizeof (seg));
+        off += sizeof (seg);
+    }
+
+    mach_linkedit_data_command_t lc = { LC_DYLD_CHAINED_FIXUPS, sizeof (lc), FIXUPS_FILEOFF, 96 };
+    memcpy (data + off, &lc, sizeof (lc));
+    off += sizeof (lc);
+
+    mach_header_t hdr = { 0 };
+    hdr.magic = MACH_MAGIC_64;
+    hdr.cputype = CPU_TYPE_ARM64;
+    hdr.filetype = MACH_TYPE_EXECUTE;
+    hdr.ncmds = 3;
+    hdr.sizeofcmds = off - sizeof (mach_header_t);
+    memcpy (data, &hdr, sizeof (hdr));
+
+    // dyld_chained_fixups_header
+    uint8_t *fx = data + FIXUPS_FILEOFF;
+    put32 (fx + 4, STARTS_OFF);
+    put32 (fx + 8, IMPORTS_OFF);
+    put32 (fx + 12, SYMBOLS_OFF);
+    put32 (fx + 16, 2);
+    put32 (fx + 20, DYLD_CHAINED_IMPORT);
+
+    // dyld_chained_starts_in_image, with __DATA's starts 12 bytes in
+    uint8_t *starts = fx + STARTS_OFF;
+    put32 (starts, 2);
+    put32 (starts + 8, 12);
+
+    uint8_t *seg = starts + 12;
+    put32 (seg, 24);
+    put16 (seg + 4, 0x1000);
+    put16 (seg + 6, DYLD_CHAINED_PTR_ARM64E_KERNEL);
+    put64 (seg + 8, DATA_FILEOFF);
+    put16 (seg + 20, 1);
+    put16 (seg + 22, 0);
+
+    // Two imports, named "_a" and "_b"
+    put32 (fx + IMPORTS_OFF, 0 << 9);
+    put32 (fx + IMPORTS_OFF + 4, 3 << 9);
+    memcpy (fx + SYMBOLS_OFF, "_a\0_b", 6);
+
+    // The chain: a bind to "_a" whose next is 3, so 12 bytes on with a
+    // 4-byte stride, then a bind to "_b" that ends the chain.
+    put64 (data + DATA_FILEOFF, (1ULL << 62) | (3ULL << 51) | 0);
+    put64 (data + DATA_FILEOFF + 12, (1ULL << 62) | 1);
+
+    return data;
+}
+
+int main (void)
+{
+    uint8_t *data = build_macho ();
+    macho_t *macho = macho_create_from_buffer ("macho-fixups", data, FILE_SIZE);
+    if (!macho) {
+        printf ("FAIL: could not parse the test Mach-O\n");
+        return 1;
+    }
+
+    mach_fixups_t *fixups = mach_fixups_load (macho);
+    int fail = 0;
+
+    uint64_t data_vmaddr = TEXT_VMADDR + DATA_FILEOFF;
+    mach_bind_t *a = mach_fixups_find_bind (fixups, data_vmaddr);
+    mach_bind_t *b = mach_fixups_find_bind (fixups, data_vmaddr + 12);
+
+    if (fixups->nbinds != 2) {
+        printf ("FAIL: expected 2 binds, found %u\n", fixups->nbinds);
+        fail = 1;
+    }
+    if (!a || !a->name || strcmp (a->name, "_a")) {
+        printf ("FAIL: no bind to _a at 0x%llx\n", (unsigned long long) data_vmaddr);
+        fail = 1;
+    }
+    if (!b || !b->name || strcmp (b->name, "_b")) {
+        printf ("FAIL: no bind to _b at 0x%llx\n", (unsigned long long) data_vmaddr + 12);
+        fail = 1;
+    }
+
+    if (!fail)
+        printf ("ok: ARM64E_KERNEL chain walked with a 4-byte stride\n");
+
+    mach_fixups_free (fixups);
+    macho_free (macho);
+    free (data);
+    return fail;
+}
@@ -0,0 +1,154 @@
+//===----------------------------- macho-free.c --------------------------===//
+//
+//                                 macho-free
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  Copyright (C) 2019, Is This On?, @h3adsh0tzz
+//  me@h3adsh0tzz.com.
+//
+//
+//===-----------------------------------------------------------------------===//
+
+//
+//  Testing for macho_free(). Builds a Mach-O in memory with segments,
+//  sections, dylibs and other commands, plus a copy of it embedded further
+//  in, then parses and frees both. Built with AddressSanitizer where the
+//  compiler has it, so anything macho_free() misses fails the test.
+//
+
+#include <libhelper-macho/macho.h>
+#include <libhelper-macho/macho-command.h>
+#include <libhelper-macho/macho-command-types.h>
+#include <libhelper-macho/macho-segment.h>
+
+#define EMBED_OFFSET    0x1000
+#define FILE_SIZE       0x2000
+
+#define DYLIB_NAME_SIZE 32
+
+static uint32_t put_dylib (uint8_t *p, uint32_t cmd, const char *name)
+{
+    mach_dylib_command_t dylib = { 0 };
+    dylib.cmd = cmd;
+    dylib.cmdsize = sizeof (mach_dylib_command_t) + DYLIB_NAME_SIZE;
+    dylib.dylib.offset = sizeof (mach_dylib_command_t);
+    memcpy (p, &dylib, sizeof (dylib));
+    strncpy ((char *) p + sizeof (dylib), name, DYLIB_NAME_SIZE);
+    return dylib.cmdsize;
+}
+
+static void put_macho (uint8_t *data)
+{
+    uint32_t off = sizeof (mach_header_t);
+
+    // Segments: __TEXT with two sections, and an empty __DATA
+    const char *names[] = { "__TEXT", "__DATA" };
+    for (int i = 0; i < 2; i++) {
+        uint32_t nsects = (i == 0) ? 2 : 0;
+
+        mach_segment_command_64_t seg = { 0 };
+        seg.cmd = LC_SEGMENT_64;
+        seg.cmdsize = sizeof (mach_segment_command_64_t) + nsects * sizeof (mach_section_64_t);
+        strncpy (seg.segname, names[i], sizeof (seg.segname));
+        seg.vmaddr = 0x10000 + i * 0x1000;
+        seg.vmsize = 0x1000;
+        seg.nsects = nsects;
+        memcpy (data + off, &seg, sizeof (seg));
+        off += sizeof (seg);
+
+        for (uint32_t j = 0; j < nsects; j++) {
+            mach_section_64_t sect = { 0 };
+            strncpy (sect.sectname, (j == 0) ? "__text" : "__const", sizeof (sect.sectname));
+            strncpy (sect.segname, names[i], sizeof (sect.segname));
+            memcpy (data + off, &sect, sizeof (sect));
+            off += sizeof (sect);
+        }
+    }
+
+    off += put_dylib (data + off, LC_ID_DYLIB, "/usr/lib/libtest.dylib");
+    off += put_dylib (data + off, LC_LOAD_DYLIB, "/usr/lib/libSystem.B.dylib");
+
+    mach_uuid_command_t uuid = { 0 };
+    uuid.cmd = LC_UUID;
+    uuid.cmdsize = sizeof (uuid);
+    memcpy (data + off, &uuid, sizeof (uuid));
+    off += sizeof (uuid);
+
+    mach_header_t hdr = { 0 };
+    hdr.magic = MACH_MAGIC_64;
+    hdr.cputype = CPU_TYPE_ARM64;
+    hdr.filetype = MACH_TYPE_DYLIB;
+    hdr.ncmds = 5;
+    hdr.sizeofcmds = off - sizeof (mach_header_t);
+    memcpy (data, &hdr, sizeof (hdr));
+}
+
+static int check_macho (macho_t *macho, const char *what)
+{
+    int fail = 0;
+
+    if (h_slist_length (macho->scmds) != 2 || h_slist_length (macho->lcmds) != 3 ||
+        h_slist_length (macho->dylibs) != 2) {
+        printf ("FAIL: %s: expected 2 segments, 3 commands and 2 dylibs, found %d, %d and %d\n", what,
+                h_slist_length (macho->scmds), h_slist_length (macho->lcmds), h_slist_length (macho->dylibs));
+        fail = 1;
+    }
+
+    mach_segment_info_t *text = (mach_segment_info_t *) h_slist_nth_data (macho->scmds, 0);
+    if (!text || h_slist_length (text->sections) != 2) {
+        printf ("FAIL: %s: expected 2 sections in __TEXT\n", what);
+        fail = 1;
+    }
+
+    mach_dylib_command_info_t *dylib = (mach_dylib_command_info_t *) h_slist_nth_data (macho->dylibs, 1);
+    if (!dylib || strcmp (dylib->name, "/usr/lib/libSystem.B.dylib")) {
+        printf ("FAIL: %s: second dylib isn't libSystem\n", what);
+        fail = 1;
+    }
+    return fail;
+}
+
+int main (void)
+{
+    uint8_t *data = calloc (1, FILE_SIZE);
+    put_macho (data);
+    put_macho (data + EMBED_OFFSET);
+
+    macho_t *macho = macho_create_from_buffer ("macho-free", data, FILE_SIZE);
+    if (!macho) {
+        printf ("FAIL: could not parse the test Mach-O\n");
+        return 1;
+    }
+
+    macho_t *embedded = macho_create_embedded (macho, EMBED_OFFSET);
+    if (!embedded) {
+        printf ("FAIL: could not parse the embedded Mach-O\n");
+        return 1;
+    }
+
+    int fail = check_macho (macho, "container") | check_macho (embedded, "embedded");
+
+    // The view shares the container's data, so it goes first, and the
+    // data is still the caller's afterwards
+    macho_free (embedded);
+    macho_free (macho);
+    macho_free (NULL);
+    free (data);
+
+    if (!fail)
+        printf ("ok: parsed and freed both Mach-Os\n");
+    return fail;
+}
@@ -22,10 +22,29 @@
 //
 //===-----------------------------------------------------------------------===//
 
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <libhelper/libhelper.h>
+#include <libhelper/hhash.h>
+#include <libhelper/hhex.h>
+#include <libhelper/hidentify.h>
+#include <libhelper/hparallel.h>
+#include <libhelper/htrace.h>
+#include <libhelper/hwriter.h>
 #include <libhelper-macho/macho.h>
 #include <libhelper-macho/macho-command.h>
-#include <libhelper-macho/macho-segment.h> 
+#include <libhelper-macho/macho-segment.h>
+#include <libhelper-macho/macho-symbol.h>
+#include <libhelper-img4/sep.h>
+#include <libhelper-lzss/lzss.h>
+#include <libhelper-lzfse/lzfse.h>
 
 #ifdef __APPLE__
 #   define BUILD_TARGET         "darwin"
@@ -45,382 +64,944 @@
 /***********************************************************************
 * Libhelper's MachO-Helper-Toolset.
 *
-*   I thought I'd be a bit creative with this and follow the model
-*   of the iBoot source - build everything from a single file. So,
-*   the code compiled depends on what value is set below.
-*
-*   Each tool has it's own version number, in the simple format of:
-*   Major.Minor.Revision. The Toolset overall has it's own version
-*   too. I did this because I can keep track of things based on the
-*   version of the specific tool, and the toolset overall.
+*   Every tool is now a subcommand of one binary, `macho-helper`. Each
+*   file given is mapped once, and every subcommand on the command
+*   line works from that mapping, so `info + symbols` doesn't load the
+*   file twice. Files are handled in parallel, and the output of each
+*   is collected in memory and written in the order they were given.
 *
-*   The Toolset's version number is like libhelper, xxx.xx.x. 
+*   The Toolset's version number is like libhelper, xxx.xx.x.
 *
 ***********************************************************************/
-#define TOOLSET_VERS            "100.14.1"
-
-#define TOOL_SECT               0
-#define TOOL_SPLIT              0
-#define TOOL_DUMP               1
-
-#if TOOL_SECT
-#   define TOOL_VERS            "1.0.0"
-#   define TOOL_NAME            "macho-section"
-#elif TOOL_SPLIT
-#   define TOOL_VERS            "1.0.0"
-#   define TOOL_NAME            "macho-split"
-#elif TOOL_DUMP
-#   define TOOL_VERS            "1.0.0"
-#   define TOOL_NAME            "macho-dump"
-#endif
+#define TOOLSET_VERS            "100.15.0"
 
-#define FAT(p) ((*(unsigned int *)(p) & ~1) == 0xbebafeca)
+#define TOOL_VERS               "2.0.0"
+#define TOOL_NAME               "macho-helper"
+
+// Files handled per thread in each round, which bounds how much output
+// is held in memory before it is written.
+#define FILES_PER_THREAD        4
+
+// The complzss header: "comp", "lzss", adler32, sizes, padding, then the
+// compressed data.
+#define COMPLZSS_HEADER_SIZE    0x180
 
-#if TOOL_SPLIT
-struct archs {
-	size_t 	  size;
-	char	 *buf;
-	char	 *name;
-};
-#endif
 
 /**
- *  Prints the banner at the top of the output when the program is
- *  executed.
- * 
+ *  A file given on the command line. It is mapped once, and the Mach-O
+ *  view of the mapping is only parsed when a subcommand needs it.
  */
-void banner ()
+typedef struct input_t {
+    const char      *path;
+    const char      *name;          /* path relative to the walked root */
+    const char      *outdir;
+
+    file_t          *file;
+    uint8_t         *data;
+    size_t           size;
+    lh_identity_t    id;
+
+    macho_t         *macho;
+    int              macho_tried;
+} input_t;
+
+typedef int (*command_func) (h_writer_t *w, input_t *in, char **args);
+
+typedef struct command_t {
+    const char      *name;
+    int              nargs;
+    command_func     func;
+    const char      *usage;
+    const char      *desc;
+} command_t;
+
+/**
+ *  A subcommand from the command line, with its arguments.
+ */
+typedef struct step_t {
+    const command_t *cmd;
+    char           **args;
+} step_t;
+
+typedef struct job_t {
+    char           **paths;
+    const char     **names;
+    const char      *outdir;
+    step_t          *steps;
+    int              nsteps;
+
+    char           **bufs;
+    size_t          *lens;
+    int             *status;
+} job_t;
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Inputs                               									 --*/
+//===-----------------------------------------------------------------------===//
+
+static int input_open (input_t *in, const char *path, const char *name, const char *outdir)
 {
-    printf ("-----------------------------------------------------\n");
-    printf (" %s %s (macho-helper-%s) - Built " __TIMESTAMP__ "\n", TOOL_NAME, TOOL_VERS, TOOLSET_VERS);
-    printf ("-----------------------------------------------------\n");
+    memset (in, '\0', sizeof (input_t));
+    in->path = path;
+    in->name = name;
+    in->outdir = outdir;
+
+    in->file = file_load (path);
+    if (!in->file)
+        return -1;
+
+    in->data = file_map (in->file, 0);
+    if (!in->data)
+        return -1;
+
+    in->size = in->file->size;
+    lh_identify (in->data, in->size, &in->id);
+    return 0;
 }
 
+static void input_close (input_t *in)
+{
+    // The view only points into the mapping, which file_close() unmaps
+    if (in->macho)
+        macho_free (in->macho);
+    if (in->file)
+        file_close (in->file);
+}
 
 /**
- *  Prints detailed version information about the tool, toolset and 
- *  libhelper.
- * 
+ *  Parses the mapping as a thin Mach-O the first time a subcommand asks
+ *  for it. The macho_t uses the mapping as its data, rather than a copy.
  */
-void version ()
+static macho_t *input_macho (input_t *in)
 {
-    printf ("MachO-Helper %s Version %s (macho-helper-%s)\n", TOOL_NAME, TOOL_VERS, TOOLSET_VERS);
-    
-    printf ("  Build Time:\t\t" __TIMESTAMP__ "\n");
-    printf ("  Default Target:\t%s-%s\n", BUILD_TARGET, BUILD_ARCH);
-    printf ("  Libhelper:\t\t%s\n", LIBHELPER_VERSION_LONG);
-    printf ("  Toolset:\t\tmacho-helper-%s\n", TOOLSET_VERS);
+    if (!in->macho_tried) {
+        in->macho_tried = 1;
+        if (in->id.format == LH_FORMAT_MACHO && in->size <= UINT32_MAX)
+            in->macho = macho_create_from_buffer ((char *) in->path, in->data, (uint32_t) in->size);
+    }
+    return in->macho;
+}
+
+/**
+ *  Output files written so far in this run. Two inputs can map to the
+ *  same output name - the same file name under two directories given on
+ *  the command line - so each name is claimed before it's written, and
+ *  the second writer is refused rather than overwriting the first.
+ */
+static HHashTable      *outputs;
+static pthread_mutex_t  outputs_lock = PTHREAD_MUTEX_INITIALIZER;
 
+static int output_claim (char *name)
+{
+    pthread_mutex_lock (&outputs_lock);
+    if (!outputs)
+        outputs = h_hash_table_new (h_str_hash, h_str_equal);
+
+    int ok = !h_hash_table_contains (outputs, name);
+    if (ok)
+        h_hash_table_insert (outputs, strdup (name), (void *) 1);
+    pthread_mutex_unlock (&outputs_lock);
+    return ok;
 }
 
+/**
+ *  Creates the directories leading up to `name`, past `outdir`, which
+ *  must exist already.
+ */
+static int output_mkdirs (char *name, size_t outdir_len)
+{
+    for (char *p = name + outdir_len + 1; (p = strchr (p, '/')); p++) {
+        *p = '\0';
+        int ret = mkdir (name, 0755);
+        *p = '/';
+        if (ret && errno != EEXIST)
+            return -1;
+    }
+    return 0;
+}
 
 /**
- *  Help menu. Most of this is common across the different tools.
- * 
+ *  Builds the name of an output file, `outdir/<name>.suffix`, where the
+ *  name is the input's path relative to the directory it was found in,
+ *  or its file name if it was given directly. The directories under
+ *  `outdir` are created to match.
  */
-void help ()
+static char *input_outname (input_t *in, const char *suffix)
 {
-    banner ();
+    char *name = NULL;
+    if (asprintf (&name, "%s/%s.%s", in->outdir, in->name, suffix) < 0)
+        return NULL;
 
-    printf ("Usage: %s", TOOL_NAME);
-#if TOOL_SECT
-    printf (" FILE [segment] [section]\n\n");
-#elif TOOL_SPLIT
-    printf (" FILE\n\n");
-#elif TOOL_DUMP
-    printf (" FILE [start_addr] [end_addr | -s size]\n\n");
-#endif
+    if (output_mkdirs (name, strlen (in->outdir))) {
+        free (name);
+        return NULL;
+    }
+    return name;
+}
 
-    printf ("Other Options:\n");
-    printf ("  -h\tHelp Menu\n  -v\tVersion Info\n\n");
+static int input_write (h_writer_t *w, input_t *in, const char *suffix, const void *buf, size_t size)
+{
+    char *name = input_outname (in, suffix);
+    if (name && !output_claim (name)) {
+        h_writer_printf (w, "    error: %s was already written by another input\n", name);
+        free (name);
+        return -1;
+    }
+
+    int ok = (name && (size_t) file_write_new (name, (unsigned char *) buf, size) == size);
+
+    if (ok)
+        h_writer_printf (w, "    wrote 0x%zx bytes to %s\n", size, name);
+    else
+        h_writer_printf (w, "    error: could not write %s\n", (name) ? name : suffix);
+
+    free (name);
+    return (ok) ? 0 : -1;
+}
+
+static const char *arch_name (uint32_t cputype, uint32_t cpusubtype)
+{
+    if (cputype == CPU_TYPE_ARM64)
+        return ((cpusubtype & 0xff) == CPU_SUBTYPE_ARM64E) ? "arm64e" : "arm64";
+    return mach_header_read_cpu_type (cputype);
 }
 
 
-#if TOOL_SECT
+//===-----------------------------------------------------------------------===//
+/*-- Subcommands                          									 --*/
+//===-----------------------------------------------------------------------===//
+
+static void info_fat (h_writer_t *w, input_t *in)
+{
+    fat_header_t hdr;
+    memcpy (&hdr, in->data, sizeof (fat_header_t));
+    swap_header_bytes (&hdr);
+
+    for (uint32_t i = 0; i < hdr.nfat_arch; i++) {
+        size_t off = sizeof (fat_header_t) + i * sizeof (struct fat_arch);
+        if (off + sizeof (struct fat_arch) > in->size)
+            break;
+
+        struct fat_arch arch;
+        memcpy (&arch, in->data + off, sizeof (struct fat_arch));
+        swap_fat_arch_bytes (&arch);
+
+        h_writer_printf (w, "    arch %-8s offset 0x%08x  size 0x%08x  align 2^%u\n",
+                         arch_name (arch.cputype, arch.cpusubtype), arch.offset, arch.size, arch.align);
+    }
+}
+
+static void info_macho (h_writer_t *w, macho_t *macho)
+{
+    for (HSList *s = macho->scmds; s; s = s->next) {
+        mach_segment_command_64_t *seg = ((mach_segment_info_t *) s->data)->segcmd;
+
+        h_writer_printf (w, "    segment %-16.16s vmaddr 0x%016llx  vmsize 0x%08llx  fileoff 0x%08llx  filesize 0x%08llx  %c%c%c\n",
+                         seg->segname, (unsigned long long) seg->vmaddr, (unsigned long long) seg->vmsize,
+                         (unsigned long long) seg->fileoff, (unsigned long long) seg->filesize,
+                         (seg->initprot & 1) ? 'r' : '-', (seg->initprot & 2) ? 'w' : '-', (seg->initprot & 4) ? 'x' : '-');
+
+        for (HSList *l = ((mach_segment_info_t *) s->data)->sections; l; l = l->next) {
+            mach_section_64_t *sect = (mach_section_64_t *) l->data;
+            h_writer_printf (w, "        section %-16.16s addr 0x%016llx  size 0x%08llx  offset 0x%08x\n",
+                             sect->sectname, (unsigned long long) sect->addr, (unsigned long long) sect->size,
+                             sect->offset);
+        }
+    }
+
+    for (HSList *l = macho->dylibs; l; l = l->next) {
+        mach_dylib_command_info_t *info = (mach_dylib_command_info_t *) l->data;
+        uint32_t v = info->dylib->dylib.current_version;
+        h_writer_printf (w, "    dylib %s (%u.%u.%u)\n", (info->name) ? info->name : "",
+                         v >> 16, (v >> 8) & 0xff, v & 0xff);
+    }
+}
+
 /**
- *  Main flow for the macho-sect tool.
- * 
+ *  info
+ *
+ *  The format of the file, and for a Mach-O its segments, sections and
+ *  dylibs.
  */
-int section_main (int argc, char *argv[])
+static int cmd_info (h_writer_t *w, input_t *in, char **args)
 {
-    // Filename, segment and section opts
-    char *filename = argv[1];
-    char *segment = argv[2];
-    char *section = argv[3];
+    (void) args;
+
+    lh_identity_t *id = &in->id;
+
+    switch (id->format) {
+        case LH_FORMAT_MACHO:
+            h_writer_printf (w, "    Mach-O %s-bit %s %s, %u load commands\n", (id->is64) ? "64" : "32",
+                             mach_header_read_file_type_short (id->filetype),
+                             arch_name (id->cputype, id->cpusubtype), id->ncmds);
+            if (input_macho (in))
+                info_macho (w, in->macho);
+            break;
+        case LH_FORMAT_FAT:
+            h_writer_printf (w, "    Mach-O Universal Binary, %u architectures\n", id->narchs);
+            info_fat (w, in);
+            break;
+        case LH_FORMAT_DYLD_CACHE:
+            h_writer_printf (w, "    dyld shared cache %s\n", id->arch);
+            break;
+        case LH_FORMAT_IMG4:
+        case LH_FORMAT_IM4P:
+            h_writer_printf (w, "    %s \"%s\", payload %s\n", lh_format_string (id->format), id->tag,
+                             lh_format_string (id->payload));
+            break;
+        case LH_FORMAT_COMPLZSS:
+        case LH_FORMAT_LZFSE:
+            h_writer_printf (w, "    %s, 0x%x bytes uncompressed\n", lh_format_string (id->format), id->uncompressed_size);
+            break;
+        default:
+            h_writer_printf (w, "    %s\n", lh_format_string (id->format));
+            break;
+    }
+    return 0;
+}
 
-    // Check they are all set
-    if ( !filename || !segment || !section )
-        goto SECT_ERROR;
+/**
+ *  section SEGMENT SECTION
+ *
+ *  Writes the section's contents to <file>.SEGMENT.SECTION.data.
+ */
+static int cmd_section (h_writer_t *w, input_t *in, char **args)
+{
+    macho_t *macho = input_macho (in);
+    if (!macho) {
+        h_writer_printf (w, "    error: not a thin Mach-O\n");
+        return -1;
+    }
 
-    // Load the file as a Mach-O
-    macho_t *macho = macho_load (filename);
+    mach_segment_info_t *seg = (macho->scmds) ? mach_segment_info_search (macho->scmds, args[0]) : NULL;
+    mach_section_64_t *sect = (seg) ? mach_section_from_segment_info (seg, args[1]) : NULL;
+    if (!sect) {
+        h_writer_printf (w, "    error: no section %s.%s\n", args[0], args[1]);
+        return -1;
+    }
 
-    // Log that we are looking for the section
-    printf ("Attempting to seperate %s.%s from %s\n", segment, section, filename);
+    if (sect->offset > in->size || sect->size > in->size - sect->offset) {
+        h_writer_printf (w, "    error: %s.%s is not in the file\n", args[0], args[1]);
+        return -1;
+    }
 
-    // Find the section
-    mach_section_info_t *section_inf = mach_section_info_from_name (macho, segment, section);
+    char suffix[64];
+    snprintf (suffix, sizeof (suffix), "%s.%s.data", args[0], args[1]);
+    return input_write (w, in, suffix, in->data + sect->offset, sect->size);
+}
 
-    // Check if the section was valid
-    if ( !section_inf )
-        goto SECT_ERROR;
+/**
+ *  split
+ *
+ *  Writes each slice of a Universal binary to <file>.<arch>.
+ */
+static int cmd_split (h_writer_t *w, input_t *in, char **args)
+{
+    (void) args;
 
-    // Load bytes from the section
-    unsigned char *section_data = macho_load_bytes (macho, section_inf->size, section_inf->addr);
+    if (in->id.format != LH_FORMAT_FAT) {
+        h_writer_printf (w, "    error: not a Universal / FAT file\n");
+        return -1;
+    }
 
-    // Setup the filename to write to
-    size_t sout = strlen (segment) + strlen (section) + 6;
-    char *outfile = malloc (sout);
-    snprintf (outfile, sout, "%s.%s.data", segment, section);
+    fat_header_t hdr;
+    memcpy (&hdr, in->data, sizeof (fat_header_t));
+    swap_header_bytes (&hdr);
 
-    // Try to write the file
-    int fd = file_write_new (outfile, section_data, section_inf->size);
-    if ( !fd )
-        goto SECT_ERROR;
+    int ret = 0;
+    for (uint32_t i = 0; i < hdr.nfat_arch; i++) {
+        size_t off = sizeof (fat_header_t) + i * sizeof (struct fat_arch);
+        if (off + sizeof (struct fat_arch) > in->size)
+            break;
+
+        struct fat_arch arch;
+        memcpy (&arch, in->data + off, sizeof (struct fat_arch));
+        swap_fat_arch_bytes (&arch);
+
+        const char *name = arch_name (arch.cputype, arch.cpusubtype);
+        if (arch.offset > in->size || arch.size > in->size - arch.offset) {
+            h_writer_printf (w, "    error: the %s slice is not in the file\n", name);
+            ret = -1;
+            continue;
+        }
 
-    // Print success
-    printf ("Wrote file to %s\n", outfile);
+        if (input_write (w, in, name, in->data + arch.offset, arch.size))
+            ret = -1;
+    }
+    return ret;
+}
 
-    // Return
-    return fd;
+/**
+ *  dump START END
+ *  dump START -s SIZE
+ *
+ *  Hexdump of a range of the file.
+ */
+static int cmd_dump (h_writer_t *w, input_t *in, char **args)
+{
+    uint64_t start = strtoull (args[0], NULL, 0);
+    uint64_t size = (!strcmp (args[1], "-s")) ? strtoull (args[2], NULL, 0)
+                                              : strtoull (args[1], NULL, 0) - start;
 
+    if (start > in->size || size > in->size - start) {
+        h_writer_printf (w, "    error: range 0x%llx - 0x%llx is outside of the file (0x%zx bytes)\n",
+                         (unsigned long long) start, (unsigned long long) (start + size), in->size);
+        return -1;
+    }
 
-SECT_ERROR:
-    printf ("Unable to split %s.%s from %s\n", segment, section, filename);
-    return -1;
+    h_hexdump (w, in->data + start, size, start);
+    return 0;
 }
-#endif
-
 
-#if TOOL_SPLIT
 /**
- *  Main flow for the macho-split tool.
- * 
+ *  A letter for a symbol's type, in the style of nm. `sects` holds the
+ *  sections by their 1-based index.
  */
-int split_main (int argc, char *argv[])
+static char symbol_letter (mach_section_64_t **sects, mach_symbol_info_t *sym)
 {
-    // Get the filename
-    char *filename = argv[1];
-
-    // Create a file and load it's data and size
-    file_t *file = file_load (filename);
-    
-    uint32_t size = file->size;
-    unsigned char *data = (unsigned char *) file_load_bytes (file, size, 0);
-
-    // Ensure that it is a Universal/FAT file
-    if ( !FAT (data) ) {
-        printf ("File is not a Universal / FAT file.\n");
-        goto SPLIT_ERROR;
-    }
-
-    // Try to detect the architecture contained within the file
-    fat_header_info_t *fat_info = mach_universal_load (file);
-
-    // Create a list of archs to write to a file
-    HSList *arch_list = NULL;
-
-    // Go through each arch and print the details like $ file ...
-    for (int i = 0; i < h_slist_length (fat_info->archs); i++) {
-
-        // Check the current arch
-        struct fat_arch *arch = (struct fat_arch *) h_slist_nth_data (fat_info->archs, i);
-        char *arch_name = NULL;
-
-        // Check for arm64e
-        ///////////////////////////////////
-        //  Implement this in libhelper  //
-        ///////////////////////////////////
-        if ( arch->cputype == CPU_TYPE_ARM64 ) {
-            arch_name = "arm64";
-            if ( arch->cpusubtype == CPU_SUBTYPE_ARM64E )
-                arch_name = "arm64e";
-        } else {
-            arch_name = mach_header_read_cpu_type (arch->cputype);
+    char c;
+
+    if (sym->type & N_STAB)
+        return '-';
+
+    switch (sym->type & N_TYPE) {
+        case N_UNDF:
+            c = (sym->value) ? 'C' : 'U';
+            break;
+        case N_ABS:
+            c = 'A';
+            break;
+        case N_INDR:
+            c = 'I';
+            break;
+        case N_SECT: {
+            mach_section_64_t *sect = sects[sym->sect];
+            c = 'S';
+            if (sect && !strncmp (sect->sectname, "__text", 16))
+                c = 'T';
+            else if (sect && !strncmp (sect->sectname, "__data", 16))
+                c = 'D';
+            else if (sect && !strncmp (sect->sectname, "__bss", 16))
+                c = 'B';
+            break;
         }
+        default:
+            c = '?';
+            break;
+    }
+
+    return (sym->type & N_EXT) ? c : (char) tolower (c);
+}
+
+/**
+ *  symbols
+ *
+ *  The symbol table, one symbol per line.
+ */
+static int cmd_symbols (h_writer_t *w, input_t *in, char **args)
+{
+    (void) args;
 
-        // Print arch info
-        mach_header_t *hdr = malloc (sizeof (mach_header_t));
-        memset (hdr, '\0', sizeof (mach_header_t));
-        memcpy (hdr, data + arch->offset, sizeof (mach_header_t));
+    macho_t *macho = input_macho (in);
+    if (!macho) {
+        h_writer_printf (w, "    error: not a thin Mach-O\n");
+        return -1;
+    }
+
+    // n_sect is 1-based, and there can be at most 255 sections
+    mach_section_64_t *sects[256] = { NULL };
+    int nsects = 0;
+    for (HSList *s = macho->scmds; s; s = s->next)
+        for (HSList *l = ((mach_segment_info_t *) s->data)->sections; l && nsects < 255; l = l->next)
+            sects[++nsects] = (mach_section_64_t *) l->data;
 
-        if ( hdr->magic == MACH_MAGIC_64 || hdr->magic == MACH_CIGAM_64 )
-       		printf ("\t%s (for architecture %s):\tMach-O 64-bit %s %s\n", file->path, arch_name, mach_header_read_file_type_short (hdr->filetype), arch_name);
-        else if (hdr->magic == MACH_MAGIC_32 || hdr->magic == MACH_CIGAM_32)
-            printf ("\t%s (for architecture %s):\tMach-O 32-bit %s %s\n", file->path, arch_name, mach_header_read_file_type_short (hdr->filetype), arch_name);
+    uint32_t count = 0;
+    mach_symbol_info_t *syms = mach_symtab_load_symbol_info (macho, &count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        char c = symbol_letter (sects, &syms[i]);
+        if (c == 'U' || c == 'u')
+            h_writer_printf (w, "    %16s %c %s\n", "", c, syms[i].name);
         else
-            printf ("\tunknown: 0x%x\n", hdr->magic);
+            h_writer_printf (w, "    %016llx %c %s\n", (unsigned long long) syms[i].value, c, syms[i].name);
+    }
 
-        // Add to the archs list
-        struct archs *tmp = malloc (sizeof(struct archs));
-		tmp->size = arch->size;
-		tmp->name = arch_name;
+    free (syms);
+    return 0;
+}
 
-        tmp->buf = malloc (arch->size);
-		memset (tmp->buf, '\0', arch->size);
-		memcpy (tmp->buf, data + arch->offset, arch->size);
+/**
+ *  sep-split
+ *
+ *  Splits SEP firmware into sepdumpNN_name files in the current
+ *  directory. The splitter keeps global state and prints as it goes, so
+ *  files are run one at a time when this is used.
+ */
+static int cmd_sep_split (h_writer_t *w, input_t *in, char **args)
+{
+    (void) args;
 
-		arch_list = h_slist_append (arch_list, tmp);
-		arch_name = NULL;
+    if (in->id.format != LH_FORMAT_SEP) {
+        h_writer_printf (w, "    error: not SEP firmware\n");
+        return -1;
     }
 
-    // Now write each extracted arch to a file
-	for (int i = 0; i < (int) h_slist_length (arch_list); i++) {
-		struct archs *tmp = (struct archs *) h_slist_nth_data (arch_list, i);
+    // Anything before this has to be out before the splitter prints
+    h_writer_flush (w);
+    sep_split_buffer (in->data, in->size);
+    fflush (stdout);
+    return 0;
+}
 
-		// Create filename
-        char outname[25];
-        snprintf (outname, 25, "macho-split%02d.%s", i, tmp->name);
-		printf ("[*] %s", outname);
+static uint8_t *decompress_lzfse (const uint8_t *src, size_t srclen, size_t hint, size_t *outlen)
+{
+    // The header only gives the size of the first block, so grow until
+    // the whole stream fits.
+    size_t cap = (hint > srclen * 4) ? hint : srclen * 4;
+    for (;;) {
+        uint8_t *dst = malloc (cap);
+        if (!dst)
+            return NULL;
+
+        size_t n = lzfse_decode_buffer (dst, cap, src, srclen, NULL);
+        if (n < cap) {
+            *outlen = n;
+            return dst;
+        }
+        free (dst);
+        cap *= 2;
+    }
+}
 
-		FILE *fptr = fopen (outname, "wb");
-		fwrite (tmp->buf, tmp->size, 1, fptr);
-		fclose (fptr);
+/**
+ *  decompress
+ *
+ *  Decompresses a complzss or LZFSE file, or an IM4P with one of those
+ *  as its payload, to <file>.dec.
+ */
+static int cmd_decompress (h_writer_t *w, input_t *in, char **args)
+{
+    (void) args;
 
-		printf (" \t...done\n");
-	}
+    const uint8_t *src = in->data;
+    size_t srclen = in->size;
+    lh_format_t format = in->id.format;
 
-    return 0;
+    if (format == LH_FORMAT_IM4P || format == LH_FORMAT_IMG4) {
+        format = in->id.payload;
+        src += in->id.payload_offset;
+        srclen -= in->id.payload_offset;
+    }
+
+    lh_identity_t id;
+    lh_identify (src, srclen, &id);
+
+    uint8_t *dst = NULL;
+    size_t len = 0;
+
+    if (format == LH_FORMAT_COMPLZSS && srclen > COMPLZSS_HEADER_SIZE) {
+        size_t clen = srclen - COMPLZSS_HEADER_SIZE;
+        if (id.compressed_size && id.compressed_size < clen)
+            clen = id.compressed_size;
+
+        // The decoder doesn't bound its output, so make room for the most
+        // a corrupt stream could expand to: 18 bytes from every 2.
+        size_t cap = clen * 9 + 18;
+        if (cap < id.uncompressed_size)
+            cap = id.uncompressed_size;
+
+        dst = malloc (cap);
+        if (dst)
+            len = decompress_lzss (dst, (uint8_t *) src + COMPLZSS_HEADER_SIZE, (uint32_t) clen);
+
+        if (dst && len != id.uncompressed_size)
+            h_writer_printf (w, "    warning: got 0x%zx bytes, expected 0x%x\n", len, id.uncompressed_size);
+
+    } else if (format == LH_FORMAT_LZFSE) {
+        dst = decompress_lzfse (src, srclen, id.uncompressed_size, &len);
+    } else {
+        h_writer_printf (w, "    error: not complzss or LZFSE compressed\n");
+        return -1;
+    }
+
+    if (!dst || !len) {
+        h_writer_printf (w, "    error: could not decompress\n");
+        free (dst);
+        return -1;
+    }
 
-SPLIT_ERROR:
-    printf ("Unable to split architectures from file %s\n", filename);
-    return -1;
+    int ret = input_write (w, in, "dec", dst, len);
+    free (dst);
+    return ret;
+}
+
+
+static const command_t commands[] = {
+    { "info",       0, cmd_info,        "info",                         "Format, segments, sections and dylibs" },
+    { "section",    2, cmd_section,     "section SEGMENT SECTION",      "Extract a section to FILE.SEGMENT.SECTION.data" },
+    { "split",      0, cmd_split,       "split",                        "Split a Universal binary into FILE.ARCH" },
+    { "dump",       2, cmd_dump,        "dump START (END | -s SIZE)",   "Hexdump a range of the file" },
+    { "symbols",    0, cmd_symbols,     "symbols",                      "List the symbol table" },
+    { "sep-split",  0, cmd_sep_split,   "sep-split",                    "Split SEP firmware into sepdumpNN_name" },
+    { "decompress", 0, cmd_decompress,  "decompress",                   "Decompress complzss / LZFSE to FILE.dec" },
+};
+
+#define NCOMMANDS   (sizeof (commands) / sizeof (commands[0]))
+
+static const command_t *command_find (const char *name)
+{
+    for (size_t i = 0; i < NCOMMANDS; i++)
+        if (!strcmp (commands[i].name, name))
+            return &commands[i];
+    return NULL;
 }
-#endif
 
 
-#if TOOL_DUMP
+//===-----------------------------------------------------------------------===//
+/*-- Running                              									 --*/
+//===-----------------------------------------------------------------------===//
+
 /**
- *  Main flow for the macho-dump tool.
- * 
+ *  Runs every step on one file, with the output going to `w`. Returns
+ *  non-zero if any step failed.
  */
-int dump_main (int argc, char *argv[])
+static int run_input (h_writer_t *w, job_t *job, const char *path, const char *name)
 {
-    // If we are here, no options were given.
-    char *filename = argv[1];
-    uint32_t start = (uint32_t) strtol (argv[2], NULL, 0);
-    uint32_t a2 = (uint32_t) strtol (argv[3], NULL, 0);
-    uint32_t size = 0;
-
-    macho_t *macho = macho_create ();
-    unsigned char *dump = NULL;
-
-    macho = macho_load (filename);
-    uint32_t offset = macho->offset;
-    printf ("Filename: %s\nOffset: 0x%x\n", macho->path, offset);
-    
-    if (!strcmp (argv[3], "-s")) {
-        // use a size
-        size = a2;
+    input_t in;
+    int ret = 0;
+
+    h_writer_printf (w, "%s:\n", path);
+
+    if (input_open (&in, path, name, job->outdir)) {
+        h_writer_printf (w, "    error: could not load the file\n");
+        ret = 1;
     } else {
-        size = a2 - start;
+        for (int i = 0; i < job->nsteps; i++)
+            if (job->steps[i].cmd->func (w, &in, job->steps[i].args))
+                ret = 1;
     }
-    printf ("Size: %d\n", size);
-    
-    dump = malloc (size);
-    
-    memset (dump, '\0', size);
-    memcpy (dump, macho->data + offset, size);
 
-    if (dump == NULL) {
-        errorf ("Something went wrong\n");
-        return -1;
+    input_close (&in);
+    return ret;
+}
+
+static void run_worker (size_t index, void *user_data)
+{
+    job_t *job = (job_t *) user_data;
+
+    h_writer_t w;
+    h_writer_init (&w, -1, 64 * 1024);
+
+    job->status[index] = run_input (&w, job, job->paths[index], job->names[index]);
+    job->bufs[index] = h_writer_take (&w, &job->lens[index]);
+}
+
+/**
+ *  Runs the job over `count` files, `nthreads` at a time, and returns the
+ *  number that failed. The output of each round is written in order once
+ *  the whole round is done. With `serial` set, files are run one by one
+ *  on this thread, straight to stdout.
+ */
+static int run_files (job_t *job, size_t count, int nthreads, int serial)
+{
+    int failed = 0;
+
+    if (serial) {
+        h_writer_t out;
+        h_writer_init (&out, STDOUT_FILENO, 0);
+        for (size_t i = 0; i < count; i++) {
+            failed += run_input (&out, job, job->paths[i], job->names[i]);
+            h_writer_flush (&out);
+            fflush (stdout);
+        }
+        h_writer_finish (&out);
+        return failed;
     }
 
-    // hexdump
-    uint8_t hex_off = 0;
-    int lines = size / 8;
-    int pos = 0;
+    size_t round = (size_t) ((nthreads > 0) ? nthreads : h_parallel_ncpus ()) * FILES_PER_THREAD;
+    char **paths = job->paths;
+    const char **names = job->names;
 
-    for (int i = 0; i < lines; i++) {
-	printf ("%08x  ", hex_off);
+    job->bufs = calloc (round, sizeof (char *));
+    job->lens = calloc (round, sizeof (size_t));
+    job->status = calloc (round, sizeof (int));
 
-	uint8_t ln[16];
+    h_writer_t out;
+    h_writer_init (&out, STDOUT_FILENO, 0);
 
-	int j;
-	for (j = 0; j < 16; j++) {
-	    uint8_t byte = (uint8_t) dump[pos];
-	    printf ("%02x ", byte);
+    for (size_t base = 0; base < count; base += round) {
+        size_t n = (count - base < round) ? count - base : round;
 
-	    if (j == 7) printf (" ");
+        job->paths = paths + base;
+        job->names = names + base;
+        h_parallel_for (n, nthreads, run_worker, job);
+
+        // Anything the library printed goes out before the round
+        fflush (stdout);
+        for (size_t i = 0; i < n; i++) {
+            h_writer_write (&out, job->bufs[i], job->lens[i]);
+            failed += job->status[i];
+            free (job->bufs[i]);
+        }
+        h_writer_flush (&out);
+    }
 
-	    pos++;
-	    ln[j] = byte;
-	}
+    job->paths = paths;
+    job->names = names;
+    h_writer_finish (&out);
+    free (job->bufs);
+    free (job->lens);
+    free (job->status);
+    return failed;
+}
 
-	printf ("  |");
 
-	for (int k = 0; k < 16; k++) {
-	    if (ln[k] < 0x20 || ln[k] > 0x7e)
-		    printf ( "." );
-	    else
-		    printf ( "%c", (char) ln[k]);
-	}
+//===-----------------------------------------------------------------------===//
+/*-- Collecting files                     									 --*/
+//===-----------------------------------------------------------------------===//
 
-	printf ("|\n");
-	    hex_off += 0x10;
+/**
+ *  The files to run on. `names` are what output files are named after,
+ *  and point into `paths`.
+ */
+typedef struct pathlist_t {
+    char           **paths;
+    const char     **names;
+    size_t           count;
+    size_t           cap;
+} pathlist_t;
+
+static void pathlist_add (pathlist_t *list, char *path, const char *name)
+{
+    if (list->count == list->cap) {
+        list->cap = (list->cap) ? list->cap * 2 : 64;
+        list->paths = realloc (list->paths, list->cap * sizeof (char *));
+        list->names = realloc (list->names, list->cap * sizeof (char *));
     }
+    list->paths[list->count] = path;
+    list->names[list->count++] = name;
+}
 
-    printf ("\n");
+static int path_compare (const void *a, const void *b)
+{
+    return strcmp (*(char * const *) a, *(char * const *) b);
+}
 
-    
-    // write to file
-    printf ("Writing %d bytes to outfile.data\n", size);
-    FILE *fptr = fopen ("outfile.data", "wb");
-    fwrite (dump, sizeof (char), size, fptr);
-    fclose (fptr);
+/**
+ *  Adds the regular files under `dir`, sorted by name in each directory.
+ *  Symbolic links to directories aren't followed. Each file is named by
+ *  its path past the first `rootlen` bytes, the directory the walk
+ *  started from.
+ */
+static void collect_dir (pathlist_t *list, const char *dir, size_t rootlen)
+{
+    DIR *d = opendir (dir);
+    if (!d) {
+        warningf ("Could not open directory %s\n", dir);
+        return;
+    }
+
+    pathlist_t here = { NULL, NULL, 0, 0 };
+    struct dirent *ent;
+    while ((ent = readdir (d))) {
+        if (!strcmp (ent->d_name, ".") || !strcmp (ent->d_name, ".."))
+            continue;
+
+        char *path = NULL;
+        if (asprintf (&path, "%s/%s", dir, ent->d_name) >= 0)
+            pathlist_add (&here, path, NULL);
+    }
+    closedir (d);
+
+    qsort (here.paths, here.count, sizeof (char *), path_compare);
+
+    for (size_t i = 0; i < here.count; i++) {
+        struct stat st;
+        if (lstat (here.paths[i], &st) == 0 && S_ISDIR (st.st_mode)) {
+            collect_dir (list, here.paths[i], rootlen);
+            free (here.paths[i]);
+        } else if (stat (here.paths[i], &st) == 0 && S_ISREG (st.st_mode)) {
+            const char *name = here.paths[i] + rootlen;
+            while (*name == '/')
+                name++;
+            pathlist_add (list, here.paths[i], name);
+        } else {
+            free (here.paths[i]);
+        }
+    }
+    free (here.paths);
+    free (here.names);
+}
+
+static void collect (pathlist_t *list, char *path)
+{
+    struct stat st;
+    if (stat (path, &st) == 0 && S_ISDIR (st.st_mode)) {
+        collect_dir (list, path, strlen (path));
+    } else {
+        char *copy = strdup (path);
+        const char *base = strrchr (copy, '/');
+        pathlist_add (list, copy, (base) ? base + 1 : copy);
+    }
+}
+
+
+//===-----------------------------------------------------------------------===//
+/*-- Main                                 									 --*/
+//===-----------------------------------------------------------------------===//
+
+/**
+ *  Prints the banner at the top of the output when the program is
+ *  executed.
+ *
+ */
+void banner ()
+{
+    printf ("-----------------------------------------------------\n");
+    printf (" %s %s (macho-helper-%s) - Built " __TIMESTAMP__ "\n", TOOL_NAME, TOOL_VERS, TOOLSET_VERS);
+    printf ("-----------------------------------------------------\n");
+}
+
+
+/**
+ *  Prints detailed version information about the tool, toolset and
+ *  libhelper.
+ *
+ */
+void version ()
+{
+    printf ("MachO-Helper %s Version %s (macho-helper-%s)\n", TOOL_NAME, TOOL_VERS, TOOLSET_VERS);
+
+    printf ("  Build Time:\t\t" __TIMESTAMP__ "\n");
+    printf ("  Default Target:\t%s-%s\n", BUILD_TARGET, BUILD_ARCH);
+    printf ("  Libhelper:\t\t%s\n", LIBHELPER_VERSION_LONG);
+    printf ("  Toolset:\t\tmacho-helper-%s\n", TOOLSET_VERS);
 
-    return 0;
 }
-#endif
 
 
 /**
- *  These tools aren't meant to be big, I'd like to keep them all to
- *  one file.
- * 
+ *  Help menu.
+ *
  */
+void help ()
+{
+    banner ();
+
+    printf ("Usage: %s [options] COMMAND [+ COMMAND ...] FILE|DIR ...\n\n", TOOL_NAME);
+
+    printf ("Commands:\n");
+    for (size_t i = 0; i < NCOMMANDS; i++)
+        printf ("  %-28s%s\n", commands[i].usage, commands[i].desc);
+
+    printf ("\nCommands joined with '+' all run on one load of each file. Directories\n");
+    printf ("are searched for files, and output is in the order the files are given.\n");
+    printf ("Files extracted from a directory's files keep their path under it.\n\n");
+
+    printf ("Options:\n");
+    printf ("  -j N\tNumber of threads (default: one per CPU)\n");
+    printf ("  -o DIR\tDirectory for extracted files (default: .)\n");
+    printf ("  -t FILE\tWrite a Chrome trace of the run to FILE\n");
+    printf ("  -h\tHelp Menu\n  -v\tVersion Info\n\n");
+}
+
+
 int main (int argc, char *argv[])
 {
+    int nthreads = 0;
+    const char *outdir = ".";
+    const char *trace = NULL;
+
     // If there is less than two args, don't bother
     if (argc < 2) {
         help ();
         return -1;
     }
 
-    // Check for the -v or -v options
-    for (int i = 1; i < argc; i++) {
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
         if (!strcmp (argv[i], "-h")) {
             help ();
             return 0;
         } else if (!strcmp (argv[i], "-v")) {
             version ();
             return 0;
-     	}
+        } else if (!strcmp (argv[i], "-j") && i + 1 < argc) {
+            nthreads = atoi (argv[++i]);
+        } else if (!strcmp (argv[i], "-o") && i + 1 < argc) {
+            outdir = argv[++i];
+        } else if (!strcmp (argv[i], "-t") && i + 1 < argc) {
+            trace = argv[++i];
+        } else {
+            errorf ("Unknown option: %s\n", argv[i]);
+            help ();
+            return -1;
+        }
+    }
+
+    // Commands, each with its arguments, joined by '+'
+    step_t *steps = calloc (argc, sizeof (step_t));
+    int nsteps = 0, serial = 0;
+
+    while (i < argc) {
+        const command_t *cmd = command_find (argv[i]);
+        if (!cmd) {
+            errorf ("Unknown command: %s\n", argv[i]);
+            help ();
+            return -1;
+        }
+
+        int nargs = cmd->nargs;
+        if (cmd->func == cmd_dump && i + 2 < argc && !strcmp (argv[i + 2], "-s"))
+            nargs = 3;
+        if (i + nargs >= argc) {
+            errorf ("Usage: %s %s FILE ...\n", TOOL_NAME, cmd->usage);
+            return -1;
+        }
+
+        steps[nsteps].cmd = cmd;
+        steps[nsteps].args = &argv[i + 1];
+        nsteps++;
+        if (cmd->func == cmd_sep_split)
+            serial = 1;
+
+        i += 1 + nargs;
+        if (i < argc && !strcmp (argv[i], "+"))
+            i++;
+        else
+            break;
     }
 
-#if TOOL_DUMP || TOOL_SECT
-    // Make sure no less than 4 args are given
-    if (argc < 4) {
+    if (!nsteps || i >= argc) {
         help ();
         return -1;
     }
-#endif
 
-    // Print the banner and begin
-    banner ();
+    pathlist_t files = { NULL, NULL, 0, 0 };
+    for (; i < argc; i++)
+        collect (&files, argv[i]);
 
-    // Return code
-    int ret = 0;
+    if (trace)
+        h_trace_enable ();
 
-#if TOOL_SECT
-    ret = section_main (argc, argv);
-#elif TOOL_SPLIT
-    ret = split_main (argc, argv);
-#elif TOOL_DUMP
-    ret = dump_main (argc, argv);
-#endif
+    job_t job = { 0 };
+    job.paths = files.paths;
+    job.names = files.names;
+    job.outdir = outdir;
+    job.steps = steps;
+    job.nsteps = nsteps;
 
-    // Return and exit
-    return ret;
-}
\ No newline at end of file
+    int failed = run_files (&job, files.count, nthreads, serial);
+
+    if (trace && h_trace_write (trace))
+        errorf ("Could not write the trace to %s\n", trace);
+
+    for (size_t f = 0; f < files.count; f++)
+        free (files.paths[f]);
+    free (files.paths);
+    free (files.names);
+    free (steps);
+
+    return (failed) ? 1 : 0;
+}